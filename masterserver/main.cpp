@@ -54,7 +54,11 @@
 #include "network.h"
 #include "main.h"
 #include <sstream>
-#include <set>
+#include <cerrno>
+#include <cctype>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 // [BB] Needed for I_GetTime.
 #ifdef _MSC_VER
@@ -67,24 +71,17 @@
 //*****************************************************************************
 //	VARIABLES
 
-// [BB] Comparision function, necessary to put SERVER_s entries into a std::set.
-class SERVERCompFunc
-{
-public:
-	bool operator()(SERVER_s s1, SERVER_s s2) const
-	{
-		// [BB] NETWORK_AddressToString uses a static char array to generate the string, so we
-		// need to cache the string conversion of the first string when comparing to two.
-		// Note: Because we need a "<" comparison and not a "!=" comparison we can't use
-		// NETWORK_CompareAddress.
-		std::string address1 = s1.Address.ToString();
-		return ( stricmp ( address1.c_str(), s2.Address.ToString() ) < 0 );
-	}
-};
+// Servers, keyed by MASTERSERVER_GetServerKey.
+typedef std::unordered_map<QWORD, SERVER_s> ServerMap;
 
 // Global server list.
-static	std::set<SERVER_s, SERVERCompFunc> g_Servers;
-static	std::set<SERVER_s, SERVERCompFunc> g_UnverifiedServers;
+static	ServerMap				g_Servers;
+static	ServerMap				g_UnverifiedServers;
+
+// The packets we answer launcher challenges with. They only change when the server list
+// does, so they're built on demand and thrown away when the list changes.
+static	std::vector<std::vector<BYTE> >	g_CachedServerListPackets;
+static	std::vector<std::vector<BYTE> >	g_CachedServerListPartPackets;
 
 // Message buffer we write our commands to.
 static	NETBUFFER_s				g_MessageBuffer;
@@ -218,6 +215,26 @@ int I_GetTime (void)
 #endif
 }
 
+//*****************************************************************************
+//
+// Packs the IP and port of a server into one integer to key the server maps with.
+QWORD MASTERSERVER_GetServerKey( const NETADDRESS_s &Address )
+{
+	return (( static_cast<QWORD>( Address.abIP[0] ) << 40 )
+		| ( static_cast<QWORD>( Address.abIP[1] ) << 32 )
+		| ( static_cast<QWORD>( Address.abIP[2] ) << 24 )
+		| ( static_cast<QWORD>( Address.abIP[3] ) << 16 )
+		| ntohs( Address.usPort ));
+}
+
+//*****************************************************************************
+//
+void MASTERSERVER_InvalidateServerListCache( void )
+{
+	g_CachedServerListPackets.clear();
+	g_CachedServerListPartPackets.clear();
+}
+
 //*****************************************************************************
 //
 void MASTERSERVER_SendBanlistToServer( const SERVER_s &Server )
@@ -336,10 +353,10 @@ void MASTERSERVER_InitializeBans( void )
 	if ( BannedIPsChanged || BannedIPExemptionsChanged )
 	{
 		// [BB] The ban list was changed, so no server has the latest list anymore.
-		for( std::set<SERVER_s, SERVERCompFunc>::iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
+		for( ServerMap::iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
 		{
-			it->bHasLatestBanList = false;
-			it->bVerifiedLatestBanList = false;
+			it->second.bHasLatestBanList = false;
+			it->second.bVerifiedLatestBanList = false;
 		}
 
 		std::cerr << "Ban lists were changed since last refresh\n";
@@ -359,22 +376,145 @@ void MASTERSERVER_InitializeBans( void )
 
 //*****************************************************************************
 //
-void MASTERSERVER_AddServer( const SERVER_s &Server, std::set<SERVER_s, SERVERCompFunc> &ServerSet )
+void MASTERSERVER_AddServer( const SERVER_s &Server, ServerMap &ServerSet )
 {
-	std::set<SERVER_s, SERVERCompFunc>::iterator addedServer = ServerSet.insert ( Server ).first;
+	SERVER_s &addedServer = ServerSet.insert ( std::make_pair( MASTERSERVER_GetServerKey( Server.Address ), Server )).first->second;
 
-	if ( addedServer == ServerSet.end() )
-		printf( "ERROR: Adding new entry to the set failed. This should not happen!\n" );
+	addedServer.lLastReceived = g_lCurrentTime;
+	if ( &ServerSet == &g_Servers )
+	{
+		printf( "+ Adding %s (revision %s) to the server list.\n", addedServer.Address.ToString(), addedServer.ServerHash );
+		MASTERSERVER_SendBanlistToServer( addedServer );
+		MASTERSERVER_InvalidateServerListCache( );
+	}
 	else
+		printf( "+ Adding %s (revision %s) to the verification list.\n", addedServer.Address.ToString(), addedServer.ServerHash );
+}
+
+//*****************************************************************************
+//
+bool MASTERSERVER_IsServerListed( const SERVER_s &Server )
+{
+	// [BB] Possibly omit servers that don't enforce our ban list.
+	return (( Server.bEnforcesBanList == true ) || ( g_bHideBanIgnoringServers == false ));
+}
+
+//*****************************************************************************
+//
+void MASTERSERVER_StoreServerListPacket( std::vector<std::vector<BYTE> > &Packets )
+{
+	Packets.push_back( std::vector<BYTE>( g_MessageBuffer.pbData, g_MessageBuffer.pbData + g_MessageBuffer.CalcSize( )));
+}
+
+//*****************************************************************************
+//
+// Collects the servers that are sent to launchers, in the order the list has always had:
+// sorted by their address strings. This also puts all servers of an IP next to each other.
+void MASTERSERVER_GetListedServers( std::vector<const SERVER_s *> &Servers )
+{
+	std::vector<std::pair<std::string, const SERVER_s *> > sortedServers;
+	sortedServers.reserve( g_Servers.size() );
+	for( ServerMap::const_iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
+	{
+		if ( MASTERSERVER_IsServerListed( it->second ))
+			sortedServers.push_back( std::make_pair( std::string( it->second.Address.ToString() ), &it->second ));
+	}
+
+	std::sort( sortedServers.begin(), sortedServers.end(), []( const std::pair<std::string, const SERVER_s *> &a, const std::pair<std::string, const SERVER_s *> &b )
+	{
+		return ( stricmp( a.first.c_str(), b.first.c_str() ) < 0 );
+	});
+
+	Servers.clear();
+	Servers.reserve( sortedServers.size() );
+	for ( unsigned int i = 0; i < sortedServers.size(); ++i )
+		Servers.push_back( sortedServers[i].second );
+}
+
+//*****************************************************************************
+//
+// The reply to LAUNCHER_SERVER_CHALLENGE: all servers in one packet.
+void MASTERSERVER_BuildServerList( void )
+{
+	std::vector<const SERVER_s *> servers;
+	MASTERSERVER_GetListedServers( servers );
+
+	g_MessageBuffer.Clear();
+
+	// Send the list of servers.
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLIST );
+	for ( unsigned int i = 0; i < servers.size(); ++i )
+		MASTERSERVER_SendServerIPToLauncher ( servers[i]->Address, &g_MessageBuffer.ByteStream );
+
+	// Tell the launcher that we're done sending servers.
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLIST );
+
+	MASTERSERVER_StoreServerListPacket( g_CachedServerListPackets );
+}
+
+//*****************************************************************************
+//
+// The reply to LAUNCHER_MASTER_CHALLENGE: the servers grouped by IP, split over as many
+// packets as necessary.
+void MASTERSERVER_BuildServerListParts( void )
+{
+	std::vector<const SERVER_s *> servers;
+	MASTERSERVER_GetListedServers( servers );
+
+	const unsigned long ulMaxPacketSize = 1024;
+	unsigned long ulPacketNum = 0;
+
+	g_MessageBuffer.Clear();
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLISTPART );
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, ulPacketNum );
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_SERVERBLOCK );
+	unsigned long ulSizeOfPacket = 6; // 4 (MSC_BEGINSERVERLISTPART) + 1 (0) + 1 (MSC_SERVERBLOCK)
+
+	unsigned int i = 0;
+	while ( i < servers.size() )
 	{
-		addedServer->lLastReceived = g_lCurrentTime;						
-		if ( &ServerSet == &g_Servers )
+		const NETADDRESS_s serverAddress = servers[i]->Address;
+		std::vector<USHORT> serverPortList;
+
+		do {
+			serverPortList.push_back ( servers[i]->Address.usPort );
+			++i;
+		} while ( ( i < servers.size() ) && servers[i]->Address.CompareNoPort( serverAddress ));
+
+		const unsigned long ulServerBlockNetSize = MASTERSERVER_CalcServerIPBlockNetSize( serverAddress, serverPortList );
+
+		// [BB] If sending this block would cause the current packet to exceed ulMaxPacketSize ...
+		if ( ulSizeOfPacket + ulServerBlockNetSize > ulMaxPacketSize - 1 )
 		{
-			printf( "+ Adding %s (revision %s) to the server list.\n", addedServer->Address.ToString(), addedServer->ServerHash );
-			MASTERSERVER_SendBanlistToServer( *addedServer );
+			// [BB] ... close the current packet and start a new one.
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, 0 ); // [BB] Terminate MSC_SERVERBLOCK by sending 0 ports.
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLISTPART );
+			MASTERSERVER_StoreServerListPacket( g_CachedServerListPartPackets );
+
+			g_MessageBuffer.Clear();
+			++ulPacketNum;
+			ulSizeOfPacket = 5;
+			NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLISTPART );
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, ulPacketNum );
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_SERVERBLOCK );
 		}
-		else
-			printf( "+ Adding %s (revision %s) to the verification list.\n", addedServer->Address.ToString(), addedServer->ServerHash );
+		ulSizeOfPacket += ulServerBlockNetSize;
+		MASTERSERVER_SendServerIPBlockToLauncher ( serverAddress, serverPortList, &g_MessageBuffer.ByteStream );
+	}
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, 0 ); // [BB] Terminate MSC_SERVERBLOCK by sending 0 ports.
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLIST );
+	MASTERSERVER_StoreServerListPacket( g_CachedServerListPartPackets );
+}
+
+//*****************************************************************************
+//
+void MASTERSERVER_SendServerListPackets( const std::vector<std::vector<BYTE> > &Packets, const NETADDRESS_s &Address )
+{
+	for ( unsigned int i = 0; i < Packets.size(); ++i )
+	{
+		g_MessageBuffer.Clear();
+		NETWORK_WriteBuffer( &g_MessageBuffer.ByteStream, &Packets[i][0], static_cast<int>( Packets[i].size() ));
+		NETWORK_LaunchPacket( &g_MessageBuffer, Address );
 	}
 }
 
@@ -438,7 +578,7 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 			newServer.bNewFormatServer = ( temp != -1 );
 			newServer.ServerHash = ( pByteStream->pbStreamEnd - pByteStream->pbStream > 4 ) ? NETWORK_ReadString( pByteStream ) : "old HG";
 
-			std::set<SERVER_s, SERVERCompFunc>::iterator currentServer = g_Servers.find ( newServer );
+			ServerMap::iterator currentServer = g_Servers.find ( MASTERSERVER_GetServerKey( AddressFrom ));
 
 			// This is a new server; add it to the list.
 			if ( currentServer == g_Servers.end() )
@@ -446,9 +586,9 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 				unsigned int iNumOtherServers = 0;
 
 				// First count the number of servers from this IP.
-				for( std::set<SERVER_s, SERVERCompFunc>::const_iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
+				for( ServerMap::const_iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
 				{
-					if ( it->Address.CompareNoPort( AddressFrom ))
+					if ( it->second.Address.CompareNoPort( AddressFrom ))
 						iNumOtherServers++;
 				}
 
@@ -456,7 +596,7 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 					printf( "* More than 10 servers received from %s. Ignoring request...\n", AddressFrom.ToString() );
 				else
 				{
-					std::set<SERVER_s, SERVERCompFunc>::iterator currentUnverifiedServer = g_UnverifiedServers.find ( newServer );
+					ServerMap::iterator currentUnverifiedServer = g_UnverifiedServers.find ( MASTERSERVER_GetServerKey( AddressFrom ));
 					// [BB] This is a new server, but we still need to verify it.
 					if ( currentUnverifiedServer == g_UnverifiedServers.end() )
 					{
@@ -475,11 +615,15 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 			else
 			{
 				// [BB] Only if the verification string matches.
-				if ( stricmp ( currentServer->MasterBanlistVerificationString.c_str(), newServer.MasterBanlistVerificationString.c_str() ) == 0 )
+				if ( stricmp ( currentServer->second.MasterBanlistVerificationString.c_str(), newServer.MasterBanlistVerificationString.c_str() ) == 0 )
 				{
-					currentServer->lLastReceived = g_lCurrentTime;
+					currentServer->second.lLastReceived = g_lCurrentTime;
 					// [BB] The server possibly changed the ban setting, so update it.
-					currentServer->bEnforcesBanList = newServer.bEnforcesBanList;
+					if ( currentServer->second.bEnforcesBanList != newServer.bEnforcesBanList )
+					{
+						currentServer->second.bEnforcesBanList = newServer.bEnforcesBanList;
+						MASTERSERVER_InvalidateServerListCache( );
+					}
 				}
 			}
 
@@ -495,16 +639,16 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 			newServer.MasterBanlistVerificationString = NETWORK_ReadString( pByteStream );
 			newServer.ServerVerificationInt = NETWORK_ReadLong( pByteStream );
 
-			std::set<SERVER_s, SERVERCompFunc>::iterator currentServer = g_UnverifiedServers.find ( newServer );
+			ServerMap::iterator currentServer = g_UnverifiedServers.find ( MASTERSERVER_GetServerKey( AddressFrom ));
 
 			// [BB] Apparently, we didn't request any verification from this server, so ignore it.
 			if ( currentServer == g_UnverifiedServers.end() )
 				return;
 
-			if ( ( stricmp ( newServer.MasterBanlistVerificationString.c_str(), currentServer->MasterBanlistVerificationString.c_str() ) == 0 )
-				&& ( newServer.ServerVerificationInt == currentServer->ServerVerificationInt ) )
+			if ( ( stricmp ( newServer.MasterBanlistVerificationString.c_str(), currentServer->second.MasterBanlistVerificationString.c_str() ) == 0 )
+				&& ( newServer.ServerVerificationInt == currentServer->second.ServerVerificationInt ) )
 			{
-				MASTERSERVER_AddServer( *currentServer, g_Servers );
+				MASTERSERVER_AddServer( currentServer->second, g_Servers );
 				g_UnverifiedServers.erase ( currentServer );
 			}
 			return;
@@ -515,15 +659,15 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 			server.Address = AddressFrom;
 			server.MasterBanlistVerificationString = NETWORK_ReadString( pByteStream );
 
-			std::set<SERVER_s, SERVERCompFunc>::iterator currentServer = g_Servers.find ( server );
+			ServerMap::iterator currentServer = g_Servers.find ( MASTERSERVER_GetServerKey( AddressFrom ));
 
 			// [BB] We don't know the server. Just ignore it.
 			if ( currentServer == g_Servers.end() )
 				return;
 
-			if ( stricmp ( server.MasterBanlistVerificationString.c_str(), currentServer->MasterBanlistVerificationString.c_str() ) == 0 )
+			if ( stricmp ( server.MasterBanlistVerificationString.c_str(), currentServer->second.MasterBanlistVerificationString.c_str() ) == 0 )
 			{
-				currentServer->bVerifiedLatestBanList = true;
+				currentServer->second.bVerifiedLatestBanList = true;
 				std::cerr << AddressFrom.ToString() << " acknowledged receipt of the banlist.\n";
 			}
 		}
@@ -567,73 +711,18 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 			switch ( lCommand )
 			{
 			case LAUNCHER_SERVER_CHALLENGE:
-				// Send the list of servers.
-				NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLIST );
-				for( std::set<SERVER_s, SERVERCompFunc>::const_iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
-				{
-					// [BB] Possibly omit servers that don't enforce our ban list.
-					if ( ( it->bEnforcesBanList == true ) || ( g_bHideBanIgnoringServers == false ) )
-						MASTERSERVER_SendServerIPToLauncher ( it->Address, &g_MessageBuffer.ByteStream );
-				}
-
-				// Tell the launcher that we're done sending servers.
-				NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLIST );
+				if ( g_CachedServerListPackets.empty() )
+					MASTERSERVER_BuildServerList( );
 
 				// Send the launcher our packet.
-				NETWORK_LaunchPacket( &g_MessageBuffer, AddressFrom );
+				MASTERSERVER_SendServerListPackets( g_CachedServerListPackets, AddressFrom );
 				return;
 
 			case LAUNCHER_MASTER_CHALLENGE:
+				if ( g_CachedServerListPartPackets.empty() )
+					MASTERSERVER_BuildServerListParts( );
 
-				const unsigned long ulMaxPacketSize = 1024;
-				unsigned long ulPacketNum = 0;
-
-				std::set<SERVER_s, SERVERCompFunc>::const_iterator it = g_Servers.begin();
-
-				NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLISTPART );
-				NETWORK_WriteByte( &g_MessageBuffer.ByteStream, ulPacketNum );
-				NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_SERVERBLOCK );
-				unsigned long ulSizeOfPacket = 6; // 4 (MSC_BEGINSERVERLISTPART) + 1 (0) + 1 (MSC_SERVERBLOCK)
-
-				while ( it != g_Servers.end() )
-				{
-					NETADDRESS_s serverAddress = it->Address;
-					std::vector<USHORT> serverPortList;
-
-					do {
-						// [BB] Possibly omit servers that don't enforce our ban list.
-						if ( ( it->bEnforcesBanList == true ) || ( g_bHideBanIgnoringServers == false ) )
-							serverPortList.push_back ( it->Address.usPort );
-						++it;
-					} while ( ( it != g_Servers.end() ) && it->Address.CompareNoPort( serverAddress ) );
-
-					// [BB] All servers on this IP ignore the list, nothing to send.
-					if ( serverPortList.size() == 0 )
-						continue;
-
-					const unsigned long ulServerBlockNetSize = MASTERSERVER_CalcServerIPBlockNetSize( serverAddress, serverPortList );
-
-					// [BB] If sending this block would cause the current packet to exceed ulMaxPacketSize ...
-					if ( ulSizeOfPacket + ulServerBlockNetSize > ulMaxPacketSize - 1 )
-					{
-						// [BB] ... close the current packet and start a new one.
-						NETWORK_WriteByte( &g_MessageBuffer.ByteStream, 0 ); // [BB] Terminate MSC_SERVERBLOCK by sending 0 ports.
-						NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLISTPART );
-						NETWORK_LaunchPacket( &g_MessageBuffer, AddressFrom );
-
-						g_MessageBuffer.Clear();
-						++ulPacketNum;
-						ulSizeOfPacket = 5;
-						NETWORK_WriteLong( &g_MessageBuffer.ByteStream, MSC_BEGINSERVERLISTPART );
-						NETWORK_WriteByte( &g_MessageBuffer.ByteStream, ulPacketNum );
-						NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_SERVERBLOCK );
-					}
-					ulSizeOfPacket += ulServerBlockNetSize;
-					MASTERSERVER_SendServerIPBlockToLauncher ( serverAddress, serverPortList, &g_MessageBuffer.ByteStream );
-				}
-				NETWORK_WriteByte( &g_MessageBuffer.ByteStream, 0 ); // [BB] Terminate MSC_SERVERBLOCK by sending 0 ports.
-				NETWORK_WriteByte( &g_MessageBuffer.ByteStream, MSC_ENDSERVERLIST );
-				NETWORK_LaunchPacket( &g_MessageBuffer, AddressFrom );
+				MASTERSERVER_SendServerListPackets( g_CachedServerListPartPackets, AddressFrom );
 				return;
 			}
 		}
@@ -645,19 +734,20 @@ void MASTERSERVER_ParseCommands( BYTESTREAM_s *pByteStream )
 
 //*****************************************************************************
 //
-void MASTERSERVER_CheckTimeouts( std::set<SERVER_s, SERVERCompFunc> &ServerSet )
+void MASTERSERVER_CheckTimeouts( ServerMap &ServerSet )
 {
 	// [BB] Because we are erasing entries from the set, the iterator has to be incremented inside
 	// the loop, depending on whether and element was erased or not.
-	for( std::set<SERVER_s, SERVERCompFunc>::iterator it = ServerSet.begin(); it != ServerSet.end(); )
+	for( ServerMap::iterator it = ServerSet.begin(); it != ServerSet.end(); )
 	{
 		// If the server has timed out, make it an open slot!
-		if (( g_lCurrentTime - it->lLastReceived ) >= 60 )
+		if (( g_lCurrentTime - it->second.lLastReceived ) >= 60 )
 		{
-			printf( "- %server at %s timed out.\n", ( &ServerSet == &g_UnverifiedServers ) ? "Unverified s" : "S", it->Address.ToString() );
-			// [BB] The standard does not require set::erase to return the incremented operator,
-			// that's why we must use the post increment operator here.
-			ServerSet.erase ( it++ );
+			printf( "- %server at %s timed out.\n", ( &ServerSet == &g_UnverifiedServers ) ? "Unverified s" : "S", it->second.Address.ToString() );
+			it = ServerSet.erase ( it );
+
+			if ( &ServerSet == &g_Servers )
+				MASTERSERVER_InvalidateServerListCache( );
 			continue;
 		}
 		else
@@ -665,8 +755,8 @@ void MASTERSERVER_CheckTimeouts( std::set<SERVER_s, SERVERCompFunc> &ServerSet )
 			// [BB] If the server doesn't have the latest ban list, send it now.
 			// This construction has the drawback that all servers are updated at once.
 			// Possibly it will be necessary to do this differently.
-			if ( it->bHasLatestBanList == false )
-				MASTERSERVER_SendBanlistToServer( *it );
+			if ( it->second.bHasLatestBanList == false )
+				MASTERSERVER_SendBanlistToServer( it->second );
 
 			++it;
 		}
@@ -681,6 +771,49 @@ void MASTERSERVER_CheckTimeouts( void )
 	MASTERSERVER_CheckTimeouts ( g_UnverifiedServers );
 }
 
+//*****************************************************************************
+//
+// Returns the argument following pszParameter on the command line, or NULL.
+const char *MASTERSERVER_CheckValue( int argc, char **argv, const char *pszParameter )
+{
+	for ( int i = 1; i < argc - 1; i++ )
+	{
+		if ( stricmp( argv[i], pszParameter ) == 0 )
+			return ( argv[i + 1] );
+	}
+
+	return ( NULL );
+}
+
+//*****************************************************************************
+//
+// Reads the number following pszParameter on the command line and clamps it to
+// [iMin, iMax]. Returns iDefault if the parameter is missing or not a number.
+unsigned int MASTERSERVER_CheckNumber( int argc, char **argv, const char *pszParameter, unsigned int iMin, unsigned int iMax, unsigned int iDefault )
+{
+	const char *pszValue = MASTERSERVER_CheckValue( argc, argv, pszParameter );
+	if ( pszValue == NULL )
+		return ( iDefault );
+
+	char *pszEnd;
+	errno = 0;
+	const unsigned long ulValue = strtoul( pszValue, &pszEnd, 10 );
+	if (( !isdigit( static_cast<unsigned char>( pszValue[0] ))) || ( *pszEnd != '\0' ))
+	{
+		std::cerr << "Ignoring " << pszParameter << " " << pszValue << ", it is not a number.\n";
+		return ( iDefault );
+	}
+
+	if (( errno == ERANGE ) || ( ulValue < iMin ) || ( ulValue > iMax ))
+	{
+		const unsigned int iValue = ( ulValue < iMin ) ? iMin : iMax;
+		std::cerr << pszParameter << " must be between " << iMin << " and " << iMax << ", using " << iValue << ".\n";
+		return ( iValue );
+	}
+
+	return ( static_cast<unsigned int>( ulValue ));
+}
+
 //*****************************************************************************
 //
 int main( int argc, char **argv )
@@ -705,6 +838,20 @@ int main( int argc, char **argv )
 	int lastParsingTime = I_GetTime( );
 	int lastBanlistVerificationTimeout = lastParsingTime;
 
+	// How many IPs the flood queues track, and how many server list requests a launcher may send in a row.
+	const char *pszQueueSize = MASTERSERVER_CheckValue( argc, argv, "-floodqueuesize" );
+	const char *pszQueryBurst = MASTERSERVER_CheckValue( argc, argv, "-queryburst" );
+	if ( pszQueueSize || pszQueryBurst )
+	{
+		const unsigned int iQueueSize = MASTERSERVER_CheckNumber( argc, argv, "-floodqueuesize", 1, MAX_FLOODQUEUESIZE, g_queryIPQueue.getMaxEntries( ));
+		const unsigned int iQueryBurst = MASTERSERVER_CheckNumber( argc, argv, "-queryburst", 1, 10, 1 );
+
+		g_queryIPQueue.setLimits( iQueueSize, iQueryBurst );
+		g_floodProtectionIPQueue.setLimits( iQueueSize, 1 );
+		g_ShortFloodQueue.setLimits( iQueueSize, 1 );
+		std::cerr << "Flood queues: " << g_queryIPQueue.getMaxEntries( ) << " IPs, server list requests in a row: " << g_queryIPQueue.getBurst( ) << std::endl;
+	}
+
 	// [BB] Do we want to hide servers that ignore our ban list?
 	if ( ( argc >= 2 ) && ( stricmp ( argv[1], "-DontHideBanIgnoringServers" ) == 0 ) )
 	{
@@ -746,12 +893,12 @@ int main( int argc, char **argv )
 
 		if ( g_lCurrentTime > lastBanlistVerificationTimeout + 10 )
 		{
-			for( std::set<SERVER_s, SERVERCompFunc>::iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
+			for( ServerMap::iterator it = g_Servers.begin(); it != g_Servers.end(); ++it )
 			{
-				if ( ( it->bVerifiedLatestBanList == false ) && ( it->bNewFormatServer == true ) )
+				if ( ( it->second.bVerifiedLatestBanList == false ) && ( it->second.bNewFormatServer == true ) )
 				{
-					it->bHasLatestBanList = false;
-					std::cerr << "No receipt received from " << it->Address.ToString() << ". Resending banlist.\n";
+					it->second.bHasLatestBanList = false;
+					std::cerr << "No receipt received from " << it->second.Address.ToString() << ". Resending banlist.\n";
 				}
 			}
 			lastBanlistVerificationTimeout = g_lCurrentTime;
@@ -760,6 +907,11 @@ int main( int argc, char **argv )
 		// [BB] Reparse the ban list every 15 minutes.
 		if ( g_lCurrentTime > lastParsingTime + 15*60 )
 		{
+			// Every packet is checked against g_floodProtectionIPQueue first, and then against g_ShortFloodQueue.
+			std::cerr << "~ Flood protection: " << g_ShortFloodQueue.getNumAccepted( ) << " packets accepted, "
+				<< g_floodProtectionIPQueue.getNumDropped( ) + g_ShortFloodQueue.getNumDropped( ) << " dropped, "
+				<< g_queryIPQueue.getNumDropped( ) << " launcher queries ignored, "
+				<< g_floodProtectionIPQueue.getNumEvicted( ) + g_queryIPQueue.getNumEvicted( ) + g_ShortFloodQueue.getNumEvicted( ) << " IPs evicted.\n";
 			std::cerr << "~ Reparsing the ban lists...\n";
 			MASTERSERVER_InitializeBans( );
 			lastParsingTime = g_lCurrentTime;
@@ -61,6 +61,9 @@ typedef int32_t __int32;
 // This is the maximum number of servers we can store in our list. Hopefully ST won't grow so big that this number can't hold them all!
 #define	MAX_SERVERS						512
 
+// The most IPs -floodqueuesize lets the flood queues track.
+#define	MAX_FLOODQUEUESIZE				1048576
+
 //*****************************************************************************
 //	STRUCTURES
 
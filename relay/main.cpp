@@ -0,0 +1,984 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: main.cpp
+//
+// Description: Spectator relay. Connects to a server as a single spectator and passes
+// the stream it receives on to any number of viewers, so that the server's load
+// doesn't depend on how many people are watching.
+//
+//-----------------------------------------------------------------------------
+
+#include "../src/networkheaders.h"
+#include "../src/networkshared.h"
+#include "../src/network_enums.h"
+#include "version.h"
+#include "network.h"
+#include "main.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <mmsystem.h>
+#endif
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+//*****************************************************************************
+//	VARIABLES
+
+// Viewers, keyed by RELAY_GetViewerKey.
+typedef std::unordered_map<QWORD, VIEWER_s> ViewerMap;
+static	ViewerMap				g_Viewers;
+
+// The reliable packets the server sent us since the current connection started, minus the
+// ones nobody can ask for anymore. g_ulFirstPacket is the index of the first one.
+static	std::deque<std::vector<BYTE> >	g_StreamPackets;
+static	ULONG					g_ulFirstPacket;
+static	size_t					g_StreamBytes;
+
+// Index of the packet new viewers start with, i.e. the beginning of the current map.
+static	ULONG					g_ulMapStartPacket;
+
+// The server we are relaying and where we are with it.
+static	NETADDRESS_s			g_ServerAddress;
+static	RELAYSTATE_e			g_State;
+static	ULONG					g_ulRetryTicks;
+static	long					g_lLastServerPacket;
+
+// Reliable packets from the server that arrived ahead of the ones we are still missing.
+static	std::map<LONG, std::vector<BYTE> >	g_OutOfOrderPackets;
+static	LONG					g_lNextSequence;
+static	LONG					g_lHighestSequence;
+static	ULONG					g_ulMissingPacketTicks;
+
+// How many more times we answer the server's last SVC_MAPAUTHENTICATE. There is no reply
+// we could wait for, so we just send it a few times.
+static	ULONG					g_ulAuthenticateLevelRetries;
+
+// What we tell new viewers while connecting them.
+static	std::string				g_MapName;
+static	LONG					g_lServerGametic;
+static	long					g_lServerGameticTime;
+static	int						g_GameMode;
+
+// Message buffer we write our commands to.
+static	NETBUFFER_s				g_MessageBuffer;
+
+// This is the current time for the relay in milliseconds, and the number of tics run.
+static	long					g_lCurrentTime;
+static	ULONG					g_ulTick;
+
+// Settings from the command line.
+static	std::string				g_RelayPassword;
+static	std::string				g_ViewerPassword;
+static	std::string				g_RelayName = "Relay";
+static	ULONG					g_ulMaxViewers = 64;
+static	ULONG					g_ulMaxPacketsPerTick = 64;
+
+//*****************************************************************************
+//	FUNCTIONS
+
+// Returns time in milliseconds
+long RELAY_GetTime( void )
+{
+#ifdef _MSC_VER
+	static DWORD  basetime;
+	DWORD         tm;
+
+	tm = timeGetTime();
+	if (!basetime)
+		basetime = tm;
+
+	return tm-basetime;
+#else
+	struct timeval tv;
+	long long int thistimereply;
+	static long long int basetime;
+
+	gettimeofday(&tv, NULL);
+
+	thistimereply = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+	if (!basetime)
+		basetime = thistimereply;
+
+	return thistimereply - basetime;
+#endif
+}
+
+//*****************************************************************************
+//
+QWORD RELAY_GetViewerKey( const NETADDRESS_s &Address )
+{
+	return (( static_cast<QWORD>( Address.abIP[0] ) << 40 )
+		| ( static_cast<QWORD>( Address.abIP[1] ) << 32 )
+		| ( static_cast<QWORD>( Address.abIP[2] ) << 24 )
+		| ( static_cast<QWORD>( Address.abIP[3] ) << 16 )
+		| ntohs( Address.usPort ));
+}
+
+//*****************************************************************************
+//
+ULONG RELAY_GetStreamEnd( void )
+{
+	return ( g_ulFirstPacket + static_cast<ULONG>( g_StreamPackets.size( )));
+}
+
+//*****************************************************************************
+//
+void RELAY_SendServerPacket( void )
+{
+	NETWORK_LaunchPacket( &g_MessageBuffer, g_ServerAddress );
+	g_MessageBuffer.Clear();
+}
+
+//*****************************************************************************
+//
+// The server doesn't check the map of a relay, so empty checksums in the layout of
+// CLIENT_AuthenticateLevel will do.
+void RELAY_WriteMapChecksums( void )
+{
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, false );
+
+	for ( ULONG ulIdx = 0; ulIdx < 4; ulIdx++ )
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, "" );
+
+	NETWORK_WriteString( &g_MessageBuffer.ByteStream, "" );
+}
+
+//*****************************************************************************
+//
+// Reads the checksums a viewer sent in the layout of CLIENT_AuthenticateLevel.
+void RELAY_SkipMapChecksums( BYTESTREAM_s *pByteStream )
+{
+	const ULONG ulNumStrings = NETWORK_ReadByte( pByteStream ) ? 1 : 4;
+
+	for ( ULONG ulIdx = 0; ulIdx < ulNumStrings; ulIdx++ )
+		NETWORK_ReadString( pByteStream );
+
+	NETWORK_ReadString( pByteStream );
+}
+
+//*****************************************************************************
+//
+// Writes one userinfo entry the way NETWORK_WriteName writes names that aren't predefined.
+// The server looks the name up again, so it ends up with the predefined one anyway.
+void RELAY_WriteUserInfo( const char *pszName, const char *pszValue )
+{
+	NETWORK_WriteShort( &g_MessageBuffer.ByteStream, -1 );
+	NETWORK_WriteString( &g_MessageBuffer.ByteStream, pszName );
+	NETWORK_WriteString( &g_MessageBuffer.ByteStream, pszValue );
+}
+
+//*****************************************************************************
+//
+void RELAY_SendConnectionSignal( void )
+{
+	switch ( g_State )
+	{
+	case RS_CONNECTING:
+
+		printf( "Connecting to %s\n", g_ServerAddress.ToString() );
+
+		// The server starts numbering its packets to us from scratch.
+		g_OutOfOrderPackets.clear();
+		g_lNextSequence = 0;
+		g_lHighestSequence = -1;
+
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLCC_ATTEMPTCONNECTION );
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, NETGAMEVER_STRING );
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, g_RelayPassword.c_str() );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CCF_STARTASSPECTATOR | CCF_RELAY );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, false );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, NETGAMEVERSION );
+		// The server doesn't check the lumps of a relay either.
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, "" );
+		break;
+	case RS_AUTHENTICATING:
+
+		printf( "Authenticating level...\n" );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLCC_ATTEMPTAUTHENTICATION );
+		RELAY_WriteMapChecksums( );
+		break;
+	case RS_REQUESTINGSNAPSHOT:
+
+		// The server insists on the userinfo that SERVER_GetUserInfo enforces.
+		printf( "Requesting snapshot...\n" );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLCC_REQUESTSNAPSHOT );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLC_USERINFO );
+		RELAY_WriteUserInfo( "Name", g_RelayName.c_str() );
+		RELAY_WriteUserInfo( "Autoaim", "0" );
+		RELAY_WriteUserInfo( "Gender", "0" );
+		RELAY_WriteUserInfo( "Skin", "base" );
+		RELAY_WriteUserInfo( "RailColor", "0" );
+		RELAY_WriteUserInfo( "CL_ClientFlags", "0" );
+		RELAY_WriteUserInfo( "Handicap", "0" );
+		RELAY_WriteUserInfo( "Color", "40 cf 00" );
+		// NAME_None ends the userinfo.
+		NETWORK_WriteShort( &g_MessageBuffer.ByteStream, 0 );
+		break;
+	default:
+
+		return;
+	}
+
+	RELAY_SendServerPacket( );
+	g_ulRetryTicks = RELAY_RESEND_TIME;
+}
+
+//*****************************************************************************
+//
+void RELAY_SendViewerError( const NETADDRESS_s &Address, ULONG ulErrorCode )
+{
+	g_MessageBuffer.Clear();
+
+	// Same as SERVER_ConnectionError, the client expects a packet header.
+	NETWORK_WriteHeader( &g_MessageBuffer.ByteStream, SVC_HEADER );
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, 0 );
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, SVCC_ERROR );
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, ulErrorCode );
+
+	if ( ulErrorCode == NETWORK_ERRORCODE_WRONGVERSION )
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, DOTVERSIONSTR );
+	else if ( ulErrorCode == NETWORK_ERRORCODE_WRONGPROTOCOLVERSION )
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, GetVersionStringRev() );
+
+	NETWORK_LaunchPacket( &g_MessageBuffer, Address );
+	g_MessageBuffer.Clear();
+}
+
+//*****************************************************************************
+//
+// The first two packets of a viewer are the ones the server sent us during the
+// handshake, with what we know about the current map.
+void RELAY_SendHandshakePacket( const VIEWER_s &Viewer, LONG lSequence )
+{
+	g_MessageBuffer.Clear();
+	NETWORK_WriteHeader( &g_MessageBuffer.ByteStream, SVC_HEADER );
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, lSequence );
+
+	if ( lSequence == 0 )
+	{
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, SVCC_AUTHENTICATE );
+		NETWORK_WriteString( &g_MessageBuffer.ByteStream, g_MapName.c_str() );
+		NETWORK_WriteLong( &g_MessageBuffer.ByteStream, g_lServerGametic + ( g_lCurrentTime - g_lServerGameticTime ) * RELAY_TICRATE / 1000 );
+	}
+	else
+	{
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, SVCC_MAPLOAD );
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, g_GameMode );
+	}
+
+	NETWORK_LaunchPacket( &g_MessageBuffer, Viewer.Address );
+	g_MessageBuffer.Clear();
+}
+
+//*****************************************************************************
+//
+void RELAY_SendStreamPacket( const VIEWER_s &Viewer, ULONG ulPacket )
+{
+	const std::vector<BYTE> &Packet = g_StreamPackets[ulPacket - g_ulFirstPacket];
+
+	g_MessageBuffer.Clear();
+	NETWORK_WriteHeader( &g_MessageBuffer.ByteStream, SVC_HEADER );
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, ulPacket - Viewer.ulFirstPacket + RELAY_FIRST_STREAM_SEQUENCE );
+	if ( Packet.size( ) > 0 )
+		NETWORK_WriteBuffer( &g_MessageBuffer.ByteStream, &Packet[0], static_cast<int>( Packet.size( )));
+
+	NETWORK_LaunchPacket( &g_MessageBuffer, Viewer.Address );
+	g_MessageBuffer.Clear();
+}
+
+//*****************************************************************************
+//
+// Sends a viewer the stream packets it doesn't have yet. Like the server's
+// OutgoingPacketBuffer, this is limited per tic, so that viewers who join late
+// get the current map's stream at a pace they can take.
+void RELAY_FlushViewer( VIEWER_s &Viewer )
+{
+	if ( Viewer.State != VS_ACTIVE )
+		return;
+
+	const ULONG ulStreamEnd = RELAY_GetStreamEnd( );
+	while (( Viewer.ulNextPacket < ulStreamEnd ) && ( Viewer.ulPacketsSentThisTick < g_ulMaxPacketsPerTick ))
+	{
+		RELAY_SendStreamPacket( Viewer, Viewer.ulNextPacket++ );
+		Viewer.ulPacketsSentThisTick++;
+	}
+}
+
+//*****************************************************************************
+//
+void RELAY_AddStreamPacket( const BYTE *pbData, size_t Size )
+{
+	g_StreamPackets.push_back( std::vector<BYTE>( pbData, pbData + Size ));
+	g_StreamBytes += Size;
+
+	for ( ViewerMap::iterator it = g_Viewers.begin(); it != g_Viewers.end(); ++it )
+		RELAY_FlushViewer( it->second );
+}
+
+//*****************************************************************************
+//
+// Drops the stream packets nobody can ask for anymore: New viewers start at the
+// beginning of the map, everyone else only asks for the last PACKET_BUFFER_SIZE
+// packets they got, like CLIENT_CheckForMissingPackets.
+void RELAY_TrimStream( void )
+{
+	ULONG ulKeep = g_ulMapStartPacket;
+
+	for ( ViewerMap::iterator it = g_Viewers.begin(); it != g_Viewers.end(); ++it )
+	{
+		if (( it->second.State == VS_ACTIVE ) && ( it->second.ulNextPacket < ulKeep + PACKET_BUFFER_SIZE ))
+			ulKeep = ( it->second.ulNextPacket > PACKET_BUFFER_SIZE ) ? it->second.ulNextPacket - PACKET_BUFFER_SIZE : 0;
+	}
+
+	while (( g_ulFirstPacket < ulKeep ) && ( g_StreamPackets.empty( ) == false ))
+	{
+		g_StreamBytes -= g_StreamPackets.front( ).size( );
+		g_StreamPackets.pop_front( );
+		g_ulFirstPacket++;
+	}
+}
+
+//*****************************************************************************
+//
+// Starts over with the stream the server sends after our snapshot request. Whoever
+// was watching the last one has been told to reconnect already.
+void RELAY_StartStream( void )
+{
+	g_StreamPackets.clear();
+	g_StreamBytes = 0;
+	g_ulFirstPacket = 0;
+	g_ulMapStartPacket = 0;
+	g_Viewers.clear();
+
+	g_State = RS_ACTIVE;
+	printf( "Relaying %s on %s.\n", g_ServerAddress.ToString(), g_MapName.c_str() );
+}
+
+//*****************************************************************************
+//
+void RELAY_Disconnect( const char *pszReason, bool bTellViewers, ULONG ulRetryTicks )
+{
+	printf( "%s\n", pszReason );
+
+	// Have the viewers reconnect like on a map change. We let them back in as soon as
+	// we're relaying again.
+	if (( bTellViewers ) && ( g_State == RS_ACTIVE ))
+	{
+		BYTE			abData[MAX_UDP_PACKET];
+		NETBUFFER_s		Packet;
+
+		Packet.pbData = abData;
+		Packet.ulMaxSize = sizeof( abData );
+		Packet.BufferType = BUFFERTYPE_WRITE;
+		Packet.Clear();
+		NETWORK_WriteHeader( &Packet.ByteStream, SVC_MAPNEW );
+		NETWORK_WriteString( &Packet.ByteStream, g_MapName.c_str() );
+		RELAY_AddStreamPacket( abData, Packet.CalcSize( ));
+	}
+
+	if ( g_State > RS_CONNECTING )
+	{
+		NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLC_QUIT );
+		RELAY_SendServerPacket( );
+	}
+
+	g_State = RS_DISCONNECTED;
+	g_ulRetryTicks = ulRetryTicks;
+	g_ulAuthenticateLevelRetries = 0;
+}
+
+//*****************************************************************************
+//
+// Handles a reliable packet from the server, in order. The stream can't be parsed
+// without the game, but everything the relay has to act on starts a packet: The
+// server clears its buffer before SVCC_AUTHENTICATE and SVCC_MAPLOAD, and sends
+// out what it has before SVC_MAPAUTHENTICATE and, for relays, SVC_MAPNEW.
+void RELAY_ParseServerPacket( const BYTE *pbData, size_t Size )
+{
+	BYTESTREAM_s	ByteStream;
+
+	ByteStream.pbStream = const_cast<BYTE *>( pbData );
+	ByteStream.pbStreamEnd = ByteStream.pbStream + Size;
+	ByteStream.bitBuffer = NULL;
+	ByteStream.bitShift = -1;
+
+	const int Command = ( Size > 0 ) ? pbData[0] : -1;
+
+	switch ( Command )
+	{
+	case SVCC_AUTHENTICATE:
+
+		// The server may also send this again while we're connected, then we go through
+		// the whole handshake again.
+		NETWORK_ReadByte( &ByteStream );
+		g_MapName = NETWORK_ReadString( &ByteStream );
+		g_lServerGametic = NETWORK_ReadLong( &ByteStream );
+		g_lServerGameticTime = g_lCurrentTime;
+
+		if ( g_State == RS_ACTIVE )
+			RELAY_Disconnect( "The server asked us to connect again.", true, 0 );
+
+		g_State = RS_AUTHENTICATING;
+		RELAY_SendConnectionSignal( );
+		return;
+	case SVCC_MAPLOAD:
+
+		if ( g_State != RS_AUTHENTICATING )
+			return;
+
+		NETWORK_ReadByte( &ByteStream );
+		g_GameMode = NETWORK_ReadByte( &ByteStream );
+
+		g_State = RS_REQUESTINGSNAPSHOT;
+		RELAY_SendConnectionSignal( );
+		return;
+	case SVCC_ERROR:
+		{
+			NETWORK_ReadByte( &ByteStream );
+			const int ErrorCode = NETWORK_ReadByte( &ByteStream );
+
+			switch ( ErrorCode )
+			{
+			case NETWORK_ERRORCODE_WRONGPASSWORD:
+
+				printf( "The server refused the relay password.\n" );
+				exit( 1 );
+			case NETWORK_ERRORCODE_WRONGVERSION:
+			case NETWORK_ERRORCODE_WRONGPROTOCOLVERSION:
+
+				printf( "The server uses a different version: %s\n", NETWORK_ReadString( &ByteStream ));
+				exit( 1 );
+			case NETWORK_ERRORCODE_BANNED:
+
+				printf( "The relay is banned from the server.\n" );
+				exit( 1 );
+			default:
+				{
+					char	szReason[64];
+
+					sprintf( szReason, "The server refused the connection (error %d).", ErrorCode );
+					RELAY_Disconnect( szReason, true, RELAY_RECONNECT_TIME );
+				}
+				return;
+			}
+		}
+	}
+
+	if ( g_State == RS_REQUESTINGSNAPSHOT )
+		RELAY_StartStream( );
+	else if ( g_State != RS_ACTIVE )
+		return;
+
+	RELAY_AddStreamPacket( pbData, Size );
+
+	if ( Command == SVC_MAPAUTHENTICATE )
+	{
+		// The server sends the new map's full update once we answer, that's where new
+		// viewers start from now on.
+		NETWORK_ReadByte( &ByteStream );
+		g_MapName = NETWORK_ReadString( &ByteStream );
+		g_ulMapStartPacket = RELAY_GetStreamEnd( );
+		g_ulAuthenticateLevelRetries = 3;
+		printf( "Map change to %s.\n", g_MapName.c_str() );
+	}
+	else if ( Command == SVC_MAPNEW )
+	{
+		// The server is about to drop everyone, including us.
+		RELAY_Disconnect( "The server is changing the map, reconnecting.", false, RELAY_TICRATE );
+	}
+}
+
+//*****************************************************************************
+//
+void RELAY_ParseServerPackets( BYTESTREAM_s *pByteStream )
+{
+	g_lLastServerPacket = g_lCurrentTime;
+
+	const int Command = NETWORK_ReadByte( pByteStream );
+
+	// Unreliable packets only go to viewers that have the whole stream. Anyone still
+	// catching up wouldn't know what they are about yet.
+	if ( Command == SVC_UNRELIABLEPACKET )
+	{
+		if ( g_State != RS_ACTIVE )
+			return;
+
+		const ULONG ulStreamEnd = RELAY_GetStreamEnd( );
+		NETBUFFER_s *pBuffer = NETWORK_GetNetworkMessageBuffer( );
+		pBuffer->ByteStream.pbStream = pBuffer->pbData;
+
+		for ( ViewerMap::iterator it = g_Viewers.begin(); it != g_Viewers.end(); ++it )
+		{
+			if (( it->second.State == VS_ACTIVE ) && ( it->second.ulNextPacket == ulStreamEnd ))
+				NETWORK_LaunchPacket( pBuffer, it->second.Address );
+		}
+		return;
+	}
+
+	if ( Command != SVC_HEADER )
+		return;
+
+	const LONG lSequence = NETWORK_ReadLong( pByteStream );
+	if (( lSequence < g_lNextSequence ) || ( g_OutOfOrderPackets.count( lSequence )))
+		return;
+
+	g_OutOfOrderPackets[lSequence].assign( pByteStream->pbStream, pByteStream->pbStreamEnd );
+	if ( lSequence > g_lHighestSequence )
+		g_lHighestSequence = lSequence;
+
+	// Handle everything that's in order now.
+	std::map<LONG, std::vector<BYTE> >::iterator it;
+	while (( it = g_OutOfOrderPackets.find( g_lNextSequence )) != g_OutOfOrderPackets.end( ))
+	{
+		const std::vector<BYTE> Packet = it->second;
+		g_OutOfOrderPackets.erase( it );
+		g_lNextSequence++;
+
+		RELAY_ParseServerPacket( Packet.empty( ) ? NULL : &Packet[0], Packet.size( ));
+
+		// We might have started over.
+		if ( g_State < RS_AUTHENTICATING )
+			break;
+	}
+}
+
+//*****************************************************************************
+//
+// Same as CLIENT_CheckForMissingPackets.
+void RELAY_CheckForMissingPackets( void )
+{
+	if ( g_ulMissingPacketTicks > 0 )
+	{
+		g_ulMissingPacketTicks--;
+		return;
+	}
+
+	if ( g_lHighestSequence < g_lNextSequence )
+		return;
+
+	if (( g_lHighestSequence - g_lNextSequence ) >= PACKET_BUFFER_SIZE )
+	{
+		RELAY_Disconnect( "Missing more packets than the server can send again.", true, 0 );
+		return;
+	}
+
+	NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLC_MISSINGPACKET );
+	for ( LONG lSequence = g_lNextSequence; lSequence < g_lHighestSequence; lSequence++ )
+	{
+		if ( g_OutOfOrderPackets.count( lSequence ) == 0 )
+			NETWORK_WriteLong( &g_MessageBuffer.ByteStream, lSequence );
+	}
+	NETWORK_WriteLong( &g_MessageBuffer.ByteStream, -1 );
+	RELAY_SendServerPacket( );
+
+	g_ulMissingPacketTicks = RELAY_TICRATE / 4;
+}
+
+//*****************************************************************************
+//
+void RELAY_ConnectViewer( BYTESTREAM_s *pByteStream, const NETADDRESS_s &Address )
+{
+	const std::string Version = NETWORK_ReadString( pByteStream );
+	const std::string Password = NETWORK_ReadString( pByteStream );
+	// Connect flags, hide account, protocol version and lump authentication.
+	NETWORK_ReadByte( pByteStream );
+	NETWORK_ReadByte( pByteStream );
+	const int NetworkGameVersion = NETWORK_ReadByte( pByteStream );
+	NETWORK_ReadString( pByteStream );
+
+	// The client keeps trying until we are relaying again.
+	if ( g_State != RS_ACTIVE )
+		return;
+
+	if ( stricmp( Version.c_str(), NETGAMEVER_STRING ) != 0 )
+	{
+		RELAY_SendViewerError( Address, NETWORK_ERRORCODE_WRONGVERSION );
+		return;
+	}
+
+	if ( NetworkGameVersion != NETGAMEVERSION )
+	{
+		RELAY_SendViewerError( Address, NETWORK_ERRORCODE_WRONGPROTOCOLVERSION );
+		return;
+	}
+
+	if (( g_ViewerPassword.empty( ) == false ) && ( stricmp( Password.c_str(), g_ViewerPassword.c_str() ) != 0 ))
+	{
+		RELAY_SendViewerError( Address, NETWORK_ERRORCODE_WRONGPASSWORD );
+		return;
+	}
+
+	const QWORD Key = RELAY_GetViewerKey( Address );
+	if (( g_Viewers.count( Key ) == 0 ) && ( g_Viewers.size( ) >= g_ulMaxViewers ))
+	{
+		RELAY_SendViewerError( Address, NETWORK_ERRORCODE_SERVERISFULL );
+		return;
+	}
+
+	VIEWER_s &Viewer = g_Viewers[Key];
+	Viewer.Address = Address;
+	Viewer.State = VS_AUTHENTICATING;
+	Viewer.ulFirstPacket = Viewer.ulNextPacket = 0;
+	Viewer.ulPacketsSentThisTick = 0;
+	Viewer.lLastReceived = g_lCurrentTime;
+	Viewer.ulLastPacketLossTick = 0;
+
+	printf( "Viewer %s connected (%u watching).\n", Address.ToString(), static_cast<unsigned int>( g_Viewers.size( )));
+	RELAY_SendHandshakePacket( Viewer, 0 );
+}
+
+//*****************************************************************************
+//
+// Returns false if the viewer had to be dropped.
+bool RELAY_ResendMissingPackets( VIEWER_s &Viewer, BYTESTREAM_s *pByteStream )
+{
+	// Same flood protection as server_MissingPacket.
+	bool bIgnore = ( g_ulTick <= Viewer.ulLastPacketLossTick + ( RELAY_TICRATE / 4 ));
+	LONG lLastPacket = -1;
+	LONG lPacket;
+
+	while (( lPacket = NETWORK_ReadLong( pByteStream )) != -1 )
+	{
+		if ( bIgnore )
+			continue;
+
+		if (( lPacket <= lLastPacket ) || ( lPacket < 0 ))
+		{
+			bIgnore = true;
+			continue;
+		}
+		lLastPacket = lPacket;
+
+		if ( lPacket < RELAY_FIRST_STREAM_SEQUENCE )
+		{
+			RELAY_SendHandshakePacket( Viewer, lPacket );
+			continue;
+		}
+
+		const ULONG ulPacket = Viewer.ulFirstPacket + lPacket - RELAY_FIRST_STREAM_SEQUENCE;
+
+		// Nothing we sent yet can be missing.
+		if ( ulPacket >= Viewer.ulNextPacket )
+			continue;
+
+		if ( ulPacket < g_ulFirstPacket )
+		{
+			printf( "Viewer %s missed too many packets.\n", Viewer.Address.ToString() );
+			return ( false );
+		}
+
+		RELAY_SendStreamPacket( Viewer, ulPacket );
+	}
+
+	Viewer.ulLastPacketLossTick = g_ulTick;
+	return ( true );
+}
+
+//*****************************************************************************
+//
+// Viewers are clients that think they are connected to the server. We only act on
+// the few commands that concern us and stop at the first one we can't skip.
+void RELAY_ParseViewerPacket( BYTESTREAM_s *pByteStream, const NETADDRESS_s &Address )
+{
+	ViewerMap::iterator it = g_Viewers.find( RELAY_GetViewerKey( Address ));
+
+	while ( 1 )
+	{
+		const int Command = NETWORK_ReadByte( pByteStream );
+
+		// End of message.
+		if ( Command == -1 )
+			return;
+
+		if ( Command == CLCC_ATTEMPTCONNECTION )
+		{
+			RELAY_ConnectViewer( pByteStream, Address );
+			return;
+		}
+
+		// Anything else has to come from someone we know.
+		if ( it == g_Viewers.end( ))
+			return;
+
+		VIEWER_s &Viewer = it->second;
+		Viewer.lLastReceived = g_lCurrentTime;
+
+		switch ( Command )
+		{
+		case CLCC_ATTEMPTAUTHENTICATION:
+
+			RELAY_SkipMapChecksums( pByteStream );
+			if ( Viewer.State != VS_ACTIVE )
+			{
+				Viewer.State = VS_LOADING;
+				RELAY_SendHandshakePacket( Viewer, 1 );
+			}
+			break;
+		case CLCC_REQUESTSNAPSHOT:
+
+			// The viewer gets the stream from the start of the map. The userinfo that
+			// follows is of no interest to us.
+			if ( Viewer.State == VS_LOADING )
+			{
+				Viewer.State = VS_ACTIVE;
+				Viewer.ulFirstPacket = Viewer.ulNextPacket = g_ulMapStartPacket;
+				RELAY_FlushViewer( Viewer );
+			}
+			return;
+		case CLC_MISSINGPACKET:
+
+			if ( RELAY_ResendMissingPackets( Viewer, pByteStream ) == false )
+			{
+				g_Viewers.erase( it );
+				return;
+			}
+			break;
+		case CLC_AUTHENTICATELEVEL:
+
+			// We answered the server already.
+			NETWORK_ReadString( pByteStream );
+			RELAY_SkipMapChecksums( pByteStream );
+			break;
+		case CLC_PONG:
+		case CLC_SPECTATEINFO:
+
+			NETWORK_ReadLong( pByteStream );
+			break;
+		case CLC_CHANGEDISPLAYPLAYER:
+
+			NETWORK_ReadByte( pByteStream );
+			break;
+		case CLC_STARTCHAT:
+		case CLC_ENDCHAT:
+		case CLC_ENTERCONSOLE:
+		case CLC_EXITCONSOLE:
+		case CLC_ENTERMENU:
+		case CLC_EXITMENU:
+		case CLC_FULLUPDATE:
+
+			break;
+		case CLC_QUIT:
+
+			printf( "Viewer %s left (%u watching).\n", Address.ToString(), static_cast<unsigned int>( g_Viewers.size( ) - 1 ));
+			g_Viewers.erase( it );
+			return;
+		default:
+
+			return;
+		}
+	}
+}
+
+//*****************************************************************************
+//
+void RELAY_Tick( void )
+{
+	g_ulTick++;
+
+	switch ( g_State )
+	{
+	case RS_DISCONNECTED:
+
+		if ( g_ulRetryTicks > 0 )
+		{
+			g_ulRetryTicks--;
+			break;
+		}
+
+		g_State = RS_CONNECTING;
+		RELAY_SendConnectionSignal( );
+		break;
+	case RS_CONNECTING:
+	case RS_AUTHENTICATING:
+	case RS_REQUESTINGSNAPSHOT:
+
+		if ( --g_ulRetryTicks == 0 )
+			RELAY_SendConnectionSignal( );
+
+		RELAY_CheckForMissingPackets( );
+		break;
+	case RS_ACTIVE:
+
+		RELAY_CheckForMissingPackets( );
+
+		// Answer the server's SVC_MAPAUTHENTICATE once a second for a while.
+		if (( g_ulAuthenticateLevelRetries > 0 ) && (( g_ulTick % RELAY_TICRATE ) == 0 ))
+		{
+			g_ulAuthenticateLevelRetries--;
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLC_AUTHENTICATELEVEL );
+			NETWORK_WriteString( &g_MessageBuffer.ByteStream, g_MapName.c_str() );
+			RELAY_WriteMapChecksums( );
+			RELAY_SendServerPacket( );
+		}
+
+		// Keep the server from timing us out, like CLIENT_SendCmd does for spectators.
+		if (( g_ulTick % ( 2 * RELAY_TICRATE )) == 0 )
+		{
+			NETWORK_WriteByte( &g_MessageBuffer.ByteStream, CLC_SPECTATEINFO );
+			NETWORK_WriteLong( &g_MessageBuffer.ByteStream, g_lServerGametic + ( g_lCurrentTime - g_lServerGameticTime ) * RELAY_TICRATE / 1000 );
+			RELAY_SendServerPacket( );
+		}
+		break;
+	}
+
+	if (( g_State > RS_CONNECTING ) && ( g_lCurrentTime - g_lLastServerPacket >= RELAY_SERVER_TIMEOUT ))
+		RELAY_Disconnect( "Lost the connection to the server.", true, 0 );
+
+	ViewerMap::iterator it = g_Viewers.begin();
+	while ( it != g_Viewers.end( ))
+	{
+		if ( g_lCurrentTime - it->second.lLastReceived >= RELAY_VIEWER_TIMEOUT )
+		{
+			printf( "Viewer %s timed out.\n", it->second.Address.ToString() );
+			it = g_Viewers.erase( it );
+			continue;
+		}
+
+		it->second.ulPacketsSentThisTick = 0;
+		RELAY_FlushViewer( it->second );
+		++it;
+	}
+
+	if (( g_ulTick % RELAY_TICRATE ) == 0 )
+		RELAY_TrimStream( );
+
+	// Print some statistics every minute.
+	if (( g_State == RS_ACTIVE ) && (( g_ulTick % ( 60 * RELAY_TICRATE )) == 0 ))
+	{
+		printf( "%u viewers, %u stream packets (%u KB) held.\n", static_cast<unsigned int>( g_Viewers.size( )),
+			static_cast<unsigned int>( g_StreamPackets.size( )), static_cast<unsigned int>( g_StreamBytes / 1024 ));
+	}
+}
+
+//*****************************************************************************
+//
+const char *RELAY_CheckValue( int argc, char **argv, const char *pszParameter )
+{
+	for ( int i = 1; i < argc - 1; i++ )
+	{
+		if ( stricmp( argv[i], pszParameter ) == 0 )
+			return ( argv[i + 1] );
+	}
+
+	return ( NULL );
+}
+
+//*****************************************************************************
+//
+int main( int argc, char **argv )
+{
+	const char		*pszValue;
+
+	printf( "=== Zandronum Spectator Relay ===\n" );
+	printf( "Revision: %s\n", GetGitTime() );
+
+	pszValue = RELAY_CheckValue( argc, argv, "-host" );
+	if (( pszValue == NULL ) || ( g_ServerAddress.LoadFromString( pszValue ) == false ))
+	{
+		printf( "Usage: %s -host <address[:port]> -password <sv_relaypassword> [-port <port>] [-useip <ip>]\n"
+			"       [-viewerpassword <password>] [-maxviewers <number>] [-maxpacketspertick <number>] [-name <name>]\n", argv[0] );
+		return ( 1 );
+	}
+
+	if ( g_ServerAddress.usPort == 0 )
+		g_ServerAddress.SetPort( DEFAULT_SERVER_PORT );
+
+	if (( pszValue = RELAY_CheckValue( argc, argv, "-password" )))
+		g_RelayPassword = pszValue;
+	if (( pszValue = RELAY_CheckValue( argc, argv, "-viewerpassword" )))
+		g_ViewerPassword = pszValue;
+	if (( pszValue = RELAY_CheckValue( argc, argv, "-name" )))
+		g_RelayName = pszValue;
+	if (( pszValue = RELAY_CheckValue( argc, argv, "-maxviewers" )))
+		g_ulMaxViewers = strtoul( pszValue, NULL, 10 );
+	if (( pszValue = RELAY_CheckValue( argc, argv, "-maxpacketspertick" )))
+		g_ulMaxPacketsPerTick = ( std::max )( 1UL, strtoul( pszValue, NULL, 10 ));
+
+	pszValue = RELAY_CheckValue( argc, argv, "-port" );
+
+	// Initialize the network system.
+	NETWORK_Construct( pszValue ? static_cast<USHORT>( atoi( pszValue )) : DEFAULT_SERVER_PORT, RELAY_CheckValue( argc, argv, "-useip" ));
+
+	// Initialize the message buffer we write our commands to.
+	g_MessageBuffer.Init( MAX_UDP_PACKET, BUFFERTYPE_WRITE );
+	g_MessageBuffer.Clear();
+
+	printf( "Relaying %s to up to %u viewers.\n", g_ServerAddress.ToString(), static_cast<unsigned int>( g_ulMaxViewers ));
+
+	g_lCurrentTime = RELAY_GetTime( );
+	long lNextTick = g_lCurrentTime;
+	g_State = RS_DISCONNECTED;
+	g_ulRetryTicks = 0;
+
+	while ( 1 )
+	{
+		I_DoSelect( ( std::max )( 0L, lNextTick - RELAY_GetTime( )));
+		g_lCurrentTime = RELAY_GetTime( );
+
+		while ( NETWORK_GetPackets( ))
+		{
+			BYTESTREAM_s *pByteStream = &NETWORK_GetNetworkMessageBuffer( )->ByteStream;
+
+			if ( NETWORK_GetFromAddress( ).Compare( g_ServerAddress ))
+				RELAY_ParseServerPackets( pByteStream );
+			else
+				RELAY_ParseViewerPacket( pByteStream, NETWORK_GetFromAddress( ));
+		}
+
+		// Tick at the same rate as the server, catching up if we fell behind.
+		while ( g_lCurrentTime >= lNextTick )
+		{
+			RELAY_Tick( );
+			lNextTick += 1000 / RELAY_TICRATE;
+		}
+	}
+
+	return ( 0 );
+}
@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: main.h
+//
+// Description: Spectator relay definitions.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef	__MAIN_H__
+#define	__MAIN_H__
+
+//*****************************************************************************
+//	DEFINES
+
+// Must match TICRATE in doomdef.h.
+#define	RELAY_TICRATE					35
+
+// How long (in milliseconds) we wait for the server or a viewer before considering it gone.
+#define	RELAY_SERVER_TIMEOUT			( 10 * 1000 )
+#define	RELAY_VIEWER_TIMEOUT			( 20 * 1000 )
+
+// How often (in tics) the connection handshake is resent, matches CONNECTION_RESEND_TIME.
+#define	RELAY_RESEND_TIME				( 3 * RELAY_TICRATE )
+
+// How long (in tics) we wait before connecting again after the server refused or dropped us.
+#define	RELAY_RECONNECT_TIME			( 10 * RELAY_TICRATE )
+
+// Viewers get SVCC_AUTHENTICATE and SVCC_MAPLOAD as their first two packets, the
+// stream starts right after them.
+#define	RELAY_FIRST_STREAM_SEQUENCE		2
+
+//*****************************************************************************
+//	STRUCTURES
+
+enum RELAYSTATE_e
+{
+	// Waiting to connect (again).
+	RS_DISCONNECTED,
+
+	// Sending CLCC_ATTEMPTCONNECTION until the server asks us to authenticate the map.
+	RS_CONNECTING,
+
+	// Sending CLCC_ATTEMPTAUTHENTICATION until the server tells us to load the map.
+	RS_AUTHENTICATING,
+
+	// Sending CLCC_REQUESTSNAPSHOT until the full update arrives.
+	RS_REQUESTINGSNAPSHOT,
+
+	// Receiving the stream and passing it on to the viewers.
+	RS_ACTIVE,
+};
+
+enum VIEWERSTATE_e
+{
+	// We sent SVCC_AUTHENTICATE and wait for CLCC_ATTEMPTAUTHENTICATION.
+	VS_AUTHENTICATING,
+
+	// We sent SVCC_MAPLOAD and wait for CLCC_REQUESTSNAPSHOT.
+	VS_LOADING,
+
+	// The viewer receives the stream.
+	VS_ACTIVE,
+};
+
+typedef struct
+{
+	// The IP address of this viewer.
+	NETADDRESS_s	Address;
+
+	VIEWERSTATE_e	State;
+
+	// Index of the stream packet the viewer knows as RELAY_FIRST_STREAM_SEQUENCE.
+	ULONG			ulFirstPacket;
+
+	// Index of the next stream packet the viewer gets.
+	ULONG			ulNextPacket;
+
+	// Number of stream packets sent to the viewer this tic.
+	ULONG			ulPacketsSentThisTick;
+
+	// The last time we heard from this viewer (used for timeouts).
+	long			lLastReceived;
+
+	// The tic the viewer last asked for missing packets.
+	ULONG			ulLastPacketLossTick;
+
+} VIEWER_s;
+
+#endif	// __MAIN_H__
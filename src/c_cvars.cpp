@@ -81,6 +81,13 @@ bool FBaseCVar::m_UseCallback = false;
 bool FBaseCVar::m_GameModeLockDisabled = false; // [AK]
 
 FBaseCVar *CVars = NULL;
+unsigned int CVarGeneration = 1;
+
+// All named cvars are also chained into this table by the case-insensitive
+// hash of their name. CVars keeps the registration order for everything
+// that walks the whole list.
+enum { CVAR_HASH_SIZE = 1024 };
+static FBaseCVar *CVarHash[CVAR_HASH_SIZE];
 
 int cvar_defflags;
 
@@ -116,6 +123,12 @@ FBaseCVar::FBaseCVar (const char *var_name, DWORD flags, void (*callback)(FBaseC
 		Name = copystring (var_name);
 		m_Next = CVars;
 		CVars = this;
+		LinkHash ();
+	}
+	else
+	{
+		m_HashNext = NULL;
+		m_HashPrev = NULL;
 	}
 
 	if (var)
@@ -154,11 +167,39 @@ FBaseCVar::~FBaseCVar ()
 			else
 				CVars = m_Next;
 		}
+		UnlinkHash ();
 		C_RemoveTabCommand(Name);
 		delete[] Name;
 	}
 }
 
+// Puts the cvar in front of its hash chain, so that like the CVars list,
+// a newer cvar shadows an older one with the same name.
+void FBaseCVar::LinkHash ()
+{
+	FBaseCVar **bucket = &CVarHash[MakeKey (Name) % CVAR_HASH_SIZE];
+
+	m_HashNext = *bucket;
+	m_HashPrev = bucket;
+	if (m_HashNext != NULL)
+		m_HashNext->m_HashPrev = &m_HashNext;
+	*bucket = this;
+	CVarGeneration++;
+}
+
+void FBaseCVar::UnlinkHash ()
+{
+	if (m_HashPrev != NULL)
+	{
+		*m_HashPrev = m_HashNext;
+		if (m_HashNext != NULL)
+			m_HashNext->m_HashPrev = m_HashPrev;
+		m_HashNext = NULL;
+		m_HashPrev = NULL;
+	}
+	CVarGeneration++;
+}
+
 void FBaseCVar::ForceSet (UCVarValue value, ECVarType type, bool nouserinfosend)
 {
 	DoSet (value, type);
@@ -1555,14 +1596,21 @@ void C_ClearModCVars (void)
 FBaseCVar *FindCVar (const char *var_name, FBaseCVar **prev)
 {
 	FBaseCVar *var;
-	FBaseCVar *dummy;
 
 	if (var_name == NULL)
 		return NULL;
 
 	if (prev == NULL)
-		prev = &dummy;
+	{
+		for (var = CVarHash[MakeKey (var_name) % CVAR_HASH_SIZE]; var != NULL; var = var->m_HashNext)
+		{
+			if (stricmp (var->GetName (), var_name) == 0)
+				break;
+		}
+		return var;
+	}
 
+	// Only the CVars list knows the predecessor.
 	var = CVars;
 	*prev = NULL;
 	while (var)
@@ -1582,7 +1630,7 @@ FBaseCVar *FindCVarSub (const char *var_name, int namelen)
 	if (var_name == NULL)
 		return NULL;
 
-	var = CVars;
+	var = CVarHash[MakeKey (var_name, namelen) % CVAR_HASH_SIZE];
 	while (var)
 	{
 		const char *probename = var->GetName ();
@@ -1592,7 +1640,7 @@ FBaseCVar *FindCVarSub (const char *var_name, int namelen)
 		{
 			break;
 		}
-		var = var->m_Next;
+		var = var->m_HashNext;
 	}
 	return var;
 }
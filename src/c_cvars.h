@@ -153,7 +153,7 @@ public:
 	static void DisableGameModeLock (bool bDisable) { m_GameModeLockDisabled = bDisable; }
 
 protected:
-	FBaseCVar () {}
+	FBaseCVar () : m_HashNext(NULL), m_HashPrev(NULL) {}
 	virtual void DoSet (UCVarValue value, ECVarType type) = 0;
 
 	static bool ToBool (UCVarValue value, ECVarType type);
@@ -176,6 +176,10 @@ private:
 
 	void (*m_Callback)(FBaseCVar &);
 	FBaseCVar *m_Next;
+	FBaseCVar *m_HashNext, **m_HashPrev;	// chain in the name hash table
+
+	void LinkHash ();
+	void UnlinkHash ();
 
 	static bool m_UseCallback;
 	static bool m_DoNoSet;
@@ -485,4 +489,8 @@ void C_RestoreServerInfoCVars (void);
 
 extern FBaseCVar *CVars;
 
+// Changes whenever a cvar is registered or removed, so that cached lookups
+// by name know when to look again.
+extern unsigned int CVarGeneration;
+
 #endif //__C_CVARS_H__
@@ -0,0 +1,600 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: checksumcache.cpp
+//
+// Description: Persistent cache of file and lump checksums
+//
+//-----------------------------------------------------------------------------
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "doomtype.h"
+#include "templates.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "md5.h"
+#include "stats.h"
+#include "version.h"
+#include "workerpool.h"
+#include "checksumcache.h"
+
+//*****************************************************************************
+//	DEFINES
+
+// Bump this whenever the format of the cache file changes.
+#define	CHECKSUMCACHE_VERSION		1
+
+// Files are hashed in reads of this size.
+#define	CHECKSUMCACHE_READ_SIZE		( 1024 * 1024 )
+
+// Hashing is mostly limited by the disk, more threads don't help.
+#define	CHECKSUMCACHE_MAX_THREADS	8
+
+// The key of the checksum of a whole file.
+#define	CHECKSUMCACHE_FILE_KEY		"*"
+
+//*****************************************************************************
+//	STRUCTURES
+
+struct FFileIdentity
+{
+	FString	Path;	// Canonical path, empty if the file can't be cached.
+	QWORD	Size;
+	QWORD	MTime;
+	QWORD	Inode;
+
+	FFileIdentity( ) : Size( 0 ), MTime( 0 ), Inode( 0 ) { }
+};
+
+struct FChecksumCacheEntry
+{
+	QWORD	Size;
+	QWORD	MTime;
+	QWORD	Inode;
+	FString	Checksum;
+};
+
+// Hashes either a file or a block of memory, if File is NULL.
+struct FChecksumJob
+{
+	const char		*File;
+	const BYTE		*Data;
+	unsigned int	Index;
+	QWORD			Size;
+	QWORD			BytesRead;
+	int				Error;
+	char			Checksum[33];
+};
+
+//*****************************************************************************
+//	VARIABLES
+
+// Keyed on the canonical path and the key of the data, separated by a tab.
+static	TMap<FString, FChecksumCacheEntry>	g_ChecksumCache;
+static	bool								g_bChecksumCacheLoaded = false;
+static	bool								g_bChecksumCacheDirty = false;
+
+static	WorkerPool							g_ChecksumWorkers;
+static	TArray<FChecksumJob>				g_ChecksumJobs;
+
+static struct
+{
+	unsigned int	ulHits;
+	unsigned int	ulMisses;
+	unsigned int	ulFilesHashed;
+	QWORD			qwBytesHashed;
+	unsigned int	ulHashTimeMS;
+} g_ChecksumCacheStats;
+
+//*****************************************************************************
+//	FUNCTIONS
+
+static FString checksumcache_GetFileName( bool bCreate )
+{
+	FString path = M_GetCachePath( bCreate );
+	if ( bCreate )
+		CreatePath( path );
+	path << "/checksums.txt";
+	return path;
+}
+
+//*****************************************************************************
+//
+static FString checksumcache_GetHeader( void )
+{
+	FString header;
+	header.Format( "# " GAMENAME " checksum cache %d", CHECKSUMCACHE_VERSION );
+	return header;
+}
+
+//*****************************************************************************
+//
+// Only regular files are cached, the time stamp of a directory doesn't change
+// when a file inside of it is modified.
+//
+static bool checksumcache_GetIdentity( const char *file, FFileIdentity &identity )
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (( _stat64( file, &info ) != 0 ) || (( info.st_mode & _S_IFMT ) != _S_IFREG ))
+		return false;
+
+	char *fullPath = _fullpath( NULL, file, 0 );
+#else
+	struct stat info;
+	if (( stat( file, &info ) != 0 ) || ( S_ISREG( info.st_mode ) == false ))
+		return false;
+
+	char *fullPath = realpath( file, NULL );
+#endif
+	if ( fullPath == NULL )
+		return false;
+
+	identity.Path = fullPath;
+	free( fullPath );
+#ifdef _WIN32
+	// Paths are case insensitive on Windows.
+	identity.Path.ReplaceChars( '\\', '/' );
+	identity.Path.ToLower( );
+#endif
+
+	identity.Size = info.st_size;
+#ifdef __linux__
+	identity.MTime = static_cast<QWORD>( info.st_mtim.tv_sec ) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+	identity.MTime = info.st_mtime;
+#endif
+	identity.Inode = info.st_ino;
+	return true;
+}
+
+//*****************************************************************************
+//
+static bool checksumcache_Matches( const FChecksumCacheEntry &entry, const FFileIdentity &identity )
+{
+	return ( entry.Size == identity.Size ) && ( entry.MTime == identity.MTime ) && ( entry.Inode == identity.Inode );
+}
+
+//*****************************************************************************
+//
+static FString checksumcache_MakeKey( const FFileIdentity &identity, const char *key )
+{
+	FString fullKey = identity.Path;
+	fullKey << '\t' << key;
+	return fullKey;
+}
+
+//*****************************************************************************
+//
+// Parses one "checksum size mtime inode key path" line of the cache file.
+// The fields are separated by tabs.
+//
+static void checksumcache_ParseLine( char *line )
+{
+	char *fields[6];
+	fields[0] = line;
+	for ( unsigned int i = 1; i < countof( fields ); ++i )
+	{
+		char *tab = strchr( fields[i-1], '\t' );
+		if ( tab == NULL )
+			return;
+
+		*tab = '\0';
+		fields[i] = tab + 1;
+	}
+
+	if (( strlen( fields[0] ) != 32 ) || ( *fields[4] == '\0' ) || ( *fields[5] == '\0' ))
+		return;
+
+	FChecksumCacheEntry entry;
+	entry.Checksum = fields[0];
+	entry.Size = strtoull( fields[1], NULL, 10 );
+	entry.MTime = strtoull( fields[2], NULL, 10 );
+	entry.Inode = strtoull( fields[3], NULL, 10 );
+
+	FString fullKey = fields[5];
+	fullKey << '\t' << fields[4];
+	g_ChecksumCache[fullKey] = entry;
+}
+
+//*****************************************************************************
+//
+static void checksumcache_Load( void )
+{
+	if ( g_bChecksumCacheLoaded )
+		return;
+
+	g_bChecksumCacheLoaded = true;
+
+	FILE *f = fopen( checksumcache_GetFileName( false ), "rb" );
+	if ( f == NULL )
+		return;
+
+	TArray<char> data;
+	fseek( f, 0, SEEK_END );
+	const long lLength = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if ( lLength > 0 )
+	{
+		data.Resize( lLength + 1 );
+		data.Resize( static_cast<unsigned int>( fread( &data[0], 1, lLength, f )) + 1 );
+		data[data.Size() - 1] = '\0';
+	}
+	fclose( f );
+
+	if ( data.Size() == 0 )
+		return;
+
+	char *line = &data[0];
+	const FString header = checksumcache_GetHeader( );
+	bool bFirstLine = true;
+
+	while ( *line != '\0' )
+	{
+		char *next = strchr( line, '\n' );
+		if ( next != NULL )
+			*next++ = '\0';
+		else
+			next = line + strlen( line );
+
+		// Ignore files written by other versions.
+		if ( bFirstLine )
+		{
+			if ( header.Compare( line ) != 0 )
+				return;
+
+			bFirstLine = false;
+		}
+		else
+			checksumcache_ParseLine( line );
+
+		line = next;
+	}
+}
+
+//*****************************************************************************
+//
+static bool checksumcache_Lookup( const FFileIdentity &identity, const char *key, FString &checksum )
+{
+	checksumcache_Load( );
+
+	const FChecksumCacheEntry *entry = g_ChecksumCache.CheckKey( checksumcache_MakeKey( identity, key ));
+	if (( entry == NULL ) || ( checksumcache_Matches( *entry, identity ) == false ))
+	{
+		g_ChecksumCacheStats.ulMisses++;
+		return false;
+	}
+
+	g_ChecksumCacheStats.ulHits++;
+	checksum = entry->Checksum;
+	return true;
+}
+
+//*****************************************************************************
+//
+static void checksumcache_Insert( const FFileIdentity &identity, const char *key, const FString &checksum )
+{
+	// These would break the format of the cache file.
+	if ( strpbrk( key, "\t\r\n" ) || strpbrk( identity.Path, "\t\r\n" ))
+		return;
+
+	checksumcache_Load( );
+
+	FChecksumCacheEntry &entry = g_ChecksumCache[checksumcache_MakeKey( identity, key )];
+	entry.Size = identity.Size;
+	entry.MTime = identity.MTime;
+	entry.Inode = identity.Inode;
+	entry.Checksum = checksum;
+	g_bChecksumCacheDirty = true;
+}
+
+//*****************************************************************************
+//
+// Runs on the worker threads, so this must not touch anything but its job.
+//
+static void checksumcache_HashJob( unsigned int ulIdx )
+{
+	FChecksumJob &job = g_ChecksumJobs[ulIdx];
+	MD5Context md5;
+
+	if ( job.File == NULL )
+	{
+		if ( job.Size > 0 )
+			md5.Update( job.Data, static_cast<unsigned int>( job.Size ));
+		job.BytesRead = job.Size;
+	}
+	else
+	{
+		FILE *f = fopen( job.File, "rb" );
+		if ( f == NULL )
+		{
+			job.Error = errno;
+			return;
+		}
+
+		// The reads are big enough already.
+		setvbuf( f, NULL, _IONBF, 0 );
+
+		std::vector<BYTE> buffer( CHECKSUMCACHE_READ_SIZE );
+		size_t len;
+
+		while (( len = fread( &buffer[0], 1, buffer.size(), f )) > 0 )
+		{
+			md5.Update( &buffer[0], static_cast<unsigned int>( len ));
+			job.BytesRead += len;
+		}
+
+		job.Error = ferror( f ) ? EIO : 0;
+		fclose( f );
+
+		if ( job.Error != 0 )
+			return;
+	}
+
+	static const char hexDigits[] = "0123456789abcdef";
+	BYTE digest[16];
+
+	md5.Final( digest );
+	for ( unsigned int i = 0; i < 16; ++i )
+	{
+		job.Checksum[2*i] = hexDigits[digest[i] >> 4];
+		job.Checksum[2*i+1] = hexDigits[digest[i] & 15];
+	}
+	job.Checksum[32] = '\0';
+}
+
+//*****************************************************************************
+//
+static bool checksumcache_CompareJobs( const FChecksumJob &a, const FChecksumJob &b )
+{
+	return a.Size > b.Size;
+}
+
+//*****************************************************************************
+//
+static void checksumcache_AddJob( const char *file, const BYTE *data, QWORD qwSize, unsigned int ulIndex )
+{
+	FChecksumJob job;
+	job.File = file;
+	job.Data = data;
+	job.Index = ulIndex;
+	job.Size = qwSize;
+	job.BytesRead = 0;
+	job.Error = 0;
+	job.Checksum[0] = '\0';
+	g_ChecksumJobs.Push( job );
+}
+
+//*****************************************************************************
+//
+static void checksumcache_RunJobs( void )
+{
+	// Start with the biggest jobs, so that no thread is left with a big one at the end.
+	std::stable_sort( &g_ChecksumJobs[0], &g_ChecksumJobs[0] + g_ChecksumJobs.Size(), checksumcache_CompareJobs );
+
+	// The calling thread takes part as well.
+	const unsigned int ulNumThreads = MIN<unsigned int>( MIN<unsigned int>( std::thread::hardware_concurrency( ), CHECKSUMCACHE_MAX_THREADS ), g_ChecksumJobs.Size() );
+	const unsigned int ulStartTime = I_MSTime( );
+
+	g_ChecksumWorkers.SetNumThreads( ulNumThreads > 1 ? ulNumThreads - 1 : 0 );
+	g_ChecksumWorkers.ParallelFor( g_ChecksumJobs.Size(), checksumcache_HashJob );
+	g_ChecksumWorkers.SetNumThreads( 0 );
+
+	g_ChecksumCacheStats.ulHashTimeMS += I_MSTime( ) - ulStartTime;
+	for ( unsigned int i = 0; i < g_ChecksumJobs.Size(); ++i )
+		g_ChecksumCacheStats.qwBytesHashed += g_ChecksumJobs[i].BytesRead;
+}
+
+//*****************************************************************************
+//
+void CHECKSUMCACHE_GetFileMD5s( const TArray<FString> &files, TArray<FString> &checksums )
+{
+	TArray<FFileIdentity> identities;
+	identities.Resize( files.Size() );
+	checksums.Clear( );
+	checksums.Resize( files.Size() );
+	g_ChecksumJobs.Clear( );
+
+	for ( unsigned int i = 0; i < files.Size(); ++i )
+	{
+		if ( checksumcache_GetIdentity( files[i], identities[i] ))
+		{
+			if ( checksumcache_Lookup( identities[i], CHECKSUMCACHE_FILE_KEY, checksums[i] ))
+				continue;
+		}
+		else
+			g_ChecksumCacheStats.ulMisses++;
+
+		checksumcache_AddJob( files[i], NULL, identities[i].Size, i );
+	}
+
+	if ( g_ChecksumJobs.Size() == 0 )
+		return;
+
+	checksumcache_RunJobs( );
+
+	for ( unsigned int i = 0; i < g_ChecksumJobs.Size(); ++i )
+	{
+		const FChecksumJob &job = g_ChecksumJobs[i];
+		if ( job.Error != 0 )
+		{
+			Printf( "%s: %s\n", job.File, strerror( job.Error ));
+			continue;
+		}
+
+		g_ChecksumCacheStats.ulFilesHashed++;
+		checksums[job.Index] = job.Checksum;
+		if ( identities[job.Index].Path.IsNotEmpty() )
+			checksumcache_Insert( identities[job.Index], CHECKSUMCACHE_FILE_KEY, checksums[job.Index] );
+	}
+
+	g_ChecksumJobs.Clear( );
+}
+
+//*****************************************************************************
+//
+void CHECKSUMCACHE_GetMD5s( const TArray<BYTE> *data, unsigned int ulCount, TArray<FString> &checksums )
+{
+	checksums.Clear( );
+	checksums.Resize( ulCount );
+	g_ChecksumJobs.Clear( );
+
+	for ( unsigned int i = 0; i < ulCount; ++i )
+		checksumcache_AddJob( NULL, data[i].Size() ? &data[i][0] : NULL, data[i].Size(), i );
+
+	if ( g_ChecksumJobs.Size() == 0 )
+		return;
+
+	checksumcache_RunJobs( );
+
+	for ( unsigned int i = 0; i < g_ChecksumJobs.Size(); ++i )
+		checksums[g_ChecksumJobs[i].Index] = g_ChecksumJobs[i].Checksum;
+
+	g_ChecksumJobs.Clear( );
+}
+
+//*****************************************************************************
+//
+bool CHECKSUMCACHE_Find( const char *file, const char *key, FString &checksum )
+{
+	FFileIdentity identity;
+	if ( checksumcache_GetIdentity( file, identity ) == false )
+	{
+		g_ChecksumCacheStats.ulMisses++;
+		return false;
+	}
+
+	return checksumcache_Lookup( identity, key, checksum );
+}
+
+//*****************************************************************************
+//
+void CHECKSUMCACHE_Store( const char *file, const char *key, const FString &checksum )
+{
+	FFileIdentity identity;
+	if ( checksumcache_GetIdentity( file, identity ))
+		checksumcache_Insert( identity, key, checksum );
+}
+
+//*****************************************************************************
+//
+// Entries of files that have changed or are gone are dropped.
+//
+void CHECKSUMCACHE_Save( void )
+{
+	if ( g_bChecksumCacheDirty == false )
+		return;
+
+	g_bChecksumCacheDirty = false;
+
+	const FString fileName = checksumcache_GetFileName( true );
+	const FString tempName = fileName + ".tmp";
+	FILE *f = fopen( tempName, "wb" );
+	if ( f == NULL )
+	{
+		Printf( "Cannot open checksum cache %s for writing\n", tempName.GetChars() );
+		return;
+	}
+
+	fprintf( f, "%s\n", checksumcache_GetHeader( ).GetChars() );
+
+	TMap<FString, FFileIdentity> identities;
+	TMap<FString, FChecksumCacheEntry>::Iterator it( g_ChecksumCache );
+	TMap<FString, FChecksumCacheEntry>::Pair *pair;
+
+	while ( it.NextPair( pair ))
+	{
+		const long lTab = pair->Key.LastIndexOf( '\t' );
+		const FString path = pair->Key.Left( lTab );
+
+		FFileIdentity *identity = identities.CheckKey( path );
+		if ( identity == NULL )
+		{
+			identity = &identities[path];
+			if ( checksumcache_GetIdentity( path, *identity ) == false )
+				identity->Path = "";
+		}
+
+		if ( identity->Path.IsEmpty() || ( checksumcache_Matches( pair->Value, *identity ) == false ))
+			continue;
+
+		fprintf( f, "%s\t%llu\t%llu\t%llu\t%s\t%s\n", pair->Value.Checksum.GetChars(),
+			static_cast<unsigned long long>( pair->Value.Size ), static_cast<unsigned long long>( pair->Value.MTime ),
+			static_cast<unsigned long long>( pair->Value.Inode ), pair->Key.GetChars() + lTab + 1, path.GetChars() );
+	}
+
+	const bool bOk = ( ferror( f ) == 0 );
+	if (( fclose( f ) != 0 ) || ( bOk == false ))
+	{
+		Printf( "Error saving checksum cache %s\n", tempName.GetChars() );
+		remove( tempName );
+		return;
+	}
+
+	remove( fileName );
+	if ( rename( tempName, fileName ) != 0 )
+		Printf( "Error saving checksum cache %s\n", fileName.GetChars() );
+}
+
+//*****************************************************************************
+//
+ADD_STAT( checksums )
+{
+	FString out;
+	const double dSeconds = MAX<unsigned int>( g_ChecksumCacheStats.ulHashTimeMS, 1 ) / 1000.;
+	const double dMegabytes = g_ChecksumCacheStats.qwBytesHashed / ( 1024. * 1024. );
+	out.Format( "Checksum cache: %u hits, %u misses, %u files hashed, %.1f MB in %u ms (%.1f MB/s)",
+		g_ChecksumCacheStats.ulHits, g_ChecksumCacheStats.ulMisses, g_ChecksumCacheStats.ulFilesHashed,
+		dMegabytes, g_ChecksumCacheStats.ulHashTimeMS, dMegabytes / dSeconds );
+	return out;
+}
@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: checksumcache.h
+//
+// Description: Persistent cache of file and lump checksums
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __CHECKSUMCACHE_H__
+#define __CHECKSUMCACHE_H__
+
+#include "doomtype.h"
+#include "tarray.h"
+#include "zstring.h"
+
+//*****************************************************************************
+//	PROTOTYPES
+
+// Computes the MD5 sums (lowercase hex) of the given files. Files whose
+// checksum isn't cached are hashed in parallel. Unreadable files get an empty
+// checksum.
+void	CHECKSUMCACHE_GetFileMD5s( const TArray<FString> &files, TArray<FString> &checksums );
+
+// Computes the MD5 sums of several blocks of data in parallel.
+void	CHECKSUMCACHE_GetMD5s( const TArray<BYTE> *data, unsigned int ulCount, TArray<FString> &checksums );
+
+// Checksums of data inside a file (e.g. lumps). The key identifies the data
+// within the file, the entry becomes invalid once the file changes.
+bool	CHECKSUMCACHE_Find( const char *file, const char *key, FString &checksum );
+void	CHECKSUMCACHE_Store( const char *file, const char *key, const FString &checksum );
+
+// Writes the cache to disk if anything has changed.
+void	CHECKSUMCACHE_Save( void );
+
+#endif	// __CHECKSUMCACHE_H__
@@ -64,6 +64,7 @@
 #include "network_enums.h"
 #include "p_acs.h"
 #include "v_video.h"
+#include "network/playersnapshot.h"
 
 EXTERN_CVAR(Int, cl_packetdup)
 
@@ -320,6 +321,8 @@ void CLIENTCOMMANDS_ClientMove( void )
 	NETWORK_WriteLong( &CLIENT_GetLocalBuffer( )->ByteStream, gametic );
 	// [CK] Send the server the latest known server-gametic
 	NETWORK_WriteLong( &CLIENT_GetLocalBuffer( )->ByteStream, CLIENT_GetLatestServerGametic( ) );
+	// Tell the server which player snapshot it can use as baseline.
+	NETWORK_WriteLong( &CLIENT_GetLocalBuffer( )->ByteStream, PLAYERSNAPSHOT_GetLatestCompleteTic( ) );
 
 	// Decide what additional information needs to be sent.
 	ulBits = 0;
@@ -51,6 +51,7 @@
 #include "c_console.h"
 #include "c_dispatch.h"
 #include "cl_demo.h"
+#include "cl_demostream.h"
 #include "cl_main.h"
 #include "cmdlib.h"
 #include "d_event.h"
@@ -59,21 +60,27 @@
 #include "d_protocol.h"
 #include "doomstat.h"
 #include "doomtype.h"
+#include "farchive.h"
+#include "g_level.h"
 #include "i_system.h"
 #include "m_misc.h"
 #include "m_random.h"
 #include "network.h"
 #include "networkshared.h"
+#include "p_acs.h"
 #include "p_local.h"
 #include "p_tick.h"
 #include "r_draw.h"
 #include "r_state.h"
 #include "sbar.h"
+#include "team.h"
+#include "teaminfo.h"
 #include "version.h"
 #include "templates.h"
 #include "r_data/r_translate.h"
 #include "m_cheat.h"
 #include "network_enums.h"
+#include "network/playersnapshot.h"
 
 //*****************************************************************************
 enum 
@@ -98,6 +105,13 @@ enum
 //	PROTOTYPES
 
 static	void				clientdemo_CheckDemoBuffer( ULONG ulSize );
+static	void				clientdemo_WriteDemoBlocks( bool bFinal );
+static	void				clientdemo_FillDemoBuffer( void );
+static	void				clientdemo_SerializeKeyframe( FArchive &arc );
+static	void				clientdemo_WriteKeyframe( void );
+static	bool				clientdemo_RestoreKeyframe( const FDemoStreamKeyframe &Keyframe );
+static	bool				clientdemo_RewindDemo( void );
+static	void				clientdemo_SeekToTic( ULONG ulTic );
 
 //*****************************************************************************
 //	VARIABLES
@@ -136,9 +150,29 @@ static	LONG				g_lDemoLength;
 // This is the gametic we started playing the demo on.
 static	LONG				g_lGameticOffset;
 
-// Maximum length our current demo can be.
+// Size of our demo buffer.
 static	LONG				g_lMaxDemoLength;
 
+// The demo file is written and read in compressed blocks while the demo is
+// recorded or played, so only a few blocks of it are in memory at once.
+static	FDemoStreamWriter	g_DemoWriter;
+static	FDemoStreamReader	g_DemoReader;
+
+// How much of the recorded demo has already been written to the file.
+static	DWORD				g_ulDemoStreamOffset;
+
+// Did we reach the end of the demo file we are playing?
+static	bool				g_bDemoStreamEnded;
+
+// How many tics of the demo have been recorded or played so far.
+static	ULONG				g_ulDemoTic;
+
+// The tic of the last keyframe in the demo we are recording.
+static	ULONG				g_ulLastKeyframeTic;
+
+// Are we archiving or restoring a keyframe right now?
+static	bool				g_bArchivingKeyframe = false;
+
 // [BB] Special player that is used to control the camera when playing demos in free spectate mode.
 static	player_t			g_demoCameraPlayer;
 
@@ -158,6 +192,14 @@ CUSTOM_CVAR( Bool, demo_pure, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG )
 
 EXTERN_CVAR(Bool, sv_showactorrandom)
 
+// How many seconds of a demo are recorded between two keyframes. demo_seek
+// restores the world from these, so this is how far it may need to play.
+CUSTOM_CVAR( Int, demo_keyframeinterval, 30, CVAR_ARCHIVE | CVAR_GLOBALCONFIG )
+{
+	if ( self < 0 )
+		self = 0;
+}
+
 //*****************************************************************************
 //	FUNCTIONS
 
@@ -177,9 +219,18 @@ void CLIENTDEMO_BeginRecording( const char *pszDemoName )
 	FixPathSeperator( g_DemoName );
 	DefaultExtension( g_DemoName, ".cld" );
 
-	// Allocate 128KB of memory for the demo buffer.
+	if ( g_DemoWriter.Open( g_DemoName ) == false )
+	{
+		Printf( "Cannot open demo file %s for writing\n", g_DemoName.GetChars() );
+		return;
+	}
+
+	// The demo buffer only holds what hasn't been written to the file yet.
 	g_bDemoRecording = true;
-	g_lMaxDemoLength = 0x20000;
+	g_lMaxDemoLength = 2 * DEMOSTREAM_BLOCK_SIZE;
+	g_ulDemoStreamOffset = 0;
+	g_ulDemoTic = 0;
+	g_ulLastKeyframeTic = 0;
 	g_pbDemoBuffer = (BYTE *)M_Malloc( g_lMaxDemoLength );
 	g_ByteStream.pbStream = g_pbDemoBuffer;
 	g_ByteStream.pbStreamEnd = g_pbDemoBuffer + g_lMaxDemoLength;
@@ -189,9 +240,10 @@ void CLIENTDEMO_BeginRecording( const char *pszDemoName )
 	// different Zandronum versions.
 	NETWORK_WriteLong( &g_ByteStream, g_demoSignature );
 
-	// Write the length of the demo. Of course, we can't complete this quite yet!
+	// Write the length of the demo. This has been written to the file long before
+	// we know it, so the length is stored in the header of the file instead.
 	NETWORK_WriteByte( &g_ByteStream, CLD_DEMOLENGTH );
-	g_ByteStream.pbStream += 4;
+	NETWORK_WriteLong( &g_ByteStream, 0 );
 
 	// Write version information helpful for this demo.
 	NETWORK_WriteByte( &g_ByteStream, CLD_DEMOVERSION );
@@ -269,7 +321,10 @@ bool CLIENTDEMO_ProcessDemoHeader( void )
 	}
 
 	g_lDemoLength = NETWORK_ReadLong( &g_ByteStream );
-	g_ByteStream.pbStreamEnd = g_pbDemoBuffer + g_lDemoLength + ( g_lDemoLength & 1 );
+	if ( g_DemoReader.IsOpen( ))
+		g_lDemoLength = g_DemoReader.GetStreamLength( );
+	else
+		g_ByteStream.pbStreamEnd = g_pbDemoBuffer + g_lDemoLength + ( g_lDemoLength & 1 );
 
 	// Continue to read header commands until we reach the body of the demo.
 	bBodyStart = false;
@@ -392,6 +447,14 @@ void CLIENTDEMO_ReadUserInfo( void )
 //
 void CLIENTDEMO_WriteTiccmd( ticcmd_t *pCmd )
 {
+	// Keyframes are written before the ticcmd, so that the demo continues with
+	// the tic the keyframe was taken in when it's restored.
+	if (( demo_keyframeinterval > 0 ) &&
+		( g_ulDemoTic - g_ulLastKeyframeTic >= static_cast<ULONG>( demo_keyframeinterval * TICRATE )))
+	{
+		clientdemo_WriteKeyframe( );
+	}
+
 	// First, make sure we have enough space to write this command. If not, add
 	// more space.
 	clientdemo_CheckDemoBuffer( 23 );
@@ -407,6 +470,11 @@ void CLIENTDEMO_WriteTiccmd( ticcmd_t *pCmd )
 	NETWORK_WriteShort( &g_ByteStream, pCmd->ucmd.upmove );
 	NETWORK_WriteShort( &g_ByteStream, pCmd->ucmd.forwardmove );
 	NETWORK_WriteShort( &g_ByteStream, pCmd->ucmd.sidemove );
+	g_ulDemoTic++;
+
+	// This is the end of the tic, so no position is marked in the demo buffer
+	// and the finished blocks can be written.
+	clientdemo_WriteDemoBlocks( false );
 }
 
 //*****************************************************************************
@@ -485,6 +553,7 @@ void CLIENTDEMO_ReadPacket( void )
 
 	while ( 1 )
 	{  
+		clientdemo_FillDemoBuffer( );
 		lCommand = NETWORK_ReadByte( &g_ByteStream );
 
 		// [TP/BB] Reset the bit reading buffer.
@@ -508,6 +577,7 @@ void CLIENTDEMO_ReadPacket( void )
 		case CLD_TICCMD:
 
 			CLIENTDEMO_ReadTiccmd( &players[consoleplayer].cmd );
+			g_ulDemoTic++;
 
 			// After we write our ticcmd, we're done for this tic.
 			if ( CLIENTDEMO_IsSkipping() == false )
@@ -587,58 +657,85 @@ void CLIENTDEMO_ReadPacket( void )
 //
 void CLIENTDEMO_FinishRecording( void )
 {
-	LONG			lDemoLength;
-	BYTESTREAM_s	ByteStream;
-
 	// Write our header.
 	NETWORK_WriteByte( &g_ByteStream, CLD_DEMOEND );
 
-	// Go back real quick and write the length of this demo.
-	lDemoLength = g_ByteStream.pbStream - g_pbDemoBuffer;
-	ByteStream.pbStream = g_pbDemoBuffer + 5;
-	ByteStream.pbStreamEnd = g_ByteStream.pbStreamEnd;
-	NETWORK_WriteLong( &ByteStream, lDemoLength );
-
-	// Write the contents of the buffer to the file, and free the memory we
-	// allocated for the demo.
-	M_WriteFile( g_DemoName.GetChars(), g_pbDemoBuffer, lDemoLength ); 
+	// Write the rest of the demo to the file along with its length, and free
+	// the memory we allocated for the demo.
+	const DWORD ulDemoLength = g_ulDemoStreamOffset + static_cast<DWORD>( g_ByteStream.pbStream - g_pbDemoBuffer );
+	clientdemo_WriteDemoBlocks( true );
+	const bool bSaved = g_DemoWriter.Close( ulDemoLength );
 	M_Free( g_pbDemoBuffer );
 	g_pbDemoBuffer = NULL;
 
 	// We're no longer recording a demo.
 	g_bDemoRecording = false;
 
+	if ( bSaved == false )
+	{
+		Printf( "Error saving demo \"%s\"!\n", g_DemoName.GetChars() );
+		return;
+	}
+
 	// All done!
-	Printf( "Demo \"%s\" successfully recorded!\n", g_DemoName.GetChars() ); 
+	Printf( "Demo \"%s\" successfully recorded! (%lu KB, %lu KB uncompressed, %u keyframes)\n", g_DemoName.GetChars(),
+		static_cast<unsigned long>( g_DemoWriter.GetFileSize( ) / 1024 ), static_cast<unsigned long>( ulDemoLength / 1024 ),
+		g_DemoWriter.GetNumKeyframes( ));
 }
 
 //*****************************************************************************
 //
 void CLIENTDEMO_DoPlayDemo( const char *pszDemoName )
 {
-	LONG	lDemoLump;
-	LONG	lDemoLength;
-	FString demoName = pszDemoName;
+	LONG		lDemoLump;
+	LONG		lDemoLength;
+	FString		demoName = pszDemoName;
+	FileReader	*pReader;
 
 	// First, check if the demo is in a lump.
 	lDemoLump = Wads.CheckNumForName( demoName );
 	if ( lDemoLump >= 0 )
-	{
-		lDemoLength = Wads.LumpLength( lDemoLump );
-
-		// Read the data from the lump into our demo buffer.
-		g_pbDemoBuffer = new BYTE[lDemoLength];
-		Wads.ReadLump( lDemoLump, g_pbDemoBuffer );
-	}
+		pReader = Wads.ReopenLumpNum( lDemoLump );
 	else
 	{
 		FixPathSeperator( demoName );
 		DefaultExtension( demoName, ".cld" );
-		lDemoLength = M_ReadFile( demoName, &g_pbDemoBuffer );
+
+		FileReader *pFile = new FileReader;
+		if ( pFile->Open( demoName ) == false )
+		{
+			delete pFile;
+			I_Error( "Couldn't read file %s", demoName.GetChars() );
+		}
+		pReader = pFile;
 	}
 
-	g_ByteStream.pbStream = g_pbDemoBuffer;
-	g_ByteStream.pbStreamEnd = g_pbDemoBuffer + lDemoLength;
+	// Demos are read from the file block by block while they are played. Demos
+	// from older versions aren't split into blocks and are read at once.
+	if ( FDemoStreamReader::IsStreamedDemo( pReader ))
+	{
+		if ( g_DemoReader.Open( pReader ) == false )
+			I_Error( "CLIENTDEMO_DoPlayDemo: %s is not a valid demo file.\n", demoName.GetChars() );
+
+		g_pbDemoBuffer = new BYTE[2 * g_DemoReader.GetBlockSize( )];
+		g_ByteStream.pbStream = g_pbDemoBuffer;
+		g_ByteStream.pbStreamEnd = g_pbDemoBuffer;
+		g_bDemoStreamEnded = false;
+		clientdemo_FillDemoBuffer( );
+	}
+	else
+	{
+		lDemoLength = pReader->GetLength( );
+		g_pbDemoBuffer = new BYTE[lDemoLength];
+		const bool bRead = ( pReader->Read( g_pbDemoBuffer, lDemoLength ) == lDemoLength );
+		delete pReader;
+
+		if ( bRead == false )
+			I_Error( "Couldn't read file %s", demoName.GetChars() );
+
+		g_ByteStream.pbStream = g_pbDemoBuffer;
+		g_ByteStream.pbStreamEnd = g_pbDemoBuffer + lDemoLength;
+	}
 
 	if ( CLIENTDEMO_ProcessDemoHeader( ))
 	{
@@ -648,6 +745,7 @@ void CLIENTDEMO_DoPlayDemo( const char *pszDemoName )
 		CLIENTDEMO_SetSkippingToNextMap ( false );
 
 		g_lGameticOffset = gametic;
+		g_ulDemoTic = 0;
 	}
 	else
 	{
@@ -662,7 +760,8 @@ void CLIENTDEMO_FinishPlaying( void )
 {
 //	C_RestoreCVars ();		// [RH] Restore cvars demo might have changed
 
-	// Free our demo buffer.
+	// Stop reading the demo file and free our demo buffer.
+	g_DemoReader.Close( );
 	delete[] ( g_pbDemoBuffer );
 	g_pbDemoBuffer = NULL;
 
@@ -818,6 +917,13 @@ void CLIENTDEMO_SetSkippingToNextMap( bool bSkipToNextMap )
 	g_bSkipToNextMap = bSkipToNextMap;
 }
 
+//*****************************************************************************
+//
+bool CLIENTDEMO_IsArchivingKeyframe( void )
+{
+	return g_bArchivingKeyframe;
+}
+
 //*****************************************************************************
 //
 bool CLIENTDEMO_IsInFreeSpectateMode( void )
@@ -956,6 +1062,294 @@ static void clientdemo_CheckDemoBuffer( ULONG ulSize )
 	}
 }
 
+//*****************************************************************************
+//
+// Writes the full blocks in our demo buffer to the demo file, and with bFinal
+// also what is left. Must not be called while a position is marked in the
+// buffer for CLIENTDEMO_InsertPacketAtMarkedPosition.
+//
+static void clientdemo_WriteDemoBlocks( bool bFinal )
+{
+	const LONG lLength = g_ByteStream.pbStream - g_pbDemoBuffer;
+	LONG lWritten = 0;
+
+	while (( lLength - lWritten >= DEMOSTREAM_BLOCK_SIZE ) || ( bFinal && ( lWritten < lLength )))
+	{
+		const LONG lBlockSize = MIN<LONG>( lLength - lWritten, DEMOSTREAM_BLOCK_SIZE );
+		g_DemoWriter.WriteBlock( g_pbDemoBuffer + lWritten, lBlockSize );
+		lWritten += lBlockSize;
+	}
+
+	if ( lWritten == 0 )
+		return;
+
+	// Move what's left to the start of the buffer.
+	memmove( g_pbDemoBuffer, g_pbDemoBuffer + lWritten, lLength - lWritten );
+	g_ByteStream.pbStream -= lWritten;
+	g_pbMarkedStreamPosition = g_ByteStream.pbStream;
+	g_ulDemoStreamOffset += lWritten;
+}
+
+//*****************************************************************************
+//
+// Makes sure that at least a block of the demo we are playing is in our demo
+// buffer ahead of the current position, unless the demo ends before that.
+// The commands never span more than that, so this is done before each one.
+//
+static void clientdemo_FillDemoBuffer( void )
+{
+	if (( g_DemoReader.IsOpen( ) == false ) || g_bDemoStreamEnded )
+		return;
+
+	const LONG lRemaining = MAX<LONG>( g_ByteStream.pbStreamEnd - g_ByteStream.pbStream, 0 );
+	if ( lRemaining >= static_cast<LONG>( g_DemoReader.GetBlockSize( )))
+		return;
+
+	memmove( g_pbDemoBuffer, g_ByteStream.pbStream, lRemaining );
+	g_ByteStream.pbStream = g_pbDemoBuffer;
+	g_ByteStream.pbStreamEnd = g_pbDemoBuffer + lRemaining;
+
+	const unsigned int ulRead = g_DemoReader.ReadBlock( g_ByteStream.pbStreamEnd );
+	g_ByteStream.pbStreamEnd += ulRead;
+
+	if ( ulRead == 0 )
+	{
+		g_bDemoStreamEnded = true;
+		if ( g_DemoReader.GetError( ) != NULL )
+			Printf( "\\cgWarning: %s\\c-\n", g_DemoReader.GetError( ));
+	}
+}
+
+//*****************************************************************************
+//
+// Archives or restores what a keyframe holds: the whole level, as it is
+// saved in a savegame, along with the players, the team scores, the ACS
+// strings the level refers to and the player snapshots the demo continues
+// with.
+//
+static void clientdemo_SerializeKeyframe( FArchive &arc )
+{
+	g_bArchivingKeyframe = true;
+
+	try
+	{
+		// The players' slots and what the level doesn't save of them. Their
+		// slots are needed before the level, which puts them back into them.
+		for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+		{
+			player_t *pPlayer = &players[ulIdx];
+
+			arc << playeringame[ulIdx]
+				<< pPlayer->bSpectating
+				<< pPlayer->bDeadSpectator
+				<< pPlayer->lPointCount
+				<< pPlayer->ulDeathCount
+				<< pPlayer->ulFragsWithoutDeath
+				<< pPlayer->ulDeathsWithoutFrag
+				<< pPlayer->ulLivesLeft
+				<< pPlayer->ulWins
+				<< pPlayer->ulPing
+				<< pPlayer->ulTime
+				<< pPlayer->bIsBot;
+		}
+
+		DWORD ulNumTeams = teams.Size( );
+		arc << ulNumTeams;
+
+		for ( ULONG ulIdx = 0; ulIdx < ulNumTeams; ++ulIdx )
+		{
+			const bool bValidTeam = ( ulIdx < teams.Size( ));
+			LONG lScore = bValidTeam ? TEAM_GetScore( ulIdx ) : 0;
+			LONG lFragCount = bValidTeam ? TEAM_GetFragCount( ulIdx ) : 0;
+			LONG lDeathCount = bValidTeam ? TEAM_GetDeathCount( ulIdx ) : 0;
+			LONG lWinCount = bValidTeam ? TEAM_GetWinCount( ulIdx ) : 0;
+
+			arc << lScore << lFragCount << lDeathCount << lWinCount;
+
+			if ( arc.IsLoading( ) && bValidTeam )
+			{
+				TEAM_SetScore( ulIdx, lScore, false );
+				TEAM_SetFragCount( ulIdx, lFragCount, false );
+				TEAM_SetDeathCount( ulIdx, lDeathCount );
+				TEAM_SetWinCount( ulIdx, lWinCount, false );
+			}
+		}
+
+		arc << level.time << level.starttime;
+
+		// Map variables and script locals hold string numbers of this pool.
+		GlobalACSStrings.Serialize( arc );
+		G_SerializeLevel( arc, false );
+
+		// With sv_deltasnapshots, the chunks that follow are encoded against these.
+		PLAYERSNAPSHOT_SerializeReceived( arc );
+	}
+	catch ( ... )
+	{
+		g_bArchivingKeyframe = false;
+		throw;
+	}
+
+	g_bArchivingKeyframe = false;
+}
+
+//*****************************************************************************
+//
+// Adds a keyframe of the current tic to the demo we are recording. The demo
+// continues in a new block after it, so that it can be played from there.
+//
+static void clientdemo_WriteKeyframe( void )
+{
+	// Only a level we have fully entered can be restored.
+	if (( gamestate != GS_LEVEL ) || ( CLIENT_GetConnectionState( ) != CTS_ACTIVE ))
+		return;
+
+	clientdemo_WriteDemoBlocks( true );
+
+	FCompressedMemFile keyframe;
+	keyframe.Open( );
+	FArchive arc( keyframe );
+	SaveVersion = SAVEVER;
+
+	FString mapName = level.mapname;
+	arc << mapName;
+	clientdemo_SerializeKeyframe( arc );
+	arc.Close( );
+
+	unsigned int ulCompressedSize, ulSize;
+	keyframe.GetSizes( ulCompressedSize, ulSize );
+	if ( ulCompressedSize != 0 )
+		ulSize = ulCompressedSize;
+
+	if ( g_DemoWriter.WriteKeyframe( g_ulDemoTic, g_ulDemoStreamOffset, static_cast<const BYTE *>( keyframe.GetImplodedBuffer( )), ulSize + 8 ) == false )
+		Printf( "\\cgWarning: Couldn't write a keyframe to the demo.\\c-\n" );
+
+	// Don't try again every tic if it failed.
+	g_ulLastKeyframeTic = g_ulDemoTic;
+}
+
+//*****************************************************************************
+//
+// Restores the world from a keyframe of the demo we are playing, and continues
+// playing the demo from there.
+//
+static bool clientdemo_RestoreKeyframe( const FDemoStreamKeyframe &Keyframe )
+{
+	TArray<BYTE> data;
+	if ( g_DemoReader.SeekToKeyframe( Keyframe, data ) == false )
+	{
+		Printf( "Couldn't read the keyframe at tic %u of the demo.\n", static_cast<unsigned int>( Keyframe.ulTic ));
+		return false;
+	}
+
+	g_ByteStream.pbStream = g_pbDemoBuffer;
+	g_ByteStream.pbStreamEnd = g_pbDemoBuffer;
+	g_bDemoStreamEnded = false;
+
+	FCompressedMemFile keyframe;
+	keyframe.Open( &data[0] );
+	FArchive arc( keyframe );
+	SaveVersion = SAVEVER;
+
+	FString mapName;
+	arc << mapName;
+
+	// The free spectator's body would be destroyed with the rest of the level.
+	CLIENTDEMO_ClearFreeSpectatorPlayer( );
+
+	// Snapshots newer than the keyframe mustn't keep the demo's from applying.
+	PLAYERSNAPSHOT_ClearReceived( );
+
+	// Load the keyframe's map if we are elsewhere. This is what happens when
+	// the demo changes the map.
+	if (( gamestate != GS_LEVEL ) || ( mapName.CompareNoCase( level.mapname ) != 0 ))
+	{
+		if ( P_CheckIfMapExists( mapName ) == false )
+			I_Error( "CLIENTDEMO_RestoreKeyframe: Unknown map: %s\n", mapName.GetChars( ));
+
+		G_InitNew( mapName, false );
+		CLIENTDEMO_SetPlaying( true );
+	}
+
+	clientdemo_SerializeKeyframe( arc );
+	arc.Close( );
+
+	// The actors have their net IDs from the keyframe.
+	g_NetIDList.rebuild( );
+
+	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+	{
+		if ( playeringame[ulIdx] == false )
+			PLAYER_ResetPlayerData( &players[ulIdx] );
+	}
+
+	if ( StatusBar )
+		StatusBar->AttachToPlayer( &players[consoleplayer] );
+	viewactive = true;
+
+	g_ulDemoTic = Keyframe.ulTic;
+	g_lGameticOffset = gametic - g_ulDemoTic;
+	return true;
+}
+
+//*****************************************************************************
+//
+// Starts playing the demo from its beginning again.
+//
+static bool clientdemo_RewindDemo( void )
+{
+	if ( g_DemoReader.IsOpen( ))
+	{
+		if ( g_DemoReader.Rewind( ) == false )
+		{
+			Printf( "Couldn't rewind the demo.\n" );
+			return false;
+		}
+
+		g_ByteStream.pbStream = g_pbDemoBuffer;
+		g_ByteStream.pbStreamEnd = g_pbDemoBuffer;
+		g_bDemoStreamEnded = false;
+		clientdemo_FillDemoBuffer( );
+	}
+	// Demos from older versions are in memory as a whole.
+	else
+		g_ByteStream.pbStream = g_pbDemoBuffer;
+
+	// This is what the demo starts with. The snapshot tics start over, too.
+	CLIENTDEMO_ClearFreeSpectatorPlayer( );
+	CLIENT_ClearAllPlayers( );
+	PLAYERSNAPSHOT_ClearReceived( );
+	CLIENTDEMO_ProcessDemoHeader( );
+
+	g_ulDemoTic = 0;
+	g_lGameticOffset = gametic;
+	return true;
+}
+
+//*****************************************************************************
+//
+// Restores the last keyframe before the tic if the demo can't simply be played
+// up to it from where we are, then skips the rest of the way.
+//
+static void clientdemo_SeekToTic( ULONG ulTic )
+{
+	const TArray<FDemoStreamKeyframe> &keyframes = g_DemoReader.GetKeyframes( );
+	const FDemoStreamKeyframe *pKeyframe = NULL;
+
+	for ( unsigned int i = 0; ( i < keyframes.Size( )) && ( keyframes[i].ulTic <= ulTic ); ++i )
+		pKeyframe = &keyframes[i];
+
+	if (( ulTic < g_ulDemoTic ) || (( pKeyframe != NULL ) && ( pKeyframe->ulTic > g_ulDemoTic )))
+	{
+		const bool bSeeked = ( pKeyframe != NULL ) ? clientdemo_RestoreKeyframe( *pKeyframe ) : clientdemo_RewindDemo( );
+		if ( bSeeked == false )
+			return;
+	}
+
+	CLIENTDEMO_SetSkippingToNextMap( false );
+	g_ulTicsToSkip = ulTic - g_ulDemoTic;
+}
+
 //*****************************************************************************
 //	CONSOLE COMMANDS
 
@@ -1002,6 +1396,27 @@ CCMD( demo_skiptics )
 	}
 }
 
+CCMD( demo_seek )
+{
+	// This command shouldn't do anything if a demo isn't playing.
+	if ( CLIENTDEMO_IsPlaying( ) == false )
+		return;
+
+	if ( argv.argc() < 2 )
+	{
+		Printf( "Usage: demo_seek <tic> or demo_seek +/-<tics>\n" );
+		Printf( "At tic %u of the demo, which has %u keyframes.\n", static_cast<unsigned int>( g_ulDemoTic ), g_DemoReader.GetKeyframes( ).Size( ));
+		return;
+	}
+
+	// A sign makes the tic relative to where we are.
+	LONG lTic = atoi( argv[1] );
+	if (( argv[1][0] == '+' ) || ( argv[1][0] == '-' ))
+		lTic += static_cast<LONG>( g_ulDemoTic );
+
+	clientdemo_SeekToTic( static_cast<ULONG>( MAX<LONG>( lTic, 0 )));
+}
+
 CCMD( demo_spectatefreely )
 {
 	// [Spleen] This command shouldn't do anything if a demo isn't playing.
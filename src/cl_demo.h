@@ -98,6 +98,7 @@ void		CLIENTDEMO_SetPlaying( bool bPlaying );
 bool		CLIENTDEMO_IsPaused( void );
 bool		CLIENTDEMO_IsSkipping( void );
 bool		CLIENTDEMO_IsSkippingToNextMap( void );
+bool		CLIENTDEMO_IsArchivingKeyframe( void );
 void		CLIENTDEMO_SetSkippingToNextMap( bool bSkipToNextMap );
 bool		CLIENTDEMO_IsInFreeSpectateMode( void );
 void		CLIENTDEMO_SetFreeSpectatorTiccmd( ticcmd_t *pCmd );
@@ -0,0 +1,567 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: cl_demostream.cpp
+//
+// Description: Block-compressed container for client demos
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include <zlib.h>
+
+#include "m_swap.h"
+#include "files.h"
+#include "cl_demostream.h"
+
+//*****************************************************************************
+//
+static void demostream_WriteLong( BYTE *pbBuffer, DWORD ulValue )
+{
+	ulValue = LittleLong( ulValue );
+	memcpy( pbBuffer, &ulValue, 4 );
+}
+
+//*****************************************************************************
+//
+static DWORD demostream_ReadLong( const BYTE *pbBuffer )
+{
+	DWORD ulValue;
+	memcpy( &ulValue, pbBuffer, 4 );
+	return LittleLong( ulValue );
+}
+
+//*****************************************************************************
+//*****************************************************************************
+//
+FDemoStreamWriter::FDemoStreamWriter ( ) : _file ( NULL ), _fileSize ( 0 ), _failed ( false )
+{
+}
+
+//*****************************************************************************
+//
+FDemoStreamWriter::~FDemoStreamWriter ( )
+{
+	if ( _file != NULL )
+		fclose( _file );
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamWriter::Open ( const char *pszFileName )
+{
+	_file = fopen( pszFileName, "wb" );
+	if ( _file == NULL )
+		return false;
+
+	// The length of the demo and the index are filled in by Close.
+	const DWORD signature = DEMOSTREAM_SIGNATURE;
+	BYTE header[DEMOSTREAM_HEADER_SIZE];
+	memcpy( header, &signature, 4 );
+	demostream_WriteLong( header + 4, DEMOSTREAM_VERSION );
+	demostream_WriteLong( header + 8, DEMOSTREAM_BLOCK_SIZE );
+	demostream_WriteLong( header + 12, 0 );
+	demostream_WriteLong( header + 16, 0 );
+
+	_fileSize = 0;
+	_failed = false;
+	_keyframes.Clear( );
+	return Write( header, sizeof( header ));
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamWriter::Write ( const void *data, size_t size )
+{
+	if (( _failed == false ) && ( size > 0 ) && ( fwrite( data, size, 1, _file ) != 1 ))
+		_failed = true;
+
+	_fileSize += static_cast<DWORD>( size );
+	return ( _failed == false );
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamWriter::WriteBlock ( const BYTE *pbData, unsigned int ulSize )
+{
+	if (( _file == NULL ) || ( ulSize == 0 ))
+		return false;
+
+	uLongf storedSize = compressBound( ulSize );
+	_compressed.Resize( storedSize );
+
+	// Keep the block as it is if it doesn't compress.
+	const BYTE *pbStored = &_compressed[0];
+	BYTE method = DEMOSTREAM_DEFLATE;
+	if (( compress( &_compressed[0], &storedSize, pbData, ulSize ) != Z_OK ) || ( storedSize >= ulSize ))
+	{
+		pbStored = pbData;
+		storedSize = ulSize;
+		method = DEMOSTREAM_STORED;
+	}
+
+	BYTE header[DEMOSTREAM_BLOCK_HEADER_SIZE];
+	demostream_WriteLong( header, ulSize );
+	demostream_WriteLong( header + 4, static_cast<DWORD>( storedSize ));
+	header[8] = method;
+
+	return Write( header, sizeof( header )) && Write( pbStored, storedSize );
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamWriter::WriteKeyframe ( DWORD ulTic, DWORD ulStreamOffset, const BYTE *pbData, unsigned int ulSize )
+{
+	if (( _file == NULL ) || ( ulSize == 0 ) || ( ulSize > DEMOSTREAM_MAX_KEYFRAME_SIZE ))
+		return false;
+
+	FDemoStreamKeyframe keyframe;
+	keyframe.ulTic = ulTic;
+	keyframe.ulStreamOffset = ulStreamOffset;
+	keyframe.ulFileOffset = _fileSize;
+
+	BYTE header[DEMOSTREAM_BLOCK_HEADER_SIZE];
+	demostream_WriteLong( header, ulSize );
+	demostream_WriteLong( header + 4, ulSize );
+	header[8] = DEMOSTREAM_KEYFRAME;
+
+	if (( Write( header, sizeof( header )) && Write( pbData, ulSize )) == false )
+		return false;
+
+	_keyframes.Push( keyframe );
+	return true;
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamWriter::Close ( DWORD ulStreamLength )
+{
+	if ( _file == NULL )
+		return false;
+
+	// Mark the end of the demo.
+	BYTE header[DEMOSTREAM_BLOCK_HEADER_SIZE];
+	memset( header, 0, sizeof( header ));
+	Write( header, sizeof( header ));
+
+	// Then write the keyframe index.
+	DWORD ulIndexOffset = 0;
+	if ( _keyframes.Size( ) > 0 )
+	{
+		ulIndexOffset = _fileSize;
+
+		BYTE entry[12];
+		demostream_WriteLong( entry, _keyframes.Size( ));
+		Write( entry, 4 );
+
+		for ( unsigned int i = 0; i < _keyframes.Size( ); ++i )
+		{
+			demostream_WriteLong( entry, _keyframes[i].ulTic );
+			demostream_WriteLong( entry + 4, _keyframes[i].ulStreamOffset );
+			demostream_WriteLong( entry + 8, _keyframes[i].ulFileOffset );
+			Write( entry, sizeof( entry ));
+		}
+	}
+
+	// Finally fill in the length of the demo and where the index is.
+	BYTE trailer[8];
+	demostream_WriteLong( trailer, ulStreamLength );
+	demostream_WriteLong( trailer + 4, ulIndexOffset );
+	if ( fseek( _file, 12, SEEK_SET ) != 0 )
+		_failed = true;
+	else
+	{
+		Write( trailer, sizeof( trailer ));
+		_fileSize -= sizeof( trailer );
+	}
+
+	if ( fclose( _file ) != 0 )
+		_failed = true;
+
+	_file = NULL;
+	return ( _failed == false );
+}
+
+//*****************************************************************************
+//*****************************************************************************
+//
+FDemoStreamReader::FDemoStreamReader ( ) :
+	_reader ( NULL ),
+	_blockSize ( 0 ),
+	_streamLength ( 0 ),
+	_firstBlockOffset ( 0 ),
+	_resumeOffset ( 0 ),
+	_firstBlock ( 0 ),
+	_numBlocks ( 0 ),
+	_finished ( false ),
+	_error ( NULL ),
+	_stop ( false )
+{
+}
+
+//*****************************************************************************
+//
+FDemoStreamReader::~FDemoStreamReader ( )
+{
+	Close( );
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamReader::IsStreamedDemo ( FileReader *pReader )
+{
+	DWORD signature = 0;
+	const long lPosition = pReader->Tell( );
+	const bool bRead = ( pReader->Read( &signature, 4 ) == 4 );
+	pReader->Seek( lPosition, SEEK_SET );
+	return bRead && ( signature == DEMOSTREAM_SIGNATURE );
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamReader::Open ( FileReader *pReader )
+{
+	Close( );
+	_reader = pReader;
+
+	BYTE header[DEMOSTREAM_HEADER_SIZE];
+	if ( _reader->Read( header, DEMOSTREAM_HEADER_SIZE_V1 ) != DEMOSTREAM_HEADER_SIZE_V1 )
+	{
+		Close( );
+		return false;
+	}
+
+	const DWORD ulVersion = demostream_ReadLong( header + 4 );
+	DWORD ulIndexOffset = 0;
+	if ( ulVersion == 1 )
+		_firstBlockOffset = DEMOSTREAM_HEADER_SIZE_V1;
+	else if (( ulVersion == DEMOSTREAM_VERSION )
+		&& ( _reader->Read( header + DEMOSTREAM_HEADER_SIZE_V1, 4 ) == 4 ))
+	{
+		_firstBlockOffset = DEMOSTREAM_HEADER_SIZE;
+		ulIndexOffset = demostream_ReadLong( header + 16 );
+	}
+	else
+	{
+		Close( );
+		return false;
+	}
+
+	// Don't trust the file with how much memory to allocate.
+	_blockSize = demostream_ReadLong( header + 8 );
+	_streamLength = demostream_ReadLong( header + 12 );
+	if (( _blockSize == 0 ) || ( _blockSize > 16 * DEMOSTREAM_BLOCK_SIZE ))
+	{
+		Close( );
+		return false;
+	}
+
+	// A broken index only means that we can't seek.
+	_keyframes.Clear( );
+	if (( ulIndexOffset != 0 ) && ( ReadIndex( ulIndexOffset ) == false ))
+		_keyframes.Clear( );
+
+	if ( _reader->Seek( _firstBlockOffset, SEEK_SET ) != 0 )
+	{
+		Close( );
+		return false;
+	}
+
+	_resumeOffset = _firstBlockOffset;
+	StartDecoder( );
+	return true;
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamReader::ReadIndex ( DWORD ulIndexOffset )
+{
+	BYTE entry[12];
+	if (( _reader->Seek( ulIndexOffset, SEEK_SET ) != 0 ) || ( _reader->Read( entry, 4 ) != 4 ))
+		return false;
+
+	const DWORD ulNumKeyframes = demostream_ReadLong( entry );
+	if ( ulNumKeyframes > static_cast<DWORD>( _reader->GetLength( )) / sizeof( entry ))
+		return false;
+
+	for ( DWORD i = 0; i < ulNumKeyframes; ++i )
+	{
+		if ( _reader->Read( entry, sizeof( entry )) != sizeof( entry ))
+			return false;
+
+		FDemoStreamKeyframe keyframe;
+		keyframe.ulTic = demostream_ReadLong( entry );
+		keyframe.ulStreamOffset = demostream_ReadLong( entry + 4 );
+		keyframe.ulFileOffset = demostream_ReadLong( entry + 8 );
+
+		// Seeking relies on the keyframes being in order.
+		if (( _keyframes.Size( ) > 0 ) && ( keyframe.ulTic < _keyframes.Last( ).ulTic ))
+			return false;
+
+		_keyframes.Push( keyframe );
+	}
+
+	return true;
+}
+
+//*****************************************************************************
+//
+void FDemoStreamReader::StartDecoder ( )
+{
+	_firstBlock = 0;
+	_numBlocks = 0;
+	_finished = false;
+	_error = NULL;
+	_stop = false;
+	_thread = std::thread( &FDemoStreamReader::DecoderMain, this );
+}
+
+//*****************************************************************************
+//
+void FDemoStreamReader::StopDecoder ( )
+{
+	if ( _thread.joinable( ))
+	{
+		{
+			std::lock_guard<std::mutex> lock ( _mutex );
+			_stop = true;
+		}
+		_slotFree.notify_all( );
+		_thread.join( );
+	}
+
+	_numBlocks = 0;
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamReader::SeekToKeyframe ( const FDemoStreamKeyframe &Keyframe, TArray<BYTE> &Data )
+{
+	if ( _reader == NULL )
+		return false;
+
+	StopDecoder( );
+
+	BYTE header[DEMOSTREAM_BLOCK_HEADER_SIZE];
+	bool bRead = ( _reader->Seek( Keyframe.ulFileOffset, SEEK_SET ) == 0 )
+		&& ( _reader->Read( header, sizeof( header )) == sizeof( header ));
+
+	const DWORD ulSize = bRead ? demostream_ReadLong( header ) : 0;
+	if (( ulSize == 0 ) || ( ulSize > DEMOSTREAM_MAX_KEYFRAME_SIZE )
+		|| ( demostream_ReadLong( header + 4 ) != ulSize ) || ( header[8] != DEMOSTREAM_KEYFRAME ))
+	{
+		bRead = false;
+	}
+	else
+	{
+		Data.Resize( ulSize );
+		bRead = ( _reader->Read( &Data[0], ulSize ) == static_cast<long>( ulSize ));
+	}
+
+	// Keep playing where we were if the keyframe can't be read.
+	if ( bRead )
+		_resumeOffset = _reader->Tell( );
+	else
+		_reader->Seek( _resumeOffset, SEEK_SET );
+
+	StartDecoder( );
+	return bRead;
+}
+
+//*****************************************************************************
+//
+bool FDemoStreamReader::Rewind ( )
+{
+	if ( _reader == NULL )
+		return false;
+
+	StopDecoder( );
+	const bool bSeeked = ( _reader->Seek( _firstBlockOffset, SEEK_SET ) == 0 );
+	if ( bSeeked )
+		_resumeOffset = _firstBlockOffset;
+	else
+		_reader->Seek( _resumeOffset, SEEK_SET );
+
+	StartDecoder( );
+	return bSeeked;
+}
+
+//*****************************************************************************
+//
+void FDemoStreamReader::Close ( )
+{
+	StopDecoder( );
+
+	delete _reader;
+	_reader = NULL;
+
+	for ( unsigned int i = 0; i < BLOCKS_AHEAD; ++i )
+		std::vector<BYTE>( ).swap( _blocks[i] );
+	_keyframes.Clear( );
+}
+
+//*****************************************************************************
+//
+unsigned int FDemoStreamReader::ReadBlock ( BYTE *pbBuffer )
+{
+	if ( _reader == NULL )
+		return 0;
+
+	std::unique_lock<std::mutex> lock ( _mutex );
+	while (( _numBlocks == 0 ) && ( _finished == false ))
+		_blockReady.wait( lock );
+
+	if ( _numBlocks == 0 )
+		return 0;
+
+	std::vector<BYTE> &block = _blocks[_firstBlock];
+	const unsigned int ulSize = static_cast<unsigned int>( block.size( ));
+	memcpy( pbBuffer, block.data( ), ulSize );
+	_resumeOffset = _blockEnds[_firstBlock];
+	_firstBlock = ( _firstBlock + 1 ) % BLOCKS_AHEAD;
+	_numBlocks--;
+
+	lock.unlock( );
+	_slotFree.notify_one( );
+	return ulSize;
+}
+
+//*****************************************************************************
+//
+// Runs on the decoder thread. Only touches the reader and, with the mutex
+// locked, the block queue.
+//
+void FDemoStreamReader::DecoderMain ( )
+{
+	std::vector<BYTE> compressed, block;
+
+	while ( true )
+	{
+		bool bEnd = false;
+		const char *pszError = DecodeBlock( compressed, block, bEnd );
+		const long lBlockEnd = _reader->Tell( );
+
+		std::unique_lock<std::mutex> lock ( _mutex );
+		if (( pszError != NULL ) || bEnd )
+		{
+			_error = pszError;
+			_finished = true;
+			lock.unlock( );
+			_blockReady.notify_all( );
+			return;
+		}
+
+		while (( _stop == false ) && ( _numBlocks == BLOCKS_AHEAD ))
+			_slotFree.wait( lock );
+
+		if ( _stop )
+			return;
+
+		const unsigned int ulSlot = ( _firstBlock + _numBlocks ) % BLOCKS_AHEAD;
+		_blocks[ulSlot].swap( block );
+		_blockEnds[ulSlot] = lBlockEnd;
+		_numBlocks++;
+		lock.unlock( );
+		_blockReady.notify_one( );
+	}
+}
+
+//*****************************************************************************
+//
+const char *FDemoStreamReader::DecodeBlock ( std::vector<BYTE> &compressed, std::vector<BYTE> &block, bool &bEnd )
+{
+	BYTE header[DEMOSTREAM_BLOCK_HEADER_SIZE];
+	if ( _reader->Read( header, sizeof( header )) != sizeof( header ))
+		return "The demo is truncated.";
+
+	DWORD ulSize = demostream_ReadLong( header );
+	DWORD ulStoredSize = demostream_ReadLong( header + 4 );
+	BYTE method = header[8];
+
+	// Keyframes are only read when seeking.
+	while (( ulSize != 0 ) && ( method == DEMOSTREAM_KEYFRAME ))
+	{
+		if (( ulStoredSize != ulSize ) || ( ulSize > DEMOSTREAM_MAX_KEYFRAME_SIZE ))
+			return "The demo is corrupt.";
+
+		if (( _reader->Seek( ulStoredSize, SEEK_CUR ) != 0 )
+			|| ( _reader->Read( header, sizeof( header )) != sizeof( header )))
+		{
+			return "The demo is truncated.";
+		}
+
+		ulSize = demostream_ReadLong( header );
+		ulStoredSize = demostream_ReadLong( header + 4 );
+		method = header[8];
+	}
+
+	if ( ulSize == 0 )
+	{
+		bEnd = true;
+		return NULL;
+	}
+
+	if (( ulSize > _blockSize )
+		|| (( method == DEMOSTREAM_STORED ) && ( ulStoredSize != ulSize ))
+		|| (( method == DEMOSTREAM_DEFLATE ) && ( ulStoredSize > compressBound( _blockSize )))
+		|| ( method > DEMOSTREAM_DEFLATE ))
+	{
+		return "The demo is corrupt.";
+	}
+
+	compressed.resize( ulStoredSize );
+	if ( _reader->Read( compressed.data( ), ulStoredSize ) != static_cast<long>( ulStoredSize ))
+		return "The demo is truncated.";
+
+	if ( method == DEMOSTREAM_STORED )
+	{
+		block.swap( compressed );
+		return NULL;
+	}
+
+	uLongf size = ulSize;
+	block.resize( ulSize );
+	if (( uncompress( block.data( ), &size, compressed.data( ), ulStoredSize ) != Z_OK ) || ( size != ulSize ))
+		return "The demo is corrupt.";
+
+	return NULL;
+}
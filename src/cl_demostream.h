@@ -0,0 +1,218 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: cl_demostream.h
+//
+// Description: Block-compressed container for client demos
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __CL_DEMOSTREAM_H__
+#define __CL_DEMOSTREAM_H__
+
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "tarray.h"
+
+class FileReader;
+
+//*****************************************************************************
+//	DEFINES
+
+// Demos are written in blocks of this many bytes, each compressed on its own.
+#define	DEMOSTREAM_BLOCK_SIZE		0x20000
+
+// A demo file starts with this, followed by the version, the block size, the
+// length of the uncompressed demo (0 if unknown) and where the keyframe index
+// is in the file (0 if there is none). Version 1 files have no index field.
+#define	DEMOSTREAM_SIGNATURE		MAKE_ID( 'Z', 'C', 'L', 'B' )
+#define	DEMOSTREAM_VERSION			2
+#define	DEMOSTREAM_HEADER_SIZE		20
+#define	DEMOSTREAM_HEADER_SIZE_V1	16
+
+// Every block starts with its uncompressed size, its stored size and how it
+// is stored. A block with an uncompressed size of 0 ends the demo.
+#define	DEMOSTREAM_BLOCK_HEADER_SIZE	9
+
+// Keyframes are larger than the demo blocks, so don't trust a file with more
+// than this.
+#define	DEMOSTREAM_MAX_KEYFRAME_SIZE	0x4000000
+
+enum
+{
+	DEMOSTREAM_STORED,
+	DEMOSTREAM_DEFLATE,
+
+	// A keyframe is kept between the blocks of the demo but isn't part of it.
+	// It is only read when seeking.
+	DEMOSTREAM_KEYFRAME,
+};
+
+//*****************************************************************************
+//	STRUCTURES
+
+// The index after the end of the demo has one of these for every keyframe.
+struct FDemoStreamKeyframe
+{
+	// How many tics of the demo were played before the keyframe.
+	DWORD	ulTic;
+
+	// Where the demo continues after the keyframe. The demo always starts a
+	// new block there.
+	DWORD	ulStreamOffset;
+
+	// Where the keyframe is in the file.
+	DWORD	ulFileOffset;
+};
+
+//*****************************************************************************
+//
+// Writes the demo to disk block by block while it is recorded.
+//
+class FDemoStreamWriter
+{
+public:
+	FDemoStreamWriter ( );
+	~FDemoStreamWriter ( );
+
+	bool	Open ( const char *pszFileName );
+	bool	WriteBlock ( const BYTE *pbData, unsigned int ulSize );
+
+	// The keyframe is stored as it is and added to the index, which Close
+	// writes to the end of the file.
+	bool	WriteKeyframe ( DWORD ulTic, DWORD ulStreamOffset, const BYTE *pbData, unsigned int ulSize );
+	bool	Close ( DWORD ulStreamLength );
+	bool	IsOpen ( ) const { return _file != NULL; }
+	DWORD	GetFileSize ( ) const { return _fileSize; }
+	unsigned int	GetNumKeyframes ( ) const { return _keyframes.Size( ); }
+
+private:
+	bool	Write ( const void *data, size_t size );
+
+	FILE			*_file;
+	TArray<BYTE>	_compressed;
+	TArray<FDemoStreamKeyframe>	_keyframes;
+	DWORD			_fileSize;
+	bool			_failed;
+};
+
+//*****************************************************************************
+//
+// Reads the blocks of a demo. A background thread reads and decompresses the
+// blocks ahead of the one that is currently played.
+//
+class FDemoStreamReader
+{
+public:
+	FDemoStreamReader ( );
+	~FDemoStreamReader ( );
+
+	static bool		IsStreamedDemo ( FileReader *pReader );
+
+	// Takes ownership of the reader, even if this fails.
+	bool			Open ( FileReader *pReader );
+	void			Close ( );
+	bool			IsOpen ( ) const { return _reader != NULL; }
+	unsigned int	GetBlockSize ( ) const { return _blockSize; }
+	DWORD			GetStreamLength ( ) const { return _streamLength; }
+
+	// Copies the next block to pbBuffer, which must hold GetBlockSize() bytes.
+	// Returns 0 at the end of the demo.
+	unsigned int	ReadBlock ( BYTE *pbBuffer );
+
+	// Why the demo ended early, NULL if it didn't.
+	const char		*GetError ( ) const { return _error; }
+
+	// The keyframes of the demo, ordered by their tic.
+	const TArray<FDemoStreamKeyframe>	&GetKeyframes ( ) const { return _keyframes; }
+
+	// Reads a keyframe into Data. The next block is then the first one after
+	// the keyframe.
+	bool			SeekToKeyframe ( const FDemoStreamKeyframe &Keyframe, TArray<BYTE> &Data );
+
+	// The next block is the first one of the demo again.
+	bool			Rewind ( );
+
+private:
+	// How many blocks the decoder may be ahead of the reader.
+	enum { BLOCKS_AHEAD = 4 };
+
+	bool			ReadIndex ( DWORD ulIndexOffset );
+	void			StartDecoder ( );
+	void			StopDecoder ( );
+	void			DecoderMain ( );
+	const char		*DecodeBlock ( std::vector<BYTE> &compressed, std::vector<BYTE> &block, bool &end );
+
+	FileReader				*_reader;
+	unsigned int			_blockSize;
+	DWORD					_streamLength;
+	DWORD					_firstBlockOffset;
+
+	// Where the block after the last one that was read starts in the file.
+	long					_resumeOffset;
+	TArray<FDemoStreamKeyframe>	_keyframes;
+
+	std::thread				_thread;
+	std::mutex				_mutex;
+	std::condition_variable	_blockReady;
+	std::condition_variable	_slotFree;
+
+	// Decoded blocks waiting to be read, and where each of them ends in the
+	// file.
+	std::vector<BYTE>		_blocks[BLOCKS_AHEAD];
+	long					_blockEnds[BLOCKS_AHEAD];
+	unsigned int			_firstBlock;
+	unsigned int			_numBlocks;
+
+	// Set by the decoder once it has reached the end of the demo.
+	bool					_finished;
+	const char				*_error;
+	bool					_stop;
+};
+
+#endif	// __CL_DEMOSTREAM_H__
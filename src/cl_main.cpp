@@ -119,6 +119,7 @@
 #include "network/servercommands.h"
 #include "am_map.h"
 #include "maprotation.h"
+#include "network/playersnapshot.h"
 
 //*****************************************************************************
 //	MISC CRAP THAT SHOULDN'T BE HERE BUT HAS TO BE BECAUSE OF SLOPPY CODING
@@ -740,6 +741,7 @@ void CLIENT_AttemptConnection( void )
 
 	g_lMissingPacketTicks = 0;
 	g_lLatestServerGametic = 0; // [CK] Reset this here since we plan on connecting to a new server
+	PLAYERSNAPSHOT_ClearReceived( );
 
 	 // Send connection signal to the server.
 	NETWORK_WriteByte( &g_LocalBuffer.ByteStream, CLCC_ATTEMPTCONNECTION );
@@ -1459,6 +1461,14 @@ void CLIENT_ProcessCommand( LONG lCommand, BYTESTREAM_s *pByteStream )
 					CLIENTCOMMANDS_ReportLumps( );
 				}
 				break;
+
+			case SVC2_PLAYERSNAPSHOT:
+				PLAYERSNAPSHOT_ParseChunk( pByteStream );
+				break;
+
+			case SVC2_ACTORSNAPSHOT:
+				PLAYERSNAPSHOT_ParseActorChunk( pByteStream );
+				break;
 				
 			case SVC2_ADDTOMAPROTATION:
 				{
@@ -5614,6 +5624,9 @@ void ServerCommands::SetSectorFloorPlaneSlope::Execute()
 	sector->floorplane.b = b;
 	sector->floorplane.c = c;
 	sector->floorplane.ic = DivScale32( 1, sector->floorplane.c );
+
+	// Sight traces memoized against the old slope don't hold anymore.
+	P_InvalidateSightCache( );
 }
 
 //*****************************************************************************
@@ -5624,6 +5637,9 @@ void ServerCommands::SetSectorCeilingPlaneSlope::Execute()
 	sector->ceilingplane.b = b;
 	sector->ceilingplane.c = c;
 	sector->ceilingplane.ic = DivScale32( 1, sector->ceilingplane.c );
+
+	// Sight traces memoized against the old slope don't hold anymore.
+	P_InvalidateSightCache( );
 }
 
 //*****************************************************************************
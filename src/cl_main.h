@@ -86,14 +86,6 @@ enum CONNECTIONSTATE_e
 
 };
 
-//[BB] Client connect flags.
-enum
-{
-	CCF_STARTASSPECTATOR			= 1 << 0,
-	CCF_DONTRESTOREFRAGS			= 1 << 1,
-	CCF_HIDECOUNTRY					= 1 << 2,
-};
-
 //*****************************************************************************
 //	STRUCTURES
 
@@ -475,6 +475,7 @@ static void client_predict_DoPrediction( player_t *pPlayer, ULONG ulTicks )
 		g_bPredicting = true;
 
 		// Predict the sectors
+		P_InvalidateSightCache( );
 		for (int i = 0; i < numsectors; ++i)
 		{
 			sectors[i].floorplane.d = sectors[i].floorplane.predictD[lTick % CLIENT_PREDICTION_TICS];
@@ -593,6 +594,7 @@ static void client_predict_DoPrediction( player_t *pPlayer, ULONG ulTicks )
 //
 static void client_predict_EndPrediction( player_t *pPlayer )
 {
+	P_InvalidateSightCache( );
 	for (int i = 0; i < numsectors; ++i)
 	{
 		sectors[i].floorplane.d = sectors[i].floorplane.predictD[g_ulGameTick % CLIENT_PREDICTION_TICS];
@@ -852,10 +852,6 @@ public:
 	int			pnumToSpyNext;
 
 	// [Spleen] Store old information about the player for unlagged support
-	fixed_t		unlaggedX[UNLAGGEDTICS];
-	fixed_t		unlaggedY[UNLAGGEDTICS];
-	fixed_t		unlaggedZ[UNLAGGEDTICS];
-
 	fixed_t		restoreX;
 	fixed_t		restoreY;
 	fixed_t		restoreZ;
@@ -236,7 +236,8 @@ namespace GC
 		GCS_Finalize
 	};
 
-	// Number of bytes currently allocated through M_Malloc/M_Realloc.
+	// Number of bytes currently allocated through M_Malloc/M_Realloc and
+	// the object slabs.
 	extern size_t AllocBytes;
 
 	// Amount of memory to allocate before triggering a collection.
@@ -281,6 +282,15 @@ namespace GC
 	// Handles the grunt work for a write barrier.
 	void Barrier(DObject *pointing, DObject *pointed);
 
+	// Allocates memory for an object from the slab of its size class.
+	void *AllocObject(size_t size);
+
+	// Queues an object's memory to be returned to its slab by ReleaseFrees.
+	void FreeObject(void *mem);
+
+	// Returns all queued object memory to the slabs. Run after each sweep.
+	void ReleaseFrees();
+
 	// Handles a write barrier.
 	static inline void WriteBarrier(DObject *pointing, DObject *pointed);
 
@@ -492,12 +502,12 @@ public:
 
 	void *operator new(size_t len)
 	{
-		return M_Malloc(len);
+		return GC::AllocObject(len);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	// GC fiddling
@@ -564,7 +574,7 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		GC::FreeObject (mem);
 	}
 };
 
@@ -253,6 +253,8 @@ static DObject **SweepList(DObject **p, size_t count, size_t *finalize_count)
 			finalized++;
 		}
 	}
+	// Put the deleted objects' slots back into their slabs in one go.
+	ReleaseFrees();
 	if (finalize_count != NULL)
 	{
 		*finalize_count = finalized;
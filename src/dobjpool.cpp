@@ -0,0 +1,395 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: dobjpool.cpp
+//
+// Description: Size-class slab pools backing DObject allocations
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include "doomtype.h"
+#include "dobject.h"
+#include "i_system.h"
+#include "stats.h"
+#include "c_dispatch.h"
+
+// Every slab is a SLAB_SIZE block aligned to its own size, so the slab that
+// owns an object is found by masking the object's address.
+enum
+{
+	SLAB_SIZE = 64 * 1024,
+	SLAB_LINE = 64,							// slots are aligned to cache lines
+	SLAB_MAX_POOLED = 4096,					// bigger objects get a slab to themselves
+	SLAB_NUM_CLASSES = SLAB_MAX_POOLED / SLAB_LINE,
+	SLAB_LARGE = SLAB_NUM_CLASSES,			// size class of a single object slab
+};
+
+struct FObjectSlab
+{
+	FObjectSlab *Prev, *Next;		// partial list of the size class
+	void *FreeSlots;				// singly linked through the slots themselves
+	size_t SlotSize;
+	unsigned int SizeClass;
+	unsigned int NumSlots;
+	unsigned int NumUsed;
+	unsigned int NumUnused;			// slots past the end of the bump area
+	BYTE *Bump;
+};
+
+// The header occupies the first line of the slab.
+static const size_t SLAB_HEADER = (sizeof(FObjectSlab) + SLAB_LINE - 1) & ~size_t(SLAB_LINE - 1);
+
+struct FSlabClass
+{
+	FObjectSlab *Partial;			// slabs with at least one free slot
+	FObjectSlab *Spare;				// one empty slab kept to absorb churn
+	unsigned int NumSlabs;
+	unsigned int NumUsed;
+};
+
+static FSlabClass SlabClasses[SLAB_NUM_CLASSES + 1];
+
+// Objects that were deleted since the last sweep. Their slots are not
+// handed out again until GC::ReleaseFrees puts them back into their slabs.
+static void *PendingFrees;
+
+static unsigned int NumSlabs;
+static size_t SlabBytes;
+static unsigned int TotalSlots;
+static unsigned int UsedSlots;
+static unsigned int NumPending;
+static QWORD NumAllocs;
+
+//*****************************************************************************
+//
+static void *slab_AllocAligned (size_t size)
+{
+	void *mem;
+
+#if defined(_WIN32)
+	mem = _aligned_malloc (size, SLAB_SIZE);
+#else
+	if (posix_memalign (&mem, SLAB_SIZE, size) != 0)
+		mem = NULL;
+#endif
+	if (mem == NULL)
+		I_FatalError ("Could not allocate a %zu byte object slab", size);
+	return mem;
+}
+
+//*****************************************************************************
+//
+static void slab_FreeAligned (void *mem)
+{
+#if defined(_WIN32)
+	_aligned_free (mem);
+#else
+	free (mem);
+#endif
+}
+
+//*****************************************************************************
+//
+static inline FObjectSlab *slab_GetSlab (void *mem)
+{
+	return (FObjectSlab *)(size_t(mem) & ~size_t(SLAB_SIZE - 1));
+}
+
+//*****************************************************************************
+//
+static void slab_Link (FSlabClass &sc, FObjectSlab *slab)
+{
+	slab->Prev = NULL;
+	slab->Next = sc.Partial;
+	if (sc.Partial != NULL)
+		sc.Partial->Prev = slab;
+	sc.Partial = slab;
+}
+
+//*****************************************************************************
+//
+static void slab_Unlink (FSlabClass &sc, FObjectSlab *slab)
+{
+	if (slab->Prev != NULL)
+		slab->Prev->Next = slab->Next;
+	else
+		sc.Partial = slab->Next;
+	if (slab->Next != NULL)
+		slab->Next->Prev = slab->Prev;
+	slab->Prev = slab->Next = NULL;
+}
+
+//*****************************************************************************
+//
+static FObjectSlab *slab_Create (unsigned int sizeclass, size_t slotsize)
+{
+	size_t bytes = sizeclass == SLAB_LARGE ? SLAB_HEADER + slotsize : size_t(SLAB_SIZE);
+	FObjectSlab *slab = (FObjectSlab *)slab_AllocAligned (bytes);
+
+	slab->Prev = slab->Next = NULL;
+	slab->FreeSlots = NULL;
+	slab->SlotSize = slotsize;
+	slab->SizeClass = sizeclass;
+	slab->NumSlots = unsigned((bytes - SLAB_HEADER) / slotsize);
+	slab->NumUsed = 0;
+	slab->NumUnused = slab->NumSlots;
+	slab->Bump = (BYTE *)slab + SLAB_HEADER;
+
+	SlabClasses[sizeclass].NumSlabs++;
+	NumSlabs++;
+	SlabBytes += bytes;
+	TotalSlots += slab->NumSlots;
+	return slab;
+}
+
+//*****************************************************************************
+//
+static void slab_Destroy (FObjectSlab *slab)
+{
+	SlabClasses[slab->SizeClass].NumSlabs--;
+	NumSlabs--;
+	SlabBytes -= slab->SizeClass == SLAB_LARGE ? SLAB_HEADER + slab->SlotSize : size_t(SLAB_SIZE);
+	TotalSlots -= slab->NumSlots;
+	slab_FreeAligned (slab);
+}
+
+//*****************************************************************************
+//
+static void *slab_TakeSlot (FObjectSlab *slab)
+{
+	void *mem;
+
+	if (slab->FreeSlots != NULL)
+	{
+		mem = slab->FreeSlots;
+		slab->FreeSlots = *(void **)mem;
+	}
+	else
+	{
+		assert (slab->NumUnused > 0);
+		mem = slab->Bump;
+		slab->Bump += slab->SlotSize;
+		slab->NumUnused--;
+	}
+	slab->NumUsed++;
+	return mem;
+}
+
+//*****************************************************************************
+//
+// Returns a slot to its slab. Emptied slabs are released, except for one
+// spare per size class so that spawn/destroy churn doesn't thrash the heap.
+//
+static void slab_ReturnSlot (void *mem)
+{
+	FObjectSlab *slab = slab_GetSlab (mem);
+	FSlabClass &sc = SlabClasses[slab->SizeClass];
+
+	sc.NumUsed--;
+	UsedSlots--;
+
+	if (slab->SizeClass == SLAB_LARGE)
+	{
+		slab_Destroy (slab);
+		return;
+	}
+
+	const bool wasfull = (slab->NumUsed == slab->NumSlots);
+
+	*(void **)mem = slab->FreeSlots;
+	slab->FreeSlots = mem;
+	slab->NumUsed--;
+
+	if (slab->NumUsed == 0)
+	{
+		if (!wasfull)
+			slab_Unlink (sc, slab);
+
+		// Start the empty slab over so the next user gets its slots in
+		// address order.
+		slab->FreeSlots = NULL;
+		slab->NumUnused = slab->NumSlots;
+		slab->Bump = (BYTE *)slab + SLAB_HEADER;
+
+		if (sc.Spare == NULL)
+			sc.Spare = slab;
+		else
+			slab_Destroy (slab);
+	}
+	else if (wasfull)
+	{
+		slab_Link (sc, slab);
+	}
+}
+
+//*****************************************************************************
+//
+void *GC::AllocObject (size_t size)
+{
+	size_t slotsize = (size + SLAB_LINE - 1) & ~size_t(SLAB_LINE - 1);
+	unsigned int sizeclass;
+	void *mem;
+
+	if (slotsize == 0)
+		slotsize = SLAB_LINE;
+
+	NumAllocs++;
+	UsedSlots++;
+	AllocBytes += slotsize;
+
+	if (slotsize > SLAB_MAX_POOLED)
+	{
+		FObjectSlab *slab = slab_Create (SLAB_LARGE, slotsize);
+		SlabClasses[SLAB_LARGE].NumUsed++;
+		return slab_TakeSlot (slab);
+	}
+
+	sizeclass = unsigned(slotsize / SLAB_LINE) - 1;
+	FSlabClass &sc = SlabClasses[sizeclass];
+	FObjectSlab *slab = sc.Partial;
+
+	if (slab == NULL)
+	{
+		if (sc.Spare != NULL)
+		{
+			slab = sc.Spare;
+			sc.Spare = NULL;
+		}
+		else
+		{
+			slab = slab_Create (sizeclass, slotsize);
+		}
+		slab_Link (sc, slab);
+	}
+
+	mem = slab_TakeSlot (slab);
+	sc.NumUsed++;
+
+	if (slab->NumUsed == slab->NumSlots)
+		slab_Unlink (sc, slab);
+
+	return mem;
+}
+
+//*****************************************************************************
+//
+void GC::FreeObject (void *mem)
+{
+	if (mem == NULL)
+		return;
+
+	AllocBytes -= slab_GetSlab (mem)->SlotSize;
+	*(void **)mem = PendingFrees;
+	PendingFrees = mem;
+	NumPending++;
+}
+
+//*****************************************************************************
+//
+// Called at the end of every sweep step.
+//
+void GC::ReleaseFrees ()
+{
+	while (PendingFrees != NULL)
+	{
+		void *mem = PendingFrees;
+
+		PendingFrees = *(void **)mem;
+		slab_ReturnSlot (mem);
+	}
+	NumPending = 0;
+}
+
+//*****************************************************************************
+//
+ADD_STAT (slabs)
+{
+	static QWORD lastallocs;
+	static unsigned int lasttime;
+	static unsigned int rate;
+	unsigned int now = I_MSTime ();
+	FString out;
+
+	if (now - lasttime >= 1000)
+	{
+		rate = unsigned((NumAllocs - lastallocs) * 1000 / (now - lasttime));
+		lastallocs = NumAllocs;
+		lasttime = now;
+	}
+
+	out.Format ("%u slabs (%zuK), %u/%u slots used (%.0f%%), %u pending, %u allocs/s",
+		NumSlabs, (SlabBytes + 1023) >> 10, UsedSlots, TotalSlots,
+		TotalSlots > 0 ? 100. * UsedSlots / TotalSlots : 0., NumPending, rate);
+	return out;
+}
+
+//*****************************************************************************
+//
+CCMD (dumpslabs)
+{
+	for (unsigned int i = 0; i <= SLAB_NUM_CLASSES; ++i)
+	{
+		const FSlabClass &sc = SlabClasses[i];
+
+		if (sc.NumSlabs == 0)
+			continue;
+
+		if (i == SLAB_LARGE)
+		{
+			Printf ("  large: %u objects\n", sc.NumUsed);
+		}
+		else
+		{
+			unsigned int slotsize = (i + 1) * SLAB_LINE;
+			unsigned int slots = sc.NumSlabs * unsigned((SLAB_SIZE - SLAB_HEADER) / slotsize);
+
+			Printf ("%7u: %4u slabs, %6u/%6u slots used%s\n", slotsize, sc.NumSlabs, sc.NumUsed, slots,
+				sc.Spare != NULL ? " (1 spare)" : "");
+		}
+	}
+	Printf ("%u slabs, %zuK total\n", NumSlabs, (SlabBytes + 1023) >> 10);
+}
@@ -255,7 +255,7 @@ const PClass *PClass::FindClass (FName zaname)
 // Create a new object that this class represents
 DObject *PClass::CreateNew () const
 {
-	BYTE *mem = (BYTE *)M_Malloc (Size);
+	BYTE *mem = (BYTE *)GC::AllocObject (Size);
 	assert (mem != NULL);
 
 	// Set this object's defaults before constructing it.
@@ -31,6 +31,7 @@
 #include "farchive.h"
 #include "cl_demo.h"
 #include "cl_main.h"
+#include "unlagged.h"
 
 IMPLEMENT_CLASS (DSectorEffect)
 
@@ -93,6 +94,9 @@ DMover::DMover (sector_t *sector)
 	: DSectorEffect (sector)
 {
 	interpolation = NULL;
+
+	// The sector may have to be reconciled from now on.
+	UNLAGGED_AddMoverSector( sector );
 }
 
 void DMover::Predict()
@@ -463,6 +467,9 @@ void P_SetCeilingPlane(sector_t *sector, fixed_t dest)
 	// Change the height.
 	sector->ceilingplane.ChangeHeight(delta);
 
+	// The ceiling moved, so memoized sight traces are stale.
+	P_InvalidateSightCache();
+
 	// Finally, adjust textures.
 	sector->SetPlaneTexZ(sector_t::ceiling, sector->GetPlaneTexZ(sector_t::ceiling) + sector->ceilingplane.HeightDiff(lastPos));
 
@@ -126,6 +126,10 @@ public:
 	bool IsOpen () const;
 	void GetSizes(unsigned int &one, unsigned int &two) const;
 
+	// After Close (), this is what Open (void *) takes to read the file again.
+	// It is 8 bytes larger than the stored size GetSizes () returns.
+	const void *GetImplodedBuffer () const { return m_ImplodedBuffer; }
+
 	void Serialize (FArchive &arc);
 
 protected:
@@ -2149,7 +2149,8 @@ void G_SerializeLevel (FArchive &arc, bool hubLoad)
 	int i = level.totaltime;
 	
 	// [BC] In client mode, we just want to save the lines we've seen.
-	if ( NETWORK_InClientMode() )
+	// Demo keyframes need the whole level though.
+	if ( NETWORK_InClientMode() && ( CLIENTDEMO_IsArchivingKeyframe( ) == false ))
 	{
 		P_SerializeWorld( arc );
 		return;
@@ -281,6 +281,7 @@ public:
 
 	bool		isCurrentlyBeingUnlagged;
 	bool		isMissile;
+	bool		wasRelinked; // The last reconciliation moved the actor or changed its flags
 
 	AUnlaggedActor* previousUnlaggedActor;
 	AUnlaggedActor* nextUnlaggedActor;
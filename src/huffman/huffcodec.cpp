@@ -70,7 +70,10 @@ namespace skulltag {
 		root->code = 0;
 		root->value = -1;
 		// recursive Huffman tree builder.
-		buildTree( root, treeData, 0, dataLength, codeTable, 256 );
+		// [TL] Only trust the tree for table decoding if it was read completely.
+		if ( buildTree( root, treeData, 0, dataLength, codeTable, 256 ) >= 0 )
+			buildDecodeTable();
+		buildEncodeTable();
 		huffResourceOwner = true;
 	}
 	
@@ -88,6 +91,8 @@ namespace skulltag {
 		root = treeRootNode;
 		codeTable = leafCodeTable;
 		huffResourceOwner = false;
+		buildDecodeTable();
+		buildEncodeTable();
 	}
 	
 	/** Checks the ownership state of this HuffmanCodec's resources.
@@ -103,6 +108,57 @@ namespace skulltag {
 		reverseBits = false;
 		expandable = true;
 		huffResourceOwner = false;
+		decodeTable = 0;
+		encodeTable = 0;
+	}
+
+	/** Builds the decode lookup table from the Huffman tree.
+	 * Leaves decodeTable NULL (0) if the tree contains a broken branch. */
+	void HuffmanCodec::buildDecodeTable(){
+		if ( (root == 0) || (root->branch == 0) ) return;
+		int const tableSize = 1 << DECODE_TABLE_BITS;
+		HuffmanDecodeEntry * table = new HuffmanDecodeEntry[ tableSize ];
+
+		for ( int window = 0; window < tableSize; window++ ){
+			HuffmanDecodeEntry &entry = table[window];
+			HuffmanNode const * node = root;
+			entry.valueCount = 0;
+			entry.bitCount = 0;
+			for ( int i = 0; i < DECODE_TABLE_VALUES; i++ ) entry.values[i] = 0;
+
+			// Walk the tree with the bits of the window, most significant bit first.
+			for ( int bit = 0; bit < DECODE_TABLE_BITS; bit++ ){
+				node = &(node->branch[ (window >> (DECODE_TABLE_BITS - 1 - bit)) & 0x01 ]);
+				if ( node->branch != 0 ) continue;
+				// A complete code. Stop once the entry is full, the remaining bits are decoded by the next lookup.
+				if ( entry.valueCount >= DECODE_TABLE_VALUES ) break;
+				entry.values[ entry.valueCount++ ] = (unsigned char)(node->value & 0xff);
+				entry.bitCount = (unsigned char)(bit + 1);
+				node = root;
+			}
+
+			// The window is the prefix of a code longer than the window, remember where it leads.
+			if ( entry.valueCount == 0 ){
+				entry.node = node;
+				entry.bitCount = DECODE_TABLE_BITS;
+			} else entry.node = 0;
+		}
+		decodeTable = table;
+	}
+
+	/** Builds the encode lookup table from the code table.
+	 * Leaves encodeTable NULL (0) if a value has no code or a code doesn't fit in 32 bits. */
+	void HuffmanCodec::buildEncodeTable(){
+		if ( codeTable == 0 ) return;
+		for ( int i = 0; i < 256; i++ ){
+			if ( (codeTable[i] == 0) || (codeTable[i]->bitCount < 1) || (codeTable[i]->bitCount > 32) ) return;
+		}
+
+		encodeTable = new HuffmanEncodeEntry[256];
+		for ( int i = 0; i < 256; i++ ){
+			encodeTable[i].code = (unsigned int)codeTable[i]->code;
+			encodeTable[i].bitCount = codeTable[i]->bitCount;
+		}
 	}
 	
 	/** Increases a codeLength up to the longest Huffman code bit length found in the node or any of its children. <br>
@@ -213,6 +269,67 @@ namespace skulltag {
 		unsigned char * const output,		/**< out: pointer to an output buffer to store data. */
 		int const &inLength,				/**< in: number of bytes of input buffer to encoded. */
 		int const &outLength				/**< in: maximum length of data to output. */
+	) const {
+		// if not expandable Limit output to input length.
+		int const maxBytes = ( expandable || ((inLength + 1) >= outLength) ) ? outLength : inLength + 1;
+		if ( (encodeTable == 0) || (maxBytes < 1) || (output == 0) ) return encodeBitwise( input, output, inLength, outLength );
+
+		long long const maxBits = (long long)(maxBytes - 1) << 3;	// bits available after the padding signal byte.
+		long long totalBits = 0;	// number of Huffman code bits produced so far.
+		unsigned long long bits = 0;	// pending bits, stored in the least significant accBits bits.
+		int accBits = 0;				// number of pending bits.
+		unsigned char * out = output + 1;	// output[0] is reserved for the padding signal.
+
+		for ( int i = 0; i < inLength; i++ ){
+			HuffmanEncodeEntry const &entry = encodeTable[ input[i] ];
+			totalBits += entry.bitCount;
+			// bail if the code doesn't fit anymore.
+			if ( totalBits > maxBits ) return -1;
+			bits = (bits << entry.bitCount) | entry.code;
+			accBits += entry.bitCount;
+
+			// Flush a whole 32-bit word once there's one.
+			if ( accBits >= 32 ){
+				unsigned int const word = (unsigned int)(bits >> (accBits - 32));
+				accBits -= 32;
+				out[0] = (unsigned char)(word >> 24);
+				out[1] = (unsigned char)(word >> 16);
+				out[2] = (unsigned char)(word >> 8);
+				out[3] = (unsigned char)word;
+				if ( reverseBits ){
+					out[0] = reverseMap[ out[0] ];
+					out[1] = reverseMap[ out[1] ];
+					out[2] = reverseMap[ out[2] ];
+					out[3] = reverseMap[ out[3] ];
+				}
+				out += 4;
+			}
+		}
+
+		// Write the remaining bits, padding the last byte with zeros on its less significant side.
+		int const padding = (8 - (accBits & 7)) & 7;
+		bits <<= padding;
+		accBits += padding;
+		while ( accBits > 0 ){
+			accBits -= 8;
+			*out = (unsigned char)(bits >> accBits);
+			if ( reverseBits ) *out = reverseMap[ *out ];
+			out++;
+		}
+
+		// write padding signal byte to begining of stream.
+		output[0] = (unsigned char)padding;
+		return (int)(out - output);
+	} // end function encode
+
+	/** Encodes data by passing each Huffman code through the BitWriter. <br>
+	 * This is the reference implementation of encode(), which must produce exactly the same output.
+	 * @return number of bytes stored in the output buffer or -1 if an error occurs while encoding. */
+	int HuffmanCodec::encodeBitwise(
+		unsigned char const * const input,	/**< in: pointer to the first byte to encode. */
+		unsigned char * const output,		/**< out: pointer to an output buffer to store data. */
+		int const &inLength,				/**< in: number of bytes of input buffer to encoded. */
+		int const &outLength				/**< in: maximum length of data to output. */
 	) const {
 		// setup the bit buffer to output. if not expandable Limit output to input length.
 		if ( expandable ) writer->outputBuffer( output, outLength );
@@ -238,7 +355,7 @@ namespace skulltag {
 		}
 
 		return bytesWritten;
-	} // end function encode
+	} // end function encodeBitwise
 
 	/** Decodes data read from an input buffer and stores the result in the output buffer.
 	 * @return number of bytes stored in the output buffer or -1 if an error occurs while decoding. */
@@ -248,6 +365,66 @@ namespace skulltag {
 		int const &inLength,				/**< in: number of bytes of input buffer to read. */
 		int const &outLength				/**< in: maximum length of data to output. */
 	){
+		if ( decodeTable == 0 ) return decodeBitwise( input, output, inLength, outLength );
+		if ( inLength < 1 ) return 0;
+		int bitsAvailable = ((inLength-1) << 3) - (0xff & input[0]);
+		int rIndex = 1;		// read index of input buffer.
+		int wIndex = 0;		// write index of output buffer.
+		unsigned long long bits = 0;	// buffered bits, the next bit to decode is the most significant one.
+		int bitsBuffered = 0;			// number of bits in the buffer.
+
+		HuffmanNode const * node = root;
+
+		while ( bitsAvailable > 0 ){
+
+			// Top up the bit buffer a byte at a time while there's room for one.
+			while ( (bitsBuffered <= 56) && (rIndex < inLength) ){
+				unsigned char byte = input[rIndex++];
+				if ( reverseBits ) byte = reverseMap[ byte ];
+				bits |= (unsigned long long)byte << (56 - bitsBuffered);
+				bitsBuffered += 8;
+			}
+
+			// Look up a whole window at once if we're at the root and neither buffer can run out during it.
+			if ( (node == root) && (bitsAvailable >= DECODE_TABLE_BITS) && (outLength - wIndex >= DECODE_TABLE_VALUES) ){
+				HuffmanDecodeEntry const &entry = decodeTable[ bits >> (64 - DECODE_TABLE_BITS) ];
+				for ( int i = 0; i < DECODE_TABLE_VALUES; i++ ) output[ wIndex + i ] = entry.values[i];
+				wIndex += entry.valueCount;
+				if ( entry.node != 0 ) node = entry.node;
+				bits <<= entry.bitCount;
+				bitsBuffered -= entry.bitCount;
+				bitsAvailable -= entry.bitCount;
+				continue;
+			}
+
+			// Otherwise traverse the tree according to the most significant bit.
+			node = &(node->branch[ bits >> 63 ]);
+			bits <<= 1;
+			bitsBuffered--;
+			bitsAvailable--;
+
+			// Is the node a leaf?
+			if ( node->branch == 0 ){
+				// buffer overflow prevention
+				if ( wIndex >= outLength ) return wIndex;
+				// Output leaf node's value and restart traversal at root node.
+				output[ wIndex++ ] = (unsigned char)(node->value & 0xff);
+				node = root;
+			}
+		}
+
+		return wIndex;
+	} // end function decode
+
+	/** Decodes data by walking the Huffman tree one bit at a time. <br>
+	 * This is the reference implementation of decode(), which must produce exactly the same output.
+	 * @return number of bytes stored in the output buffer or -1 if an error occurs while decoding. */
+	int HuffmanCodec::decodeBitwise(
+		unsigned char const * const input,	/**< in: pointer to data that needs decoding. */
+		unsigned char * const output,		/**< out: pointer to output buffer to store decoded data. */
+		int const &inLength,				/**< in: number of bytes of input buffer to read. */
+		int const &outLength				/**< in: maximum length of data to output. */
+	) const {
 		if ( inLength < 1 ) return 0;
 		int bitsAvailable = ((inLength-1) << 3) - (0xff & input[0]);
 		int rIndex = 1;		// read index of input buffer.
@@ -285,7 +462,7 @@ namespace skulltag {
 		}
 
 		return wIndex;
-	} // end function decode
+	} // end function decodeBitwise
 
 	/** Deletes all sub nodes of a HuffmanNode by traversing and deleting its child nodes.
 	 * @param treeNode pointer to a HuffmanNode whos children will be deleted. */
@@ -301,6 +478,8 @@ namespace skulltag {
 	/** Destructor - frees resources. */
 	HuffmanCodec::~HuffmanCodec() {
 		delete writer;
+		delete[] decodeTable;
+		delete[] encodeTable;
 		//check for resource ownership before deletion
 		if ( huffmanResourceOwner() ){
 			delete[] codeTable;
@@ -34,6 +34,21 @@
 /** Prevents naming convention problems via encapsulation. */
 namespace skulltag {
 
+	/** Entry of the lookup table used by HuffmanCodec::decode(). <br>
+	 * Each entry describes what a window of HuffmanCodec::DECODE_TABLE_BITS bits, read from the root of the tree, decodes to. */
+	struct HuffmanDecodeEntry {
+		HuffmanNode const * node;	/**< branch reached after all bits of the window if no code fits in it, NULL (0) otherwise. */
+		unsigned char valueCount;	/**< number of complete Huffman codes found in the window. */
+		unsigned char bitCount;		/**< number of bits of the window used by the complete codes. */
+		unsigned char values[4];	/**< the values of the complete codes, in stream order. */
+	};
+
+	/** Entry of the lookup table used by HuffmanCodec::encode(). */
+	struct HuffmanEncodeEntry {
+		unsigned int code;			/**< bit representation of the Huffman code, stored in the least significant bits. */
+		int bitCount;				/**< number of bits in the Huffman code. */
+	};
+
 	/** HuffmanCodec class - Encodes and Decodes data using a Huffman tree. */
 	class HuffmanCodec : public Codec {
 
@@ -67,8 +82,22 @@ namespace skulltag {
 		/** Number of bits the shortest huffman code in the tree has. */
 		int shortestCode;	
 
+		/** Lookup table of 2^DECODE_TABLE_BITS entries used for decoding several bits per step or NULL (0) if the tree is unusable.
+		 * The table is derived from the tree and always owned by this HuffmanCodec. */
+		HuffmanDecodeEntry * decodeTable;
+
+		/** Table of 256 Huffman codes indexed by value used for encoding or NULL (0) if the code table is incomplete.
+		 * The table is derived from the code table and always owned by this HuffmanCodec. */
+		HuffmanEncodeEntry * encodeTable;
+
 	public:	
 
+		/** Number of bits the decoder looks up at once. 2^11 entries keep the table within 32 KB. */
+		static int const DECODE_TABLE_BITS = 11;
+
+		/** Maximum number of values a single decode table entry can hold. */
+		static int const DECODE_TABLE_VALUES = 4;
+
 		/** Creates a new HuffmanCodec from the Huffman tree data.
 		 * @param treeData 		pointer to a buffer containing the Huffman tree structure definition.
 		 * @param dataLength 	length in bytes of the Huffman tree structure data. */
@@ -95,6 +124,16 @@ namespace skulltag {
 			int const &outLength				/**< in: maximum length of data to output. */
 		) const;
 
+		/** Encodes data by passing each Huffman code through the BitWriter. <br>
+		 * This is the reference implementation of encode(), which must produce exactly the same output.
+		 * @return number of bytes stored in the output buffer or -1 if an error occurs while encoding. */
+		int encodeBitwise(
+			unsigned char const * const input,	/**< in: pointer to the first byte to encode. */
+			unsigned char * const output,		/**< out: pointer to an output buffer to store data. */
+			int const &inLength,				/**< in: number of bytes of input buffer to encoded. */
+			int const &outLength				/**< in: maximum length of data to output. */
+		) const;
+
 		/** Decodes data read from an input buffer and stores the result in the output buffer.
 		 * @return number of bytes stored in the output buffer or -1 if an error occurs while decoding. */
 		virtual int decode(
@@ -104,6 +143,16 @@ namespace skulltag {
 			int const &outLength				/**< in: maximum length of data to output. */
 		);
 
+		/** Decodes data by walking the Huffman tree one bit at a time. <br>
+		 * This is the reference implementation of decode(), which must produce exactly the same output.
+		 * @return number of bytes stored in the output buffer or -1 if an error occurs while decoding. */
+		int decodeBitwise(
+			unsigned char const * const input,	/**< in: pointer to data that needs decoding. */
+			unsigned char * const output,		/**< out: pointer to output buffer to store decoded data. */
+			int const &inLength,				/**< in: number of bytes of input buffer to read. */
+			int const &outLength				/**< in: maximum length of data to output. */
+		) const;
+
 		/** Enables or Disables backwards bit ordering of bytes.
 		 * @param backwards  "true" enables reversed bit order bytes, "false" uses standard byte bit ordering. */
 		void reversedBytes( bool backwards );
@@ -176,6 +225,14 @@ namespace skulltag {
 		/** Perform initialization procedures common to all constructors. */
 		void init();
 
+		/** Builds the decode lookup table from the Huffman tree.
+		 * Leaves decodeTable NULL (0) if the tree contains a broken branch. */
+		void buildDecodeTable();
+
+		/** Builds the encode lookup table from the code table.
+		 * Leaves encodeTable NULL (0) if a value has no code or a code doesn't fit in 32 bits. */
+		void buildEncodeTable();
+
 	}; // end class Huffman Codec.
 } // end namespace skulltag
 
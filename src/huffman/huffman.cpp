@@ -95,6 +95,11 @@ void HUFFMAN_Destruct(){
 	__codec = NULL;
 }
 
+/** @return the HuffmanCodec used by HUFFMAN_Encode() and HUFFMAN_Decode() or NULL if HUFFMAN_Construct() hasn't been called. */
+HuffmanCodec * HUFFMAN_GetCodec(){
+	return __codec;
+}
+
 /** Applies Huffman encoding to a block of data. */
 void HUFFMAN_Encode(
 	/** in: Pointer to start of data that is to be encoded. */
@@ -36,6 +36,9 @@ void HUFFMAN_Construct();
 /** Releases resources allocated by the HuffmanCodec. */
 void HUFFMAN_Destruct();
 
+/** @return the HuffmanCodec used by HUFFMAN_Encode() and HUFFMAN_Decode() or NULL if HUFFMAN_Construct() hasn't been called. */
+skulltag::HuffmanCodec * HUFFMAN_GetCodec();
+
 /** Applies Huffman encoding to a block of data. */
 void HUFFMAN_Encode(
 	unsigned char const * const inputBuffer,	/**< in: Pointer to start of data that is to be encoded. */
@@ -67,6 +67,12 @@
 #include <ctype.h>
 #include <math.h>
 #include <list>
+#ifdef __linux__
+#include <sys/uio.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <time.h>
+#endif
 #include "../GeoIP/GeoIP.h"
 
 #include "c_console.h"
@@ -90,6 +96,7 @@
 #include "d_netinf.h"
 
 #include "md5.h"
+#include "checksumcache.h"
 #include "network/sv_auth.h"
 #include "doomerrors.h"
 
@@ -138,8 +145,59 @@ static	bool				g_bLANSocketInvalid = false;
 // Our local port.
 static	USHORT			g_usLocalPort;
 
-// Buffer for the Huffman encoding.
-static	UCHAR			g_ucHuffmanBuffer[131072];
+// Buffer for the received packets before they are Huffman decoded.
+static	UCHAR			g_ucReceiveBuffer[131072];
+
+// Buffer for the Huffman encoding. Every thread that launches packets has its own.
+// This is as big as the old shared buffer, since some NETBUFFER_s, like the
+// client's g_LocalBuffer, are a lot bigger than MAX_UDP_PACKET.
+static	thread_local	UCHAR	g_ucEncodeBuffer[131072];
+
+// If set, NETWORK_LaunchPacket adds the packets launched by this thread to the
+// queue instead of sending them.
+static	thread_local	NETWORK_OUTBOUNDQUEUE_s	*g_pOutboundQueue = NULL;
+
+// File the raw inbound packets are written to if "-capturepackets" is used, to be replayed by huffbench.
+static	FILE			*g_PacketCaptureFile = NULL;
+
+// Batched socket I/O with recvmmsg/sendmmsg, only available on Linux.
+#ifdef __linux__
+#define	NETWORK_BATCHED_IO
+
+// Maximum number of datagrams received or sent with a single system call.
+#define	NETWORK_BATCH_SIZE			32
+
+// Outbound packets bigger than this are sent right away.
+#define	NETWORK_OUTBOUND_SLOT_SIZE	( MAX_UDP_PACKET + 1 )
+
+// Datagrams received by the last recvmmsg call and how many of them have been handed out.
+static	struct mmsghdr		g_InboundMessages[NETWORK_BATCH_SIZE];
+static	struct iovec		g_InboundVectors[NETWORK_BATCH_SIZE];
+static	struct sockaddr_in	g_InboundAddresses[NETWORK_BATCH_SIZE];
+static	UCHAR				*g_pInboundData = NULL;
+static	ULONG				g_ulInboundBatchSize = 0;
+static	ULONG				g_ulNumInboundBatched = 0;
+static	ULONG				g_ulInboundBatchPosition = 0;
+
+// Encoded packets waiting for NETWORK_FlushOutboundBatch.
+static	struct mmsghdr		g_OutboundMessages[NETWORK_BATCH_SIZE];
+static	struct iovec		g_OutboundVectors[NETWORK_BATCH_SIZE];
+static	struct sockaddr_in	g_OutboundAddresses[NETWORK_BATCH_SIZE];
+static	NETADDRESS_s		g_OutboundNetAddresses[NETWORK_BATCH_SIZE];
+static	UCHAR				g_ucOutboundData[NETWORK_BATCH_SIZE][NETWORK_OUTBOUND_SLOT_SIZE];
+static	ULONG				g_ulNumOutboundBatched = 0;
+#endif
+
+#ifdef __linux__
+// Timer that fires at the deadline passed to NETWORK_WaitForPackets.
+static	int					g_TimerFD = -1;
+#endif
+
+// Are outbound packets currently queued instead of sent right away?
+static	bool			g_bBatchingOutbound = false;
+
+// Only has an effect on Linux servers.
+CVAR( Bool, sv_batchsocketio, false, CVAR_ARCHIVE|CVAR_NOSETBYACS )
 
 // Our local address;
 NETADDRESS_s	g_LocalAddress;
@@ -166,6 +224,12 @@ static	void			network_Error( const char *pszError );
 static	SOCKET			network_AllocateSocket( void );
 static	bool			network_BindSocketToPort( SOCKET Socket, ULONG ulInAddr, USHORT usPort, bool bReUse );
 static	bool			network_GenerateLumpMD5HashAndWarnIfNeeded( const int LumpNum, const char *LumpName, FString &MD5Hash );
+static	int				network_ProcessReceivedPacket( UCHAR *pbData, LONG lNumBytes, const struct sockaddr_in &SocketFrom );
+static	void			network_SendEncodedPacket( const UCHAR *pbData, INT iNumBytesOut, const NETADDRESS_s &Address );
+#ifdef NETWORK_BATCHED_IO
+static	bool			network_UseBatchedIO( void );
+static	int				network_GetBatchedPacket( void );
+#endif
 
 //*****************************************************************************
 //	FUNCTIONS
@@ -180,6 +244,15 @@ void NETWORK_Construct( USHORT usPort, bool bAllocateLANSocket )
 	// Initialize the Huffman buffer.
 	HUFFMAN_Construct( );
 
+	// Open the packet capture file if requested.
+	const char *pszCaptureFile = Args->CheckValue( "-capturepackets" );
+	if (( pszCaptureFile ) && ( g_PacketCaptureFile == NULL ))
+	{
+		g_PacketCaptureFile = fopen( pszCaptureFile, "wb" );
+		if ( g_PacketCaptureFile == NULL )
+			Printf( "NETWORK_Construct: \\cGWARNING: Cannot open packet capture file %s\n", pszCaptureFile );
+	}
+
 	if ( !restart )
 	{
 #ifdef __WIN32__
@@ -526,6 +599,29 @@ void NETWORK_Destruct( void )
 	// Free the network message buffer.
 	g_NetworkMessage.Free();
 
+	if ( g_PacketCaptureFile )
+	{
+		fclose( g_PacketCaptureFile );
+		g_PacketCaptureFile = NULL;
+	}
+
+#ifdef NETWORK_BATCHED_IO
+	delete[] g_pInboundData;
+	g_pInboundData = NULL;
+	g_ulInboundBatchSize = 0;
+	g_ulNumInboundBatched = g_ulInboundBatchPosition = 0;
+	g_ulNumOutboundBatched = 0;
+#endif
+	g_bBatchingOutbound = false;
+
+#ifdef __linux__
+	if ( g_TimerFD != -1 )
+	{
+		close( g_TimerFD );
+		g_TimerFD = -1;
+	}
+#endif
+
 	// [BB] Delete the GeoIP database.
 	GeoIP_delete ( g_GeoIPDB );
 	g_GeoIPDB = NULL;
@@ -539,7 +635,6 @@ void NETWORK_Destruct( void )
 int NETWORK_GetPackets( void )
 {
 	LONG				lNumBytes;
-	INT					iDecodedNumBytes = sizeof(g_ucHuffmanBuffer);
 	struct sockaddr_in	SocketFrom;
 	INT					iSocketFromLength;
 
@@ -549,10 +644,16 @@ int NETWORK_GetPackets( void )
 	if ( g_NetworkSocket == INVALID_SOCKET )
 		return ( 0 );
 
+#ifdef NETWORK_BATCHED_IO
+	// Hand out datagrams received in batches. Keep draining the current batch even if batching was just turned off.
+	if (( network_UseBatchedIO( )) || ( g_ulInboundBatchPosition < g_ulNumInboundBatched ))
+		return ( network_GetBatchedPacket( ));
+#endif
+
 #ifdef	WIN32
-	lNumBytes = recvfrom( g_NetworkSocket, (char *)g_ucHuffmanBuffer, sizeof( g_ucHuffmanBuffer ), 0, (struct sockaddr *)&SocketFrom, &iSocketFromLength );
+	lNumBytes = recvfrom( g_NetworkSocket, (char *)g_ucReceiveBuffer, sizeof( g_ucReceiveBuffer ), 0, (struct sockaddr *)&SocketFrom, &iSocketFromLength );
 #else
-	lNumBytes = recvfrom( g_NetworkSocket, (char *)g_ucHuffmanBuffer, sizeof( g_ucHuffmanBuffer ), 0, (struct sockaddr *)&SocketFrom, (socklen_t *)&iSocketFromLength );
+	lNumBytes = recvfrom( g_NetworkSocket, (char *)g_ucReceiveBuffer, sizeof( g_ucReceiveBuffer ), 0, (struct sockaddr *)&SocketFrom, (socklen_t *)&iSocketFromLength );
 #endif
 
 	// If the number of bytes returned is -1, an error has occured.
@@ -588,6 +689,16 @@ int NETWORK_GetPackets( void )
 #endif
 	}
 
+	return ( network_ProcessReceivedPacket( g_ucReceiveBuffer, lNumBytes, SocketFrom ));
+}
+
+//*****************************************************************************
+//
+// Decodes a datagram received from SocketFrom into g_NetworkMessage.
+static int network_ProcessReceivedPacket( UCHAR *pbData, LONG lNumBytes, const struct sockaddr_in &SocketFrom )
+{
+	INT					iDecodedNumBytes = sizeof(g_ucReceiveBuffer);
+
 	// No packets or an error, so don't process anything.
 	if ( lNumBytes <= 0 )
 		return ( 0 );
@@ -607,14 +718,22 @@ int NETWORK_GetPackets( void )
 	// [BB] Communication with the auth server is not Huffman-encoded.
 	if ( g_AddressFrom.Compare( NETWORK_AUTH_GetCachedServerAddress() ) == false )
 	{
-		HUFFMAN_Decode( g_ucHuffmanBuffer, (unsigned char *)g_NetworkMessage.pbData, lNumBytes, &iDecodedNumBytes );
+		// Record the encoded packet as a little endian 32-bit length followed by the data.
+		if ( g_PacketCaptureFile )
+		{
+			const BYTE length[4] = { static_cast<BYTE>( lNumBytes ), static_cast<BYTE>( lNumBytes >> 8 ), static_cast<BYTE>( lNumBytes >> 16 ), static_cast<BYTE>( lNumBytes >> 24 ) };
+			fwrite( length, 1, sizeof( length ), g_PacketCaptureFile );
+			fwrite( pbData, 1, lNumBytes, g_PacketCaptureFile );
+		}
+
+		HUFFMAN_Decode( pbData, (unsigned char *)g_NetworkMessage.pbData, lNumBytes, &iDecodedNumBytes );
 		g_NetworkMessage.ulCurrentSize = iDecodedNumBytes;
 	}
 	else
 	{
 		// [BB] We don't need to decode, so we just copy the data.
 		// Not very efficient, but this keeps the changes at a minimum for now.
-		memcpy ( g_NetworkMessage.pbData, g_ucHuffmanBuffer, lNumBytes );
+		memcpy ( g_NetworkMessage.pbData, pbData, lNumBytes );
 		g_NetworkMessage.ulCurrentSize = lNumBytes;
 	}
 	g_NetworkMessage.ByteStream.pbStream = g_NetworkMessage.pbData;
@@ -625,6 +744,149 @@ int NETWORK_GetPackets( void )
 	return ( g_NetworkMessage.ulCurrentSize );
 }
 
+#ifdef NETWORK_BATCHED_IO
+//*****************************************************************************
+//
+static bool network_UseBatchedIO( void )
+{
+	return (( sv_batchsocketio ) && ( NETWORK_GetState( ) == NETSTATE_SERVER ));
+}
+
+//*****************************************************************************
+//
+// Hands out the next datagram of the current batch, receiving a new batch with
+// a single recvmmsg call once the current one is used up. Datagrams that can't
+// be used are skipped, so this only returns 0 when there's nothing left to read.
+static int network_GetBatchedPacket( void )
+{
+	while ( 1 )
+	{
+		if ( g_ulInboundBatchPosition >= g_ulNumInboundBatched )
+		{
+			g_ulNumInboundBatched = g_ulInboundBatchPosition = 0;
+
+			if ( g_pInboundData == NULL )
+			{
+				// Datagrams that don't fit into g_NetworkMessage are ignored anyway.
+				g_ulInboundBatchSize = g_NetworkMessage.ulMaxSize;
+				g_pInboundData = new UCHAR[NETWORK_BATCH_SIZE * g_ulInboundBatchSize];
+			}
+
+			for ( ULONG ulIdx = 0; ulIdx < NETWORK_BATCH_SIZE; ulIdx++ )
+			{
+				g_InboundVectors[ulIdx].iov_base = g_pInboundData + ulIdx * g_ulInboundBatchSize;
+				g_InboundVectors[ulIdx].iov_len = g_ulInboundBatchSize;
+				memset( &g_InboundMessages[ulIdx], 0, sizeof( g_InboundMessages[ulIdx] ));
+				g_InboundMessages[ulIdx].msg_hdr.msg_name = &g_InboundAddresses[ulIdx];
+				g_InboundMessages[ulIdx].msg_hdr.msg_namelen = sizeof( g_InboundAddresses[ulIdx] );
+				g_InboundMessages[ulIdx].msg_hdr.msg_iov = &g_InboundVectors[ulIdx];
+				g_InboundMessages[ulIdx].msg_hdr.msg_iovlen = 1;
+			}
+
+			const int iNumReceived = recvmmsg( g_NetworkSocket, g_InboundMessages, NETWORK_BATCH_SIZE, MSG_DONTWAIT, NULL );
+			if ( iNumReceived == -1 )
+			{
+				if (( errno == EWOULDBLOCK ) || ( errno == EAGAIN ) || ( errno == ECONNREFUSED ))
+					return ( 0 );
+
+				Printf( "NETWORK_GetPackets: WARNING!: Error #%d: %s\n", errno, strerror( errno ));
+				return ( 0 );
+			}
+
+			g_ulNumInboundBatched = iNumReceived;
+			if ( g_ulNumInboundBatched == 0 )
+				return ( 0 );
+		}
+
+		const ULONG ulSlot = g_ulInboundBatchPosition++;
+		LONG lNumBytes = g_InboundMessages[ulSlot].msg_len;
+
+		// A truncated datagram was too big for g_NetworkMessage. Let network_ProcessReceivedPacket ignore it.
+		if ( g_InboundMessages[ulSlot].msg_hdr.msg_flags & MSG_TRUNC )
+			lNumBytes = g_NetworkMessage.ulMaxSize;
+
+		// An empty or oversized datagram mustn't end the loop of the caller while
+		// the rest of the batch is still waiting.
+		const int iNumBytes = network_ProcessReceivedPacket( g_pInboundData + ulSlot * g_ulInboundBatchSize, lNumBytes, g_InboundAddresses[ulSlot] );
+		if ( iNumBytes > 0 )
+			return ( iNumBytes );
+	}
+}
+#endif
+
+//*****************************************************************************
+//
+void NETWORK_BeginOutboundBatch( void )
+{
+#ifdef NETWORK_BATCHED_IO
+	g_bBatchingOutbound = network_UseBatchedIO( );
+#endif
+}
+
+//*****************************************************************************
+//
+void NETWORK_FlushOutboundBatch( void )
+{
+#ifdef NETWORK_BATCHED_IO
+	ULONG	ulNumSent = 0;
+
+	while ( ulNumSent < g_ulNumOutboundBatched )
+	{
+		const int iNumSent = sendmmsg( g_NetworkSocket, &g_OutboundMessages[ulNumSent], g_ulNumOutboundBatched - ulNumSent, 0 );
+
+		// The first packet couldn't be sent. Drop it, like NETWORK_LaunchPacket would, and continue with the others.
+		if ( iNumSent == -1 )
+		{
+			if (( errno != EWOULDBLOCK ) && ( errno != EAGAIN ) && ( errno != ECONNREFUSED ))
+			{
+				Printf( "NETWORK_LaunchPacket: %s\n", strerror( errno ));
+				Printf( "NETWORK_LaunchPacket: Address %s\n", g_OutboundNetAddresses[ulNumSent].ToString() );
+			}
+			ulNumSent++;
+			continue;
+		}
+
+		// Record this for our statistics window.
+		if ( NETWORK_GetState( ) == NETSTATE_SERVER )
+		{
+			for ( int i = 0; i < iNumSent; i++ )
+				SERVER_STATISTIC_AddToOutboundDataTransfer( g_OutboundMessages[ulNumSent + i].msg_len );
+		}
+
+		ulNumSent += iNumSent;
+	}
+
+	g_ulNumOutboundBatched = 0;
+#endif
+	g_bBatchingOutbound = false;
+}
+
+#ifdef NETWORK_BATCHED_IO
+//*****************************************************************************
+//
+// Adds an encoded packet to the outbound batch, flushing the batch first if it's full.
+static void network_QueueOutboundPacket( const UCHAR *pbData, INT iNumBytes, const struct sockaddr_in &SocketAddress, const NETADDRESS_s &Address )
+{
+	if ( g_ulNumOutboundBatched >= NETWORK_BATCH_SIZE )
+	{
+		NETWORK_FlushOutboundBatch( );
+		g_bBatchingOutbound = true;
+	}
+
+	const ULONG ulSlot = g_ulNumOutboundBatched++;
+	memcpy( g_ucOutboundData[ulSlot], pbData, iNumBytes );
+	g_OutboundAddresses[ulSlot] = SocketAddress;
+	g_OutboundNetAddresses[ulSlot] = Address;
+	g_OutboundVectors[ulSlot].iov_base = g_ucOutboundData[ulSlot];
+	g_OutboundVectors[ulSlot].iov_len = iNumBytes;
+	memset( &g_OutboundMessages[ulSlot], 0, sizeof( g_OutboundMessages[ulSlot] ));
+	g_OutboundMessages[ulSlot].msg_hdr.msg_name = &g_OutboundAddresses[ulSlot];
+	g_OutboundMessages[ulSlot].msg_hdr.msg_namelen = sizeof( g_OutboundAddresses[ulSlot] );
+	g_OutboundMessages[ulSlot].msg_hdr.msg_iov = &g_OutboundVectors[ulSlot];
+	g_OutboundMessages[ulSlot].msg_hdr.msg_iovlen = 1;
+}
+#endif
+
 //*****************************************************************************
 //
 int NETWORK_GetLANPackets( void )
@@ -634,16 +896,16 @@ int NETWORK_GetLANPackets( void )
 		return 0;
 
 	LONG				lNumBytes;
-	INT					iDecodedNumBytes = sizeof(g_ucHuffmanBuffer);
+	INT					iDecodedNumBytes = sizeof(g_ucReceiveBuffer);
 	struct sockaddr_in	SocketFrom;
 	INT					iSocketFromLength;
 
     iSocketFromLength = sizeof( SocketFrom );
 
 #ifdef	WIN32
-	lNumBytes = recvfrom( g_LANSocket, (char *)g_ucHuffmanBuffer, sizeof( g_ucHuffmanBuffer ), 0, (struct sockaddr *)&SocketFrom, &iSocketFromLength );
+	lNumBytes = recvfrom( g_LANSocket, (char *)g_ucReceiveBuffer, sizeof( g_ucReceiveBuffer ), 0, (struct sockaddr *)&SocketFrom, &iSocketFromLength );
 #else
-	lNumBytes = recvfrom( g_LANSocket, (char *)g_ucHuffmanBuffer, sizeof( g_ucHuffmanBuffer ), 0, (struct sockaddr *)&SocketFrom, (socklen_t *)&iSocketFromLength );
+	lNumBytes = recvfrom( g_LANSocket, (char *)g_ucReceiveBuffer, sizeof( g_ucReceiveBuffer ), 0, (struct sockaddr *)&SocketFrom, (socklen_t *)&iSocketFromLength );
 #endif
 
 	// If the number of bytes returned is -1, an error has occured.
@@ -698,14 +960,14 @@ int NETWORK_GetLANPackets( void )
 	// [BB] Communication with the auth server is not Huffman-encoded.
 	if ( g_AddressFrom.Compare( NETWORK_AUTH_GetCachedServerAddress() ) == false )
 	{
-		HUFFMAN_Decode( g_ucHuffmanBuffer, (unsigned char *)g_NetworkMessage.pbData, lNumBytes, &iDecodedNumBytes );
+		HUFFMAN_Decode( g_ucReceiveBuffer, (unsigned char *)g_NetworkMessage.pbData, lNumBytes, &iDecodedNumBytes );
 		g_NetworkMessage.ulCurrentSize = iDecodedNumBytes;
 	}
 	else 
 	{
 		// [BB] We don't need to decode, so we just copy the data.
 		// Not very efficient, but this keeps the changes at a minimum for now.
-		memcpy ( g_NetworkMessage.pbData, g_ucHuffmanBuffer, lNumBytes );
+		memcpy ( g_NetworkMessage.pbData, g_ucReceiveBuffer, lNumBytes );
 		g_NetworkMessage.ulCurrentSize = lNumBytes;
 	}
 	g_NetworkMessage.ByteStream.pbStream = g_NetworkMessage.pbData;
@@ -725,8 +987,7 @@ NETADDRESS_s NETWORK_GetFromAddress( void )
 //
 void NETWORK_LaunchPacket( NETBUFFER_s *pBuffer, NETADDRESS_s Address )
 {
-	LONG				lNumBytes;
-	INT					iNumBytesOut = sizeof(g_ucHuffmanBuffer);
+	INT					iNumBytesOut = sizeof(g_ucEncodeBuffer);
 
 	pBuffer->ulCurrentSize = pBuffer->CalcSize();
 
@@ -734,21 +995,98 @@ void NETWORK_LaunchPacket( NETBUFFER_s *pBuffer, NETADDRESS_s Address )
 	if ( pBuffer->ulCurrentSize == 0 )
 		return;
 
-	// Convert the IP address to a socket address.
-	struct sockaddr_in SocketAddress = Address.ToSocketAddress();
+	// Never send a truncated packet. The encoder may need one more byte than
+	// the data itself if it can't compress it.
+	// Printf may only be used on the main thread, a worker leaves it to
+	// NETWORK_SendOutboundQueue.
+	if ( pBuffer->ulCurrentSize + 1 > sizeof( g_ucEncodeBuffer ))
+	{
+		if ( g_pOutboundQueue != NULL )
+			g_pOutboundQueue->ulNumDropped++;
+		else
+			Printf( "NETWORK_LaunchPacket: Packet of %lu bytes to %s is too big, not sending it.\n", pBuffer->ulCurrentSize, Address.ToString() );
+		return;
+	}
 
 	// [BB] Communication with the auth server is not Huffman-encoded.
 	if ( Address.Compare( NETWORK_AUTH_GetCachedServerAddress() ) == false )
-		HUFFMAN_Encode( (unsigned char *)pBuffer->pbData, g_ucHuffmanBuffer, pBuffer->ulCurrentSize, &iNumBytesOut );
+	{
+		HUFFMAN_Encode( (unsigned char *)pBuffer->pbData, g_ucEncodeBuffer, pBuffer->ulCurrentSize, &iNumBytesOut );
+
+		if ( iNumBytesOut <= 0 )
+		{
+			if ( g_pOutboundQueue != NULL )
+				g_pOutboundQueue->ulNumDropped++;
+			else
+				Printf( "NETWORK_LaunchPacket: Failed to encode the packet to %s, not sending it.\n", Address.ToString() );
+			return;
+		}
+	}
 	else
 	{
 		// [BB] We don't need to encode, so we just copy the data.
 		// Not very efficient, but this keeps the changes at a minimum for now.
-		memcpy ( g_ucHuffmanBuffer, pBuffer->pbData, pBuffer->ulCurrentSize );
 		iNumBytesOut = pBuffer->ulCurrentSize;
+		memcpy ( g_ucEncodeBuffer, pBuffer->pbData, iNumBytesOut );
+	}
+
+	// Leave it to NETWORK_SendOutboundQueue to send the packet.
+	if ( g_pOutboundQueue != NULL )
+	{
+		NETWORK_OUTBOUNDQUEUE_s::Packet packet;
+		packet.Address = Address;
+		packet.ulOffset = static_cast<ULONG>( g_pOutboundQueue->Data.size( ));
+		packet.ulSize = iNumBytesOut;
+		g_pOutboundQueue->Data.insert( g_pOutboundQueue->Data.end( ), g_ucEncodeBuffer, g_ucEncodeBuffer + iNumBytesOut );
+		g_pOutboundQueue->Packets.push_back( packet );
+		return;
+	}
+
+	network_SendEncodedPacket( g_ucEncodeBuffer, iNumBytesOut, Address );
+}
+
+//*****************************************************************************
+//
+void NETWORK_SetOutboundQueue( NETWORK_OUTBOUNDQUEUE_s *pQueue )
+{
+	g_pOutboundQueue = pQueue;
+}
+
+//*****************************************************************************
+//
+void NETWORK_SendOutboundQueue( NETWORK_OUTBOUNDQUEUE_s &Queue )
+{
+	for ( unsigned int i = 0; i < Queue.Packets.size(); ++i )
+		network_SendEncodedPacket( &Queue.Data[Queue.Packets[i].ulOffset], Queue.Packets[i].ulSize, Queue.Packets[i].Address );
+
+	if ( Queue.ulNumDropped > 0 )
+		Printf( "NETWORK_SendOutboundQueue: %lu packets were too big to be sent.\n", Queue.ulNumDropped );
+
+	// Keeps the capacity, so the workers rarely have to allocate.
+	Queue.Data.clear();
+	Queue.Packets.clear();
+	Queue.ulNumDropped = 0;
+}
+
+//*****************************************************************************
+//
+static void network_SendEncodedPacket( const UCHAR *pbData, INT iNumBytesOut, const NETADDRESS_s &Address )
+{
+	LONG				lNumBytes;
+
+	// Convert the IP address to a socket address.
+	struct sockaddr_in SocketAddress = Address.ToSocketAddress();
+
+#ifdef NETWORK_BATCHED_IO
+	// Leave it to NETWORK_FlushOutboundBatch to send the packet.
+	if (( g_bBatchingOutbound ) && ( iNumBytesOut > 0 ) && ( iNumBytesOut <= NETWORK_OUTBOUND_SLOT_SIZE ))
+	{
+		network_QueueOutboundPacket( pbData, iNumBytesOut, SocketAddress, Address );
+		return;
 	}
+#endif
 
-	lNumBytes = sendto( g_NetworkSocket, (const char*)g_ucHuffmanBuffer, iNumBytesOut, 0, (struct sockaddr *)&SocketAddress, sizeof( SocketAddress ));
+	lNumBytes = sendto( g_NetworkSocket, (const char*)pbData, iNumBytesOut, 0, (struct sockaddr *)&SocketAddress, sizeof( SocketAddress ));
 
 	// If sendto returns -1, there was an error.
 	if ( lNumBytes == -1 )
@@ -1027,10 +1365,37 @@ void NETWORK_GenerateMapLumpMD5Hash( MapData *Map, const LONG LumpNumber, FStrin
 	delete[] pbData;
 }
 
+//*****************************************************************************
+//
+// Finds the file on disk that contains the given wad and the name of the data
+// within that file, so that its checksums can be cached.
+static void network_GetChecksumCacheKey( const int WadNum, const char *Data, FString &File, FString &Key )
+{
+	int containerNum = WadNum, parentNum;
+	while (( parentNum = Wads.GetParentWad( containerNum )) != containerNum )
+		containerNum = parentNum;
+
+	File = Wads.GetWadFullName( containerNum );
+	const char *embeddedName = Wads.GetWadFullName( WadNum ) + File.Len();
+	if ( *embeddedName == ':' )
+		embeddedName++;
+
+	Key.Format( "%s:%s", embeddedName, Data );
+}
+
 //*****************************************************************************
 //
 void NETWORK_GenerateLumpMD5Hash( const int LumpNum, FString &MD5Hash )
 {
+	// Authenticated lumps tend to come from big files, don't read them again
+	// if they haven't changed.
+	const int wadNum = Wads.GetWadnumFromLumpnum( LumpNum );
+	FString file, key, lumpData;
+	lumpData.Format( "lump:%d:%s", LumpNum - Wads.GetFirstLump( wadNum ), Wads.GetLumpFullName( LumpNum ));
+	network_GetChecksumCacheKey( wadNum, lumpData, file, key );
+	if ( CHECKSUMCACHE_Find( file, key, MD5Hash ))
+		return;
+
 	const int lumpSize = Wads.LumpLength (LumpNum);
 	BYTE *pbData = new BYTE[lumpSize];
 
@@ -1042,6 +1407,8 @@ void NETWORK_GenerateLumpMD5Hash( const int LumpNum, FString &MD5Hash )
 	// Perform the checksum on our buffer, and free it.
 	CMD5Checksum::GetMD5( pbData, lumpSize, MD5Hash );
 	delete[] pbData;
+
+	CHECKSUMCACHE_Store( file, key, MD5Hash );
 }
 
 //*****************************************************************************
@@ -1063,15 +1430,56 @@ bool network_GenerateLumpMD5HashAndWarnIfNeeded( const int LumpNum, const char *
 
 }
 
+//*****************************************************************************
+//
+// Hashes the maps that weren't in the cache in parallel and caches them.
+static void network_HashMaps( TArray<TArray<BYTE> > &Data, TArray<unsigned int> &Maps, TArray<FString> &Files, TArray<FString> &Keys, TArray<FString> &MapSums )
+{
+	TArray<FString> sums;
+	CHECKSUMCACHE_GetMD5s( Data.Size() ? &Data[0] : NULL, Data.Size(), sums );
+
+	for ( unsigned int i = 0; i < sums.Size(); i++ )
+	{
+		MapSums[Maps[i]] = sums[i];
+		CHECKSUMCACHE_Store( Files[i], Keys[i], sums[i] );
+	}
+
+	Data.Clear( );
+	Maps.Clear( );
+	Files.Clear( );
+	Keys.Clear( );
+}
+
 //*****************************************************************************
 // [Dusk] Gets a checksum of every map loaded.
 FString NETWORK_MapCollectionChecksum( )
 {
-	FString longSum, fullSum;
+	// The map data read for hashing is limited to this many bytes at once.
+	const unsigned int MAX_PENDING_MAP_DATA = 64 * 1024 * 1024;
+
+	// The checksum of each map is cached under the file the map is in, so
+	// only maps from files that changed since the last start need to be read.
+	TArray<FString> mapSums;
+	TArray<TArray<BYTE> > mapData;
+	TArray<unsigned int> pendingMaps;
+	TArray<FString> files, keys;
+	unsigned int pendingSize = 0;
+
+	mapSums.Resize( wadlevelinfos.Size( ));
 	for( unsigned i = 0; i < wadlevelinfos.Size( ); i++ )
 	{
 		char* mname = wadlevelinfos[i].mapname;
-		FString sum;
+
+		const int lump = P_FindMapLump( mname );
+		if ( lump == -1 )
+			continue;
+
+		const int wadNum = Wads.GetLumpFile( lump );
+		FString file, key, mapKey;
+		mapKey.Format( "map:%d:%s", lump - Wads.GetFirstLump( wadNum ), mname );
+		network_GetChecksumCacheKey( wadNum, mapKey, file, key );
+		if ( CHECKSUMCACHE_Find( file, key, mapSums[i] ))
+			continue;
 
 		// [BB] P_OpenMapData may throw an exception, so make sure that mname is a valid map.
 		if ( P_CheckIfMapExists ( mname ) == false )
@@ -1081,13 +1489,30 @@ FString NETWORK_MapCollectionChecksum( )
 		if ( !mdata )
 			continue;
 
-		BYTE BSum[16];
-		mdata->GetChecksum( BSum );
-		for (ULONG j = 0; j < sizeof( BSum ); j++)
-			sum.AppendFormat ("%02X", BSum[j]);
-
-		longSum += sum;
+		const unsigned int idx = mapData.Reserve( 1 );
+		mdata->GetChecksumData( mapData[idx] );
 		delete mdata;
+
+		pendingSize += mapData[idx].Size( );
+		pendingMaps.Push( i );
+		files.Push( file );
+		keys.Push( key );
+
+		if ( pendingSize >= MAX_PENDING_MAP_DATA )
+		{
+			network_HashMaps( mapData, pendingMaps, files, keys, mapSums );
+			pendingSize = 0;
+		}
+	}
+
+	network_HashMaps( mapData, pendingMaps, files, keys, mapSums );
+	CHECKSUMCACHE_Save( );
+
+	FString longSum, fullSum;
+	for ( unsigned i = 0; i < mapSums.Size( ); i++ )
+	{
+		mapSums[i].ToUpper( );
+		longSum += mapSums[i];
 	}
 
 	CMD5Checksum::GetMD5( reinterpret_cast<const BYTE *>( longSum.GetChars( ) ),
@@ -1538,6 +1963,8 @@ static void network_InitPWADList( void )
 	g_IWAD = Wads.GetWadName( ulRealIWADIdx );
 
 	// Collect all the PWADs into a list.
+	TArray<ULONG> wadNums;
+	TArray<FString> files, checksums;
 	for ( ULONG ulIdx = 0; Wads.GetWadName( ulIdx ) != NULL; ulIdx++ )
 	{
 		// Skip the IWAD, q-zandronum.pk3, files that were automatically loaded from subdirectories (such as skin files), and WADs loaded automatically within pk3 files.
@@ -1547,12 +1974,21 @@ static void network_InitPWADList( void )
 		{
 			continue;
 		}
-		char MD5Sum[33];
-		MD5SumOfFile ( Wads.GetWadFullName( ulIdx ), MD5Sum );
+
+		wadNums.Push( ulIdx );
+		files.Push( Wads.GetWadFullName( ulIdx ));
+	}
+
+	// Files that haven't changed since the last start come from the cache, the others are hashed in parallel.
+	CHECKSUMCACHE_GetFileMD5s( files, checksums );
+
+	for ( unsigned int i = 0; i < wadNums.Size(); i++ )
+	{
+		const ULONG ulIdx = wadNums[i];
 
 		NetworkPWAD pwad;
 		pwad.name = Wads.GetWadName( ulIdx );
-		pwad.checksum = MD5Sum;
+		pwad.checksum = checksums[i];
 		pwad.wadnum = ulIdx;
 
 		if (stricmp(Wads.GetWadName(ulIdx), GAMENAMELOWERCASE ".pk3") == 0)
@@ -1560,6 +1996,8 @@ static void network_InitPWADList( void )
 		else
 			g_PWADs.Push( pwad );
 	}
+
+	CHECKSUMCACHE_Save( );
 }
 
 void network_Error( const char *pszError )
@@ -1650,6 +2088,113 @@ void I_DoSelect (void)
 #endif
 } 
 
+//*****************************************************************************
+//
+// Reads CLOCK_MONOTONIC in nanoseconds. Returns false if this platform doesn't
+// have it.
+bool NETWORK_GetMonotonicTime( QWORD &qwTimeNS )
+{
+#ifdef __linux__
+	struct timespec	Now;
+
+	if ( clock_gettime( CLOCK_MONOTONIC, &Now ) == -1 )
+		return ( false );
+
+	qwTimeNS = static_cast<QWORD>( Now.tv_sec ) * 1000000000 + Now.tv_nsec;
+	return ( true );
+#else
+	return ( false );
+#endif
+}
+
+//*****************************************************************************
+//
+// Sleeps until a packet arrives on the network socket, the server console has
+// input or NETWORK_GetMonotonicTime( ) reaches qwDeadlineNS. bPacketReady and
+// bTimerExpired tell which of the first and the last woke us up, both can be
+// set at once. If the timer expired, lLatenessUS is set to how many
+// microseconds after qwDeadlineNS that happened, else to 0. Returns false if
+// this isn't supported on this platform, the caller has to poll in that case.
+bool NETWORK_WaitForPackets( QWORD qwDeadlineNS, bool &bPacketReady, bool &bTimerExpired, LONG &lLatenessUS )
+{
+	bPacketReady = false;
+	bTimerExpired = false;
+	lLatenessUS = 0;
+
+#ifdef __linux__
+	if ( g_NetworkSocket == INVALID_SOCKET )
+		return ( false );
+
+	if ( g_TimerFD == -1 )
+	{
+		g_TimerFD = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+		if ( g_TimerFD == -1 )
+			return ( false );
+	}
+
+	struct pollfd	fds[3];
+	int				iNumFDs = 0;
+	int				iStdinFD = -1;
+	int				iTimerFD = -1;
+
+	fds[iNumFDs].fd = g_NetworkSocket;
+	fds[iNumFDs++].events = POLLIN;
+	if ( do_stdin )
+	{
+		iStdinFD = iNumFDs;
+		fds[iNumFDs].fd = 0;
+		fds[iNumFDs++].events = POLLIN;
+	}
+
+	// Don't sleep at all if the deadline already passed, only check the console.
+	QWORD qwNowNS;
+	if ( NETWORK_GetMonotonicTime( qwNowNS ) == false )
+		return ( false );
+
+	if ( qwNowNS < qwDeadlineNS )
+	{
+		struct itimerspec	Timer;
+
+		memset( &Timer, 0, sizeof( Timer ));
+		Timer.it_value.tv_sec = static_cast<time_t>( qwDeadlineNS / 1000000000 );
+		Timer.it_value.tv_nsec = static_cast<long>( qwDeadlineNS % 1000000000 );
+		if ( timerfd_settime( g_TimerFD, TFD_TIMER_ABSTIME, &Timer, NULL ) == -1 )
+			return ( false );
+
+		iTimerFD = iNumFDs;
+		fds[iNumFDs].fd = g_TimerFD;
+		fds[iNumFDs++].events = POLLIN;
+	}
+
+	for ( int i = 0; i < iNumFDs; i++ )
+		fds[i].revents = 0;
+
+	if ( poll( fds, iNumFDs, ( iTimerFD == -1 ) ? 0 : -1 ) == -1 )
+		return ( errno == EINTR );
+
+	if ( iStdinFD != -1 )
+		stdin_ready = !!( fds[iStdinFD].revents & POLLIN );
+
+	bPacketReady = !!( fds[0].revents & POLLIN );
+
+	if (( iTimerFD != -1 ) && ( fds[iTimerFD].revents & POLLIN ))
+	{
+		uint64_t		ulExpirations;
+
+		if ( read( g_TimerFD, &ulExpirations, sizeof( ulExpirations )) == sizeof( ulExpirations ))
+		{
+			bTimerExpired = true;
+			if (( NETWORK_GetMonotonicTime( qwNowNS )) && ( qwNowNS > qwDeadlineNS ))
+				lLatenessUS = static_cast<LONG>( MIN<QWORD>(( qwNowNS - qwDeadlineNS ) / 1000, INT_MAX ));
+		}
+	}
+
+	return ( true );
+#else
+	return ( false );
+#endif
+}
+
 //*****************************************************************************
 // [BB] Let Skulltag's existing code use ZDoom's MD5 code.
 void CMD5Checksum::GetMD5(const BYTE* pBuf, UINT nLength, FString &OutString)
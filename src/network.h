@@ -57,6 +57,7 @@
 #include "p_setup.h"
 #include "sv_main.h"
 #include "tflags.h"
+#include <vector>
 
 //*****************************************************************************
 //	DEFINES
@@ -215,6 +216,34 @@ enum
 extern FString g_lumpsAuthenticationChecksum;
 extern FString g_MapCollectionChecksum;
 
+//*****************************************************************************
+//	STRUCTURES
+
+// Encoded packets collected by NETWORK_LaunchPacket while this queue is set
+// with NETWORK_SetOutboundQueue. Lets worker threads prepare packets that
+// the main thread then sends with NETWORK_SendOutboundQueue.
+//
+// This uses std::vector rather than TArray, since TArray allocates through
+// M_Malloc, which updates the GC's allocation counter and so must only be
+// called on the main thread.
+struct NETWORK_OUTBOUNDQUEUE_s
+{
+	struct Packet
+	{
+		NETADDRESS_s	Address;
+		ULONG			ulOffset;
+		ULONG			ulSize;
+	};
+
+	std::vector<BYTE>	Data;
+	std::vector<Packet>	Packets;
+
+	// Packets that were too big to be sent. Reported by the main thread.
+	ULONG				ulNumDropped;
+
+	NETWORK_OUTBOUNDQUEUE_s( ) : ulNumDropped( 0 ) { }
+};
+
 //*****************************************************************************
 //	PROTOTYPES
 
@@ -225,6 +254,12 @@ int				NETWORK_GetPackets( void );
 int				NETWORK_GetLANPackets( void );
 NETADDRESS_s	NETWORK_GetFromAddress( void );
 void			NETWORK_LaunchPacket( NETBUFFER_s *pBuffer, NETADDRESS_s Address );
+void			NETWORK_BeginOutboundBatch( void );
+void			NETWORK_FlushOutboundBatch( void );
+void			NETWORK_SetOutboundQueue( NETWORK_OUTBOUNDQUEUE_s *pQueue );
+void			NETWORK_SendOutboundQueue( NETWORK_OUTBOUNDQUEUE_s &Queue );
+bool			NETWORK_GetMonotonicTime( QWORD &qwTimeNS );
+bool			NETWORK_WaitForPackets( QWORD qwDeadlineNS, bool &bPacketReady, bool &bTimerExpired, LONG &lLatenessUS );
 NETADDRESS_s	NETWORK_GetLocalAddress( void );
 NETADDRESS_s	NETWORK_GetCachedLocalAddress( void );
 NETBUFFER_s		*NETWORK_GetNetworkMessageBuffer( void );
@@ -197,7 +197,7 @@ void OutgoingPacketBuffer::SetClientIndex ( const unsigned int ClientIdx )
 //
 void OutgoingPacketBuffer::ScheduleUnsentPacket ( const NETBUFFER_s &Packet )
 {
-	if ( ( _unsentPackets.Size () == 0 ) && ( _packetsSentThisTick < static_cast<unsigned int> ( sv_maxpacketspertick ) ) )
+	if ( ( _unsentPackets.size () == 0 ) && ( _packetsSentThisTick < static_cast<unsigned int> ( sv_maxpacketspertick ) ) )
 	{
 		++_packetsSentThisTick;
 		const int packetNumber = this->StorePacket ( Packet );
@@ -205,7 +205,7 @@ void OutgoingPacketBuffer::ScheduleUnsentPacket ( const NETBUFFER_s &Packet )
 	}
 	else
 	{
-		_unsentPackets.Push ( Packet );
+		_unsentPackets.push_back ( Packet );
 	}
 }
 
@@ -267,9 +267,9 @@ void OutgoingPacketBuffer::Clear ( )
 {
 	PacketArchive::Clear();
 	ClearScheduling();
-	for ( unsigned int i = 0; i < _unsentPackets.Size(); ++i )
+	for ( unsigned int i = 0; i < _unsentPackets.size(); ++i )
 		_unsentPackets[i].Free();
-	_unsentPackets.Clear();
+	_unsentPackets.clear();
 }
 
 //*****************************************************************************
@@ -282,19 +282,22 @@ void OutgoingPacketBuffer::ForceSendAll()
 		SendPacket( _scheduledPacketIndices[i], SERVER_GetClient ( _clientIdx )->Address );
 	}
 	_scheduledPacketIndices.Clear();
-	for ( unsigned int i = 0; i < _unsentPackets.Size(); ++i )
+	for ( unsigned int i = 0; i < _unsentPackets.size(); ++i )
 	{
 		++_packetsSentThisTick;
 		const int packetNumber = this->StorePacket ( _unsentPackets[i] );
 		SendPacket ( packetNumber, SERVER_GetClient (_clientIdx)->Address );
 		_unsentPackets[i].Free ();
 	}
-	_unsentPackets.Clear();
+	_unsentPackets.clear();
 }
 
 //*****************************************************************************
 //
-void OutgoingPacketBuffer::Tick ( )
+// Returns false if a packet the client asked for is no longer archived. The
+// caller has to kick the client then. Kicking isn't done here, since this may
+// run on a worker thread.
+bool OutgoingPacketBuffer::Tick ( )
 {
 	{
 		const int packetsToSend = MIN ( sv_maxpacketspertick - static_cast<int> ( _packetsSentThisTick ), static_cast<int> ( _scheduledPacketIndices.Size () ) );
@@ -302,16 +305,13 @@ void OutgoingPacketBuffer::Tick ( )
 		{
 			++_packetsSentThisTick;
 			if ( SendPacket( _scheduledPacketIndices[i], SERVER_GetClient( _clientIdx )->Address) == false )
-			{
-				SERVER_KickPlayer( _clientIdx, "Too many missed packets.");
-				return;
-			}
+				return false;
 		}
 		_scheduledPacketIndices.Delete( 0, packetsToSend );
 	}
 
 	{
-		const int unsentPacketsToSend = MIN ( sv_maxpacketspertick - static_cast<int> ( _packetsSentThisTick ), static_cast<int> ( _unsentPackets.Size () ) );
+		const int unsentPacketsToSend = MIN ( sv_maxpacketspertick - static_cast<int> ( _packetsSentThisTick ), static_cast<int> ( _unsentPackets.size () ) );
 		for ( int i = 0; i < unsentPacketsToSend; ++i )
 		{
 			++_packetsSentThisTick;
@@ -319,8 +319,9 @@ void OutgoingPacketBuffer::Tick ( )
 			SendPacket ( packetNumber, SERVER_GetClient( _clientIdx )->Address );
 			_unsentPackets[i].Free ();
 		}
-		_unsentPackets.Delete( 0, unsentPacketsToSend );
+		_unsentPackets.erase( _unsentPackets.begin(), _unsentPackets.begin() + unsentPacketsToSend );
 	}
 
 	_packetsSentThisTick = 0;
+	return true;
 }
@@ -49,6 +49,7 @@
 //-----------------------------------------------------------------------------
 
 #pragma once
+#include <deque>
 #include "../networkshared.h"
 
 class PacketArchive
@@ -96,7 +97,10 @@ class OutgoingPacketBuffer : public PacketArchive
 	unsigned int _packetsSentThisTick;
 	unsigned int _clientIdx;
 	TArray<unsigned int> _scheduledPacketIndices;
-	TArray<NETBUFFER_s> _unsentPackets;
+	// ScheduleUnsentPacket may run on a worker thread, so this mustn't be a
+	// TArray (see NETWORK_OUTBOUNDQUEUE_s). A deque never moves its elements,
+	// which matters since NETBUFFER_s has no destructor to free copies.
+	std::deque<NETBUFFER_s> _unsentPackets;
 private:
 	bool SendPacket( unsigned int packetNumber, const NETADDRESS_s &Address ) const;
 public:
@@ -107,5 +111,5 @@ public:
 	void ClearScheduling();
 	void ForceSendAll();
 	void Clear();
-	void Tick ( );
+	bool Tick ( );
 };
@@ -0,0 +1,1149 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: playersnapshot.cpp
+//
+// Description: Delta compressed player and actor movement snapshots
+//
+// With sv_deltasnapshots enabled, the per tic player movement updates are no
+// longer sent as one SVC_MOVEPLAYER per player and client. Instead the server
+// sends each client one snapshot of all players per tic, split into chunks of
+// PLAYERSNAPSHOT_PLAYERS_PER_CHUNK players. Every field of a player is encoded
+// as the difference to the latest snapshot the client reported to have received
+// completely. The client reports that snapshot along with its movement commands.
+// If the server no longer knows that snapshot, the fields are sent in full.
+//
+// The same snapshot also holds the missiles and every other actor with a net ID
+// that moves by its velocity. Their fields are encoded as the difference to
+// where the baseline's velocity would have taken them, so a missile that flies
+// on as the client expects isn't sent at all. Only actors that differ from that
+// prediction, appeared or disappeared are sent, in SVC2_ACTORSNAPSHOT chunks
+// that are numbered after the player chunks. An actor that came to rest stays
+// in the snapshots until the client acknowledged where it stopped. The other
+// movement, e.g. a monster walking or a teleport, is still sent as
+// SVC_MOVETHING, the actor snapshots only correct what the client extrapolates.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "../doomstat.h"
+#include "../d_player.h"
+#include "../c_cvars.h"
+#include "../stats.h"
+#include "../farchive.h"
+#include "../cl_main.h"
+#include "../sv_main.h"
+#include "../templates.h"
+#include "../network.h"
+#include "../network_enums.h"
+#include "netcommand.h"
+#include "network/servercommands.h"
+#include "playersnapshot.h"
+
+//*****************************************************************************
+//	VARIABLES
+
+// The fields of a player that are part of a snapshot. These are the same ones
+// that SVC_MOVEPLAYER sends.
+enum
+{
+	PSF_X,
+	PSF_Y,
+	PSF_Z,
+	PSF_WATERLEVEL,
+	PSF_ANGLE,
+	PSF_PITCH,
+	PSF_VELX,
+	PSF_VELY,
+	PSF_VELZ,
+	PSF_FORWARDMOVE,
+	PSF_SIDEMOVE,
+	PSF_UPMOVE,
+	PSF_YAW,
+	PSF_UCMDPITCH,
+	PSF_BUTTONS,
+
+	NUM_PLAYERSNAPSHOT_FIELDS
+};
+
+// The fields of an actor that are part of a snapshot. There may be at most
+// eight, an entry sends which ones changed as a bit mask.
+enum
+{
+	ASF_X,
+	ASF_Y,
+	ASF_Z,
+	ASF_VELX,
+	ASF_VELY,
+	ASF_VELZ,
+	ASF_ANGLE,
+	ASF_PITCH,
+
+	NUM_ACTORSNAPSHOT_FIELDS
+};
+
+// How an actor entry of a SVC2_ACTORSNAPSHOT chunk is encoded.
+enum
+{
+	// The fields are the difference to the actor's predicted baseline fields.
+	ASE_DELTA,
+
+	// The actor isn't part of the baseline, the fields are sent in full.
+	ASE_FULL,
+
+	// The actor isn't part of the snapshot anymore.
+	ASE_REMOVED,
+};
+
+//*****************************************************************************
+struct PLAYERSNAPSHOTSTATE_s
+{
+	// Is this player part of the snapshot?
+	bool			bPresent;
+
+	// Is the recipient allowed to know where this player is? If not, the
+	// fields are all zero.
+	bool			bVisible;
+
+	int				Fields[NUM_PLAYERSNAPSHOT_FIELDS];
+};
+
+//*****************************************************************************
+struct ACTORSNAPSHOTSTATE_s
+{
+	LONG			lNetID;
+	int				Fields[NUM_ACTORSNAPSHOT_FIELDS];
+};
+
+//*****************************************************************************
+struct ACTORSNAPSHOTENTRY_s
+{
+	LONG			lNetID;
+	ULONG			ulType;
+
+	// Which fields are sent and their encoded values.
+	ULONG			ulFieldMask;
+	int				Values[NUM_ACTORSNAPSHOT_FIELDS];
+};
+
+//*****************************************************************************
+struct PLAYERSNAPSHOT_s
+{
+	// The server gametic of this snapshot, -1 if this slot is unused.
+	LONG			lTic;
+
+	// The number of chunks this snapshot was split into and a bit mask of the
+	// ones that were received (client only).
+	ULONG			ulNumChunks;
+	ULONG			ulReceivedChunks;
+
+	PLAYERSNAPSHOTSTATE_s	Players[MAXPLAYERS];
+
+	// The actors of this snapshot, sorted by net ID. The client only knows
+	// them once the snapshot is complete.
+	std::vector<ACTORSNAPSHOTSTATE_s>	Actors;
+
+	// The tic of the baseline this snapshot was encoded against and the actor
+	// entries received so far, keyed by net ID (client only).
+	LONG			lBaselineTic;
+	std::map<LONG, ACTORSNAPSHOTENTRY_s>	ReceivedActors;
+};
+
+//*****************************************************************************
+struct PLAYERSNAPSHOTHISTORY_s
+{
+	// The last PLAYERSNAPSHOT_BACKUP snapshots, indexed by tic.
+	PLAYERSNAPSHOT_s	Snapshots[PLAYERSNAPSHOT_BACKUP];
+
+	// The latest snapshot the client received completely, 0 if none.
+	LONG			lAcknowledgedTic;
+};
+
+// The snapshots the server sent to each client. Only allocated while the
+// client is sent snapshots.
+static	PLAYERSNAPSHOTHISTORY_s	*g_pSentSnapshots[MAXPLAYERS];
+
+// The snapshots the client received from the server.
+static	PLAYERSNAPSHOTHISTORY_s	g_ReceivedSnapshots;
+
+// The tic of the latest snapshot that was applied to each player (client only).
+static	LONG	g_lLastAppliedTic[MAXPLAYERS];
+
+// The tic of the latest snapshot whose actors were applied (client only).
+static	LONG	g_lLastAppliedActorTic;
+
+// The actors that are part of this tic's snapshots, sorted by net ID. They
+// are the same for every client, so they're only collected once per tic.
+static	std::vector<ACTORSNAPSHOTSTATE_s>	g_TrackedActors;
+static	LONG	g_lTrackedActorsTic = -1;
+
+// Statistics about the snapshots sent by the server.
+static	ULONG	g_ulNumChunksSent = 0;
+static	ULONG	g_ulNumDeltaEntries = 0;
+static	ULONG	g_ulNumFullEntries = 0;
+static	ULONG	g_ulNumActorEntries = 0;
+static	ULONG	g_ulNumActorsSkipped = 0;
+static	QWORD	g_qwNumBytesSent = 0;
+
+CVAR( Bool, sv_deltasnapshots, false, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+
+//*****************************************************************************
+//	FUNCTIONS
+
+static void playersnapshot_ClearHistory( PLAYERSNAPSHOTHISTORY_s &History )
+{
+	for ( ULONG ulIdx = 0; ulIdx < PLAYERSNAPSHOT_BACKUP; ++ulIdx )
+	{
+		History.Snapshots[ulIdx].lTic = -1;
+		History.Snapshots[ulIdx].Actors.clear( );
+		History.Snapshots[ulIdx].ReceivedActors.clear( );
+	}
+
+	History.lAcknowledgedTic = 0;
+}
+
+//*****************************************************************************
+//
+static PLAYERSNAPSHOT_s *playersnapshot_FindSnapshot( PLAYERSNAPSHOTHISTORY_s &History, LONG lTic )
+{
+	if ( lTic <= 0 )
+		return ( NULL );
+
+	PLAYERSNAPSHOT_s *pSnapshot = &History.Snapshots[lTic % PLAYERSNAPSHOT_BACKUP];
+	return ( pSnapshot->lTic == lTic ) ? pSnapshot : NULL;
+}
+
+//*****************************************************************************
+//
+static bool playersnapshot_HasBaseFields( const PLAYERSNAPSHOT_s *pBaseline, ULONG ulPlayer )
+{
+	if (( pBaseline == NULL ) || ( ulPlayer >= MAXPLAYERS ))
+		return ( false );
+
+	return ( pBaseline->Players[ulPlayer].bPresent && pBaseline->Players[ulPlayer].bVisible );
+}
+
+//*****************************************************************************
+//
+// Returns the fields the player's entry is delta encoded against. Players that
+// aren't visible in the baseline are encoded against zero.
+static const int *playersnapshot_GetBaseFields( const PLAYERSNAPSHOT_s *pBaseline, ULONG ulPlayer )
+{
+	static const int NullFields[NUM_PLAYERSNAPSHOT_FIELDS] = { 0 };
+
+	if ( playersnapshot_HasBaseFields( pBaseline, ulPlayer ) == false )
+		return ( NullFields );
+
+	return ( pBaseline->Players[ulPlayer].Fields );
+}
+
+//*****************************************************************************
+//
+static bool playersnapshot_IsComplete( const PLAYERSNAPSHOT_s &Snapshot )
+{
+	return ( Snapshot.ulNumChunks > 0 ) && ( Snapshot.ulReceivedChunks == ( 1u << Snapshot.ulNumChunks ) - 1 );
+}
+
+//*****************************************************************************
+//
+// Maps small differences of either sign to small non-negative numbers, so that
+// NETWORK_WriteVariable can send them as a single byte.
+static int playersnapshot_EncodeDelta( int Value, int Base )
+{
+	const unsigned int delta = static_cast<unsigned int>( Value ) - static_cast<unsigned int>( Base );
+	return static_cast<int>(( delta << 1 ) ^ ( 0u - ( delta >> 31 )));
+}
+
+//*****************************************************************************
+//
+static int playersnapshot_DecodeDelta( int Encoded, int Base )
+{
+	const unsigned int encoded = static_cast<unsigned int>( Encoded );
+	const unsigned int delta = ( encoded >> 1 ) ^ ( 0u - ( encoded & 1 ));
+	return static_cast<int>( static_cast<unsigned int>( Base ) + delta );
+}
+
+//*****************************************************************************
+//
+// Moves an actor of the baseline lTics tics ahead by its velocity. The server
+// and the client have to come to exactly the same result.
+static void playersnapshot_PredictActor( const ACTORSNAPSHOTSTATE_s &Base, LONG lTics, ACTORSNAPSHOTSTATE_s &Predicted )
+{
+	Predicted = Base;
+	Predicted.Fields[ASF_X] = static_cast<int>( static_cast<unsigned int>( Base.Fields[ASF_X] ) + static_cast<unsigned int>( Base.Fields[ASF_VELX] ) * lTics );
+	Predicted.Fields[ASF_Y] = static_cast<int>( static_cast<unsigned int>( Base.Fields[ASF_Y] ) + static_cast<unsigned int>( Base.Fields[ASF_VELY] ) * lTics );
+	Predicted.Fields[ASF_Z] = static_cast<int>( static_cast<unsigned int>( Base.Fields[ASF_Z] ) + static_cast<unsigned int>( Base.Fields[ASF_VELZ] ) * lTics );
+}
+
+//*****************************************************************************
+//
+static bool playersnapshot_IsActorAtRest( const ACTORSNAPSHOTSTATE_s &State )
+{
+	return ( State.Fields[ASF_VELX] == 0 ) && ( State.Fields[ASF_VELY] == 0 ) && ( State.Fields[ASF_VELZ] == 0 );
+}
+
+//*****************************************************************************
+//
+// Checks if the actor can be part of the snapshots sent to ulClient. Unless
+// bMoving is false, it also has to be a missile or move by its velocity.
+static bool playersnapshot_ShouldSendActor( AActor *pActor, ULONG ulClient, bool bMoving )
+{
+	if (( pActor == NULL ) || ( pActor->lNetID < 0 ) || ( pActor->player != NULL ) || ( pActor->ObjectFlags & OF_EuthanizeMe ))
+		return ( false );
+
+	if ( pActor->ulNetworkFlags & ( NETFL_SERVERSIDEONLY|NETFL_DESTROYED_ON_CLIENT ))
+		return ( false );
+
+	// Like SVC_MOVETHING, don't correct the owner of an actor it predicts itself.
+	if (( pActor->ulNetworkFlags & NETFL_SKIPOWNER ) && pActor->target && ( pActor->target->player == &players[ulClient] ))
+		return ( false );
+
+	if ( bMoving == false )
+		return ( true );
+
+	return ( pActor->flags & MF_MISSILE ) || ( pActor->velx != 0 ) || ( pActor->vely != 0 ) || ( pActor->velz != 0 );
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_CaptureActor( const AActor *pActor, ACTORSNAPSHOTSTATE_s &State )
+{
+	State.lNetID = pActor->lNetID;
+	State.Fields[ASF_X] = pActor->x;
+	State.Fields[ASF_Y] = pActor->y;
+	State.Fields[ASF_Z] = pActor->z;
+	State.Fields[ASF_VELX] = pActor->velx;
+	State.Fields[ASF_VELY] = pActor->vely;
+	State.Fields[ASF_VELZ] = pActor->velz;
+	State.Fields[ASF_ANGLE] = pActor->angle;
+	State.Fields[ASF_PITCH] = pActor->pitch;
+}
+
+//*****************************************************************************
+//
+static bool playersnapshot_CompareNetIDs( const ACTORSNAPSHOTSTATE_s &A, const ACTORSNAPSHOTSTATE_s &B )
+{
+	return ( A.lNetID < B.lNetID );
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_CollectTrackedActors( void )
+{
+	if ( g_lTrackedActorsTic == gametic )
+		return;
+
+	TThinkerIterator<AActor>	Iterator;
+	AActor						*pActor;
+
+	g_TrackedActors.clear( );
+	while (( pActor = Iterator.Next( )) != NULL )
+	{
+		// Whether the owner gets it is checked per client.
+		if ( playersnapshot_ShouldSendActor( pActor, MAXPLAYERS, true ) == false )
+			continue;
+
+		g_TrackedActors.resize( g_TrackedActors.size( ) + 1 );
+		playersnapshot_CaptureActor( pActor, g_TrackedActors.back( ));
+	}
+
+	std::sort( g_TrackedActors.begin( ), g_TrackedActors.end( ), playersnapshot_CompareNetIDs );
+	g_lTrackedActorsTic = gametic;
+}
+
+//*****************************************************************************
+//
+// Encodes State as an entry of type ulType against Base.
+static void playersnapshot_EncodeActor( const ACTORSNAPSHOTSTATE_s &State, const int *pBaseFields, ULONG ulType, ACTORSNAPSHOTENTRY_s &Entry )
+{
+	Entry.lNetID = State.lNetID;
+	Entry.ulType = ulType;
+	Entry.ulFieldMask = 0;
+
+	for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+	{
+		Entry.Values[ulField] = playersnapshot_EncodeDelta( State.Fields[ulField], pBaseFields[ulField] );
+		if ( Entry.Values[ulField] != 0 )
+			Entry.ulFieldMask |= 1 << ulField;
+	}
+}
+
+//*****************************************************************************
+//
+// Compares this tic's actors to the baseline and decides which entries are
+// sent to ulClient. Snapshot.Actors becomes what the client will know once it
+// received all entries: Actors that don't fit into ulMaxEntries are left as
+// the client predicts them and sent in a later tic.
+static void playersnapshot_BuildActorEntries( ULONG ulClient, const PLAYERSNAPSHOT_s *pBaseline, PLAYERSNAPSHOT_s &Snapshot, std::vector<ACTORSNAPSHOTENTRY_s> &Entries, ULONG ulMaxEntries )
+{
+	static const int NullFields[NUM_ACTORSNAPSHOT_FIELDS] = { 0 };
+	static const std::vector<ACTORSNAPSHOTSTATE_s> NoActors;
+
+	const std::vector<ACTORSNAPSHOTSTATE_s> &BaseActors = pBaseline ? pBaseline->Actors : NoActors;
+	const LONG lTics = pBaseline ? ( gametic - pBaseline->lTic ) : 0;
+	size_t base = 0;
+	size_t tracked = 0;
+
+	Snapshot.Actors.clear( );
+	Entries.clear( );
+
+	while (( base < BaseActors.size( )) || ( tracked < g_TrackedActors.size( )))
+	{
+		const ACTORSNAPSHOTSTATE_s *pBase = NULL;
+		const ACTORSNAPSHOTSTATE_s *pState = NULL;
+		ACTORSNAPSHOTSTATE_s Predicted;
+		ACTORSNAPSHOTSTATE_s Stopped;
+
+		if (( tracked == g_TrackedActors.size( )) || (( base < BaseActors.size( )) && ( BaseActors[base].lNetID <= g_TrackedActors[tracked].lNetID )))
+			pBase = &BaseActors[base++];
+		if (( tracked < g_TrackedActors.size( )) && (( pBase == NULL ) || ( pBase->lNetID == g_TrackedActors[tracked].lNetID )))
+			pState = &g_TrackedActors[tracked++];
+
+		if ( pState && ( playersnapshot_ShouldSendActor( g_NetIDList.findPointerByID( pState->lNetID ), ulClient, true ) == false ))
+			pState = NULL;
+
+		if ( pBase )
+			playersnapshot_PredictActor( *pBase, lTics, Predicted );
+
+		// An actor that stopped moving stays until the client knows that it stopped.
+		if (( pBase != NULL ) && ( pState == NULL ) && ( playersnapshot_IsActorAtRest( *pBase ) == false ))
+		{
+			AActor *pActor = g_NetIDList.findPointerByID( pBase->lNetID );
+			if ( playersnapshot_ShouldSendActor( pActor, ulClient, false ))
+			{
+				playersnapshot_CaptureActor( pActor, Stopped );
+				pState = &Stopped;
+			}
+		}
+
+		// Neither part of the baseline nor to be sent to this client.
+		if (( pBase == NULL ) && ( pState == NULL ))
+			continue;
+
+		// Unchanged actors aren't sent.
+		if ( pState && pBase && ( memcmp( pState->Fields, Predicted.Fields, sizeof( Predicted.Fields )) == 0 ))
+		{
+			Snapshot.Actors.push_back( Predicted );
+			continue;
+		}
+
+		if ( Entries.size( ) >= ulMaxEntries )
+		{
+			g_ulNumActorsSkipped++;
+			if ( pBase )
+				Snapshot.Actors.push_back( Predicted );
+			continue;
+		}
+
+		Entries.resize( Entries.size( ) + 1 );
+		if ( pState == NULL )
+		{
+			Entries.back( ).lNetID = pBase->lNetID;
+			Entries.back( ).ulType = ASE_REMOVED;
+			Entries.back( ).ulFieldMask = 0;
+			continue;
+		}
+
+		playersnapshot_EncodeActor( *pState, pBase ? Predicted.Fields : NullFields, pBase ? ASE_DELTA : ASE_FULL, Entries.back( ));
+		Snapshot.Actors.push_back( *pState );
+	}
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_CaptureState( ULONG ulClient, ULONG ulPlayer, PLAYERSNAPSHOTSTATE_s &State )
+{
+	const player_t *pPlayer = &players[ulPlayer];
+
+	State.bPresent = true;
+	State.bVisible = SERVER_IsPlayerVisible( ulClient, ulPlayer );
+	if ( State.bVisible == false )
+	{
+		memset( State.Fields, 0, sizeof( State.Fields ));
+		return;
+	}
+
+	State.Fields[PSF_X] = pPlayer->mo->x;
+	State.Fields[PSF_Y] = pPlayer->mo->y;
+	State.Fields[PSF_Z] = pPlayer->mo->z;
+	State.Fields[PSF_WATERLEVEL] = pPlayer->mo->waterlevel;
+	State.Fields[PSF_ANGLE] = pPlayer->mo->angle;
+	State.Fields[PSF_PITCH] = pPlayer->mo->pitch;
+	// Like SERVERCOMMANDS_MovePlayer, send the velocity from before friction was applied.
+	State.Fields[PSF_VELX] = pPlayer->ServerXYZVel[0];
+	State.Fields[PSF_VELY] = pPlayer->ServerXYZVel[1];
+	State.Fields[PSF_VELZ] = pPlayer->ServerXYZVel[2];
+	State.Fields[PSF_FORWARDMOVE] = pPlayer->cmd.ucmd.forwardmove;
+	State.Fields[PSF_SIDEMOVE] = pPlayer->cmd.ucmd.sidemove;
+	State.Fields[PSF_UPMOVE] = pPlayer->cmd.ucmd.upmove;
+	State.Fields[PSF_YAW] = pPlayer->cmd.ucmd.yaw;
+	State.Fields[PSF_UCMDPITCH] = pPlayer->cmd.ucmd.pitch;
+	State.Fields[PSF_BUTTONS] = pPlayer->cmd.ucmd.buttons;
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_ApplyState( ULONG ulPlayer, const PLAYERSNAPSHOTSTATE_s &State )
+{
+	if (( PLAYER_IsValidPlayer( ulPlayer ) == false ) || ( players[ulPlayer].mo == NULL ))
+		return;
+
+	ServerCommands::MovePlayer command;
+	command.SetPlayer( &players[ulPlayer] );
+	command.SetIsVisible( State.bVisible );
+
+	if ( State.bVisible )
+	{
+		command.SetX( State.Fields[PSF_X] );
+		command.SetY( State.Fields[PSF_Y] );
+		command.SetZ( State.Fields[PSF_Z] );
+		command.SetWaterlevel( State.Fields[PSF_WATERLEVEL] );
+		command.SetAngle( State.Fields[PSF_ANGLE] );
+		command.SetPitch( State.Fields[PSF_PITCH] );
+		command.SetVelx( State.Fields[PSF_VELX] );
+		command.SetVely( State.Fields[PSF_VELY] );
+		command.SetVelz( State.Fields[PSF_VELZ] );
+		command.SetUcmd_forwardmove( State.Fields[PSF_FORWARDMOVE] );
+		command.SetUcmd_sidemove( State.Fields[PSF_SIDEMOVE] );
+		command.SetUcmd_upmove( State.Fields[PSF_UPMOVE] );
+		command.SetUcmd_yaw( State.Fields[PSF_YAW] );
+		command.SetUcmd_pitch( State.Fields[PSF_UCMDPITCH] );
+		command.SetUcmd_buttons( State.Fields[PSF_BUTTONS] );
+	}
+
+	command.Execute();
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_ApplyActorState( const ACTORSNAPSHOTSTATE_s &State )
+{
+	AActor *pActor = CLIENT_FindThingByNetID( State.lNetID );
+	if ( pActor == NULL )
+		return;
+
+	// Keep the last position, the server may tell us to reuse it with SVC_MOVETHING.
+	ServerCommands::MoveThing command;
+	command.SetActor( pActor );
+	command.SetBits( CM_XY|CM_Z|CM_VELXY|CM_VELZ|CM_ANGLE|CM_PITCH|CM_LAST_XY|CM_LAST_Z );
+	command.SetNewX( State.Fields[ASF_X] );
+	command.SetNewY( State.Fields[ASF_Y] );
+	command.SetNewZ( State.Fields[ASF_Z] );
+	command.SetLastX( pActor->lastX );
+	command.SetLastY( pActor->lastY );
+	command.SetLastZ( pActor->lastZ );
+	command.SetAngle( State.Fields[ASF_ANGLE] );
+	command.SetVelX( State.Fields[ASF_VELX] );
+	command.SetVelY( State.Fields[ASF_VELY] );
+	command.SetVelZ( State.Fields[ASF_VELZ] );
+	command.SetPitch( State.Fields[ASF_PITCH] );
+	command.SetMovedir( pActor->movedir );
+	command.Execute();
+}
+
+//*****************************************************************************
+//
+bool PLAYERSNAPSHOT_IsEnabled( void )
+{
+	return ( sv_deltasnapshots );
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_ClearClient( ULONG ulClient )
+{
+	if ( ulClient >= MAXPLAYERS )
+		return;
+
+	delete g_pSentSnapshots[ulClient];
+	g_pSentSnapshots[ulClient] = NULL;
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_AcknowledgeTic( ULONG ulClient, LONG lTic )
+{
+	if (( ulClient >= MAXPLAYERS ) || ( g_pSentSnapshots[ulClient] == NULL ))
+		return;
+
+	// Don't accept acknowledgements for snapshots we didn't send yet.
+	if (( lTic < 0 ) || ( lTic > gametic ))
+		return;
+
+	g_pSentSnapshots[ulClient]->lAcknowledgedTic = lTic;
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_SendToClient( ULONG ulClient )
+{
+	if ( ulClient >= MAXPLAYERS )
+		return;
+
+	if ( g_pSentSnapshots[ulClient] == NULL )
+	{
+		g_pSentSnapshots[ulClient] = new PLAYERSNAPSHOTHISTORY_s;
+		playersnapshot_ClearHistory( *g_pSentSnapshots[ulClient] );
+	}
+
+	PLAYERSNAPSHOTHISTORY_s &History = *g_pSentSnapshots[ulClient];
+
+	// Only use the acknowledged snapshot as baseline if its slot isn't about to be overwritten.
+	const PLAYERSNAPSHOT_s *pBaseline = NULL;
+	if (( History.lAcknowledgedTic < gametic ) && ( gametic - History.lAcknowledgedTic < PLAYERSNAPSHOT_BACKUP ))
+		pBaseline = playersnapshot_FindSnapshot( History, History.lAcknowledgedTic );
+
+	PLAYERSNAPSHOT_s &Snapshot = History.Snapshots[gametic % PLAYERSNAPSHOT_BACKUP];
+	Snapshot.lTic = gametic;
+	Snapshot.ulNumChunks = 0;
+	Snapshot.ulReceivedChunks = 0;
+
+	ULONG ulNumPlayers = 0;
+	ULONG aulPlayers[MAXPLAYERS];
+
+	for ( ULONG ulPlayer = 0; ulPlayer < MAXPLAYERS; ++ulPlayer )
+	{
+		Snapshot.Players[ulPlayer].bPresent = false;
+
+		if (( playeringame[ulPlayer] == false ) || players[ulPlayer].bSpectating )
+			continue;
+
+		// The client moves its own player itself.
+		if (( ulPlayer == ulClient ) || ( PLAYER_IsValidPlayerWithMo( ulPlayer ) == false ))
+			continue;
+
+		playersnapshot_CaptureState( ulClient, ulPlayer, Snapshot.Players[ulPlayer] );
+		aulPlayers[ulNumPlayers++] = ulPlayer;
+	}
+
+	std::vector<ACTORSNAPSHOTENTRY_s> ActorEntries;
+	playersnapshot_CollectTrackedActors( );
+	playersnapshot_BuildActorEntries( ulClient, pBaseline, Snapshot, ActorEntries, ACTORSNAPSHOT_ACTORS_PER_CHUNK * ACTORSNAPSHOT_MAX_CHUNKS );
+
+	const ULONG ulNumPlayerChunks = ( ulNumPlayers + PLAYERSNAPSHOT_PLAYERS_PER_CHUNK - 1 ) / PLAYERSNAPSHOT_PLAYERS_PER_CHUNK;
+	const ULONG ulNumActorChunks = ( ActorEntries.size( ) + ACTORSNAPSHOT_ACTORS_PER_CHUNK - 1 ) / ACTORSNAPSHOT_ACTORS_PER_CHUNK;
+	Snapshot.ulNumChunks = ulNumPlayerChunks + ulNumActorChunks;
+	if ( Snapshot.ulNumChunks == 0 )
+		return;
+
+	const LONG lBaselineOffset = ( pBaseline != NULL ) ? ( gametic - pBaseline->lTic ) : 0;
+
+	for ( ULONG ulChunk = 0; ulChunk < ulNumPlayerChunks; ++ulChunk )
+	{
+		const ULONG ulFirst = ulChunk * PLAYERSNAPSHOT_PLAYERS_PER_CHUNK;
+		const ULONG ulLast = MIN<ULONG>( ulFirst + PLAYERSNAPSHOT_PLAYERS_PER_CHUNK, ulNumPlayers );
+
+		NetCommand command( SVC2_PLAYERSNAPSHOT );
+		command.setUnreliable( true );
+		command.addLong( gametic );
+		command.addVariable( lBaselineOffset );
+		command.addByte( ulChunk );
+		command.addByte( Snapshot.ulNumChunks );
+		command.addByte( ulLast - ulFirst );
+
+		for ( ULONG ulIdx = ulFirst; ulIdx < ulLast; ++ulIdx )
+		{
+			const ULONG ulPlayer = aulPlayers[ulIdx];
+			const PLAYERSNAPSHOTSTATE_s &State = Snapshot.Players[ulPlayer];
+
+			command.addByte( ulPlayer );
+			command.addBit( State.bVisible );
+
+			if ( State.bVisible == false )
+				continue;
+
+			const int *pBaseFields = playersnapshot_GetBaseFields( pBaseline, ulPlayer );
+			for ( ULONG ulField = 0; ulField < NUM_PLAYERSNAPSHOT_FIELDS; ++ulField )
+				command.addVariable( playersnapshot_EncodeDelta( State.Fields[ulField], pBaseFields[ulField] ));
+
+			if ( playersnapshot_HasBaseFields( pBaseline, ulPlayer ))
+				g_ulNumDeltaEntries++;
+			else
+				g_ulNumFullEntries++;
+		}
+
+		g_ulNumChunksSent++;
+		g_qwNumBytesSent += command.calcSize();
+		command.sendCommandToOneClient( ulClient );
+	}
+
+	for ( ULONG ulChunk = 0; ulChunk < ulNumActorChunks; ++ulChunk )
+	{
+		const ULONG ulFirst = ulChunk * ACTORSNAPSHOT_ACTORS_PER_CHUNK;
+		const ULONG ulLast = MIN<ULONG>( ulFirst + ACTORSNAPSHOT_ACTORS_PER_CHUNK, ActorEntries.size( ));
+
+		NetCommand command( SVC2_ACTORSNAPSHOT );
+		command.setUnreliable( true );
+		command.addLong( gametic );
+		command.addVariable( lBaselineOffset );
+		command.addByte( ulNumPlayerChunks + ulChunk );
+		command.addByte( Snapshot.ulNumChunks );
+		command.addByte( ulLast - ulFirst );
+
+		// The entries are sorted, so the net IDs are sent as the difference to the previous one.
+		LONG lPreviousNetID = 0;
+		for ( ULONG ulIdx = ulFirst; ulIdx < ulLast; ++ulIdx )
+		{
+			const ACTORSNAPSHOTENTRY_s &Entry = ActorEntries[ulIdx];
+
+			command.addVariable( Entry.lNetID - lPreviousNetID );
+			command.addVariable( Entry.ulType | ( Entry.ulFieldMask << 2 ));
+			lPreviousNetID = Entry.lNetID;
+
+			for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+			{
+				if ( Entry.ulFieldMask & ( 1 << ulField ))
+					command.addVariable( Entry.Values[ulField] );
+			}
+
+			g_ulNumActorEntries++;
+		}
+
+		g_ulNumChunksSent++;
+		g_qwNumBytesSent += command.calcSize();
+		command.sendCommandToOneClient( ulClient );
+	}
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_ClearReceived( void )
+{
+	playersnapshot_ClearHistory( g_ReceivedSnapshots );
+
+	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+		g_lLastAppliedTic[ulIdx] = 0;
+
+	g_lLastAppliedActorTic = 0;
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_SerializeActor( FArchive &arc, ACTORSNAPSHOTSTATE_s &State )
+{
+	arc << State.lNetID;
+	for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+		arc << State.Fields[ulField];
+}
+
+//*****************************************************************************
+//
+// Archives the snapshots we received, for the keyframes of client demos. The
+// chunks after a keyframe are delta encoded against these.
+void PLAYERSNAPSHOT_SerializeReceived( FArchive &arc )
+{
+	for ( ULONG ulIdx = 0; ulIdx < PLAYERSNAPSHOT_BACKUP; ++ulIdx )
+	{
+		PLAYERSNAPSHOT_s &Snapshot = g_ReceivedSnapshots.Snapshots[ulIdx];
+
+		arc << Snapshot.lTic;
+		if ( Snapshot.lTic == -1 )
+			continue;
+
+		arc << Snapshot.ulNumChunks << Snapshot.ulReceivedChunks << Snapshot.lBaselineTic;
+
+		for ( ULONG ulPlayer = 0; ulPlayer < MAXPLAYERS; ++ulPlayer )
+		{
+			PLAYERSNAPSHOTSTATE_s &State = Snapshot.Players[ulPlayer];
+
+			arc << State.bPresent;
+			if ( State.bPresent == false )
+				continue;
+
+			arc << State.bVisible;
+			for ( ULONG ulField = 0; ulField < NUM_PLAYERSNAPSHOT_FIELDS; ++ulField )
+				arc << State.Fields[ulField];
+		}
+
+		DWORD dwNumActors = Snapshot.Actors.size( );
+		arc << dwNumActors;
+		Snapshot.Actors.resize( dwNumActors );
+		for ( ULONG ulActor = 0; ulActor < dwNumActors; ++ulActor )
+			playersnapshot_SerializeActor( arc, Snapshot.Actors[ulActor] );
+
+		// The entries of a snapshot that isn't complete yet are still needed when the rest arrives.
+		DWORD dwNumReceived = Snapshot.ReceivedActors.size( );
+		arc << dwNumReceived;
+		if ( arc.IsStoring( ))
+		{
+			for ( std::map<LONG, ACTORSNAPSHOTENTRY_s>::iterator it = Snapshot.ReceivedActors.begin( ); it != Snapshot.ReceivedActors.end( ); ++it )
+			{
+				arc << it->second.lNetID << it->second.ulType << it->second.ulFieldMask;
+				for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+					arc << it->second.Values[ulField];
+			}
+		}
+		else
+		{
+			Snapshot.ReceivedActors.clear( );
+			for ( ULONG ulActor = 0; ulActor < dwNumReceived; ++ulActor )
+			{
+				ACTORSNAPSHOTENTRY_s Entry;
+				arc << Entry.lNetID << Entry.ulType << Entry.ulFieldMask;
+				for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+					arc << Entry.Values[ulField];
+				Snapshot.ReceivedActors[Entry.lNetID] = Entry;
+			}
+		}
+	}
+
+	arc << g_ReceivedSnapshots.lAcknowledgedTic;
+
+	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+		arc << g_lLastAppliedTic[ulIdx];
+
+	arc << g_lLastAppliedActorTic;
+}
+
+//*****************************************************************************
+//
+// Reads the header that SVC2_PLAYERSNAPSHOT and SVC2_ACTORSNAPSHOT share and
+// looks up the baseline. bUsable is set to false if the chunk can't be used.
+static const PLAYERSNAPSHOT_s *playersnapshot_ReadChunkHeader( BYTESTREAM_s *pByteStream, LONG &lTic, LONG &lBaselineTic, ULONG &ulChunk, ULONG &ulNumChunks, bool &bUsable )
+{
+	lTic = NETWORK_ReadLong( pByteStream );
+	const LONG lBaselineOffset = NETWORK_ReadVariable( pByteStream );
+	ulChunk = NETWORK_ReadByte( pByteStream );
+	ulNumChunks = NETWORK_ReadByte( pByteStream );
+	lBaselineTic = 0;
+
+	// If we don't have the baseline anymore, the chunk is read but discarded.
+	// The server falls back to full snapshots once it no longer gets our
+	// acknowledgements for newer ones.
+	bUsable = ( lTic > 0 ) && ( ulChunk < ulNumChunks ) && ( ulNumChunks <= PLAYERSNAPSHOT_MAX_CHUNKS + ACTORSNAPSHOT_MAX_CHUNKS );
+	if ( lBaselineOffset == 0 )
+		return ( NULL );
+
+	lBaselineTic = lTic - lBaselineOffset;
+	const PLAYERSNAPSHOT_s *pBaseline = playersnapshot_FindSnapshot( g_ReceivedSnapshots, lBaselineTic );
+	if (( lBaselineOffset < 0 ) || ( lBaselineOffset >= PLAYERSNAPSHOT_BACKUP ) || ( pBaseline == NULL ) || ( playersnapshot_IsComplete( *pBaseline ) == false ))
+		bUsable = false;
+
+	return ( pBaseline );
+}
+
+//*****************************************************************************
+//
+// Returns the slot for a chunk of the snapshot of lTic, starting a new snapshot
+// if this is the first chunk of this tic we got. Returns NULL if the chunk is
+// stale.
+static PLAYERSNAPSHOT_s *playersnapshot_BeginChunk( LONG lTic, LONG lBaselineTic, ULONG ulNumChunks )
+{
+	PLAYERSNAPSHOT_s &Snapshot = g_ReceivedSnapshots.Snapshots[lTic % PLAYERSNAPSHOT_BACKUP];
+
+	// Chunks of snapshots that are older than the one in the slot are stale.
+	if ( Snapshot.lTic > lTic )
+		return ( NULL );
+
+	if ( Snapshot.lTic != lTic )
+	{
+		Snapshot.lTic = lTic;
+		Snapshot.ulNumChunks = ulNumChunks;
+		Snapshot.ulReceivedChunks = 0;
+		Snapshot.lBaselineTic = lBaselineTic;
+		Snapshot.Actors.clear( );
+		Snapshot.ReceivedActors.clear( );
+		for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+			Snapshot.Players[ulIdx].bPresent = false;
+	}
+
+	return ( &Snapshot );
+}
+
+//*****************************************************************************
+//
+// Builds the actors of a complete snapshot from its baseline and the entries
+// that were received. Returns false if the baseline is gone by now.
+static bool playersnapshot_CompleteActors( PLAYERSNAPSHOT_s &Snapshot )
+{
+	static const std::vector<ACTORSNAPSHOTSTATE_s> NoActors;
+
+	const PLAYERSNAPSHOT_s *pBaseline = NULL;
+	if ( Snapshot.lBaselineTic != 0 )
+	{
+		pBaseline = playersnapshot_FindSnapshot( g_ReceivedSnapshots, Snapshot.lBaselineTic );
+		if (( pBaseline == NULL ) || ( playersnapshot_IsComplete( *pBaseline ) == false ))
+			return ( false );
+	}
+
+	const std::vector<ACTORSNAPSHOTSTATE_s> &BaseActors = pBaseline ? pBaseline->Actors : NoActors;
+	const LONG lTics = Snapshot.lTic - Snapshot.lBaselineTic;
+	std::map<LONG, ACTORSNAPSHOTENTRY_s>::const_iterator it = Snapshot.ReceivedActors.begin( );
+	size_t base = 0;
+
+	Snapshot.Actors.clear( );
+	while (( base < BaseActors.size( )) || ( it != Snapshot.ReceivedActors.end( )))
+	{
+		const ACTORSNAPSHOTSTATE_s *pBase = NULL;
+		const ACTORSNAPSHOTENTRY_s *pEntry = NULL;
+		ACTORSNAPSHOTSTATE_s State;
+
+		if (( it == Snapshot.ReceivedActors.end( )) || (( base < BaseActors.size( )) && ( BaseActors[base].lNetID <= it->first )))
+			pBase = &BaseActors[base++];
+		if (( it != Snapshot.ReceivedActors.end( )) && (( pBase == NULL ) || ( pBase->lNetID == it->first )))
+			pEntry = &( it++ )->second;
+
+		if ( pBase )
+			playersnapshot_PredictActor( *pBase, lTics, State );
+		else
+			memset( &State, 0, sizeof( State ));
+
+		if ( pEntry )
+		{
+			if ( pEntry->ulType == ASE_REMOVED )
+				continue;
+
+			// A delta entry for an actor we don't have is from a different baseline.
+			if (( pEntry->ulType == ASE_DELTA ) && ( pBase == NULL ))
+				return ( false );
+
+			if ( pEntry->ulType == ASE_FULL )
+				memset( State.Fields, 0, sizeof( State.Fields ));
+
+			State.lNetID = pEntry->lNetID;
+			for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+				State.Fields[ulField] = playersnapshot_DecodeDelta( pEntry->Values[ulField], State.Fields[ulField] );
+		}
+
+		Snapshot.Actors.push_back( State );
+	}
+
+	Snapshot.ReceivedActors.clear( );
+	return ( true );
+}
+
+//*****************************************************************************
+//
+static void playersnapshot_FinishChunk( PLAYERSNAPSHOT_s &Snapshot, ULONG ulChunk )
+{
+	if ( Snapshot.ulReceivedChunks & ( 1u << ulChunk ))
+		return;
+
+	Snapshot.ulReceivedChunks |= 1u << ulChunk;
+	if ( playersnapshot_IsComplete( Snapshot ) == false )
+		return;
+
+	// Without its actors, the snapshot can't be a baseline.
+	if ( playersnapshot_CompleteActors( Snapshot ) == false )
+	{
+		Snapshot.lTic = -1;
+		return;
+	}
+
+	if ( Snapshot.lTic > g_ReceivedSnapshots.lAcknowledgedTic )
+		g_ReceivedSnapshots.lAcknowledgedTic = Snapshot.lTic;
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_ParseChunk( BYTESTREAM_s *pByteStream )
+{
+	LONG lTic, lBaselineTic;
+	ULONG ulChunk, ulNumChunks;
+	bool bUsable;
+	const PLAYERSNAPSHOT_s *pBaseline = playersnapshot_ReadChunkHeader( pByteStream, lTic, lBaselineTic, ulChunk, ulNumChunks, bUsable );
+	const ULONG ulNumPlayers = NETWORK_ReadByte( pByteStream );
+
+	ULONG aulPlayers[PLAYERSNAPSHOT_PLAYERS_PER_CHUNK];
+	PLAYERSNAPSHOTSTATE_s States[PLAYERSNAPSHOT_PLAYERS_PER_CHUNK];
+	ULONG ulNumParsed = 0;
+
+	for ( ULONG ulIdx = 0; ulIdx < ulNumPlayers; ++ulIdx )
+	{
+		const ULONG ulPlayer = NETWORK_ReadByte( pByteStream );
+		PLAYERSNAPSHOTSTATE_s State;
+
+		State.bPresent = true;
+		State.bVisible = NETWORK_ReadBit( pByteStream );
+		memset( State.Fields, 0, sizeof( State.Fields ));
+
+		if ( State.bVisible )
+		{
+			const int *pBaseFields = playersnapshot_GetBaseFields( bUsable ? pBaseline : NULL, ulPlayer );
+			for ( ULONG ulField = 0; ulField < NUM_PLAYERSNAPSHOT_FIELDS; ++ulField )
+				State.Fields[ulField] = playersnapshot_DecodeDelta( NETWORK_ReadVariable( pByteStream ), pBaseFields[ulField] );
+		}
+
+		if (( ulPlayer >= MAXPLAYERS ) || ( ulNumParsed >= PLAYERSNAPSHOT_PLAYERS_PER_CHUNK ))
+		{
+			bUsable = false;
+			continue;
+		}
+
+		aulPlayers[ulNumParsed] = ulPlayer;
+		States[ulNumParsed] = State;
+		ulNumParsed++;
+	}
+
+	if (( bUsable == false ) || ( pByteStream->pbStream > pByteStream->pbStreamEnd ))
+		return;
+
+	PLAYERSNAPSHOT_s *pSnapshot = playersnapshot_BeginChunk( lTic, lBaselineTic, ulNumChunks );
+	if ( pSnapshot == NULL )
+		return;
+
+	for ( ULONG ulIdx = 0; ulIdx < ulNumParsed; ++ulIdx )
+	{
+		pSnapshot->Players[aulPlayers[ulIdx]] = States[ulIdx];
+
+		// Packets from the unreliable buffer may arrive in the wrong order.
+		// Don't let an older snapshot undo a newer one.
+		if ( g_lLastAppliedTic[aulPlayers[ulIdx]] <= lTic )
+		{
+			g_lLastAppliedTic[aulPlayers[ulIdx]] = lTic;
+			playersnapshot_ApplyState( aulPlayers[ulIdx], States[ulIdx] );
+		}
+	}
+
+	playersnapshot_FinishChunk( *pSnapshot, ulChunk );
+}
+
+//*****************************************************************************
+//
+void PLAYERSNAPSHOT_ParseActorChunk( BYTESTREAM_s *pByteStream )
+{
+	LONG lTic, lBaselineTic;
+	ULONG ulChunk, ulNumChunks;
+	bool bUsable;
+	const PLAYERSNAPSHOT_s *pBaseline = playersnapshot_ReadChunkHeader( pByteStream, lTic, lBaselineTic, ulChunk, ulNumChunks, bUsable );
+	const ULONG ulNumActors = NETWORK_ReadByte( pByteStream );
+
+	ACTORSNAPSHOTENTRY_s Entries[ACTORSNAPSHOT_ACTORS_PER_CHUNK];
+	ULONG ulNumParsed = 0;
+	LONG lNetID = 0;
+
+	for ( ULONG ulIdx = 0; ulIdx < ulNumActors; ++ulIdx )
+	{
+		ACTORSNAPSHOTENTRY_s Entry;
+
+		lNetID += NETWORK_ReadVariable( pByteStream );
+		const ULONG ulTypeAndMask = NETWORK_ReadVariable( pByteStream );
+
+		Entry.lNetID = lNetID;
+		Entry.ulType = ulTypeAndMask & 3;
+		Entry.ulFieldMask = ( ulTypeAndMask >> 2 ) & (( 1 << NUM_ACTORSNAPSHOT_FIELDS ) - 1 );
+		for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+			Entry.Values[ulField] = ( Entry.ulFieldMask & ( 1 << ulField )) ? NETWORK_ReadVariable( pByteStream ) : 0;
+
+		if (( Entry.ulType > ASE_REMOVED ) || ( ulNumParsed >= ACTORSNAPSHOT_ACTORS_PER_CHUNK ))
+		{
+			bUsable = false;
+			continue;
+		}
+
+		Entries[ulNumParsed++] = Entry;
+	}
+
+	if (( bUsable == false ) || ( pByteStream->pbStream > pByteStream->pbStreamEnd ))
+		return;
+
+	PLAYERSNAPSHOT_s *pSnapshot = playersnapshot_BeginChunk( lTic, lBaselineTic, ulNumChunks );
+	if ( pSnapshot == NULL )
+		return;
+
+	// Don't let an older snapshot undo a newer one.
+	const bool bApply = ( g_lLastAppliedActorTic <= lTic );
+	if ( bApply )
+		g_lLastAppliedActorTic = lTic;
+
+	for ( ULONG ulIdx = 0; ulIdx < ulNumParsed; ++ulIdx )
+	{
+		const ACTORSNAPSHOTENTRY_s &Entry = Entries[ulIdx];
+		pSnapshot->ReceivedActors[Entry.lNetID] = Entry;
+
+		if (( bApply == false ) || ( Entry.ulType == ASE_REMOVED ))
+			continue;
+
+		ACTORSNAPSHOTSTATE_s State;
+		memset( &State, 0, sizeof( State ));
+
+		if ( Entry.ulType == ASE_DELTA )
+		{
+			if ( pBaseline == NULL )
+				continue;
+
+			// The baseline's actors are sorted by net ID.
+			ACTORSNAPSHOTSTATE_s Key;
+			Key.lNetID = Entry.lNetID;
+			std::vector<ACTORSNAPSHOTSTATE_s>::const_iterator it = std::lower_bound( pBaseline->Actors.begin( ), pBaseline->Actors.end( ), Key, playersnapshot_CompareNetIDs );
+			if (( it == pBaseline->Actors.end( )) || ( it->lNetID != Entry.lNetID ))
+				continue;
+
+			playersnapshot_PredictActor( *it, lTic - lBaselineTic, State );
+		}
+
+		State.lNetID = Entry.lNetID;
+		for ( ULONG ulField = 0; ulField < NUM_ACTORSNAPSHOT_FIELDS; ++ulField )
+			State.Fields[ulField] = playersnapshot_DecodeDelta( Entry.Values[ulField], State.Fields[ulField] );
+
+		playersnapshot_ApplyActorState( State );
+	}
+
+	playersnapshot_FinishChunk( *pSnapshot, ulChunk );
+}
+
+//*****************************************************************************
+//
+LONG PLAYERSNAPSHOT_GetLatestCompleteTic( void )
+{
+	return ( g_ReceivedSnapshots.lAcknowledgedTic );
+}
+
+//*****************************************************************************
+//	STATISTICS
+
+ADD_STAT( playersnapshots )
+{
+	FString	Out;
+	const ULONG ulNumEntries = g_ulNumDeltaEntries + g_ulNumFullEntries;
+
+	Out.Format( "%lu chunks sent, %llu bytes, %lu player entries (%.1f%% delta encoded), %lu actor entries, %lu actors deferred",
+		g_ulNumChunksSent,
+		static_cast<unsigned long long>( g_qwNumBytesSent ),
+		ulNumEntries,
+		( ulNumEntries > 0 ) ? 100.0 * g_ulNumDeltaEntries / ulNumEntries : 0.0,
+		g_ulNumActorEntries,
+		g_ulNumActorsSkipped );
+	return ( Out );
+}
@@ -0,0 +1,92 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: playersnapshot.h
+//
+// Description: Delta compressed player and actor movement snapshots
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __PLAYERSNAPSHOT_H__
+#define __PLAYERSNAPSHOT_H__
+
+#include "../doomtype.h"
+#include "../doomdef.h"
+#include "../networkshared.h"
+
+class FArchive;
+
+//*****************************************************************************
+//	DEFINES
+
+// How many snapshots the server and the client remember. A baseline that is
+// older than this has to be replaced by a full snapshot.
+#define	PLAYERSNAPSHOT_BACKUP				32
+
+// How many players are sent per SVC2_PLAYERSNAPSHOT command. This keeps each
+// command small enough to fit into a packet of the default sv_maxpacketsize.
+#define	PLAYERSNAPSHOT_PLAYERS_PER_CHUNK	8
+#define	PLAYERSNAPSHOT_MAX_CHUNKS			(( MAXPLAYERS + PLAYERSNAPSHOT_PLAYERS_PER_CHUNK - 1 ) / PLAYERSNAPSHOT_PLAYERS_PER_CHUNK )
+
+// How many actors are sent per SVC2_ACTORSNAPSHOT command, and how many of
+// these commands a snapshot may have. Actors that don't fit are sent in a
+// later tic. A snapshot can't have more than 32 chunks in total.
+#define	ACTORSNAPSHOT_ACTORS_PER_CHUNK		16
+#define	ACTORSNAPSHOT_MAX_CHUNKS			16
+
+//*****************************************************************************
+//	PROTOTYPES
+
+// Server side.
+bool	PLAYERSNAPSHOT_IsEnabled( void );
+void	PLAYERSNAPSHOT_ClearClient( ULONG ulClient );
+void	PLAYERSNAPSHOT_AcknowledgeTic( ULONG ulClient, LONG lTic );
+void	PLAYERSNAPSHOT_SendToClient( ULONG ulClient );
+
+// Client side.
+void	PLAYERSNAPSHOT_ClearReceived( void );
+void	PLAYERSNAPSHOT_SerializeReceived( FArchive &arc );
+void	PLAYERSNAPSHOT_ParseChunk( BYTESTREAM_s *pByteStream );
+void	PLAYERSNAPSHOT_ParseActorChunk( BYTESTREAM_s *pByteStream );
+LONG	PLAYERSNAPSHOT_GetLatestCompleteTic( void );
+
+#endif	// __PLAYERSNAPSHOT_H__
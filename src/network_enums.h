@@ -366,6 +366,8 @@ BEGIN_ENUM( SVC2 )
 	ENUM_ELEMENT ( SVC2_SRP_USER_START_AUTHENTICATION ),
 	ENUM_ELEMENT ( SVC2_SRP_USER_PROCESS_CHALLENGE ),
 	ENUM_ELEMENT ( SVC2_SRP_USER_VERIFY_SESSION ),
+	ENUM_ELEMENT ( SVC2_PLAYERSNAPSHOT ),
+	ENUM_ELEMENT ( SVC2_ACTORSNAPSHOT ),
 
 	ENUM_ELEMENT ( NUM_SVC2_COMMANDS ),
 }
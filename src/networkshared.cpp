@@ -1027,6 +1027,142 @@ time_t IPFileParser::readExpirationDate( FILE *pFile )
 	return mktime( pTimeInfo );
 }
 
+//*****************************************************************************
+//
+// Parses one octet of an IP address. Only the canonical decimal form is accepted,
+// since the string comparisons in IPList can't match anything else against an address.
+static bool iplist_ParseOctet( const char *pszOctet, ULONG &ulOctet )
+{
+	if (( pszOctet[0] < '0' ) || ( pszOctet[0] > '9' ))
+		return ( false );
+
+	// No leading zeros.
+	if (( pszOctet[0] == '0' ) && ( pszOctet[1] != 0 ))
+		return ( false );
+
+	ulOctet = 0;
+	for ( int i = 0; pszOctet[i]; i++ )
+	{
+		if (( i == 3 ) || ( pszOctet[i] < '0' ) || ( pszOctet[i] > '9' ))
+			return ( false );
+
+		ulOctet = ulOctet * 10 + ( pszOctet[i] - '0' );
+	}
+
+	return ( ulOctet <= 255 );
+}
+
+//*****************************************************************************
+//
+// Packs the four octets into a single number. Octets that are a plain "*" are set to zero and
+// marked in Pattern. Returns false if an octet is neither a number nor a plain "*".
+static bool iplist_PackAddress( const char *pszIP0, const char *pszIP1, const char *pszIP2, const char *pszIP3, ULONG &ulAddress, unsigned int &Pattern )
+{
+	const char	*pszIP[4] = { pszIP0, pszIP1, pszIP2, pszIP3 };
+	ULONG		ulOctet;
+
+	ulAddress = 0;
+	Pattern = 0;
+	for ( int i = 0; i < 4; i++ )
+	{
+		ulAddress <<= 8;
+
+		if (( pszIP[i][0] == '*' ) && ( pszIP[i][1] == 0 ))
+			Pattern |= 1 << i;
+		else if ( iplist_ParseOctet( pszIP[i], ulOctet ))
+			ulAddress |= ulOctet;
+		else
+			return ( false );
+	}
+
+	return ( true );
+}
+
+//*****************************************************************************
+//
+static ULONG iplist_GetPatternMask( const unsigned int Pattern )
+{
+	ULONG ulMask = 0;
+
+	for ( int i = 0; i < 4; i++ )
+	{
+		if (( Pattern & ( 1 << i )) == 0 )
+			ulMask |= 0xFFUL << ( 8 * ( 3 - i ));
+	}
+
+	return ( ulMask );
+}
+
+//*****************************************************************************
+//
+static bool iplist_EntryMatches( const IPADDRESSBAN_s &Entry, const IPStringArray &szAddress )
+{
+	for ( int i = 0; i < 4; i++ )
+	{
+		if (( Entry.szIP[i][0] != '*' ) && ( stricmp( szAddress[i], Entry.szIP[i] ) != 0 ))
+			return ( false );
+	}
+
+	return ( true );
+}
+
+//*****************************************************************************
+//
+void IPList::rebuildIndex( void )
+{
+	for ( int i = 0; i < 16; i++ )
+		_entryIndex[i].clear( );
+
+	_usedWildcardPatterns = 0;
+	_unindexedEntries.clear( );
+
+	for ( ULONG ulIdx = 0; ulIdx < _ipVector.size( ); ulIdx++ )
+		indexEntry( ulIdx );
+}
+
+//*****************************************************************************
+//
+// Adds an entry to the index. Entries have to be added in ascending order.
+void IPList::indexEntry( const ULONG ulIdx )
+{
+	ULONG			ulAddress;
+	unsigned int	Pattern;
+
+	if ( iplist_PackAddress( _ipVector[ulIdx].szIP[0], _ipVector[ulIdx].szIP[1], _ipVector[ulIdx].szIP[2], _ipVector[ulIdx].szIP[3], ulAddress, Pattern ) == false )
+	{
+		_unindexedEntries.push_back( ulIdx );
+		return;
+	}
+
+	// Only the first entry with these octets is of interest, so don't overwrite existing ones.
+	_entryIndex[Pattern].insert( std::make_pair( ulAddress, ulIdx ));
+	_usedWildcardPatterns |= 1 << Pattern;
+}
+
+//*****************************************************************************
+//
+ULONG IPList::findIndexedEntry( const unsigned int Pattern, const ULONG ulAddress ) const
+{
+	std::unordered_map<ULONG, ULONG>::const_iterator it = _entryIndex[Pattern].find( ulAddress );
+	return ( it != _entryIndex[Pattern].end( )) ? it->second : size( );
+}
+
+//*****************************************************************************
+//
+ULONG IPList::findFirstIndexedMatch( const ULONG ulAddress ) const
+{
+	ULONG ulFirstIdx = size();
+
+	// Check every combination of wildcards that is in use.
+	for ( unsigned int i = 0; i < 16; i++ )
+	{
+		if ( _usedWildcardPatterns & ( 1 << i ))
+			ulFirstIdx = std::min( ulFirstIdx, findIndexedEntry( i, ulAddress & iplist_GetPatternMask( i )));
+	}
+
+	return ( ulFirstIdx );
+}
+
 //*****************************************************************************
 //
 void IPList::copy( IPList &destination )
@@ -1053,6 +1189,7 @@ bool IPList::clearAndLoadFromFile( const char *Filename )
 	if ( !success )
 		_error = parser.getErrorMessage();
 
+	rebuildIndex();
 	return success;
 }
 
@@ -1103,6 +1240,23 @@ void IPList::removeExpiredEntries( void )
 //
 ULONG IPList::getFirstMatchingEntryIndex( const IPStringArray &szAddress ) const
 {
+	ULONG			ulAddress;
+	unsigned int	Pattern;
+
+	// Only a real address can be looked up in the index.
+	if ( iplist_PackAddress( szAddress[0], szAddress[1], szAddress[2], szAddress[3], ulAddress, Pattern ) && ( Pattern == 0 ))
+	{
+		const ULONG ulFirstIdx = findFirstIndexedMatch( ulAddress );
+
+		for ( ULONG ulIdx = 0; ( ulIdx < _unindexedEntries.size() ) && ( _unindexedEntries[ulIdx] < ulFirstIdx ); ulIdx++ )
+		{
+			if ( iplist_EntryMatches( _ipVector[_unindexedEntries[ulIdx]], szAddress ))
+				return ( _unindexedEntries[ulIdx] );
+		}
+
+		return ( ulFirstIdx );
+	}
+
 	for ( ULONG ulIdx = 0; ulIdx < _ipVector.size(); ulIdx++ )
 	{
 		if ((( _ipVector[ulIdx].szIP[0][0] == '*' ) || ( stricmp( szAddress[0], _ipVector[ulIdx].szIP[0] ) == 0 )) &&
@@ -1121,6 +1275,13 @@ ULONG IPList::getFirstMatchingEntryIndex( const IPStringArray &szAddress ) const
 //
 ULONG IPList::getFirstMatchingEntryIndex( const NETADDRESS_s &Address ) const
 {
+	// Skip the string conversion if the index suffices.
+	if ( _unindexedEntries.empty( ))
+	{
+		const ULONG ulAddress = ( static_cast<ULONG>( Address.abIP[0] ) << 24 ) | ( Address.abIP[1] << 16 ) | ( Address.abIP[2] << 8 ) | Address.abIP[3];
+		return ( findFirstIndexedMatch( ulAddress ));
+	}
+
 	IPStringArray szAddress;
 	Address.ToIPStringArray( szAddress );
 	return getFirstMatchingEntryIndex( szAddress );
@@ -1137,15 +1298,20 @@ bool IPList::isIPInList( const IPStringArray &szAddress ) const
 //
 bool IPList::isIPInList( const NETADDRESS_s &Address ) const
 {
-	IPStringArray szAddress;
-	Address.ToIPStringArray( szAddress );
-	return isIPInList( szAddress );
+	return ( getFirstMatchingEntryIndex ( Address ) != size() );
 }
 
 //*****************************************************************************
 //
 ULONG IPList::doesEntryExist( const char *pszIP0, const char *pszIP1, const char *pszIP2, const char *pszIP3 ) const
 {
+	ULONG			ulAddress;
+	unsigned int	Pattern;
+
+	// Octets that are numbers or a plain "*" can only be equal to those of an indexed entry.
+	if ( iplist_PackAddress( pszIP0, pszIP1, pszIP2, pszIP3, ulAddress, Pattern ))
+		return ( findIndexedEntry( Pattern, ulAddress ));
+
 	for ( ULONG ulIdx = 0; ulIdx < _ipVector.size( ); ulIdx++ )
 	{
 		if (( stricmp( pszIP0, _ipVector[ulIdx].szIP[0] ) == 0 ) &&
@@ -1317,6 +1483,7 @@ void IPList::addEntry( const char *pszIP0, const char *pszIP1, const char *pszIP
 	newIPEntry.szComment[127] = 0;
 	newIPEntry.tExpirationDate = tExpiration;
 	_ipVector.push_back( newIPEntry );
+	indexEntry( static_cast<ULONG>( _ipVector.size() - 1 ));
 
 	// Finally, append the IP to the file.
 	if ( (pFile = fopen( _filename.c_str(), "a" )) )
@@ -1390,6 +1557,7 @@ void IPList::removeEntry( ULONG ulEntryIdx )
 			_ipVector[ulIdx] = _ipVector[ulIdx+1];
 
 	_ipVector.pop_back();
+	rebuildIndex ();
 	rewriteListToFile ();
 }
 
@@ -1479,12 +1647,114 @@ struct ASCENDINGIPSORT_S
 void IPList::sort()
 {
 	std::sort( _ipVector.begin(), _ipVector.end(), ASCENDINGIPSORT_S() );
+	rebuildIndex();
 }
 
 //=============================================================================
 // QueryIPQueue
 //=============================================================================
 
+//*****************************************************************************
+//
+static ULONG queryipqueue_GetKey( const NETADDRESS_s &Address )
+{
+	return ( static_cast<ULONG>( Address.abIP[0] ) << 24 ) | ( Address.abIP[1] << 16 ) | ( Address.abIP[2] << 8 ) | Address.abIP[3];
+}
+
+//=============================================================================
+//
+// QueryIPQueue
+//
+//=============================================================================
+
+QueryIPQueue::QueryIPQueue( int iEntryLength, unsigned int iMaxEntries, unsigned int iBurst )
+	: _lCurrentTime( 0 ), _iEntryLength( iEntryLength ), _iBurst( std::max<unsigned int>( iBurst, 1 )), _iMaxEntries( std::max<unsigned int>( iMaxEntries, 1 )),
+	_ulNumAccepted( 0 ), _ulNumDropped( 0 ), _ulNumEvicted( 0 )
+{
+	// No entry expires later than _iBurst * _iEntryLength seconds from now.
+	_ExpiryWheel.resize( _iBurst * _iEntryLength + 1 );
+}
+
+//=============================================================================
+//
+// setLimits
+//
+// Changes how many IPs the queue can hold and how many queries an IP may
+// send in a row. Tracked IPs are kept as far as they fit.
+//
+//=============================================================================
+
+void QueryIPQueue::setLimits( unsigned int iMaxEntries, unsigned int iBurst )
+{
+	_iMaxEntries = std::max<unsigned int>( iMaxEntries, 1 );
+	_iBurst = std::max<unsigned int>( iBurst, 1 );
+
+	// The wheel has to cover the longest time an entry can be in the queue now.
+	_ExpiryWheel.clear( );
+	_ExpiryWheel.resize( _iBurst * _iEntryLength + 1 );
+
+	for ( std::unordered_map<ULONG, STORED_QUERY_IP_t>::iterator it = _IPs.begin( ); it != _IPs.end( ); ++it )
+	{
+		it->second.lTheoreticalArrivalTime = std::min<LONG>( it->second.lTheoreticalArrivalTime, _lCurrentTime + _iBurst * _iEntryLength );
+		it->second.Slot = static_cast<unsigned int>( _ExpiryWheel.size( ));
+		fileEntry( it->first, it->second );
+	}
+
+	while ( _IPs.size( ) > _iMaxEntries )
+		evictFirstToExpire( );
+}
+
+//=============================================================================
+//
+// fileEntry
+//
+// Files the entry under the wheel slot of its expiration time.
+//
+//=============================================================================
+
+void QueryIPQueue::fileEntry( const ULONG ulKey, STORED_QUERY_IP_t &Entry )
+{
+	const unsigned int Slot = static_cast<unsigned int>( Entry.lTheoreticalArrivalTime % _ExpiryWheel.size( ));
+
+	if ( Entry.Slot != Slot )
+	{
+		Entry.Slot = Slot;
+		_ExpiryWheel[Slot].push_back( ulKey );
+	}
+}
+
+//=============================================================================
+//
+// evictFirstToExpire
+//
+// Makes room for a new entry by removing the one that would expire first.
+//
+//=============================================================================
+
+void QueryIPQueue::evictFirstToExpire( )
+{
+	for ( unsigned int i = 0; i < _ExpiryWheel.size( ); i++ )
+	{
+		const unsigned int Slot = static_cast<unsigned int>(( _lCurrentTime + i ) % _ExpiryWheel.size( ));
+		std::vector<ULONG> &Keys = _ExpiryWheel[Slot];
+
+		while ( Keys.empty( ) == false )
+		{
+			const ULONG ulKey = Keys.back( );
+			Keys.pop_back( );
+
+			// Slots may contain keys of entries that were refiled or removed since.
+			std::unordered_map<ULONG, STORED_QUERY_IP_t>::iterator it = _IPs.find( ulKey );
+			if (( it != _IPs.end( )) && ( it->second.Slot == Slot ))
+			{
+				_IPs.erase( it );
+				_ulNumEvicted++;
+				return;
+			}
+		}
+	}
+}
+
 //=============================================================================
 //
 // adjustHead
@@ -1495,28 +1765,58 @@ void IPList::sort()
 
 void QueryIPQueue::adjustHead( const LONG CurrentTime )
 {
-	while (( _iQueueHead != _iQueueTail ) && ( CurrentTime >= _IPQueue[_iQueueHead].lNextAllowedTime ))
-		_iQueueHead = ( _iQueueHead + 1 ) % MAX_QUERY_IPS;
+	if ( CurrentTime <= _lCurrentTime )
+		return;
+
+	// Go through the slots of the seconds that passed since the last call.
+	const LONG lNumSeconds = std::min<LONG>( CurrentTime - _lCurrentTime, static_cast<LONG>( _ExpiryWheel.size( )));
+	for ( LONG lTime = CurrentTime - lNumSeconds + 1; lTime <= CurrentTime; lTime++ )
+	{
+		const unsigned int Slot = static_cast<unsigned int>( lTime % _ExpiryWheel.size( ));
+		std::vector<ULONG> &Keys = _ExpiryWheel[Slot];
+
+		for ( unsigned int i = 0; i < Keys.size( ); )
+		{
+			std::unordered_map<ULONG, STORED_QUERY_IP_t>::iterator it = _IPs.find( Keys[i] );
+			const bool bFiledHere = ( it != _IPs.end( )) && ( it->second.Slot == Slot );
+
+			if ( bFiledHere && ( CurrentTime >= it->second.lTheoreticalArrivalTime ))
+				_IPs.erase( it );
+
+			// Only entries that expire a full turn of the wheel later stay in the slot.
+			if ( bFiledHere && ( CurrentTime < it->second.lTheoreticalArrivalTime ))
+				i++;
+			else
+			{
+				Keys[i] = Keys.back( );
+				Keys.pop_back( );
+			}
+		}
+	}
+
+	_lCurrentTime = CurrentTime;
 }
 
 //=============================================================================
 //
 // addressInQueue
 //
-// Returns whether the given IP is in the queue.
+// Returns whether the given IP is in the queue, i.e. has no tokens left.
 //
 //=============================================================================
 
 bool QueryIPQueue::addressInQueue( const NETADDRESS_s AddressFrom ) const
 {
-	// Search through the queue.
-	for ( unsigned int i = _iQueueHead; i != _iQueueTail; i = ( i + 1 ) % MAX_QUERY_IPS )
+	std::unordered_map<ULONG, STORED_QUERY_IP_t>::const_iterator it = _IPs.find( queryipqueue_GetKey( AddressFrom ));
+
+	// The bucket is empty until the time the next query is due minus the queries it can hold in reserve.
+	if (( it != _IPs.end( )) && ( _lCurrentTime < it->second.lTheoreticalArrivalTime - static_cast<LONG>(( _iBurst - 1 ) * _iEntryLength )))
 	{
-		if ( AddressFrom.CompareNoPort( _IPQueue[i].Address ))
-			return true;
+		_ulNumDropped++;
+		return true;
 	}
 
-	// Not found, or the queue is empty.
+	_ulNumAccepted++;
 	return false;
 }
 
@@ -1524,37 +1824,47 @@ bool QueryIPQueue::addressInQueue( const NETADDRESS_s AddressFrom ) const
 //
 // isFull
 //
-// Returns if the queue is full.
-// This will only happen if the server is being attacked by a DOS with >= MAX_QUERY_IPS computers. The sever should stop processing new requests at that point.
+// Returns if the queue is full. If so, adding a new IP removes the one that would expire first.
 //
 //=============================================================================
 
 bool QueryIPQueue::isFull( ) const
 {
-	return ((( _iQueueTail + 1 ) % MAX_QUERY_IPS ) == _iQueueHead );
+	return ( _IPs.size( ) >= _iMaxEntries );
 }
 
 //=============================================================================
 //
 // addAddress
 //
-// Adds the given address to the queue. (If the queue is full, an error written to errorOut)
+// Takes a token from the bucket of the given address. (If the queue is full, an error written to errorOut)
 //
 //=============================================================================
 
 void QueryIPQueue::addAddress( const NETADDRESS_s AddressFrom, const LONG lCurrentTime, std::ostream *errorOut )
 {
-	// Add and advance the tail.
-	_IPQueue[_iQueueTail].Address = AddressFrom;
-	_IPQueue[_iQueueTail].lNextAllowedTime = lCurrentTime + _iEntryLength;
-	_iQueueTail = ( _iQueueTail + 1 ) % MAX_QUERY_IPS;
+	const ULONG ulKey = queryipqueue_GetKey( AddressFrom );
+	std::unordered_map<ULONG, STORED_QUERY_IP_t>::iterator it = _IPs.find( ulKey );
 
-	// Is the queue full?
-	if (_iQueueTail == _iQueueHead )
+	if ( it == _IPs.end( ))
 	{
-		if ( errorOut )
-			*errorOut << "WARNING! The IP flood queue is full.\n";
+		// Is the queue full?
+		if ( isFull( ))
+		{
+			if ( errorOut )
+				*errorOut << "WARNING! The IP flood queue is full.\n";
 
-		_iQueueHead = ( _iQueueHead + 1 ) % MAX_QUERY_IPS; // [RC] Start removing older entries.
+			evictFirstToExpire( );
+		}
+
+		STORED_QUERY_IP_t Entry;
+		Entry.lTheoreticalArrivalTime = lCurrentTime;
+		Entry.Slot = static_cast<unsigned int>( _ExpiryWheel.size( ));
+		it = _IPs.insert( std::make_pair( ulKey, Entry )).first;
 	}
+
+	// An IP can't owe more than a full bucket.
+	const LONG lLastArrivalTime = std::max<LONG>( it->second.lTheoreticalArrivalTime, lCurrentTime );
+	it->second.lTheoreticalArrivalTime = std::min<LONG>( lLastArrivalTime + _iEntryLength, lCurrentTime + _iBurst * _iEntryLength );
+	fileEntry( ulKey, it->second );
 }
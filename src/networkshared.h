@@ -57,6 +57,7 @@
 #include <iostream>
 #include <vector>
 #include <list>
+#include <unordered_map>
 #include <time.h>
 #include <ctype.h>
 #include <math.h>
@@ -79,6 +80,17 @@ enum BUFFERTYPE_e
 
 };
 
+//*****************************************************************************
+//[BB] Client connect flags.
+enum
+{
+	CCF_STARTASSPECTATOR			= 1 << 0,
+	CCF_DONTRESTOREFRAGS			= 1 << 1,
+	CCF_HIDECOUNTRY					= 1 << 2,
+	// The client is a spectator relay and the password it sent is sv_relaypassword.
+	CCF_RELAY						= 1 << 3,
+};
+
 //*****************************************************************************
 enum
 {
@@ -370,8 +382,19 @@ class IPList
 	std::string						_filename;
 	std::string						_error;
 
+	// Index of the entries for fast lookups. Every combination of wildcard octets
+	// has its own map from the packed address (wildcard octets zeroed) to the index
+	// of the first entry with these octets.
+	std::unordered_map<ULONG, ULONG>	_entryIndex[16];
+	unsigned int					_usedWildcardPatterns;
+
+	// Entries whose octets can't be indexed, i.e. wildcards other than a plain "*".
+	std::vector<ULONG>				_unindexedEntries;
+
 //*************************************************************************
 public:
+	IPList( ) : _usedWildcardPatterns( 0 ) { }
+
 	bool			clearAndLoadFromFile( const char *Filename );
 	ULONG			getFirstMatchingEntryIndex( const IPStringArray &szAddress ) const;
 	ULONG			getFirstMatchingEntryIndex( const NETADDRESS_s &Address ) const;
@@ -393,8 +416,8 @@ public:
 	void			removeExpiredEntries( void ); // [RC]
 
 	unsigned int	size() const { return static_cast<unsigned int>( _ipVector.size( )); }
-	void			clear() { _ipVector.clear(); }
-	void			push_back ( IPADDRESSBAN_s &IP ) { _ipVector.push_back(IP); }
+	void			clear() { _ipVector.clear(); rebuildIndex(); }
+	void			push_back ( IPADDRESSBAN_s &IP ) { _ipVector.push_back(IP); indexEntry( static_cast<ULONG>( _ipVector.size() - 1 )); }
 	const char*		getErrorMessage() const { return _error.c_str(); }
 	
 	std::vector<IPADDRESSBAN_s>&	getVector() { return _ipVector; }
@@ -402,13 +425,19 @@ public:
 //*************************************************************************
 private:
 	bool rewriteListToFile ();
+	void rebuildIndex ();
+	void indexEntry ( const ULONG ulIdx );
+	ULONG findIndexedEntry ( const unsigned int Pattern, const ULONG ulAddress ) const;
+	ULONG findFirstIndexedMatch ( const ULONG ulAddress ) const;
 };
 
 //==========================================================================
 //
 // QueryIPQueue
 //
-// Stores IPs that have recently queried us to prevent flooding.
+// Stores IPs that have recently queried us to prevent flooding. Every IP
+// has a token bucket that holds up to iBurst queries and regains one every
+// iEntryLength seconds. An IP is in the queue while its bucket is empty.
 // @author Benjamin Berkels, Rivecoder
 //
 //==========================================================================
@@ -418,37 +447,57 @@ class QueryIPQueue
 	//*************************************************************************
 	struct STORED_QUERY_IP_t
 	{
-		// The IP address.
-		NETADDRESS_s		Address;
-
-		// Expiration date.
-		long				lNextAllowedTime;
+		// Theoretical arrival time of the next query. The IP's token bucket
+		// is full again once this time has passed.
+		LONG				lTheoreticalArrivalTime;
 
+		// Expiry wheel slot the entry is filed under.
+		unsigned int		Slot;
 	};
 
-	// The maximum number of entries that we can store.
-	static const unsigned int	MAX_QUERY_IPS = 512;
+	// The default maximum number of entries that we can store.
+	static const unsigned int	DEFAULT_MAX_QUERY_IPS = 8192;
 
-	// The array of IPs.
-	STORED_QUERY_IP_t			_IPQueue[MAX_QUERY_IPS];
+	// The IPs, indexed by their packed address.
+	std::unordered_map<ULONG, STORED_QUERY_IP_t>	_IPs;
 
-	// Head and tail of the queue.
-	unsigned int				_iQueueHead;
-	unsigned int				_iQueueTail;
+	// Expiry wheel, one slot per second. Entries are filed under the slot
+	// of the time they expire at.
+	std::vector<std::vector<ULONG> >	_ExpiryWheel;
+	LONG						_lCurrentTime;
 
-	// How long entries will last (seconds).
+	// How long it takes to earn a token back (seconds).
 	unsigned int				_iEntryLength;
 
+	// How many queries an IP may send in a row.
+	unsigned int				_iBurst;
+
+	unsigned int				_iMaxEntries;
+
+	// Statistics.
+	mutable ULONG				_ulNumAccepted;
+	mutable ULONG				_ulNumDropped;
+	ULONG						_ulNumEvicted;
+
+	void	fileEntry( const ULONG ulKey, STORED_QUERY_IP_t &Entry );
+	void	evictFirstToExpire( );
+
 //*************************************************************************
 public:
-	QueryIPQueue( int iEntryLength ) : _iQueueHead( 0 ), _iQueueTail( 0 ), _iEntryLength( iEntryLength )
-	{
-	}
+	QueryIPQueue( int iEntryLength, unsigned int iMaxEntries = DEFAULT_MAX_QUERY_IPS, unsigned int iBurst = 1 );
 
+	void	setLimits( unsigned int iMaxEntries, unsigned int iBurst );
 	void	adjustHead( const LONG CurrentTime );
 	bool	addressInQueue( const NETADDRESS_s AddressFrom ) const;
 	void	addAddress( const NETADDRESS_s AddressFrom, const LONG lCurrentTime, std::ostream *errorOut = NULL );
 	bool	isFull( ) const;
+
+	unsigned int	size( ) const { return static_cast<unsigned int>( _IPs.size( )); }
+	unsigned int	getMaxEntries( ) const { return _iMaxEntries; }
+	unsigned int	getBurst( ) const { return _iBurst; }
+	ULONG			getNumAccepted( ) const { return _ulNumAccepted; }
+	ULONG			getNumDropped( ) const { return _ulNumDropped; }
+	ULONG			getNumEvicted( ) const { return _ulNumEvicted; }
 };
 
 //==========================================================================
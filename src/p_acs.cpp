@@ -51,6 +51,7 @@
 #include "doomstat.h"
 #include "c_console.h"
 #include "c_dispatch.h"
+#include "stats.h"
 #include "s_sndseq.h"
 #include "i_system.h"
 #include "i_movie.h"
@@ -172,6 +173,7 @@ FRandom pr_acs ("ACS");
 // I imagine this much stack space is probably overkill, but it could
 // potentially get used with recursive functions.
 #define STACK_SIZE 4096
+#define ACS_RUNAWAY_LIMIT 2000000	// p-codes a script may run per tic
 
 #define CLAMPCOLOR(c)		(EColorRange)((unsigned)(c) >= NUM_TEXT_COLORS ? CR_UNTRANSLATED : (c))
 #define LANGREGIONMASK		MAKE_ID(0,0,0xff,0xff)
@@ -360,7 +362,10 @@ int GetNetworkReplicationFlags()
 //
 // When the string table needs to grow to hold more strings, a garbage
 // collection is first attempted to see if more room can be made to store
-// strings without growing. A string is concidered in use if any value
+// strings without growing. The collection frees the unused strings that
+// were added since the previous one right away. Older strings are swept a
+// few at a time over the following tics, so a large pool doesn't stall
+// a single tic. A string is concidered in use if any value
 // in any of these variable blocks contains a valid ID in the global string
 // table:
 //   * The active area of the ACS stack
@@ -397,8 +402,14 @@ int ACS_PushAndReturnDynamicString ( const FString &Work, const SDWORD *stack, i
 
 ACSStringPool::ACSStringPool()
 {
-	memset(PoolBuckets, 0xFF, sizeof(PoolBuckets));
+	HashUsed = 0;
+	NumStrings = 0;
 	FirstFreeEntry = 0;
+	MarkEpoch = 1;
+	SweepEpoch = 0;
+	SweepPos = SweepEnd = 0;
+	NumCollections = 0;
+	LastYoungFreed = LastOldFreed = 0;
 }
 
 //============================================================================
@@ -412,8 +423,12 @@ ACSStringPool::ACSStringPool()
 void ACSStringPool::Clear()
 {
 	Pool.Clear();
-	memset(PoolBuckets, 0xFF, sizeof(PoolBuckets));
+	HashTable.Clear();
+	Nursery.Clear();
+	HashUsed = 0;
+	NumStrings = 0;
 	FirstFreeEntry = 0;
+	CancelSweep();
 }
 
 //============================================================================
@@ -429,26 +444,24 @@ int ACSStringPool::AddString(const char *str, const SDWORD *stack, int stackdept
 {
 	size_t len = strlen(str);
 	unsigned int h = SuperFastHash(str, len);
-	unsigned int bucketnum = h % NUM_BUCKETS;
-	int i = FindString(str, len, h, bucketnum);
+	int i = FindString(str, len, h);
 	if (i >= 0)
 	{
 		return i | STRPOOL_LIBRARYID_OR;
 	}
 	FString fstr(str);
-	return InsertString(fstr, h, bucketnum, stack, stackdepth);
+	return InsertString(fstr, h, stack, stackdepth);
 }
 
 int ACSStringPool::AddString(FString &str, const SDWORD *stack, int stackdepth)
 {
 	unsigned int h = SuperFastHash(str.GetChars(), str.Len());
-	unsigned int bucketnum = h % NUM_BUCKETS;
-	int i = FindString(str, str.Len(), h, bucketnum);
+	int i = FindString(str, str.Len(), h);
 	if (i >= 0)
 	{
 		return i | STRPOOL_LIBRARYID_OR;
 	}
-	return InsertString(str, h, bucketnum, stack, stackdepth);
+	return InsertString(str, h, stack, stackdepth);
 }
 
 //============================================================================
@@ -461,7 +474,7 @@ const char *ACSStringPool::GetString(int strnum)
 {
 	assert((strnum & LIBRARYID_MASK) == STRPOOL_LIBRARYID_OR);
 	strnum &= ~LIBRARYID_MASK;
-	if ((unsigned)strnum < Pool.Size() && Pool[strnum].Next != FREE_ENTRY)
+	if ((unsigned)strnum < Pool.Size() && Pool[strnum].Slot != FREE_ENTRY)
 	{
 		return Pool[strnum].Str;
 	}
@@ -489,6 +502,8 @@ void ACSStringPool::LockString(int strnum)
 // ACSStringPool :: UnlockString
 //
 // When equally mated with LockString, allows this string to be purged.
+// Strings that were only kept by their lock were not marked by the running
+// collection, so any sweep in progress has to stop.
 //
 //============================================================================
 
@@ -499,6 +514,7 @@ void ACSStringPool::UnlockString(int strnum)
 	assert((unsigned)strnum < Pool.Size());
 	assert(Pool[strnum].LockCount > 0);
 	Pool[strnum].LockCount--;
+	CancelSweep();
 }
 
 //============================================================================
@@ -515,7 +531,7 @@ void ACSStringPool::MarkString(int strnum)
 	assert((strnum & LIBRARYID_MASK) == STRPOOL_LIBRARYID_OR);
 	strnum &= ~LIBRARYID_MASK;
 	assert((unsigned)strnum < Pool.Size());
-	Pool[strnum].LockCount |= 0x80000000;
+	Pool[strnum].Mark = MarkEpoch;
 }
 
 //============================================================================
@@ -569,6 +585,7 @@ void ACSStringPool::UnlockStringArray(const int *strnum, unsigned int count)
 			}
 		}
 	}
+	CancelSweep();
 }
 
 //============================================================================
@@ -589,7 +606,7 @@ void ACSStringPool::MarkStringArray(const int *strnum, unsigned int count)
 			num &= ~LIBRARYID_MASK;
 			if ((unsigned)num < Pool.Size())
 			{
-				Pool[num].LockCount |= 0x80000000;
+				Pool[num].Mark = MarkEpoch;
 			}
 		}
 	}
@@ -616,7 +633,7 @@ void ACSStringPool::MarkStringMap(const FWorldGlobalArray &aray)
 			num &= ~LIBRARYID_MASK;
 			if ((unsigned)num < Pool.Size())
 			{
-				Pool[num].LockCount |= 0x80000000;
+				Pool[num].Mark = MarkEpoch;
 			}
 		}
 	}
@@ -637,49 +654,100 @@ void ACSStringPool::UnlockAll()
 	{
 		Pool[i].LockCount = 0;
 	}
+	CancelSweep();
 }
 
 //============================================================================
 //
 // ACSStringPool :: PurgeStrings
 //
-// Remove all unlocked strings from the pool.
+// Remove all unlocked strings from the pool that were not marked since the
+// last purge.
 //
 //============================================================================
 
 void ACSStringPool::PurgeStrings()
 {
-	// Clear the hash buckets. We'll rebuild them as we decide what strings
-	// to keep and which to toss.
-	memset(PoolBuckets, 0xFF, sizeof(PoolBuckets));
-	size_t usedcount = 0, freedcount = 0;
+	size_t freedcount = 0;
+
+	CancelSweep();
 	for (unsigned int i = 0; i < Pool.Size(); ++i)
 	{
 		PoolEntry *entry = &Pool[i];
-		if (entry->Next != FREE_ENTRY)
+		if (entry->Slot != FREE_ENTRY && entry->LockCount == 0 && entry->Mark != MarkEpoch)
 		{
-			if (entry->LockCount == 0)
-			{
-				freedcount++;
-				// Mark this entry as free.
-				entry->Next = FREE_ENTRY;
-				if (i < FirstFreeEntry)
-				{
-					FirstFreeEntry = i;
-				}
-				// And free the string.
-				entry->Str = "";
-			}
-			else
-			{
-				usedcount++;
-				// Rehash this entry.
-				unsigned int h = entry->Hash % NUM_BUCKETS;
-				entry->Next = PoolBuckets[h];
-				PoolBuckets[h] = i;
-				// Remove MarkString's mark.
-				entry->LockCount &= 0x7FFFFFFF;
-			}
+			FreeEntry(i);
+			freedcount++;
+		}
+	}
+	MarkEpoch++;
+	Nursery.Clear();
+	LastYoungFreed = 0;
+	LastOldFreed = (unsigned int)freedcount;
+
+	// Get rid of the deleted slots while we're at it.
+	Rehash(NumStrings * 2);
+}
+
+//============================================================================
+//
+// ACSStringPool :: StartCollection
+//
+// Marks everything that is referenced right now. The strings that were
+// added since the last collection are swept immediately; the rest is left
+// to SweepStrings. Strings that are added or looked up before the sweep
+// reaches them count as marked.
+//
+//============================================================================
+
+void ACSStringPool::StartCollection(const SDWORD *stack, int stackdepth)
+{
+	// Finish the previous collection with its own marks.
+	if (SweepPos < SweepEnd)
+	{
+		SweepStrings(SweepEnd - SweepPos);
+	}
+
+	P_MarkACSGlobalStrings(stack, stackdepth);
+	NumCollections++;
+
+	LastYoungFreed = 0;
+	for (unsigned int i = 0; i < Nursery.Size(); ++i)
+	{
+		PoolEntry *entry = &Pool[Nursery[i]];
+		if (entry->Slot != FREE_ENTRY && entry->LockCount == 0 && entry->Mark != MarkEpoch)
+		{
+			FreeEntry(Nursery[i]);
+			LastYoungFreed++;
+		}
+	}
+	Nursery.Clear();
+
+	SweepEpoch = MarkEpoch++;
+	SweepPos = 0;
+	SweepEnd = Pool.Size();
+	LastOldFreed = 0;
+}
+
+//============================================================================
+//
+// ACSStringPool :: SweepStrings
+//
+// Continues the sweep started by the last collection for up to count
+// entries. Called once per tic.
+//
+//============================================================================
+
+void ACSStringPool::SweepStrings(unsigned int count)
+{
+	for (; count > 0 && SweepPos < SweepEnd; --count)
+	{
+		unsigned int i = SweepPos++;
+		PoolEntry *entry = &Pool[i];
+		if (entry->Slot != FREE_ENTRY && entry->LockCount == 0 && entry->Mark != SweepEpoch)
+		{
+			FreeEntry(i);
+			LastOldFreed++;
 		}
 	}
 }
@@ -693,21 +761,37 @@ void ACSStringPool::PurgeStrings()
 //
 //============================================================================
 
-int ACSStringPool::FindString(const char *str, size_t len, unsigned int h, unsigned int bucketnum)
+int ACSStringPool::FindString(const char *str, size_t len, unsigned int h)
 {
-	unsigned int i = PoolBuckets[bucketnum];
-	while (i != NO_ENTRY)
+	unsigned int mask = HashTable.Size() - 1;
+
+	if (HashTable.Size() == 0)
 	{
-		PoolEntry *entry = &Pool[i];
-		assert(entry->Next != FREE_ENTRY);
-		if (entry->Hash == h && entry->Str.Len() == len &&
-			memcmp(entry->Str.GetChars(), str, len) == 0)
+		return -1;
+	}
+	for (unsigned int slot = h & mask; ; slot = (slot + 1) & mask)
+	{
+		unsigned int i = HashTable[slot];
+		if (i == NO_ENTRY)
+		{
+			return -1;
+		}
+		if (i != DELETED_ENTRY)
 		{
-			return i;
+			PoolEntry *entry = &Pool[i];
+			assert(entry->Slot == slot);
+			if (entry->Hash == h && entry->Str.Len() == len &&
+				memcmp(entry->Str.GetChars(), str, len) == 0)
+			{
+				// Whoever asked for it is going to hold on to it.
+				if (i >= SweepPos && i < SweepEnd)
+				{
+					entry->Mark = SweepEpoch;
+				}
+				return i;
+			}
 		}
-		i = entry->Next;
 	}
-	return -1;
 }
 
 //============================================================================
@@ -718,12 +802,12 @@ int ACSStringPool::FindString(const char *str, size_t len, unsigned int h, unsig
 //
 //============================================================================
 
-int ACSStringPool::InsertString(FString &str, unsigned int h, unsigned int bucketnum, const SDWORD *stack, int stackdepth)
+int ACSStringPool::InsertString(FString &str, unsigned int h, const SDWORD *stack, int stackdepth)
 {
 	unsigned int index = FirstFreeEntry;
 	if (index >= MIN_GC_SIZE && index == Pool.Max())
 	{ // We will need to grow the array. Try a garbage collection first.
-		P_CollectACSGlobalStrings(stack, stackdepth);
+		StartCollection(stack, stackdepth);
 		index = FirstFreeEntry;
 	}
 	if (FirstFreeEntry >= STRPOOL_LIBRARYID_OR)
@@ -742,12 +826,105 @@ int ACSStringPool::InsertString(FString &str, unsigned int h, unsigned int bucke
 	PoolEntry *entry = &Pool[index];
 	entry->Str = str;
 	entry->Hash = h;
-	entry->Next = PoolBuckets[bucketnum];
 	entry->LockCount = 0;
-	PoolBuckets[bucketnum] = index;
+	entry->Mark = (index >= SweepPos && index < SweepEnd) ? SweepEpoch : 0;
+	entry->Slot = FREE_ENTRY;
+	LinkEntry(index);
+	Nursery.Push(index);
 	return index | STRPOOL_LIBRARYID_OR;
 }
 
+//============================================================================
+//
+// ACSStringPool :: LinkEntry
+//
+// Adds a pool entry to the hash table.
+//
+//============================================================================
+
+void ACSStringPool::LinkEntry(unsigned int index)
+{
+	if ((HashUsed + 1) * 4 > HashTable.Size() * 3)
+	{
+		Rehash((NumStrings + 1) * 2);
+	}
+
+	PoolEntry *entry = &Pool[index];
+	unsigned int mask = HashTable.Size() - 1;
+	unsigned int slot = entry->Hash & mask;
+
+	while (HashTable[slot] != NO_ENTRY && HashTable[slot] != DELETED_ENTRY)
+	{
+		slot = (slot + 1) & mask;
+	}
+	if (HashTable[slot] == NO_ENTRY)
+	{
+		HashUsed++;
+	}
+	HashTable[slot] = index;
+	entry->Slot = slot;
+	NumStrings++;
+}
+
+//============================================================================
+//
+// ACSStringPool :: FreeEntry
+//
+//============================================================================
+
+void ACSStringPool::FreeEntry(unsigned int index)
+{
+	PoolEntry *entry = &Pool[index];
+
+	HashTable[entry->Slot] = DELETED_ENTRY;
+	entry->Slot = FREE_ENTRY;
+	entry->Str = "";
+	NumStrings--;
+	if (index < FirstFreeEntry)
+	{
+		FirstFreeEntry = index;
+	}
+}
+
+//============================================================================
+//
+// ACSStringPool :: Rehash
+//
+// Rebuilds the hash table with room for at least size entries, dropping
+// the slots of deleted strings.
+//
+//============================================================================
+
+void ACSStringPool::Rehash(unsigned int size)
+{
+	unsigned int newsize = MIN_TABLE_SIZE;
+
+	while (newsize < size)
+	{
+		newsize <<= 1;
+	}
+	HashTable.Resize(newsize);
+	memset(&HashTable[0], 0xFF, newsize * sizeof(unsigned int));
+	HashUsed = 0;
+	NumStrings = 0;
+
+	for (unsigned int i = 0; i < Pool.Size(); ++i)
+	{
+		if (Pool[i].Slot != FREE_ENTRY)
+		{
+			unsigned int slot = Pool[i].Hash & (newsize - 1);
+			while (HashTable[slot] != NO_ENTRY)
+			{
+				slot = (slot + 1) & (newsize - 1);
+			}
+			HashTable[slot] = i;
+			Pool[i].Slot = slot;
+			HashUsed++;
+			NumStrings++;
+		}
+	}
+}
+
 //============================================================================
 //
 // ACSStringPool :: FindFirstFreeEntry
@@ -758,7 +935,7 @@ int ACSStringPool::InsertString(FString &str, unsigned int h, unsigned int bucke
 
 void ACSStringPool::FindFirstFreeEntry(unsigned base)
 {
-	while (base < Pool.Size() && Pool[base].Next != FREE_ENTRY)
+	while (base < Pool.Size() && Pool[base].Slot != FREE_ENTRY)
 	{
 		base++;
 	}
@@ -781,40 +958,59 @@ void ACSStringPool::ReadStrings(PNGHandle *png, DWORD id)
 	if (len != 0)
 	{
 		FPNGChunkArchive arc(png->File->GetFile(), id, len);
-		int32 i, j, poolsize;
-		unsigned int h, bucketnum;
-		char *str = NULL;
+		ReadStrings(arc);
+	}
+}
 
-		arc << poolsize;
+//============================================================================
+//
+// ACSStringPool :: ReadStrings
+//
+// Reads the strings written by WriteStrings into the cleared pool.
+//
+//============================================================================
+
+void ACSStringPool::ReadStrings(FArchive &arc)
+{
+	int32 i, j, poolsize;
+	char *str = NULL;
+
+	arc << poolsize;
 
-		Pool.Resize(poolsize);
-		i = 0;
+	Pool.Resize(poolsize);
+	i = 0;
+	j = arc.ReadCount();
+	while (j >= 0)
+	{
+		// Mark skipped entries as free
+		for (; i < j; ++i)
+		{
+			Pool[i].Slot = FREE_ENTRY;
+			Pool[i].LockCount = 0;
+			Pool[i].Mark = 0;
+		}
+		arc << str;
+		Pool[i].Str = str;
+		Pool[i].Hash = SuperFastHash(str, strlen(str));
+		Pool[i].LockCount = arc.ReadCount();
+		Pool[i].Mark = 0;
+		Pool[i].Slot = 0;
+		i++;
 		j = arc.ReadCount();
-		while (j >= 0)
-		{
-			// Mark skipped entries as free
-			for (; i < j; ++i)
-			{
-				Pool[i].Next = FREE_ENTRY;
-				Pool[i].LockCount = 0;
-			}
-			arc << str;
-			h = SuperFastHash(str, strlen(str));
-			bucketnum = h % NUM_BUCKETS;
-			Pool[i].Str = str;
-			Pool[i].Hash = h;
-			Pool[i].LockCount = arc.ReadCount();
-			Pool[i].Next = PoolBuckets[bucketnum];
-			PoolBuckets[bucketnum] = i;
-			i++;
-			j = arc.ReadCount();
-		}
-		if (str != NULL)
-		{
-			delete[] str;
-		}
-		FindFirstFreeEntry(0);
 	}
+	// Entries after the last string are free, too.
+	for (; i < poolsize; ++i)
+	{
+		Pool[i].Slot = FREE_ENTRY;
+		Pool[i].LockCount = 0;
+		Pool[i].Mark = 0;
+	}
+	if (str != NULL)
+	{
+		delete[] str;
+	}
+	Rehash(poolsize * 2);
+	FindFirstFreeEntry(0);
 }
 
 //============================================================================
@@ -827,19 +1023,31 @@ void ACSStringPool::ReadStrings(PNGHandle *png, DWORD id)
 
 void ACSStringPool::WriteStrings(FILE *file, DWORD id) const
 {
-	int32 i, poolsize = (int32)Pool.Size();
-	
-	if (poolsize == 0)
+	if (Pool.Size() == 0)
 	{ // No need to write if we don't have anything.
 		return;
 	}
 	FPNGChunkArchive arc(file, id);
+	WriteStrings(arc);
+}
+
+//============================================================================
+//
+// ACSStringPool :: WriteStrings
+//
+// Writes the pool size, then the index, text and lock count of every string.
+//
+//============================================================================
+
+void ACSStringPool::WriteStrings(FArchive &arc) const
+{
+	int32 i, poolsize = (int32)Pool.Size();
 
 	arc << poolsize;
 	for (i = 0; i < poolsize; ++i)
 	{
 		PoolEntry *entry = &Pool[i];
-		if (entry->Next != FREE_ENTRY)
+		if (entry->Slot != FREE_ENTRY)
 		{
 			arc.WriteCount(i);
 			arc.WriteString(entry->Str);
@@ -849,6 +1057,28 @@ void ACSStringPool::WriteStrings(FILE *file, DWORD id) const
 	arc.WriteCount(-1);
 }
 
+//============================================================================
+//
+// ACSStringPool :: Serialize
+//
+// Archives the whole pool, e.g. for the keyframes of client demos, so that
+// the string numbers stored elsewhere in the archive stay valid.
+//
+//============================================================================
+
+void ACSStringPool::Serialize(FArchive &arc)
+{
+	if (arc.IsStoring())
+	{
+		WriteStrings(arc);
+	}
+	else
+	{
+		Clear();
+		ReadStrings(arc);
+	}
+}
+
 //============================================================================
 //
 // ACSStringPool :: Dump
@@ -861,7 +1091,7 @@ void ACSStringPool::Dump() const
 {
 	for (unsigned int i = 0; i < Pool.Size(); ++i)
 	{
-		if (Pool[i].Next != FREE_ENTRY)
+		if (Pool[i].Slot != FREE_ENTRY)
 		{
 			Printf("%4u. (%2d) \"%s\"\n", i, Pool[i].LockCount, Pool[i].Str.GetChars());
 		}
@@ -926,13 +1156,13 @@ void P_MarkGlobalVarStrings()
 
 //============================================================================
 //
-// P_CollectACSGlobalStrings
+// P_MarkACSGlobalStrings
 //
-// Garbage collect ACS global strings.
+// Marks every ACS global string that may still be referenced.
 //
 //============================================================================
 
-void P_CollectACSGlobalStrings(const SDWORD *stack, int stackdepth)
+void P_MarkACSGlobalStrings(const SDWORD *stack, int stackdepth)
 {
 	if (stack != NULL && stackdepth != 0)
 	{
@@ -941,9 +1171,48 @@ void P_CollectACSGlobalStrings(const SDWORD *stack, int stackdepth)
 	FBehavior::StaticMarkLevelVarStrings();
 	P_MarkWorldVarStrings();
 	P_MarkGlobalVarStrings();
+}
+
+//============================================================================
+//
+// P_CollectACSGlobalStrings
+//
+// Garbage collect ACS global strings.
+//
+//============================================================================
+
+void P_CollectACSGlobalStrings(const SDWORD *stack, int stackdepth)
+{
+	P_MarkACSGlobalStrings(stack, stackdepth);
 	GlobalACSStrings.PurgeStrings();
 }
 
+//============================================================================
+//
+// ACSStringPool :: GetStats
+//
+//============================================================================
+
+FString ACSStringPool::GetStats() const
+{
+	FString out;
+
+	out.Format("%u strings in %u entries, hash %u/%u, %u young, ",
+		NumStrings, Pool.Size(), HashUsed, HashTable.Size(), Nursery.Size());
+	if (SweepPos < SweepEnd)
+	{
+		out.AppendFormat("sweeping %u/%u, ", SweepPos, SweepEnd);
+	}
+	out.AppendFormat("%u collections, last freed %u young + %u old",
+		NumCollections, LastYoungFreed, LastOldFreed);
+	return out;
+}
+
+ADD_STAT(acsstrings)
+{
+	return GlobalACSStrings.GetStats();
+}
+
 #ifdef _DEBUG
 CCMD(acsgc)
 {
@@ -2260,6 +2529,7 @@ FBehavior::FBehavior (int lumpnum, FileReader * fr, int len)
 	memset (MapVarStore, 0, sizeof(MapVarStore));
 	ModuleName[0] = 0;
 	FunctionProfileData = NULL;
+	FastCodeFull = false;
 	// Now that everything is set up, record this module as being among the loaded modules.
 	// We need to do this before resolving any imports, because an import might (indirectly)
 	// need to resolve exports in this module. The only things that can be exported are
@@ -2674,6 +2944,8 @@ FBehavior::FBehavior (int lumpnum, FileReader * fr, int len)
 		}
 	}
 
+	DecodeScripts ();
+
 	DPrintf ("Loaded %d scripts, %d functions\n", NumScripts, NumFunctions);
 }
 
@@ -2979,6 +3251,363 @@ void FBehavior::UnescapeStringTable(BYTE *chunkstart, BYTE *datastart, bool has_
 	}
 }
 
+//============================================================================
+//
+// FBehavior :: DecodeScripts
+//
+// Decodes the code reachable from every script and function entry point
+// for DLevelScript::RunFastCode. Whatever follows a p-code that has to
+// go through RunScript's switch is decoded the first time it's reached.
+//
+//============================================================================
+
+void FBehavior::DecodeScripts ()
+{
+	int i;
+
+	for (i = 0; i < NumScripts; ++i)
+	{
+		if (Scripts[i].Address < (DWORD)DataSize)
+		{
+			DecodeFastCode (Scripts[i].Address);
+		}
+	}
+	for (i = 0; i < NumFunctions; ++i)
+	{
+		ScriptFunction *func = &((ScriptFunction *)Functions)[i];
+
+		if (func->ImportNum == 0 && func->Address != 0 && func->Address < (DWORD)DataSize)
+		{
+			DecodeFastCode (func->Address);
+		}
+	}
+}
+
+//============================================================================
+//
+// FBehavior :: GetFastCode
+//
+// Returns the decoded instruction for the p-code at pc, or NULL if pc is
+// outside of this module or can't be decoded anymore.
+//
+//============================================================================
+
+const FACSInstruction *FBehavior::GetFastCode (int *pc)
+{
+	DWORD ofs = PC2Ofs (pc);
+
+	if (ofs >= (DWORD)DataSize)
+	{
+		return NULL;
+	}
+	if (FastCodeIndex.Size() != 0 && FastCodeIndex[ofs] != 0)
+	{
+		return &FastCode[FastCodeIndex[ofs] - 1];
+	}
+
+	int index = DecodeFastCode (ofs);
+	return index < 0 ? NULL : &FastCode[index];
+}
+
+//============================================================================
+//
+// FBehavior :: DecodeFastCode
+//
+// Decodes the p-codes starting at ofs up to the next one RunFastCode can't
+// handle, and everything those jump to. Returns the index of the first
+// instruction, or -1 if there are too many instructions for FastCodeIndex.
+//
+//============================================================================
+
+int FBehavior::DecodeFastCode (DWORD ofs)
+{
+	TArray<DWORD> pending;
+	TArray<int> fixups;
+	TArray<DWORD> decoded;
+	DWORD start;
+	const unsigned int oldsize = FastCode.Size();
+
+	if (FastCodeFull)
+	{
+		return -1;
+	}
+	if (FastCodeIndex.Size() == 0)
+	{
+		FastCodeIndex.Resize (DataSize);
+		memset (&FastCodeIndex[0], 0, DataSize * sizeof(WORD));
+	}
+
+	pending.Push (ofs);
+	while (pending.Pop (start))
+	{
+		DWORD pos = start;
+
+		while (true)
+		{
+			FACSInstruction insn;
+			DWORD next = pos;
+			DWORD target = ~0u;
+			bool fast;
+
+			if (FastCode.Size() >= 0xFFFF)
+			{
+				// Undo this call, so that every decoded jump still has its target.
+				for (unsigned int i = 0; i < decoded.Size(); ++i)
+				{
+					FastCodeIndex[decoded[i]] = 0;
+				}
+				FastCode.Resize (oldsize);
+				FastCodeFull = true;
+				return -1;
+			}
+			if (pos < (DWORD)DataSize && FastCodeIndex[pos] != 0)
+			{
+				// Already decoded: continue there.
+				if (pos != start)
+				{
+					insn.Op = AFX_Jump;
+					insn.Count = 0;
+					insn.Pad = 0;
+					insn.Ofs = pos;
+					insn.Arg = 0;
+					insn.Target = FastCodeIndex[pos] - 1;
+					FastCode.Push (insn);
+				}
+				break;
+			}
+
+			fast = pos < (DWORD)DataSize && DecodeInstruction (next, insn, target);
+			if (fast && target != ~0u && target >= (DWORD)DataSize)
+			{
+				fast = false;
+			}
+			if (!fast)
+			{
+				insn.Op = AFX_Slow;
+				insn.Count = 0;
+				insn.Arg = 0;
+				insn.Target = 0;
+			}
+			insn.Pad = 0;
+			insn.Ofs = pos;
+
+			int index = FastCode.Push (insn);
+			if (pos < (DWORD)DataSize)
+			{
+				FastCodeIndex[pos] = (WORD)(index + 1);
+				decoded.Push (pos);
+			}
+			if (!fast)
+			{
+				break;
+			}
+			if (target != ~0u)
+			{
+				// Resolved to an instruction index once everything is decoded.
+				FastCode[index].Target = target;
+				fixups.Push (index);
+				pending.Push (target);
+			}
+			if (insn.Op == AFX_Goto)
+			{
+				break;
+			}
+			pos = next;
+		}
+	}
+
+	for (unsigned int i = 0; i < fixups.Size(); ++i)
+	{
+		FACSInstruction &insn = FastCode[fixups[i]];
+		insn.Target = FastCodeIndex[insn.Target] - 1;
+	}
+	return FastCodeIndex[ofs] - 1;
+}
+
+//============================================================================
+//
+// FBehavior :: DecodeArg
+//
+// Reads an operand the way NEXTBYTE (isbyte) or NEXTWORD would.
+//
+//============================================================================
+
+bool FBehavior::DecodeArg (DWORD &ofs, bool isbyte, SDWORD &arg) const
+{
+	if (isbyte && Format == ACS_LittleEnhanced)
+	{
+		if (ofs + 1 > (DWORD)DataSize)
+		{
+			return false;
+		}
+		arg = Data[ofs];
+		ofs += 1;
+	}
+	else
+	{
+		if (ofs + 4 > (DWORD)DataSize)
+		{
+			return false;
+		}
+		arg = LittleLong (*(SDWORD *)(Data + ofs));
+		ofs += 4;
+	}
+	return true;
+}
+
+//============================================================================
+//
+// FBehavior :: DecodeInstruction
+//
+// Decodes the p-code at ofs into insn and advances ofs past it. target is
+// set to the offset it may jump to. Returns false for p-codes that
+// RunFastCode doesn't handle.
+//
+//============================================================================
+
+bool FBehavior::DecodeInstruction (DWORD &ofs, FACSInstruction &insn, DWORD &target) const
+{
+	int pcd;
+	SDWORD arg;
+
+	insn.Count = 0;
+	insn.Arg = 0;
+	insn.Target = 0;
+
+	if (Format == ACS_LittleEnhanced)
+	{
+		if (ofs >= (DWORD)DataSize)
+		{
+			return false;
+		}
+		pcd = Data[ofs++];
+		if (pcd >= 256-16)
+		{
+			if (ofs >= (DWORD)DataSize)
+			{
+				return false;
+			}
+			pcd = (256-16) + ((pcd - (256-16)) << 8) + Data[ofs++];
+		}
+	}
+	else if (!DecodeArg (ofs, false, pcd))
+	{
+		return false;
+	}
+
+	switch (pcd)
+	{
+	case DLevelScript::PCD_PUSHNUMBER:
+		insn.Op = AFX_PushNumber;
+		return DecodeArg (ofs, false, insn.Arg);
+
+	case DLevelScript::PCD_PUSHBYTE:
+		if (ofs >= (DWORD)DataSize)
+		{
+			return false;
+		}
+		insn.Op = AFX_PushNumber;
+		insn.Arg = Data[ofs++];
+		return true;
+
+	case DLevelScript::PCD_PUSH2BYTES:
+	case DLevelScript::PCD_PUSH3BYTES:
+	case DLevelScript::PCD_PUSH4BYTES:
+	case DLevelScript::PCD_PUSH5BYTES:
+		insn.Op = AFX_PushBytes;
+		insn.Count = pcd - DLevelScript::PCD_PUSH2BYTES + 2;
+		insn.Target = ofs;
+		ofs += insn.Count;
+		return ofs <= (DWORD)DataSize;
+
+	case DLevelScript::PCD_PUSHBYTES:
+		if (ofs >= (DWORD)DataSize)
+		{
+			return false;
+		}
+		insn.Op = AFX_PushBytes;
+		insn.Count = Data[ofs];
+		insn.Target = ofs + 1;
+		ofs += insn.Count + 1;
+		return ofs <= (DWORD)DataSize;
+
+	case DLevelScript::PCD_GOTO:			insn.Op = AFX_Goto; break;
+	case DLevelScript::PCD_IFGOTO:			insn.Op = AFX_IfGoto; break;
+	case DLevelScript::PCD_IFNOTGOTO:		insn.Op = AFX_IfNotGoto; break;
+
+	case DLevelScript::PCD_CASEGOTO:
+		insn.Op = AFX_CaseGoto;
+		if (!DecodeArg (ofs, false, insn.Arg))
+		{
+			return false;
+		}
+		break;
+
+	case DLevelScript::PCD_DUP:				insn.Op = AFX_Dup; return true;
+	case DLevelScript::PCD_SWAP:			insn.Op = AFX_Swap; return true;
+	case DLevelScript::PCD_DROP:			insn.Op = AFX_Drop; return true;
+	case DLevelScript::PCD_ADD:				insn.Op = AFX_Add; return true;
+	case DLevelScript::PCD_SUBTRACT:		insn.Op = AFX_Subtract; return true;
+	case DLevelScript::PCD_MULTIPLY:		insn.Op = AFX_Multiply; return true;
+	case DLevelScript::PCD_DIVIDE:			insn.Op = AFX_Divide; return true;
+	case DLevelScript::PCD_MODULUS:			insn.Op = AFX_Modulus; return true;
+	case DLevelScript::PCD_EQ:				insn.Op = AFX_EQ; return true;
+	case DLevelScript::PCD_NE:				insn.Op = AFX_NE; return true;
+	case DLevelScript::PCD_LT:				insn.Op = AFX_LT; return true;
+	case DLevelScript::PCD_GT:				insn.Op = AFX_GT; return true;
+	case DLevelScript::PCD_LE:				insn.Op = AFX_LE; return true;
+	case DLevelScript::PCD_GE:				insn.Op = AFX_GE; return true;
+	case DLevelScript::PCD_ANDLOGICAL:		insn.Op = AFX_AndLogical; return true;
+	case DLevelScript::PCD_ORLOGICAL:		insn.Op = AFX_OrLogical; return true;
+	case DLevelScript::PCD_ANDBITWISE:		insn.Op = AFX_AndBitwise; return true;
+	case DLevelScript::PCD_ORBITWISE:		insn.Op = AFX_OrBitwise; return true;
+	case DLevelScript::PCD_EORBITWISE:		insn.Op = AFX_EorBitwise; return true;
+	case DLevelScript::PCD_LSHIFT:			insn.Op = AFX_LShift; return true;
+	case DLevelScript::PCD_RSHIFT:			insn.Op = AFX_RShift; return true;
+	case DLevelScript::PCD_NEGATELOGICAL:	insn.Op = AFX_NegateLogical; return true;
+	case DLevelScript::PCD_NEGATEBINARY:	insn.Op = AFX_NegateBinary; return true;
+	case DLevelScript::PCD_UNARYMINUS:		insn.Op = AFX_UnaryMinus; return true;
+
+	case DLevelScript::PCD_PUSHSCRIPTVAR:	insn.Op = AFX_PushScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_PUSHMAPVAR:		insn.Op = AFX_PushMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_PUSHWORLDVAR:	insn.Op = AFX_PushWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_PUSHGLOBALVAR:	insn.Op = AFX_PushGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ASSIGNSCRIPTVAR:	insn.Op = AFX_AssignScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ASSIGNMAPVAR:	insn.Op = AFX_AssignMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ASSIGNWORLDVAR:	insn.Op = AFX_AssignWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ASSIGNGLOBALVAR:	insn.Op = AFX_AssignGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ADDSCRIPTVAR:	insn.Op = AFX_AddScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ADDMAPVAR:		insn.Op = AFX_AddMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ADDWORLDVAR:		insn.Op = AFX_AddWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_ADDGLOBALVAR:	insn.Op = AFX_AddGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_SUBSCRIPTVAR:	insn.Op = AFX_SubScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_SUBMAPVAR:		insn.Op = AFX_SubMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_SUBWORLDVAR:		insn.Op = AFX_SubWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_SUBGLOBALVAR:	insn.Op = AFX_SubGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_INCSCRIPTVAR:	insn.Op = AFX_IncScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_INCMAPVAR:		insn.Op = AFX_IncMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_INCWORLDVAR:		insn.Op = AFX_IncWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_INCGLOBALVAR:	insn.Op = AFX_IncGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_DECSCRIPTVAR:	insn.Op = AFX_DecScriptVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_DECMAPVAR:		insn.Op = AFX_DecMapVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_DECWORLDVAR:		insn.Op = AFX_DecWorldVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_DECGLOBALVAR:	insn.Op = AFX_DecGlobalVar; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_PUSHWORLDARRAY:	insn.Op = AFX_PushWorldArray; return DecodeArg (ofs, true, insn.Arg);
+	case DLevelScript::PCD_PUSHGLOBALARRAY:	insn.Op = AFX_PushGlobalArray; return DecodeArg (ofs, true, insn.Arg);
+
+	default:
+		return false;
+	}
+
+	// Jumps: the target is always a full word.
+	if (!DecodeArg (ofs, false, arg))
+	{
+		return false;
+	}
+	target = arg;
+	return true;
+}
+
 //============================================================================
 //
 // FBehavior :: IsGood
@@ -3215,6 +3844,49 @@ const char *FBehavior::LookupString (DWORD index) const
 	}
 }
 
+FBaseCVar *FBehavior::StaticLookupCVar (DWORD index)
+{
+	DWORD lib = index >> LIBRARYID_SHIFT;
+
+	// Strings from the dynamic pool come and go, so only the string
+	// tables of the modules get their lookups cached.
+	if (lib == STRPOOL_LIBRARYID)
+	{
+		return FindCVar (GlobalACSStrings.GetString(index), NULL);
+	}
+	if (lib >= (DWORD)StaticModules.Size())
+	{
+		return NULL;
+	}
+	return StaticModules[lib]->LookupCVar (index & 0xffff);
+}
+
+FBaseCVar *FBehavior::LookupCVar (DWORD index)
+{
+	if (index < CVarHandles.Size() && CVarHandles[index].Generation == CVarGeneration)
+	{
+		return CVarHandles[index].CVar;
+	}
+
+	const char *name = LookupString (index);
+	if (name == NULL)
+	{
+		return NULL;
+	}
+
+	if (index >= CVarHandles.Size())
+	{
+		CVarHandle empty = { NULL, 0 };
+		while (index >= CVarHandles.Size())
+		{
+			CVarHandles.Push (empty);
+		}
+	}
+	CVarHandles[index].CVar = FindCVar (name, NULL);
+	CVarHandles[index].Generation = CVarGeneration;
+	return CVarHandles[index].CVar;
+}
+
 void FBehavior::StaticStartTypedScripts (WORD type, AActor *activator, bool always, int arg1, bool runNow, bool onlyClientSideScripts, int arg2, int arg3) // [BB] Added arg2+arg3
 {
 	static const char *const TypeNames[] =
@@ -3470,6 +4142,7 @@ void DACSThinker::Tick ()
 	}
 
 //	GlobalACSStrings.Clear();
+	GlobalACSStrings.SweepStrings(ACSStringPool::SWEEP_STEP);
 
 	if (ACS_StringBuilderStack.Size())
 	{
@@ -5748,9 +6421,9 @@ static int GetUserCVar(int playernum, const char *cvarname, bool is_string, cons
 	return DoGetCVar(cvar, is_string, stack, stackdepth);
 }
 
-static int GetCVar(AActor *activator, const char *cvarname, bool is_string, const SDWORD *stack, int stackdepth)
+static int GetCVar(AActor *activator, int strnum, bool is_string, const SDWORD *stack, int stackdepth)
 {
-	FBaseCVar *cvar = FindCVar(cvarname, NULL);
+	FBaseCVar *cvar = FBehavior::StaticLookupCVar(strnum);
 	// Either the cvar doesn't exist, or it's for a mod that isn't loaded, so return 0.
 	if (cvar == NULL || (cvar->GetFlags() & CVAR_IGNORE))
 	{
@@ -5766,11 +6439,11 @@ static int GetCVar(AActor *activator, const char *cvarname, bool is_string, cons
 				// [BB] Compatibility with Zandronum 2.x: In CLIENTSIDE scripts,
 				// return the value belonging to the consoleplayer
 				if ( NETWORK_InClientMode() ) 
-					return GetUserCVar(consoleplayer, cvarname, is_string, stack, stackdepth);
+					return GetUserCVar(consoleplayer, cvar->GetName(), is_string, stack, stackdepth);
 
 				return 0;
 			}
-			return GetUserCVar(int(activator->player - players), cvarname, is_string, stack, stackdepth);
+			return GetUserCVar(int(activator->player - players), cvar->GetName(), is_string, stack, stackdepth);
 		}
 		return DoGetCVar(cvar, is_string, stack, stackdepth);
 	}
@@ -5806,9 +6479,9 @@ static int SetUserCVar(int playernum, const char *cvarname, int value, bool is_s
 	return 1;
 }
 
-static int SetCVar(AActor *activator, const char *cvarname, int value, bool is_string)
+static int SetCVar(AActor *activator, int strnum, int value, bool is_string)
 {
-	FBaseCVar *cvar = FindCVar(cvarname, NULL);
+	FBaseCVar *cvar = FBehavior::StaticLookupCVar(strnum);
 	// Only mod-created cvars may be set.
 	if (cvar == NULL || (cvar->GetFlags() & (CVAR_IGNORE|CVAR_NOSET)) || !(cvar->GetFlags() & CVAR_MOD))
 	{
@@ -5821,7 +6494,7 @@ static int SetCVar(AActor *activator, const char *cvarname, int value, bool is_s
 		{
 			return 0;
 		}
-		return SetUserCVar(int(activator->player - players), cvarname, value, is_string);
+		return SetUserCVar(int(activator->player - players), cvar->GetName(), value, is_string);
 	}
 	DoSetCVar(cvar, value, is_string);
 	return 1;
@@ -6449,21 +7122,21 @@ int DLevelScript::CallFunction(int argCount, int funcIndex, SDWORD *args, const
 		case ACSF_GetCVarString:
 			if (argCount == 1)
 			{
-				return GetCVar(activator, FBehavior::StaticLookupString(args[0]), true, stack, stackdepth);
+				return GetCVar(activator, args[0], true, stack, stackdepth);
 			}
 			break;
 
 		case ACSF_SetCVar:
 			if (argCount == 2)
 			{
-				return SetCVar(activator, FBehavior::StaticLookupString(args[0]), args[1], false);
+				return SetCVar(activator, args[0], args[1], false);
 			}
 			break;
 
 		case ACSF_SetCVarString:
 			if (argCount == 2)
 			{
-				return SetCVar(activator, FBehavior::StaticLookupString(args[0]), args[1], true);
+				return SetCVar(activator, args[0], args[1], true);
 			}
 			break;
 
@@ -8106,6 +8779,204 @@ inline int getshort (int *&pc)
 	return res;
 }
 
+//============================================================================
+//
+// DLevelScript :: RunFastCode
+//
+// Runs pre-decoded p-codes until one comes up that has to go through
+// RunScript's switch, then returns the pc of that p-code. Every p-code
+// run here counts towards the runaway limit just like in RunScript.
+//
+//============================================================================
+
+#if defined(__GNUC__)
+#define ACS_THREADED_DISPATCH
+#endif
+
+#ifdef ACS_THREADED_DISPATCH
+#define FAST_LABEL(x)	op_##x:
+#define FAST_NEXT		goto *dispatch[insn->Op]
+#else
+#define FAST_LABEL(x)	case AFX_##x:
+#define FAST_NEXT		continue
+#endif
+#define FAST_COUNT		if (runaway >= ACS_RUNAWAY_LIMIT) goto bail; ++runaway
+#define FAST_OP(x)		FAST_LABEL(x) FAST_COUNT;
+
+int *DLevelScript::RunFastCode (const FACSInstruction *insn, SDWORD *Stack, int &sp, SDWORD *locals, unsigned int &runaway)
+{
+	const FACSInstruction *code = activeBehavior->GetFastCodeStart ();
+	int temp;
+
+#ifdef ACS_THREADED_DISPATCH
+	static const void *const dispatch[NUM_AFX] =
+	{
+		&&op_Slow, &&op_Jump, &&op_PushNumber, &&op_PushBytes,
+		&&op_Dup, &&op_Swap, &&op_Drop,
+		&&op_Add, &&op_Subtract, &&op_Multiply, &&op_Divide, &&op_Modulus,
+		&&op_EQ, &&op_NE, &&op_LT, &&op_GT, &&op_LE, &&op_GE,
+		&&op_AndLogical, &&op_OrLogical, &&op_AndBitwise, &&op_OrBitwise, &&op_EorBitwise,
+		&&op_LShift, &&op_RShift, &&op_NegateLogical, &&op_NegateBinary, &&op_UnaryMinus,
+		&&op_PushScriptVar, &&op_PushMapVar, &&op_PushWorldVar, &&op_PushGlobalVar,
+		&&op_AssignScriptVar, &&op_AssignMapVar, &&op_AssignWorldVar, &&op_AssignGlobalVar,
+		&&op_AddScriptVar, &&op_AddMapVar, &&op_AddWorldVar, &&op_AddGlobalVar,
+		&&op_SubScriptVar, &&op_SubMapVar, &&op_SubWorldVar, &&op_SubGlobalVar,
+		&&op_IncScriptVar, &&op_IncMapVar, &&op_IncWorldVar, &&op_IncGlobalVar,
+		&&op_DecScriptVar, &&op_DecMapVar, &&op_DecWorldVar, &&op_DecGlobalVar,
+		&&op_PushWorldArray, &&op_PushGlobalArray,
+		&&op_Goto, &&op_IfGoto, &&op_IfNotGoto, &&op_CaseGoto,
+	};
+
+	FAST_NEXT;
+#else
+	for (;;) switch (insn->Op)
+	{
+	default:
+#endif
+	FAST_LABEL(Slow)
+bail:
+		return activeBehavior->Ofs2PC (insn->Ofs);
+
+	FAST_LABEL(Jump)
+		insn = code + insn->Target;
+		FAST_NEXT;
+
+	FAST_OP(PushNumber)
+		PushToStack (insn->Arg);
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(PushBytes)
+		for (temp = 0; temp < insn->Count; temp++)
+		{
+			PushToStack (*((BYTE *)activeBehavior->Ofs2PC (insn->Target) + temp));
+		}
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(Dup)
+		Stack[sp] = Stack[sp-1];
+		sp++;
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(Swap)
+		swapvalues(Stack[sp-2], Stack[sp-1]);
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(Drop)
+		sp--;
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(Add)			STACK(2) = STACK(2) + STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(Subtract)		STACK(2) = STACK(2) - STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(Multiply)		STACK(2) = STACK(2) * STACK(1); sp--; insn++; FAST_NEXT;
+
+	FAST_LABEL(Divide)
+		// Division by zero is reported by RunScript.
+		if (STACK(1) == 0) goto bail;
+		FAST_COUNT;
+		STACK(2) = STACK(2) / STACK(1);
+		sp--;
+		insn++;
+		FAST_NEXT;
+
+	FAST_LABEL(Modulus)
+		if (STACK(1) == 0) goto bail;
+		FAST_COUNT;
+		STACK(2) = STACK(2) % STACK(1);
+		sp--;
+		insn++;
+		FAST_NEXT;
+
+	FAST_OP(EQ)				STACK(2) = (STACK(2) == STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(NE)				STACK(2) = (STACK(2) != STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(LT)				STACK(2) = (STACK(2) < STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(GT)				STACK(2) = (STACK(2) > STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(LE)				STACK(2) = (STACK(2) <= STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(GE)				STACK(2) = (STACK(2) >= STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(AndLogical)		STACK(2) = (STACK(2) && STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(OrLogical)		STACK(2) = (STACK(2) || STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(AndBitwise)		STACK(2) = (STACK(2) & STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(OrBitwise)		STACK(2) = (STACK(2) | STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(EorBitwise)		STACK(2) = (STACK(2) ^ STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(LShift)			STACK(2) = (STACK(2) << STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(RShift)			STACK(2) = (STACK(2) >> STACK(1)); sp--; insn++; FAST_NEXT;
+	FAST_OP(NegateLogical)	STACK(1) = !STACK(1); insn++; FAST_NEXT;
+	FAST_OP(NegateBinary)	STACK(1) = ~STACK(1); insn++; FAST_NEXT;
+	FAST_OP(UnaryMinus)		STACK(1) = -STACK(1); insn++; FAST_NEXT;
+
+	FAST_OP(PushScriptVar)	PushToStack (locals[insn->Arg]); insn++; FAST_NEXT;
+	FAST_OP(PushMapVar)		PushToStack (*(activeBehavior->MapVars[insn->Arg])); insn++; FAST_NEXT;
+	FAST_OP(PushWorldVar)	PushToStack (ACS_WorldVars[insn->Arg]); insn++; FAST_NEXT;
+	FAST_OP(PushGlobalVar)	PushToStack (ACS_GlobalVars[insn->Arg]); insn++; FAST_NEXT;
+
+	FAST_OP(AssignScriptVar)	locals[insn->Arg] = STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AssignMapVar)		*(activeBehavior->MapVars[insn->Arg]) = STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AssignWorldVar)		ACS_WorldVars[insn->Arg] = STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AssignGlobalVar)	ACS_GlobalVars[insn->Arg] = STACK(1); sp--; insn++; FAST_NEXT;
+
+	FAST_OP(AddScriptVar)	locals[insn->Arg] += STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AddMapVar)		*(activeBehavior->MapVars[insn->Arg]) += STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AddWorldVar)	ACS_WorldVars[insn->Arg] += STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(AddGlobalVar)	ACS_GlobalVars[insn->Arg] += STACK(1); sp--; insn++; FAST_NEXT;
+
+	FAST_OP(SubScriptVar)	locals[insn->Arg] -= STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(SubMapVar)		*(activeBehavior->MapVars[insn->Arg]) -= STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(SubWorldVar)	ACS_WorldVars[insn->Arg] -= STACK(1); sp--; insn++; FAST_NEXT;
+	FAST_OP(SubGlobalVar)	ACS_GlobalVars[insn->Arg] -= STACK(1); sp--; insn++; FAST_NEXT;
+
+	FAST_OP(IncScriptVar)	++locals[insn->Arg]; insn++; FAST_NEXT;
+	FAST_OP(IncMapVar)		*(activeBehavior->MapVars[insn->Arg]) += 1; insn++; FAST_NEXT;
+	FAST_OP(IncWorldVar)	++ACS_WorldVars[insn->Arg]; insn++; FAST_NEXT;
+	FAST_OP(IncGlobalVar)	++ACS_GlobalVars[insn->Arg]; insn++; FAST_NEXT;
+
+	FAST_OP(DecScriptVar)	--locals[insn->Arg]; insn++; FAST_NEXT;
+	FAST_OP(DecMapVar)		*(activeBehavior->MapVars[insn->Arg]) -= 1; insn++; FAST_NEXT;
+	FAST_OP(DecWorldVar)	--ACS_WorldVars[insn->Arg]; insn++; FAST_NEXT;
+	FAST_OP(DecGlobalVar)	--ACS_GlobalVars[insn->Arg]; insn++; FAST_NEXT;
+
+	FAST_OP(PushWorldArray)		STACK(1) = ACS_WorldArrays[insn->Arg][STACK(1)]; insn++; FAST_NEXT;
+	FAST_OP(PushGlobalArray)	STACK(1) = ACS_GlobalArrays[insn->Arg][STACK(1)]; insn++; FAST_NEXT;
+
+	FAST_OP(Goto)
+		insn = code + insn->Target;
+		FAST_NEXT;
+
+	FAST_OP(IfGoto)
+		insn = STACK(1) ? code + insn->Target : insn + 1;
+		sp--;
+		FAST_NEXT;
+
+	FAST_OP(IfNotGoto)
+		insn = !STACK(1) ? code + insn->Target : insn + 1;
+		sp--;
+		FAST_NEXT;
+
+	FAST_OP(CaseGoto)
+		if (STACK(1) == insn->Arg)
+		{
+			insn = code + insn->Target;
+			sp--;
+		}
+		else
+		{
+			insn++;
+		}
+		FAST_NEXT;
+
+#ifndef ACS_THREADED_DISPATCH
+	}
+#endif
+}
+
+#undef FAST_OP
+#undef FAST_COUNT
+#undef FAST_NEXT
+#undef FAST_LABEL
+
 int DLevelScript::RunScript ()
 {
 	DACSThinker *controller = DACSThinker::ActiveThinker;
@@ -8189,7 +9060,14 @@ int DLevelScript::RunScript ()
 
 	while (state == SCRIPT_Running)
 	{
-		if (++runaway > 2000000)
+		const FACSInstruction *fastcode = activeBehavior->GetFastCode (pc);
+
+		if (fastcode != NULL && fastcode->Op != AFX_Slow)
+		{
+			pc = RunFastCode (fastcode, Stack, sp, locals, runaway);
+		}
+
+		if (++runaway > ACS_RUNAWAY_LIMIT)
 		{
 			Printf ("Runaway %s terminated\n", ScriptPresentation(script).GetChars());
 			state = SCRIPT_PleaseRemove;
@@ -10359,6 +11237,7 @@ scriptwait:
 						lines[line].flags |= ML_BLOCK_PLAYERS;
 						break;
 					}
+					P_InvalidateSightCache ();
 
 					// If we're the server, tell clients to update this line.
 					if ( NETWORK_GetState( ) == NETSTATE_SERVER )
@@ -11416,7 +12295,7 @@ scriptwait:
 			break;
 
 		case PCD_GETCVAR:
-			STACK(1) = GetCVar(activator, FBehavior::StaticLookupString(STACK(1)), false, Stack, sp);
+			STACK(1) = GetCVar(activator, STACK(1), false, Stack, sp);
 			break;
 
 		case PCD_SETHUDSIZE:
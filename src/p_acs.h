@@ -46,6 +46,7 @@
 
 class FFont;
 class FileReader;
+class FBaseCVar;
 
 
 enum
@@ -108,33 +109,61 @@ public:
 	void MarkStringArray(const int *strnum, unsigned int count);
 	void MarkStringMap(const FWorldGlobalArray &array);
 	void PurgeStrings();
+	void SweepStrings(unsigned int count);
 	void Clear();
 	void Dump() const;
+	FString GetStats() const;
 	void ReadStrings(PNGHandle *png, DWORD id);
 	void WriteStrings(FILE *file, DWORD id) const;
+	void Serialize(FArchive &arc);
+
+	enum { SWEEP_STEP = 1024 };			// Entries SweepStrings looks at per tic
 
 private:
-	int FindString(const char *str, size_t len, unsigned int h, unsigned int bucketnum);
-	int InsertString(FString &str, unsigned int h, unsigned int bucketnum, const SDWORD *stack, int stackdepth);
+	void ReadStrings(FArchive &arc);
+	void WriteStrings(FArchive &arc) const;
+	int FindString(const char *str, size_t len, unsigned int h);
+	int InsertString(FString &str, unsigned int h, const SDWORD *stack, int stackdepth);
 	void FindFirstFreeEntry(unsigned int base);
-
-	enum { NUM_BUCKETS = 251 };
-	enum { FREE_ENTRY = 0xFFFFFFFE };	// Stored in PoolEntry's Next field
-	enum { NO_ENTRY = 0xFFFFFFFF };
+	void StartCollection(const SDWORD *stack, int stackdepth);
+	void FreeEntry(unsigned int index);
+	void LinkEntry(unsigned int index);
+	void Rehash(unsigned int size);
+	void CancelSweep() { SweepPos = SweepEnd = 0; }
+
+	enum { FREE_ENTRY = 0xFFFFFFFE };	// Stored in PoolEntry's Slot field
+	enum { NO_ENTRY = 0xFFFFFFFF };		// Empty slot of the hash table
+	enum { DELETED_ENTRY = 0xFFFFFFFE };	// Hash table slot of a removed string
 	enum { MIN_GC_SIZE = 100 };			// Don't auto-collect until there are this many strings
+	enum { MIN_TABLE_SIZE = 256 };
 	struct PoolEntry
 	{
 		FString Str;
 		unsigned int Hash;
-		unsigned int Next;
+		unsigned int Slot;				// Where this entry is in HashTable
 		unsigned int LockCount;
+		unsigned int Mark;				// MarkEpoch of the last MarkString
 	};
 	TArray<PoolEntry> Pool;
-	unsigned int PoolBuckets[NUM_BUCKETS];
+	TArray<unsigned int> HashTable;		// Open addressing, linear probing; power of 2 sized
+	unsigned int HashUsed;				// Slots that are not NO_ENTRY
+	unsigned int NumStrings;
 	unsigned int FirstFreeEntry;
+
+	// Strings added since the last collection. Most of them are temporary,
+	// so they are swept as soon as a collection starts. Older strings are
+	// swept by SweepStrings a few at a time.
+	TArray<unsigned int> Nursery;
+	unsigned int MarkEpoch;
+	unsigned int SweepEpoch;			// MarkEpoch the current sweep is for
+	unsigned int SweepPos, SweepEnd;
+
+	unsigned int NumCollections;
+	unsigned int LastYoungFreed, LastOldFreed;
 };
 extern ACSStringPool GlobalACSStrings;
 
+void P_MarkACSGlobalStrings(const SDWORD *stack, int stackdepth);
 void P_CollectACSGlobalStrings(const SDWORD *stack, int stackdepth);
 void P_ReadACSVars(PNGHandle *);
 void P_WriteACSVars(FILE*);
@@ -369,6 +398,43 @@ enum
 	TPROP_LoserTheme,
 };
 
+// P-codes that are decoded once per module and run by DLevelScript::RunFastCode
+// instead of going through the switch in RunScript. Every other p-code is
+// decoded as AFX_Slow, which hands control back to RunScript.
+enum EACSFastOp
+{
+	AFX_Slow,
+	AFX_Jump,			// links to an already decoded instruction; not a p-code of its own
+	AFX_PushNumber,
+	AFX_PushBytes,
+	AFX_Dup, AFX_Swap, AFX_Drop,
+	AFX_Add, AFX_Subtract, AFX_Multiply, AFX_Divide, AFX_Modulus,
+	AFX_EQ, AFX_NE, AFX_LT, AFX_GT, AFX_LE, AFX_GE,
+	AFX_AndLogical, AFX_OrLogical, AFX_AndBitwise, AFX_OrBitwise, AFX_EorBitwise,
+	AFX_LShift, AFX_RShift, AFX_NegateLogical, AFX_NegateBinary, AFX_UnaryMinus,
+	AFX_PushScriptVar, AFX_PushMapVar, AFX_PushWorldVar, AFX_PushGlobalVar,
+	AFX_AssignScriptVar, AFX_AssignMapVar, AFX_AssignWorldVar, AFX_AssignGlobalVar,
+	AFX_AddScriptVar, AFX_AddMapVar, AFX_AddWorldVar, AFX_AddGlobalVar,
+	AFX_SubScriptVar, AFX_SubMapVar, AFX_SubWorldVar, AFX_SubGlobalVar,
+	AFX_IncScriptVar, AFX_IncMapVar, AFX_IncWorldVar, AFX_IncGlobalVar,
+	AFX_DecScriptVar, AFX_DecMapVar, AFX_DecWorldVar, AFX_DecGlobalVar,
+	AFX_PushWorldArray, AFX_PushGlobalArray,
+	AFX_Goto, AFX_IfGoto, AFX_IfNotGoto, AFX_CaseGoto,
+
+	NUM_AFX
+};
+
+// One decoded p-code, 16 bytes.
+struct FACSInstruction
+{
+	BYTE Op;			// EACSFastOp
+	BYTE Count;			// number of bytes pushed by AFX_PushBytes
+	WORD Pad;
+	DWORD Ofs;			// offset of the p-code in the module
+	SDWORD Arg;			// immediate value or variable number
+	int Target;			// index of the jump target, or the offset of AFX_PushBytes' bytes
+};
+
 class FBehavior
 {
 public:
@@ -402,6 +468,9 @@ public:
 	ACSProfileInfo *GetFunctionProfileData(int index) { return index >= 0 && index < NumFunctions ? &FunctionProfileData[index] : NULL; }
 	ACSProfileInfo *GetFunctionProfileData(ScriptFunction *func) { return GetFunctionProfileData((int)(func - (ScriptFunction *)Functions)); }
 	const char *LookupString (DWORD index) const;
+	FBaseCVar *LookupCVar (DWORD index);
+	const FACSInstruction *GetFastCode (int *pc);
+	const FACSInstruction *GetFastCodeStart () const { return &FastCode[0]; }
 
 	SDWORD *MapVars[NUM_MAPVARS];
 
@@ -417,6 +486,7 @@ public:
 
 	static const ScriptPtr *StaticFindScript (int script, FBehavior *&module);
 	static const char *StaticLookupString (DWORD index);
+	static FBaseCVar *StaticLookupCVar (DWORD index);
 	static void StaticStartTypedScripts (WORD type, AActor *activator, bool always, int arg1=0, bool runNow=false, bool onlyClientSideScripts=false, int arg2=0, int arg3=0); // [BB] Added arg2+arg3
 	static void StaticStopMyScripts (AActor *actor);
 	static int StaticCountTypedScripts( WORD type );
@@ -450,9 +520,30 @@ private:
 	char ModuleName[9];
 	TArray<int> JumpPoints;
 
+	// The cvar named by each string of the string table, filled in as scripts
+	// look them up. An entry is only valid for the CVarGeneration it was
+	// made in.
+	struct CVarHandle
+	{
+		FBaseCVar *CVar;
+		unsigned int Generation;
+	};
+	TArray<CVarHandle> CVarHandles;
+
+	// Decoded p-codes, and for every byte of Data the index of the
+	// instruction decoded there plus one (0 if none). Once FastCode can't
+	// be indexed by a WORD anymore, no more code is decoded.
+	TArray<FACSInstruction> FastCode;
+	TArray<WORD> FastCodeIndex;
+	bool FastCodeFull;
+
 	static TArray<FBehavior *> StaticModules;
 
 	void LoadScriptsDirectory ();
+	void DecodeScripts ();
+	int DecodeFastCode (DWORD ofs);
+	bool DecodeInstruction (DWORD &ofs, FACSInstruction &insn, DWORD &target) const;
+	bool DecodeArg (DWORD &ofs, bool isbyte, SDWORD &arg) const;
 
 	static int STACK_ARGS SortScripts (const void *a, const void *b);
 	void UnencryptStrings ();
@@ -1010,6 +1101,8 @@ protected:
 private:
 	DLevelScript ();
 
+	int *RunFastCode (const FACSInstruction *insn, SDWORD *Stack, int &sp, SDWORD *locals, unsigned int &runaway);
+
 	friend class DACSThinker;
 
 	// [BB/TP] The client needs to call DLevelScript::ReplaceTextures.
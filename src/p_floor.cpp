@@ -1837,6 +1837,7 @@ void DWaggleBase::DoWaggle (bool ceiling)
 	dist = plane->d;
 	plane->d = m_OriginalDist + plane->PointToDist (0, 0, FixedMul (mag, m_Scale));
 	m_Sector->ChangePlaneTexZ(pos, plane->HeightDiff (dist));
+	P_InvalidateSightCache ();
 	dist = plane->HeightDiff (dist);
 
 	// Interesting: Hexen passes 'true' for the crunch parameter which really is crushing damage here...
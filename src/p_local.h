@@ -478,6 +478,7 @@ enum ESightFlags
 };
 
 void	P_ResetSightCounters (bool full);
+void	P_InvalidateSightCache ();
 void	P_ResetSpawnCounters( void ); // [BC]
 bool	P_TalkFacing (AActor *player);
 void	P_UseLines (player_t* player);
@@ -6622,6 +6622,9 @@ bool P_ChangeSector(sector_t *sector, int crunch, int amt, int floorOrCeil, bool
 	cpos.movemidtex = false;
 	cpos.sector = sector;
 
+	// The sector's planes have moved, so memoized sight traces are stale.
+	P_InvalidateSightCache ();
+
 #ifdef _3DFLOORS
 	// Also process all sectors that have 3D floors transferred from the
 	// changed sector.
@@ -384,6 +384,11 @@ void AActor::Serialize (FArchive &arc)
 		<< pMonsterSpot
 		<< pPickupSpot
 		<< Rune;
+
+	// Demo keyframes are restored while the demo is played, so the net IDs
+	// the server gave the actors have to stay the same.
+	if ( CLIENTDEMO_IsArchivingKeyframe( ))
+		arc << lNetID;
 	
 	actorRandom.WriteRNGState(arc);
 
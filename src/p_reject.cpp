@@ -0,0 +1,967 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: p_reject.cpp
+//
+// Description: Generates a conservative REJECT matrix for maps that don't have one
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "doomtype.h"
+#include "templates.h"
+#include "m_swap.h"
+#include "m_misc.h"
+#include "cmdlib.h"
+#include "i_system.h"
+#include "md5.h"
+#include "doomdata.h"
+#include "r_defs.h"
+#include "r_state.h"
+#include "r_utility.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "nodebuild.h"
+#include "network.h"
+#include "workerpool.h"
+
+// Portal endpoints closer than this (in map units) to a clipping line count
+// as being on it. This errs on the side of seeing too much.
+static const double REJECT_EPSILON = 1. / 16;
+
+// Every step of the portal flow works on a row of bits, one for each leaf.
+// This limits the number of row bytes processed for the whole map. A portal
+// that uses up its share falls back to the flooded estimate, but every
+// portal may take at least REJECT_MIN_FLOW_STEPS steps.
+static const double REJECT_FLOW_WORK = 1024. * 1024 * 1024;
+static const unsigned int REJECT_MIN_FLOW_STEPS = 256;
+
+// The portal flow is done in this many waves.
+static const unsigned int REJECT_FLOW_WAVES = 32;
+
+// The matrix needs numsectors^2 bits, don't bother with huge maps.
+static const int REJECT_MAX_SECTORS = 16384;
+
+// Bump this whenever the generated matrices change, so that old cache
+// files are not used anymore.
+static const DWORD REJECT_CACHE_VERSION = 1;
+
+static WorkerPool RejectWorkers;
+
+//*****************************************************************************
+//
+// A portal is the part of a GL subsector's boundary through which one can
+// look into the neighbouring subsector. Its endpoints are ordered so that the
+// subsector the portal leads into is on the left side.
+//
+struct FRejectSeg
+{
+	double x1, y1, x2, y2;
+};
+
+struct FRejectPortal
+{
+	FRejectSeg	Seg;
+	int			FromLeaf;
+	int			Leaf;
+};
+
+struct FRejectLeaf
+{
+	TArray<int>	Portals;	// Portals leading out of this leaf.
+	double		CenterX, CenterY;
+};
+
+//*****************************************************************************
+//
+// Returns the distance of (x,y) to the line through (ox,oy) with direction
+// (dx,dy). Points on the left side of the line are positive.
+//
+static inline double PointDistance (double x, double y, double ox, double oy, double dx, double dy, double len)
+{
+	return (dx * (y - oy) - dy * (x - ox)) / len;
+}
+
+//*****************************************************************************
+//
+// Cuts off the part of seg that is on the right side of the line. Returns
+// false if nothing is left.
+//
+static bool ClipToLine (FRejectSeg &seg, double ox, double oy, double dx, double dy)
+{
+	const double len = sqrt (dx*dx + dy*dy);
+
+	// A degenerate line can't clip anything.
+	if (len < REJECT_EPSILON)
+		return true;
+
+	const double d1 = PointDistance (seg.x1, seg.y1, ox, oy, dx, dy, len);
+	const double d2 = PointDistance (seg.x2, seg.y2, ox, oy, dx, dy, len);
+
+	if (d1 >= -REJECT_EPSILON && d2 >= -REJECT_EPSILON)
+		return true;
+	if (d1 < -REJECT_EPSILON && d2 < -REJECT_EPSILON)
+		return false;
+
+	// Move the outside point to where the segment is REJECT_EPSILON away from the line.
+	const double frac = (d1 + REJECT_EPSILON) / (d1 - d2);
+	const double x = seg.x1 + frac * (seg.x2 - seg.x1);
+	const double y = seg.y1 + frac * (seg.y2 - seg.y1);
+
+	if (d1 < -REJECT_EPSILON)
+	{
+		seg.x1 = x;
+		seg.y1 = y;
+	}
+	else
+	{
+		seg.x2 = x;
+		seg.y2 = y;
+	}
+	return true;
+}
+
+//*****************************************************************************
+//
+// Every sight line that passes through first and then through second is
+// bounded by the lines that go through an endpoint of each of them and have
+// the two on opposite sides. Clips target to what is between those lines on
+// the far side of second. Returns false if nothing of target is left.
+//
+static bool ClipToSeparators (const FRejectSeg &first, const FRejectSeg &second, FRejectSeg &target)
+{
+	const double firstpoints[2][2] = { { first.x1, first.y1 }, { first.x2, first.y2 } };
+	const double secondpoints[2][2] = { { second.x1, second.y1 }, { second.x2, second.y2 } };
+
+	for (int i = 0; i < 2; ++i)
+	{
+		const double *a = firstpoints[i];
+		const double *otherA = firstpoints[1-i];
+
+		for (int j = 0; j < 2; ++j)
+		{
+			const double *b = secondpoints[j];
+			const double *otherB = secondpoints[1-j];
+			const double dx = b[0] - a[0];
+			const double dy = b[1] - a[1];
+			const double len = sqrt (dx*dx + dy*dy);
+
+			if (len < REJECT_EPSILON)
+				continue;
+
+			const double sideA = PointDistance (otherA[0], otherA[1], a[0], a[1], dx, dy, len);
+			const double sideB = PointDistance (otherB[0], otherB[1], a[0], a[1], dx, dy, len);
+
+			// If either segment touches the line, it's not a proper separator.
+			if (fabs (sideA) <= REJECT_EPSILON || fabs (sideB) <= REJECT_EPSILON)
+				continue;
+			if ((sideA > 0) == (sideB > 0))
+				continue;
+
+			// Keep the target on the same side as the second segment.
+			if (sideB > 0)
+			{
+				if (!ClipToLine (target, a[0], a[1], dx, dy))
+					return false;
+			}
+			else
+			{
+				if (!ClipToLine (target, b[0], b[1], -dx, -dy))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+//*****************************************************************************
+//
+struct FMightCountLess
+{
+	FMightCountLess (const TArray<unsigned int> &counts) : Counts (counts) { }
+	bool operator() (unsigned int a, unsigned int b) const { return Counts[a] < Counts[b]; }
+
+	const TArray<unsigned int> &Counts;
+};
+
+//*****************************************************************************
+//
+// Computes which GL subsectors (leaves) can possibly see each other in 2D,
+// like the vis tools for portal based engines do, and turns that into a
+// sector to sector matrix. Heights, doors, polyobjects and ML_BLOCKSIGHT are
+// ignored, so the result only rejects pairs of sectors that can never see
+// each other no matter what happens in the level. Like the REJECT lumps made
+// by node builders, this assumes that actors are not stuck inside walls.
+//
+class FRejectBuilder
+{
+public:
+	FRejectBuilder (seg_t *segs, const glsegextra_t *segextras, int numsegs, subsector_t *subsectors, int numsubsectors);
+
+	bool	Build (BYTE *reject);
+	int		GetNumPortals () const { return Portals.Size(); }
+	int		GetNumFallbacks () const { return NumFallbacks; }
+	int		GetNumRejected () const { return NumRejected; }
+
+private:
+	struct FFlowFrame
+	{
+		int				Leaf;
+		unsigned int	NextPortal;
+		FRejectSeg		Source;
+		FRejectSeg		Pass;
+		bool			HasPass;
+		size_t			MightSee;	// Offset into the might see buffer.
+	};
+
+	void	FloodPortal (unsigned int portalnum);
+	void	FlowPortal (unsigned int portalnum);
+	void	FlowNextPortal (unsigned int index) { FlowPortal (FlowOrder[WaveStart + index]); }
+	void	MakeSectorMatrix (BYTE *reject);
+	int		FindFace (int leaf);
+
+	bool	TestBit (const BYTE *bits, int bit) const { return !!(bits[bit >> 3] & (1 << (bit & 7))); }
+	void	SetBit (BYTE *bits, int bit) const { bits[bit >> 3] |= 1 << (bit & 7); }
+
+	seg_t					*Segs;
+	const glsegextra_t		*SegExtras;
+	int						NumSegs;
+	subsector_t				*Subsectors;
+	int						NumSubsectors;
+
+	TArray<FRejectPortal>	Portals;
+	TArray<FRejectLeaf>		Leaves;
+	TArray<int>				LeafOfSeg;
+	size_t					LeafBytes;
+
+	// One row of LeafBytes per portal.
+	TArray<BYTE>			MightSee;
+	TArray<BYTE>			PortalVis;
+
+	// Portals that might see less are done first, so that the others can
+	// use their results. To keep the results independent of the timing,
+	// only portals of earlier waves are used.
+	TArray<unsigned int>	FlowOrder;
+	TArray<bool>			PortalDone;
+	unsigned int			WaveStart;
+	unsigned int			MaxFlowSteps;
+
+	// Leaves joined by minisegs form a face.
+	TArray<int>				FaceOfLeaf;
+
+	std::atomic<int>		NumFallbacks;
+	int						NumRejected;
+};
+
+//*****************************************************************************
+//
+FRejectBuilder::FRejectBuilder (seg_t *segs, const glsegextra_t *segextras, int numsegs, subsector_t *subsectors, int numsubsectors)
+	: Segs (segs), SegExtras (segextras), NumSegs (numsegs), Subsectors (subsectors), NumSubsectors (numsubsectors),
+	  NumFallbacks (0), NumRejected (0)
+{
+	Leaves.Resize (numsubsectors);
+	LeafOfSeg.Resize (numsegs);
+	for (int i = 0; i < numsegs; ++i)
+	{
+		LeafOfSeg[i] = -1;
+	}
+
+	for (int i = 0; i < numsubsectors; ++i)
+	{
+		const subsector_t &sub = subsectors[i];
+		double x = 0, y = 0;
+
+		for (DWORD j = 0; j < sub.numlines; ++j)
+		{
+			const seg_t &seg = sub.firstline[j];
+			LeafOfSeg[&seg - segs] = i;
+			x += FIXED2DBL(seg.v1->x);
+			y += FIXED2DBL(seg.v1->y);
+		}
+		if (sub.numlines > 0)
+		{
+			x /= sub.numlines;
+			y /= sub.numlines;
+		}
+		Leaves[i].CenterX = x;
+		Leaves[i].CenterY = y;
+	}
+
+	// Every seg between two leaves that doesn't belong to a solid line is a portal.
+	for (int i = 0; i < numsegs; ++i)
+	{
+		const seg_t &seg = segs[i];
+		const DWORD partner = segextras[i].PartnerSeg;
+
+		if (partner >= (DWORD)numsegs || LeafOfSeg[i] < 0 || LeafOfSeg[partner] < 0 || LeafOfSeg[partner] == LeafOfSeg[i])
+			continue;
+
+		// Same test as P_SightCheckLine, ML_BLOCKSIGHT can be changed during the game though.
+		if (seg.linedef != NULL && (seg.linedef->backsector == NULL || !(seg.linedef->flags & ML_TWOSIDED)))
+			continue;
+
+		FRejectPortal portal;
+		const FRejectLeaf &leaf = Leaves[LeafOfSeg[i]];
+
+		portal.FromLeaf = LeafOfSeg[i];
+		portal.Leaf = LeafOfSeg[partner];
+		portal.Seg.x1 = FIXED2DBL(seg.v1->x);
+		portal.Seg.y1 = FIXED2DBL(seg.v1->y);
+		portal.Seg.x2 = FIXED2DBL(seg.v2->x);
+		portal.Seg.y2 = FIXED2DBL(seg.v2->y);
+
+		// Segs have their subsector on the right side. Check anyway, since
+		// the portal clipping depends on it.
+		const double dx = portal.Seg.x2 - portal.Seg.x1;
+		const double dy = portal.Seg.y2 - portal.Seg.y1;
+		const double len = sqrt (dx*dx + dy*dy);
+		if (len > REJECT_EPSILON && PointDistance (leaf.CenterX, leaf.CenterY, portal.Seg.x1, portal.Seg.y1, dx, dy, len) > REJECT_EPSILON)
+		{
+			swapvalues (portal.Seg.x1, portal.Seg.x2);
+			swapvalues (portal.Seg.y1, portal.Seg.y2);
+		}
+
+		Leaves[portal.FromLeaf].Portals.Push (Portals.Push (portal));
+	}
+
+	// Rows are processed a QWORD at a time.
+	LeafBytes = ((Leaves.Size() + 63) >> 6) * 8;
+}
+
+//*****************************************************************************
+//
+// Finds the leaves a portal might see by flooding through all portals that
+// are at least partly in front of it, with the portal at least partly
+// behind them.
+//
+void FRejectBuilder::FloodPortal (unsigned int portalnum)
+{
+	static thread_local std::vector<int> queue;
+	const FRejectPortal &source = Portals[portalnum];
+	const FRejectSeg &s = source.Seg;
+	const double sdx = s.x2 - s.x1;
+	const double sdy = s.y2 - s.y1;
+	const double slen = sqrt (sdx*sdx + sdy*sdy);
+	BYTE *might = &MightSee[portalnum * LeafBytes];
+
+	queue.clear();
+	queue.push_back (source.Leaf);
+	SetBit (might, source.Leaf);
+
+	for (size_t i = 0; i < queue.size(); ++i)
+	{
+		const FRejectLeaf &leaf = Leaves[queue[i]];
+
+		for (unsigned int j = 0; j < leaf.Portals.Size(); ++j)
+		{
+			const FRejectPortal &portal = Portals[leaf.Portals[j]];
+
+			if (portal.Leaf == source.FromLeaf || TestBit (might, portal.Leaf))
+				continue;
+
+			const FRejectSeg &p = portal.Seg;
+			if (slen >= REJECT_EPSILON &&
+				PointDistance (p.x1, p.y1, s.x1, s.y1, sdx, sdy, slen) <= -REJECT_EPSILON &&
+				PointDistance (p.x2, p.y2, s.x1, s.y1, sdx, sdy, slen) <= -REJECT_EPSILON)
+				continue;
+
+			const double pdx = p.x2 - p.x1;
+			const double pdy = p.y2 - p.y1;
+			const double plen = sqrt (pdx*pdx + pdy*pdy);
+			if (plen >= REJECT_EPSILON &&
+				PointDistance (s.x1, s.y1, p.x1, p.y1, pdx, pdy, plen) >= REJECT_EPSILON &&
+				PointDistance (s.x2, s.y2, p.x1, p.y1, pdx, pdy, plen) >= REJECT_EPSILON)
+				continue;
+
+			SetBit (might, portal.Leaf);
+			queue.push_back (portal.Leaf);
+		}
+	}
+}
+
+//*****************************************************************************
+//
+// Follows the sight lines through a portal from leaf to leaf, clipping each
+// portal on the way to what can be seen through the portals before it.
+//
+void FRejectBuilder::FlowPortal (unsigned int portalnum)
+{
+	static thread_local std::vector<FFlowFrame> stack;
+	static thread_local std::vector<BYTE> mightBuffer;
+	static thread_local std::vector<BYTE> onStack;
+
+	const FRejectPortal &source = Portals[portalnum];
+	const FRejectSeg &s = source.Seg;
+	const BYTE *baseMight = &MightSee[portalnum * LeafBytes];
+	BYTE *vis = &PortalVis[portalnum * LeafBytes];
+	unsigned int steps = 0;
+
+	if (onStack.size() < Leaves.Size())
+		onStack.resize (Leaves.Size());
+	if (mightBuffer.size() < LeafBytes)
+		mightBuffer.resize (LeafBytes);
+	memcpy (&mightBuffer[0], baseMight, LeafBytes);
+
+	// A straight line can't enter a convex leaf twice.
+	onStack[source.FromLeaf] = true;
+	onStack[source.Leaf] = true;
+	SetBit (vis, source.Leaf);
+
+	FFlowFrame first;
+	first.Leaf = source.Leaf;
+	first.NextPortal = 0;
+	first.Source = s;
+	first.HasPass = false;
+	first.MightSee = 0;
+	stack.clear();
+	stack.push_back (first);
+
+	while (stack.empty() == false)
+	{
+		FFlowFrame &frame = stack.back();
+		const FRejectLeaf &leaf = Leaves[frame.Leaf];
+
+		if (frame.NextPortal >= leaf.Portals.Size())
+		{
+			onStack[frame.Leaf] = false;
+			stack.pop_back();
+			continue;
+		}
+
+		const FRejectPortal &portal = Portals[leaf.Portals[frame.NextPortal++]];
+		const int next = portal.Leaf;
+
+		if (onStack[next] || !TestBit (&mightBuffer[frame.MightSee], next))
+			continue;
+
+		FRejectSeg target = portal.Seg;
+		FRejectSeg newSource = frame.Source;
+
+		if (!ClipToLine (target, s.x1, s.y1, s.x2 - s.x1, s.y2 - s.y1))
+			continue;
+
+		if (frame.HasPass)
+		{
+			if (!ClipToSeparators (frame.Source, frame.Pass, target))
+				continue;
+			if (!ClipToSeparators (target, frame.Pass, newSource))
+				continue;
+		}
+
+		// Only go on if this can show something that isn't known to be visible yet.
+		const size_t nextMight = stack.size() * LeafBytes;
+		if (mightBuffer.size() < nextMight + LeafBytes)
+			mightBuffer.resize (nextMight + LeafBytes);
+
+		const size_t portalnum = &portal - &Portals[0];
+		const QWORD *prevMight = reinterpret_cast<const QWORD *>(&mightBuffer[frame.MightSee]);
+		const QWORD *portalMight = reinterpret_cast<const QWORD *>(PortalDone[portalnum] ? &PortalVis[portalnum * LeafBytes] : &MightSee[portalnum * LeafBytes]);
+		const QWORD *visWords = reinterpret_cast<const QWORD *>(vis);
+		QWORD *might = reinterpret_cast<QWORD *>(&mightBuffer[nextMight]);
+		QWORD more = 0;
+
+		for (size_t i = 0; i < LeafBytes / 8; ++i)
+		{
+			might[i] = prevMight[i] & portalMight[i];
+			more |= might[i] & ~visWords[i];
+		}
+		if (more == 0 && TestBit (vis, next))
+			continue;
+
+		if (++steps > MaxFlowSteps)
+		{
+			for (size_t i = 0; i < stack.size(); ++i)
+				onStack[stack[i].Leaf] = false;
+			stack.clear();
+			memcpy (vis, baseMight, LeafBytes);
+			++NumFallbacks;
+			break;
+		}
+
+		SetBit (vis, next);
+		onStack[next] = true;
+
+		FFlowFrame nextFrame;
+		nextFrame.Leaf = next;
+		nextFrame.NextPortal = 0;
+		nextFrame.Source = newSource;
+		nextFrame.Pass = target;
+		nextFrame.HasPass = true;
+		nextFrame.MightSee = nextMight;
+		// frame is invalid after this.
+		stack.push_back (nextFrame);
+	}
+
+	onStack[source.FromLeaf] = false;
+}
+
+//*****************************************************************************
+//
+// Returns false if the map is too big to do this in a sensible amount of memory.
+//
+bool FRejectBuilder::Build (BYTE *reject)
+{
+	const size_t rowsSize = Portals.Size() * LeafBytes;
+
+	if (rowsSize > (size_t(256) << 20))
+		return false;
+
+	MightSee.Resize ((unsigned int)rowsSize);
+	PortalVis.Resize ((unsigned int)rowsSize);
+	if (rowsSize > 0)
+	{
+		memset (&MightSee[0], 0, rowsSize);
+		memset (&PortalVis[0], 0, rowsSize);
+	}
+
+	// The flow needs the flooded estimates of all portals, so this is done in two passes.
+	RejectWorkers.ParallelFor (Portals.Size(), std::bind (&FRejectBuilder::FloodPortal, this, std::placeholders::_1));
+
+	TArray<unsigned int> mightCounts (Portals.Size());
+	FlowOrder.Resize (Portals.Size());
+	PortalDone.Resize (Portals.Size());
+	mightCounts.Resize (Portals.Size());
+	for (unsigned int i = 0; i < Portals.Size(); ++i)
+	{
+		const BYTE *might = &MightSee[i * LeafBytes];
+		unsigned int count = 0;
+
+		for (size_t j = 0; j < LeafBytes; ++j)
+		{
+			for (BYTE bits = might[j]; bits != 0; bits &= bits - 1)
+				++count;
+		}
+		mightCounts[i] = count;
+		FlowOrder[i] = i;
+		PortalDone[i] = false;
+	}
+	std::stable_sort (&FlowOrder[0], &FlowOrder[0] + FlowOrder.Size(), FMightCountLess (mightCounts));
+
+	MaxFlowSteps = MAX<unsigned int> (REJECT_MIN_FLOW_STEPS, (unsigned int)MIN<double> (REJECT_FLOW_WORK / (double(Portals.Size()) * LeafBytes), 1 << 24));
+
+	const unsigned int waveSize = MAX<unsigned int> (1, (Portals.Size() + REJECT_FLOW_WAVES - 1) / REJECT_FLOW_WAVES);
+	for (WaveStart = 0; WaveStart < Portals.Size(); WaveStart += waveSize)
+	{
+		const unsigned int count = MIN<unsigned int> (waveSize, Portals.Size() - WaveStart);
+
+		RejectWorkers.ParallelFor (count, std::bind (&FRejectBuilder::FlowNextPortal, this, std::placeholders::_1));
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			PortalDone[FlowOrder[WaveStart + i]] = true;
+		}
+	}
+
+	MakeSectorMatrix (reject);
+	return true;
+}
+
+//*****************************************************************************
+//
+int FRejectBuilder::FindFace (int leaf)
+{
+	while (FaceOfLeaf[leaf] != leaf)
+	{
+		FaceOfLeaf[leaf] = FaceOfLeaf[FaceOfLeaf[leaf]];
+		leaf = FaceOfLeaf[leaf];
+	}
+	return leaf;
+}
+
+//*****************************************************************************
+//
+// A sector sees another one if any face that may belong to the first sector
+// sees a face that may belong to the second one.
+//
+void FRejectBuilder::MakeSectorMatrix (BYTE *reject)
+{
+	const int numleaves = Leaves.Size();
+	int numfaces = 0;
+
+	FaceOfLeaf.Resize (numleaves);
+	for (int i = 0; i < numleaves; ++i)
+	{
+		FaceOfLeaf[i] = i;
+	}
+	for (int i = 0; i < NumSegs; ++i)
+	{
+		const DWORD partner = SegExtras[i].PartnerSeg;
+
+		if (Segs[i].linedef == NULL && partner < (DWORD)NumSegs && LeafOfSeg[i] >= 0 && LeafOfSeg[partner] >= 0)
+		{
+			FaceOfLeaf[FindFace (LeafOfSeg[i])] = FindFace (LeafOfSeg[partner]);
+		}
+	}
+
+	TArray<int> faceIndex (numleaves);
+	faceIndex.Resize (numleaves);
+	for (int i = 0; i < numleaves; ++i)
+	{
+		faceIndex[i] = -1;
+	}
+	for (int i = 0; i < numleaves; ++i)
+	{
+		int &index = faceIndex[FindFace (i)];
+		if (index < 0)
+			index = numfaces++;
+	}
+	for (int i = 0; i < numleaves; ++i)
+	{
+		FaceOfLeaf[i] = faceIndex[FindFace (i)];
+	}
+
+	// Collect the sectors each face may belong to. Besides the sectors of
+	// its walls this asks the game's nodes, since those decide which sector
+	// an actor is in.
+	TArray< TArray<int> > faceSectors (numfaces);
+	TArray<bool> labelled (numsectors);
+	faceSectors.Resize (numfaces);
+	labelled.Resize (numsectors);
+	for (int i = 0; i < numsectors; ++i)
+	{
+		labelled[i] = false;
+	}
+
+	for (int i = 0; i < numleaves; ++i)
+	{
+		const subsector_t &sub = Subsectors[i];
+		const FRejectLeaf &leaf = Leaves[i];
+		TArray<int> &list = faceSectors[FaceOfLeaf[i]];
+		TArray<const sector_t *> candidates;
+
+		candidates.Push (sub.sector);
+		candidates.Push (R_PointInSubsector (FLOAT2FIXED(leaf.CenterX), FLOAT2FIXED(leaf.CenterY))->sector);
+		for (DWORD j = 0; j < sub.numlines; ++j)
+		{
+			const seg_t &seg = sub.firstline[j];
+			const double x = FIXED2DBL(seg.v1->x);
+			const double y = FIXED2DBL(seg.v1->y);
+
+			if (seg.sidedef != NULL)
+				candidates.Push (seg.sidedef->sector);
+			candidates.Push (R_PointInSubsector (FLOAT2FIXED((3 * leaf.CenterX + x) / 4), FLOAT2FIXED((3 * leaf.CenterY + y) / 4))->sector);
+		}
+
+		for (unsigned int j = 0; j < candidates.Size(); ++j)
+		{
+			if (candidates[j] == NULL)
+				continue;
+
+			const int secnum = int(candidates[j] - sectors);
+			if (list.Find (secnum) == list.Size())
+				list.Push (secnum);
+			labelled[secnum] = true;
+		}
+	}
+
+	// Which faces see each other.
+	const size_t faceBytes = (numfaces + 7) >> 3;
+	TArray<BYTE> faceVis ((unsigned int)(numfaces * faceBytes));
+	faceVis.Resize ((unsigned int)(numfaces * faceBytes));
+	memset (&faceVis[0], 0, numfaces * faceBytes);
+
+	for (int i = 0; i < numleaves; ++i)
+	{
+		BYTE *row = &faceVis[FaceOfLeaf[i] * faceBytes];
+
+		SetBit (row, FaceOfLeaf[i]);
+		for (unsigned int j = 0; j < Leaves[i].Portals.Size(); ++j)
+		{
+			const BYTE *vis = &PortalVis[Leaves[i].Portals[j] * LeafBytes];
+
+			for (size_t k = 0; k < LeafBytes; ++k)
+			{
+				if (vis[k] == 0)
+					continue;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					if (vis[k] & (1 << bit))
+						SetBit (row, FaceOfLeaf[k * 8 + bit]);
+				}
+			}
+		}
+	}
+
+	// Which sectors see each other, one byte aligned row per sector.
+	const size_t sectorBytes = (numsectors + 7) >> 3;
+	TArray<BYTE> visible ((unsigned int)(numsectors * sectorBytes));
+	TArray<BYTE> seen ((unsigned int)sectorBytes);
+	visible.Resize ((unsigned int)(numsectors * sectorBytes));
+	seen.Resize ((unsigned int)sectorBytes);
+	memset (&visible[0], 0, numsectors * sectorBytes);
+
+	for (int i = 0; i < numfaces; ++i)
+	{
+		const BYTE *row = &faceVis[i * faceBytes];
+
+		memset (&seen[0], 0, sectorBytes);
+		for (int j = 0; j < numfaces; ++j)
+		{
+			if (TestBit (row, j))
+			{
+				for (unsigned int k = 0; k < faceSectors[j].Size(); ++k)
+					SetBit (&seen[0], faceSectors[j][k]);
+			}
+		}
+		for (unsigned int j = 0; j < faceSectors[i].Size(); ++j)
+		{
+			BYTE *secrow = &visible[faceSectors[i][j] * sectorBytes];
+			for (size_t k = 0; k < sectorBytes; ++k)
+				secrow[k] |= seen[k];
+		}
+	}
+
+	// Sectors that no face belongs to can't be judged, so they see everything.
+	// Sight is symmetric, so a pair is only rejected if neither sees the other.
+	memset (reject, 0, (numsectors * numsectors + 7) >> 3);
+	NumRejected = 0;
+	for (int i = 0; i < numsectors; ++i)
+	{
+		for (int j = i + 1; j < numsectors; ++j)
+		{
+			if (labelled[i] == false || labelled[j] == false)
+				continue;
+			if (TestBit (&visible[i * sectorBytes], j) || TestBit (&visible[j * sectorBytes], i))
+				continue;
+
+			SetBit (reject, i * numsectors + j);
+			SetBit (reject, j * numsectors + i);
+			NumRejected += 2;
+		}
+	}
+}
+
+//*****************************************************************************
+//
+// The cache is keyed on the checksums of the lumps the matrix depends on.
+//
+static FString CreateRejectCacheName (MapData *map, bool create)
+{
+	static const int textLumps[] = { ML_TEXTMAP, ML_ZNODES };
+	static const int binaryLumps[] = { ML_VERTEXES, ML_LINEDEFS, ML_SIDEDEFS, ML_SECTORS, ML_SEGS, ML_SSECTORS, ML_NODES };
+	const int *lumps = map->isText ? textLumps : binaryLumps;
+	const int numLumps = map->isText ? countof(textLumps) : countof(binaryLumps);
+	FString hashes, hash;
+
+	hashes.Format ("%u", REJECT_CACHE_VERSION);
+	for (int i = 0; i < numLumps; ++i)
+	{
+		hashes += ':';
+		if (map->Size (lumps[i]) > 0)
+		{
+			NETWORK_GenerateMapLumpMD5Hash (map, lumps[i], hash);
+			hashes += hash;
+		}
+	}
+	CMD5Checksum::GetMD5 (reinterpret_cast<const BYTE *>(hashes.GetChars()), hashes.Len(), hash);
+
+	FString path = M_GetCachePath (create);
+	path << "/reject";
+	if (create) CreatePath (path);
+	path << '/' << hash << ".rej";
+	return path;
+}
+
+//*****************************************************************************
+//
+static bool LoadCachedReject (const FString &path, BYTE *reject, int rejectsize)
+{
+	FILE *f = fopen (path, "rb");
+	if (f == NULL)
+		return false;
+
+	char magic[4];
+	DWORD header[3];
+	TArray<BYTE> compressed;
+	bool ok = false;
+
+	if (fread (magic, 1, 4, f) == 4 && memcmp (magic, "REJC", 4) == 0 && fread (header, 4, 3, f) == 3 &&
+		LittleLong (header[0]) == REJECT_CACHE_VERSION && (int)LittleLong (header[1]) == numsectors)
+	{
+		const DWORD compressedSize = LittleLong (header[2]);
+		uLongf outlen = rejectsize;
+
+		compressed.Resize (compressedSize);
+		if (compressedSize > 0 && fread (&compressed[0], 1, compressedSize, f) == compressedSize &&
+			uncompress (reject, &outlen, &compressed[0], compressedSize) == Z_OK && outlen == (uLongf)rejectsize)
+		{
+			ok = true;
+		}
+	}
+	fclose (f);
+	return ok;
+}
+
+//*****************************************************************************
+//
+static void SaveCachedReject (const FString &path, const BYTE *reject, int rejectsize)
+{
+	uLongf outlen = compressBound (rejectsize);
+	TArray<BYTE> compressed (outlen + 16);
+	compressed.Resize (outlen + 16);
+
+	if (compress (&compressed[16], &outlen, reject, rejectsize) != Z_OK)
+		return;
+
+	const DWORD header[3] = { LittleLong (REJECT_CACHE_VERSION), LittleLong (DWORD(numsectors)), LittleLong (DWORD(outlen)) };
+	memcpy (&compressed[0], "REJC", 4);
+	memcpy (&compressed[4], header, 12);
+
+	FILE *f = fopen (path, "wb");
+	if (f != NULL)
+	{
+		if (fwrite (&compressed[0], outlen + 16, 1, f) != 1)
+		{
+			Printf ("Error saving REJECT to file %s\n", path.GetChars());
+		}
+		fclose (f);
+	}
+	else
+	{
+		Printf ("Cannot open REJECT file %s for writing\n", path.GetChars());
+	}
+}
+
+//*****************************************************************************
+//
+// Generates rejectmatrix for maps that don't come with a usable REJECT lump.
+// Uses the level's GL nodes if there are any, otherwise it builds its own.
+//
+void P_GenerateReject (MapData *map)
+{
+	if (numsectors == 0)
+		return;
+
+	if (numsectors > REJECT_MAX_SECTORS)
+	{
+		DPrintf ("Not generating REJECT for %d sectors\n", numsectors);
+		return;
+	}
+
+	const int rejectsize = (numsectors * numsectors + 7) >> 3;
+	BYTE *reject = new BYTE[rejectsize];
+
+	if (LoadCachedReject (CreateRejectCacheName (map, false), reject, rejectsize))
+	{
+		DPrintf ("Loaded REJECT from the cache\n");
+		rejectmatrix = reject;
+		return;
+	}
+
+	const unsigned int startTime = I_FPSTime ();
+	node_t *glnodes = NULL;
+	seg_t *glsegs = segs;
+	glsegextra_t *glextras = glsegextras;
+	subsector_t *glsubsectors = subsectors;
+	vertex_t *glvertexes = NULL;
+	line_t *gllines = NULL;
+	int numglnodes = 0, numglsegs = numsegs, numglsubsectors = numsubsectors, numglvertexes = 0;
+
+	if (glextras == NULL)
+	{
+		// The node builder points the lines to its own vertices, so it gets a copy of them.
+		TArray<FNodeBuilder::FPolyStart> polyspots, anchors;
+		gllines = new line_t[numlines];
+		memcpy (gllines, lines, numlines * sizeof(line_t));
+
+		FNodeBuilder::FLevel leveldata =
+		{
+			vertexes, numvertexes,
+			sides, numsides,
+			gllines, numlines,
+			0, 0, 0, 0
+		};
+		leveldata.FindMapBounds ();
+		FNodeBuilder builder (leveldata, polyspots, anchors, true);
+		builder.Extract (glnodes, numglnodes,
+			glsegs, glextras, numglsegs,
+			glsubsectors, numglsubsectors,
+			glvertexes, numglvertexes);
+	}
+
+	bool generated;
+	int numportals, numfallbacks, numrejected;
+	{
+		FRejectBuilder builder (glsegs, glextras, numglsegs, glsubsectors, numglsubsectors);
+		const unsigned int numcores = std::thread::hardware_concurrency ();
+
+		// The calling thread takes part as well.
+		RejectWorkers.SetNumThreads (numcores > 1 ? MIN<unsigned int> (numcores - 1, 15) : 0);
+		generated = builder.Build (reject);
+		RejectWorkers.SetNumThreads (0);
+
+		numportals = builder.GetNumPortals ();
+		numfallbacks = builder.GetNumFallbacks ();
+		numrejected = builder.GetNumRejected ();
+	}
+
+	if (gllines != NULL)
+	{
+		delete[] glnodes;
+		delete[] glsegs;
+		delete[] glextras;
+		delete[] glsubsectors;
+		delete[] glvertexes;
+		delete[] gllines;
+	}
+
+	if (generated == false)
+	{
+		DPrintf ("Map is too big to generate REJECT\n");
+		delete[] reject;
+		return;
+	}
+
+	DPrintf ("REJECT generation took %.3f sec (%d portals, %d fallbacks, %.1f%% of sector pairs rejected)\n",
+		(I_FPSTime () - startTime) * 0.001, numportals, numfallbacks,
+		numsectors > 0 ? numrejected * 100. / (double(numsectors) * numsectors) : 0.);
+
+	SaveCachedReject (CreateRejectCacheName (map, true), reject, rejectsize);
+	rejectmatrix = reject;
+}
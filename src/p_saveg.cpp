@@ -76,6 +76,18 @@ void P_SerializePlayers (FArchive &arc, bool skipload)
 	BYTE numPlayers, numPlayersNow;
 	int i;
 
+	// Demo keyframes put every player back into the slot they were recorded in.
+	// Which players are in the game was already restored before the level.
+	if ( CLIENTDEMO_IsArchivingKeyframe( ))
+	{
+		for ( i = 0; i < MAXPLAYERS; ++i )
+		{
+			if ( playeringame[i] )
+				players[i].Serialize( arc );
+		}
+		return;
+	}
+
 	// Count the number of players present right now.
 	for (numPlayersNow = 0, i = 0; i < MAXPLAYERS; ++i)
 	{
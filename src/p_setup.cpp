@@ -87,6 +87,7 @@
 #include "joinqueue.h"
 #include "cl_demo.h"
 #include "domination.h"
+#include "unlagged.h"
 
 // [BB] New #includes..
 #include "gl/dynlights/gl_dynlight.h"
@@ -114,6 +115,7 @@ EXTERN_CVAR(Bool, am_textured)
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, genglnodes, false, CVAR_SERVERINFO);
+CVAR (Bool, genreject, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, showloadtimes, false, 0);
 
 static void P_InitTagLists ();
@@ -560,6 +562,36 @@ bool P_CheckMapData(const char *mapname)
 	return true;
 }
 
+//===========================================================================
+//
+// Returns the lump P_OpenMapData would read the map from without opening
+// it, i.e. the map's header or its wad or Build map in a zip.
+// Returns -1 if there is none.
+//
+//===========================================================================
+
+int P_FindMapLump(const char *mapname)
+{
+	FString fmt;
+
+	if (!strnicmp(mapname, "file:", 5))
+	{
+		return -1;
+	}
+
+	int lump_name = Wads.CheckNumForName(mapname);
+	fmt.Format("maps/%s.wad", mapname);
+	int lump_wad = Wads.CheckNumForFullName(fmt);
+	fmt.Format("maps/%s.map", mapname);
+	int lump_map = Wads.CheckNumForFullName(fmt);
+
+	if (lump_name > lump_wad && lump_name > lump_map)
+	{
+		return lump_name;
+	}
+	return MAX(lump_wad, lump_map);
+}
+
 //===========================================================================
 //
 // MapData :: GetChecksum
@@ -572,37 +604,56 @@ bool P_CheckMapData(const char *mapname)
 void MapData::GetChecksum(BYTE cksum[16])
 {
 	MD5Context md5;
+	TArray<BYTE> data;
+
+	GetChecksumData(data);
+	if (data.Size() > 0)
+	{
+		md5.Update(&data[0], data.Size());
+	}
+	md5.Final(cksum);
+}
 
+//===========================================================================
+//
+// MapData :: GetChecksumData
+//
+// Collects the data GetChecksum hashes, so that it can be hashed somewhere
+// else.
+//
+//===========================================================================
+
+void MapData::GetChecksumData(TArray<BYTE> &data)
+{
+	data.Clear();
 	if (file != NULL)
 	{
 		if (isText)
 		{
-			Seek(ML_TEXTMAP);
-			md5.Update(file, Size(ML_TEXTMAP));
+			AppendLump(ML_TEXTMAP, data);
 		}
 		else
 		{
-			if (Size(ML_LABEL) != 0)
-			{
-				Seek(ML_LABEL);
-				md5.Update(file, Size(ML_LABEL));
-			}
-			Seek(ML_THINGS);
-			md5.Update(file, Size(ML_THINGS));
-			Seek(ML_LINEDEFS);
-			md5.Update(file, Size(ML_LINEDEFS));
-			Seek(ML_SIDEDEFS);
-			md5.Update(file, Size(ML_SIDEDEFS));
-			Seek(ML_SECTORS);
-			md5.Update(file, Size(ML_SECTORS));
+			AppendLump(ML_LABEL, data);
+			AppendLump(ML_THINGS, data);
+			AppendLump(ML_LINEDEFS, data);
+			AppendLump(ML_SIDEDEFS, data);
+			AppendLump(ML_SECTORS, data);
 		}
 		if (HasBehavior)
 		{
-			Seek(ML_BEHAVIOR);
-			md5.Update(file, Size(ML_BEHAVIOR));
+			AppendLump(ML_BEHAVIOR, data);
 		}
 	}
-	md5.Final(cksum);
+}
+
+void MapData::AppendLump(unsigned int lumpindex, TArray<BYTE> &data)
+{
+	DWORD size = Size(lumpindex);
+	if (size > 0)
+	{
+		Read(lumpindex, &data[data.Reserve(size)], size);
+	}
 }
 
 
@@ -4347,6 +4398,14 @@ void P_SetupLevel (char *lumpname, int position)
 	P_GroupLines (buildmap);
 	times[12].Unclock();
 
+	// Most maps don't come with a usable REJECT, so sight checks can't skip anything.
+	if (genreject && rejectmatrix == NULL && !buildmap)
+	{
+		times[11].Clock();
+		P_GenerateReject (map);
+		times[11].Unclock();
+	}
+
 	times[13].Clock();
 	P_FloodZones ();
 	times[13].Unclock();
@@ -4467,6 +4526,9 @@ void P_SetupLevel (char *lumpname, int position)
 	PO_Init ();	// Initialize the polyobjs
 	times[16].Unclock();
 
+	// Start the unlagged history of the sectors with their initial heights.
+	UNLAGGED_ResetSectors( );
+
 	assert(sidetemp != NULL);
 	delete[] sidetemp;
 	sidetemp = NULL;
@@ -92,10 +92,15 @@ struct MapData
 	}
 
 	void GetChecksum(BYTE cksum[16]);
+	void GetChecksumData(TArray<BYTE> &data);
+
+private:
+	void AppendLump(unsigned int lumpindex, TArray<BYTE> &data);
 };
 
 MapData * P_OpenMapData(const char * mapname, bool justcheck);
 bool P_CheckMapData(const char * mapname);
+int P_FindMapLump(const char * mapname);
 
 // [BB]
 bool P_CheckIfMapExists(const char * mapname);
@@ -128,6 +133,8 @@ bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime);
 bool P_CheckForGLNodes();
 void P_SetRenderSector();
 
+void P_GenerateReject(MapData * map);
+
 
 struct sidei_t	// [RH] Only keep BOOM sidedef init stuff around for init
 {
@@ -43,6 +43,27 @@ static int sightcounts[6];
 static cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
+// Per-tic memo of full sight traces. Monsters ask about the same target
+// several times per tic (P_LookForPlayers, then A_Chase), so the traversal
+// result is kept until the tic ends or something changes the map geometry.
+// Entries also store both actors' positions, so a moved actor misses.
+enum { SIGHTMEMO_SIZE = 1024 };
+
+struct FSightMemo
+{
+	const AActor *t1, *t2;
+	fixed_t x1, y1, z1, h1;
+	fixed_t x2, y2, z2, h2;
+	int flags;
+	unsigned int epoch;
+	bool result;
+};
+
+static FSightMemo SightMemo[SIGHTMEMO_SIZE];
+static unsigned int SightMemoEpoch = 1;
+static int SightMemoHits;
+static int SightMemoMisses;
+
 static TArray<intercept_t> intercepts (128);
 
 class SightCheck
@@ -637,6 +658,31 @@ sightcounts[2]++;
 	return P_SightTraverseIntercepts ( );
 }
 
+//*****************************************************************************
+//
+static unsigned int P_SightMemoSlot (const AActor *t1, const AActor *t2, int flags)
+{
+	size_t key = (size_t(t1) >> 3) * 0x9E3779B1u;
+
+	key ^= (size_t(t2) >> 3) + flags;
+	key ^= key >> 15;
+	return unsigned(key * 0x85EBCA6Bu) >> 22;
+}
+
+//*****************************************************************************
+//
+// Drops all memoized sight results. Must be called whenever lines or sector
+// planes change in a way a sight trace could observe.
+//
+void P_InvalidateSightCache ()
+{
+	if (++SightMemoEpoch == 0)
+	{
+		memset (SightMemo, 0, sizeof(SightMemo));
+		SightMemoEpoch = 1;
+	}
+}
+
 /*
 =====================
 =
@@ -714,10 +760,38 @@ sightcounts[0]++;
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 
-	validcount++;
 	{
-		SightCheck s(t1, t2, flags);
-		res = s.P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y);
+		FSightMemo &memo = SightMemo[P_SightMemoSlot (t1, t2, flags)];
+
+		if (memo.epoch == SightMemoEpoch && memo.t1 == t1 && memo.t2 == t2 && memo.flags == flags &&
+			memo.x1 == t1->x && memo.y1 == t1->y && memo.z1 == t1->z && memo.h1 == t1->height &&
+			memo.x2 == t2->x && memo.y2 == t2->y && memo.z2 == t2->z && memo.h2 == t2->height)
+		{
+			SightMemoHits++;
+			res = memo.result;
+			goto done;
+		}
+
+		validcount++;
+		{
+			SightCheck s(t1, t2, flags);
+			res = s.P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y);
+		}
+
+		SightMemoMisses++;
+		memo.t1 = t1;
+		memo.t2 = t2;
+		memo.flags = flags;
+		memo.x1 = t1->x;
+		memo.y1 = t1->y;
+		memo.z1 = t1->z;
+		memo.h1 = t1->height;
+		memo.x2 = t2->x;
+		memo.y2 = t2->y;
+		memo.z2 = t2->z;
+		memo.h2 = t2->height;
+		memo.epoch = SightMemoEpoch;
+		memo.result = res;
 	}
 
 done:
@@ -728,9 +802,12 @@ done:
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d%4d\n",
+	int lookups = SightMemoHits + SightMemoMisses;
+
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d%4d, memo %d/%d (%.0f%%)\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[3], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[3], sightcounts[4], sightcounts[5],
+		SightMemoHits, lookups, lookups > 0 ? 100. * SightMemoHits / lookups : 0.);
 	return out;
 }
 
@@ -746,6 +823,11 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	SightMemoHits = SightMemoMisses = 0;
+
+	// Actors may be destroyed and their memory reused at the tic boundary,
+	// so nothing memoized may survive it.
+	P_InvalidateSightCache ();
 }
 
 
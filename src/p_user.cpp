@@ -408,10 +408,6 @@ player_t::player_t()
 	memset( &ulMedalCount, 0, sizeof( ULONG ) * NUM_MEDALS );
 	memset( &ServerXYZ, 0, sizeof( fixed_t ) * 3 );
 	memset( &ServerXYZVel, 0, sizeof( fixed_t ) * 3 );
-	
-	memset( &unlaggedX, 0, sizeof( fixed_t ) * UNLAGGEDTICS );
-	memset( &unlaggedY, 0, sizeof( fixed_t ) * UNLAGGEDTICS );
-	memset( &unlaggedZ, 0, sizeof( fixed_t ) * UNLAGGEDTICS );
 }
 
   player_t &player_t::operator=(const player_t &p)
@@ -545,9 +541,6 @@ player_t::player_t()
 	  bUnarmed = p.bUnarmed;
 	  ticsToSpyNext = p.ticsToSpyNext;
 	  pnumToSpyNext = p.pnumToSpyNext;
-	  memcpy(unlaggedX, &p.unlaggedX, sizeof(unlaggedX));
-	  memcpy(unlaggedY, &p.unlaggedY, sizeof(unlaggedY));
-	  memcpy(unlaggedZ, &p.unlaggedZ, sizeof(unlaggedZ));
 	  restoreX = p.restoreX;
 	  restoreY = p.restoreY;
 	  restoreZ = p.restoreZ;
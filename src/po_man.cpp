@@ -1531,6 +1531,7 @@ bool FPolyObj::MovePolyobj (int x, int y, bool force)
 	FBoundingBox oldbounds = Bounds;
 	UnLinkPolyobj ();
 	DoMovePolyobj (x, y);
+	P_InvalidateSightCache ();
 
 	if (!force)
 	{
@@ -1618,6 +1619,7 @@ bool FPolyObj::RotatePolyobj (angle_t angle)
 	an = (this->angle+angle)>>ANGLETOFINESHIFT;
 
 	UnLinkPolyobj();
+	P_InvalidateSightCache ();
 
 	for(unsigned i=0;i < Vertices.Size(); i++)
 	{
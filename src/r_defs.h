@@ -247,8 +247,7 @@ struct secplane_t
 
 	fixed_t a, b, c, d, ic;
 
-	// [Spleen] Store the old D's of the plane for unlagged and client prediction support
-	fixed_t		unlaggedD[UNLAGGEDTICS];
+	// [Spleen] Store the old D's of the plane for client prediction support
 	fixed_t		predictD[CLIENT_PREDICTION_TICS];
 	fixed_t		restoreD;
 	fixed_t		predictMovingSpeed[CLIENT_PREDICTION_TICS]; // used to predict Elevator Jump properly
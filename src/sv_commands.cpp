@@ -255,6 +255,69 @@ void SERVERCOMMANDS_SpawnPlayer( ULONG ulPlayer, LONG lPlayerState, ULONG ulPlay
 	SERVERCOMMANDS_UpdateClientNetID( ulPlayer, true );
 }
 
+//*****************************************************************************
+//
+// The movement update of a player only depends on the recipient through
+// SERVER_IsPlayerVisible. While SERVER_WriteCommands sends the updates, both
+// variants of each player's command are serialized once and the finished
+// bytes are copied into the buffers of all clients.
+static struct
+{
+	NetCommand	*pFullCommand;
+	NetCommand	*pStubCommand;
+
+} g_MovePlayerCache[MAXPLAYERS];
+
+static	bool	g_bMovePlayerCacheActive = false;
+
+//*****************************************************************************
+//
+static void servercommands_SetupMovePlayer( ULONG ulPlayer, ServerCommands::MovePlayer &command )
+{
+	command.SetPlayer ( &players[ulPlayer] );
+	command.SetClientTicOnServerEnd ( SERVER_GetClient( ulPlayer )->ulClientGameTic );
+	command.SetIsVisible( true );
+	command.SetX( players[ulPlayer].mo->x );
+	command.SetY( players[ulPlayer].mo->y );
+	command.SetZ( players[ulPlayer].mo->z );
+	command.SetWaterlevel( players[ulPlayer].mo->waterlevel );
+	command.SetAngle( players[ulPlayer].mo->angle );
+	command.SetPitch( players[ulPlayer].mo->pitch );
+	command.SetVelx( players[ulPlayer].ServerXYZVel[0] );	// The server first moves the player, then calculates his friction, and then sends it to clients
+	command.SetVely( players[ulPlayer].ServerXYZVel[1] );	// As a result, clients calculate further movement with velocity value lower than what the server had
+	command.SetVelz( players[ulPlayer].ServerXYZVel[2] );	// So save pre-friction velocity and send that instead
+	command.SetUcmd_forwardmove( players[ulPlayer].cmd.ucmd.forwardmove );
+	command.SetUcmd_sidemove( players[ulPlayer].cmd.ucmd.sidemove );
+	command.SetUcmd_upmove( players[ulPlayer].cmd.ucmd.upmove );
+	command.SetUcmd_yaw( players[ulPlayer].cmd.ucmd.yaw );
+	command.SetUcmd_pitch( players[ulPlayer].cmd.ucmd.pitch );
+	// command.SetUcmd_roll( players[ulPlayer].cmd.ucmd.roll );
+	command.SetUcmd_buttons( players[ulPlayer].cmd.ucmd.buttons );
+}
+
+//*****************************************************************************
+//
+void SERVERCOMMANDS_BeginMovePlayerCache( void )
+{
+	SERVERCOMMANDS_EndMovePlayerCache( );
+	g_bMovePlayerCacheActive = true;
+}
+
+//*****************************************************************************
+//
+void SERVERCOMMANDS_EndMovePlayerCache( void )
+{
+	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+	{
+		delete g_MovePlayerCache[ulIdx].pFullCommand;
+		delete g_MovePlayerCache[ulIdx].pStubCommand;
+		g_MovePlayerCache[ulIdx].pFullCommand = NULL;
+		g_MovePlayerCache[ulIdx].pStubCommand = NULL;
+	}
+
+	g_bMovePlayerCacheActive = false;
+}
+
 //*****************************************************************************
 //
 void SERVERCOMMANDS_MovePlayer( ULONG ulPlayer, ULONG ulPlayerExtra, ServerCommandFlags flags )
@@ -262,26 +325,33 @@ void SERVERCOMMANDS_MovePlayer( ULONG ulPlayer, ULONG ulPlayerExtra, ServerComma
 	if ( PLAYER_IsValidPlayerWithMo( ulPlayer ) == false )
 		return;
 
+	if ( g_bMovePlayerCacheActive )
+	{
+		// Serialize the commands the first time this player is sent during this batch.
+		if ( g_MovePlayerCache[ulPlayer].pFullCommand == NULL )
+		{
+			ServerCommands::MovePlayer fullCommand;
+			servercommands_SetupMovePlayer( ulPlayer, fullCommand );
+
+			ServerCommands::MovePlayer stubCommand = fullCommand;
+			stubCommand.SetIsVisible( false );
+
+			g_MovePlayerCache[ulPlayer].pFullCommand = new NetCommand( fullCommand.BuildNetCommand( ));
+			g_MovePlayerCache[ulPlayer].pStubCommand = new NetCommand( stubCommand.BuildNetCommand( ));
+		}
+
+		for ( ClientIterator it ( ulPlayerExtra, flags ); it.notAtEnd(); ++it )
+		{
+			if ( SERVER_IsPlayerVisible( *it, ulPlayer ))
+				g_MovePlayerCache[ulPlayer].pFullCommand->sendCommandToOneClient( *it );
+			else
+				g_MovePlayerCache[ulPlayer].pStubCommand->sendCommandToOneClient( *it );
+		}
+		return;
+	}
+
 	ServerCommands::MovePlayer fullCommand;
-	fullCommand.SetPlayer ( &players[ulPlayer] );
-	fullCommand.SetClientTicOnServerEnd ( SERVER_GetClient( ulPlayer )->ulClientGameTic );
-	fullCommand.SetIsVisible( true );
-	fullCommand.SetX( players[ulPlayer].mo->x );
-	fullCommand.SetY( players[ulPlayer].mo->y );
-	fullCommand.SetZ( players[ulPlayer].mo->z );
-	fullCommand.SetWaterlevel( players[ulPlayer].mo->waterlevel );
-	fullCommand.SetAngle( players[ulPlayer].mo->angle );
-	fullCommand.SetPitch( players[ulPlayer].mo->pitch );
-	fullCommand.SetVelx( players[ulPlayer].ServerXYZVel[0] );	// The server first moves the player, then calculates his friction, and then sends it to clients
-	fullCommand.SetVely( players[ulPlayer].ServerXYZVel[1] );	// As a result, clients calculate further movement with velocity value lower than what the server had
-	fullCommand.SetVelz( players[ulPlayer].ServerXYZVel[2] );	// So save pre-friction velocity and send that instead
-	fullCommand.SetUcmd_forwardmove( players[ulPlayer].cmd.ucmd.forwardmove );
-	fullCommand.SetUcmd_sidemove( players[ulPlayer].cmd.ucmd.sidemove );
-	fullCommand.SetUcmd_upmove( players[ulPlayer].cmd.ucmd.upmove );
-	fullCommand.SetUcmd_yaw( players[ulPlayer].cmd.ucmd.yaw );
-	fullCommand.SetUcmd_pitch( players[ulPlayer].cmd.ucmd.pitch );
-	// fullCommand.SetUcmd_roll( players[ulPlayer].cmd.ucmd.roll );
-	fullCommand.SetUcmd_buttons( players[ulPlayer].cmd.ucmd.buttons );
+	servercommands_SetupMovePlayer( ulPlayer, fullCommand );
 
 	ServerCommands::MovePlayer stubCommand = fullCommand;
 	stubCommand.SetIsVisible( false );
@@ -123,6 +123,8 @@
 #include "d_protocol.h"
 #include "p_enemy.h"
 #include "network/packetarchive.h"
+#include "network/playersnapshot.h"
+#include "workerpool.h"
 #include "p_lnspec.h"
 #include "unlagged.h"
 
@@ -173,6 +175,8 @@ static	bool	server_CheckJoinPassword( const FString& clientPassword );
 static	bool	server_InfoCheat( BYTESTREAM_s* pByteStream );
 static	bool	server_CheckLogin( const ULONG ulClient );
 static	void	server_PrintWithIP( FString message, const NETADDRESS_s &address );
+static	void	server_SendClientPackets( unsigned int ulClient );
+static	void	server_SendAllClientPackets( void );
 
 // [RC]
 #ifdef CREATE_PACKET_LOG
@@ -352,6 +356,17 @@ CUSTOM_CVAR( String, sv_rconpassword, "", CVAR_ARCHIVE|CVAR_NOSETBYACS )
 	}
 }
 
+//*****************************************************************************
+//
+CUSTOM_CVAR( String, sv_relaypassword, "", CVAR_ARCHIVE|CVAR_NOSETBYACS )
+{
+	if ( strlen( self ) > 0 && strlen( self ) <= 4 )
+	{
+		Printf( "sv_relaypassword must be greater than 4 chars in length!\n" );
+		self = "";
+	}
+}
+
 //*****************************************************************************
 //
 CUSTOM_CVAR( Int, sv_maxpacketsize, 1024, CVAR_ARCHIVE )
@@ -377,6 +392,36 @@ CUSTOM_CVAR( Bool, sv_limitcommands, false, CVAR_ARCHIVE | CVAR_NOSETBYACS | CVA
 		SERVERCOMMANDS_SetGameModeLimits();
 }
 
+//*****************************************************************************
+// How many IPs the flood protection queue tracks, and how many launcher queries
+// or connection attempts an IP may send in a row before it's ignored.
+//
+EXTERN_CVAR( Int, sv_floodqueueburst )
+
+CUSTOM_CVAR( Int, sv_floodqueuesize, 8192, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+{
+	if ( self < 1 )
+	{
+		Printf( "sv_floodqueuesize must be positive.\n" );
+		self = 8192;
+		return;
+	}
+
+	g_floodProtectionIPQueue.setLimits( self, sv_floodqueueburst );
+}
+
+CUSTOM_CVAR( Int, sv_floodqueueburst, 1, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+{
+	if (( self < 1 ) || ( self > 10 ))
+	{
+		Printf( "sv_floodqueueburst must be between 1 and 10.\n" );
+		self = clamp<int>( self, 1, 10 );
+		return;
+	}
+
+	g_floodProtectionIPQueue.setLimits( sv_floodqueuesize, self );
+}
+
 //*****************************************************************************
 //	FUNCTIONS
 
@@ -541,6 +586,123 @@ void SERVER_Destruct( void )
 
 //DWORD	g_LastMS, g_LastSec, g_FrameCount, g_LastCount, g_LastTic;
 
+// On Linux, sleep until a packet arrives or the next tic is due instead of polling every millisecond.
+CVAR( Bool, sv_eventdriventick, false, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+
+// Counters for how well SERVER_Tick keeps up with the tic rate.
+static struct
+{
+	ULONG	ulTics;				// Tics run.
+	ULONG	ulOverruns;			// Times more than one tic was due at once.
+	ULONG	ulOverrunTics;		// Tics that had to be caught up on.
+	ULONG	ulPacketWakeups;	// Times a packet woke up the event driven scheduler.
+	ULONG	ulTimerWakeups;		// Times the tic deadline woke up the event driven scheduler.
+	QWORD	qwTotalLatenessUS;	// Sum of how late the timer wakeups were.
+	LONG	lMaxLatenessUS;		// Latest timer wakeup.
+} g_TicSchedulerStats;
+
+// Worker threads that build and encode the packets of the clients.
+static	WorkerPool					g_SendWorkers;
+
+// The packets the workers prepared for each client, and whether the client has to be kicked.
+static	NETWORK_OUTBOUNDQUEUE_s		g_OutboundQueues[MAXPLAYERS];
+static	bool						g_bKickForMissedPackets[MAXPLAYERS];
+
+CUSTOM_CVAR( Int, sv_sendthreads, 0, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+{
+	if (( self < 0 ) || ( self > 16 ))
+	{
+		Printf( "sv_sendthreads must be between 0 and 16.\n" );
+		self = clamp<int>( self, 0, 16 );
+		return;
+	}
+
+	g_SendWorkers.SetNumThreads( self );
+}
+
+//*****************************************************************************
+//
+// Returns the I_MSTime( ) at which tic lTic starts, i.e. the first millisecond
+// for which SERVER_Tick computes that tic.
+static unsigned int server_GetTicStartTime( LONG lTic )
+{
+	// Use the same computation as SERVER_Tick so that rounding can't make us wake up early.
+	unsigned int uiTime = static_cast<unsigned int> ( lTic * (( 1.0 / TICRATE ) * 1000.0 ));
+	while ( static_cast<LONG> ( uiTime / (( 1.0 / TICRATE ) * 1000.0 )) < lTic )
+		uiTime++;
+	return uiTime;
+}
+
+//*****************************************************************************
+//
+// The event driven scheduler counts tics on CLOCK_MONOTONIC, so that the timer
+// can be armed for the exact start of a tic instead of the next full
+// millisecond. The clock is anchored to I_MSTime( ) whenever the scheduler is
+// switched on, so both count the same tics.
+static	bool	g_bTicClockAnchored = false;
+static	QWORD	g_qwTicClockBaseNS;
+
+//*****************************************************************************
+//
+// Returns the CLOCK_MONOTONIC time at which tic lTic starts.
+static QWORD server_GetTicStartTimeNS( LONG lTic )
+{
+	// Round up so that the tic has really started when the timer expires.
+	return g_qwTicClockBaseNS + ( static_cast<QWORD>( lTic ) * 1000000000 + TICRATE - 1 ) / TICRATE;
+}
+
+//*****************************************************************************
+//
+// Computes the current tic and I_MSTime( ) like time. The tic clock is used if
+// bUseTicClock is true and the platform supports it, returns whether it was.
+static bool server_GetCurrentTic( bool bUseTicClock, LONG &lNowTime, LONG &lTic )
+{
+	QWORD qwNowNS;
+	if ( bUseTicClock && NETWORK_GetMonotonicTime( qwNowNS ))
+	{
+		if ( g_bTicClockAnchored == false )
+		{
+			g_qwTicClockBaseNS = qwNowNS - static_cast<QWORD>( I_MSTime( )) * 1000000;
+			g_bTicClockAnchored = true;
+		}
+
+		qwNowNS -= g_qwTicClockBaseNS;
+		lNowTime = static_cast<LONG> ( qwNowNS / 1000000 );
+		lTic = static_cast<LONG> ( qwNowNS * TICRATE / 1000000000 );
+		return true;
+	}
+
+	g_bTicClockAnchored = false;
+	lNowTime = I_MSTime( );
+	lTic = static_cast<LONG> ( lNowTime / (( 1.0 / TICRATE ) * 1000.0 ) );
+	return false;
+}
+
+//*****************************************************************************
+//
+ADD_STAT( ticscheduler )
+{
+	FString out;
+	const ULONG ulTimerWakeups = MAX<ULONG>( g_TicSchedulerStats.ulTimerWakeups, 1 );
+	out.Format( "%s: tics %lu, overruns %lu (%lu tics), wakeups %lu packet / %lu timer, lateness %.1f us avg / %ld us max",
+		sv_eventdriventick ? "event driven" : "polling",
+		g_TicSchedulerStats.ulTics, g_TicSchedulerStats.ulOverruns, g_TicSchedulerStats.ulOverrunTics,
+		g_TicSchedulerStats.ulPacketWakeups, g_TicSchedulerStats.ulTimerWakeups,
+		static_cast<double>( g_TicSchedulerStats.qwTotalLatenessUS ) / ulTimerWakeups, g_TicSchedulerStats.lMaxLatenessUS );
+	return out;
+}
+
+//*****************************************************************************
+//
+ADD_STAT( floodqueue )
+{
+	FString out;
+	out.Format( "Flood protection: %lu accepted, %lu dropped, %u / %u IPs tracked, %lu evicted",
+		g_floodProtectionIPQueue.getNumAccepted( ), g_floodProtectionIPQueue.getNumDropped( ),
+		g_floodProtectionIPQueue.size( ), g_floodProtectionIPQueue.getMaxEntries( ), g_floodProtectionIPQueue.getNumEvicted( ));
+	return out;
+}
+
 void			SERVERCONSOLE_UpdateStatistics( void );
 
 //*****************************************************************************
@@ -554,11 +716,13 @@ void SERVER_Tick( void )
 	LONG			lCurTics;
 	ULONG			ulIdx;
 
-	I_DoSelect();
+	// The event driven scheduler checks the console input itself, I_DoSelect would block for up to a tic.
+	const bool bEventDriven = sv_eventdriventick;
+	if ( bEventDriven == false )
+		I_DoSelect();
 	lPreviousTics = static_cast<LONG> ( g_lGameTime / (( 1.0 / TICRATE ) * 1000.0 ) );
 
-	lNowTime = I_MSTime( );
-	lNewTics = static_cast<LONG> ( lNowTime / (( 1.0 / TICRATE ) * 1000.0 ) );
+	const bool bTicClock = server_GetCurrentTic( bEventDriven, lNowTime, lNewTics );
 
 	lCurTics = lNewTics - lPreviousTics;
 	while ( lCurTics <= 0 )
@@ -567,12 +731,36 @@ void SERVER_Tick( void )
 		// for an accurate ping measurement.
 		SERVER_GetPackets( );
 
-		I_Sleep( 1 );
-		lNowTime = I_MSTime( );
-		lNewTics = static_cast<LONG> ( lNowTime / (( 1.0 / TICRATE ) * 1000.0 ) );
+		// Sleep until the next packet arrives or the next tic is due, whatever comes first.
+		bool bPacketReady, bTimerExpired;
+		LONG lLatenessUS;
+		if (( bTicClock == false ) || ( NETWORK_WaitForPackets( server_GetTicStartTimeNS( lPreviousTics + 1 ), bPacketReady, bTimerExpired, lLatenessUS ) == false ))
+			I_Sleep( 1 );
+		else
+		{
+			// Count by what actually woke us up, a timer can expire right on time.
+			if ( bTimerExpired )
+			{
+				g_TicSchedulerStats.ulTimerWakeups++;
+				g_TicSchedulerStats.qwTotalLatenessUS += lLatenessUS;
+				g_TicSchedulerStats.lMaxLatenessUS = MAX( g_TicSchedulerStats.lMaxLatenessUS, lLatenessUS );
+			}
+			if ( bPacketReady )
+				g_TicSchedulerStats.ulPacketWakeups++;
+		}
+
+		server_GetCurrentTic( bTicClock, lNowTime, lNewTics );
 		lCurTics = lNewTics - lPreviousTics;
 	}
 
+	// We're running behind if more than one tic is due.
+	g_TicSchedulerStats.ulTics += lCurTics;
+	if ( lCurTics > 1 )
+	{
+		g_TicSchedulerStats.ulOverruns++;
+		g_TicSchedulerStats.ulOverrunTics += lCurTics - 1;
+	}
+
 #ifdef NO_SERVER_GUI
 	// console input
 	char *cmd = I_ConsoleInput();
@@ -634,17 +822,14 @@ void SERVER_Tick( void )
 		// Send out player's true position, etc.
 		SERVER_WriteCommands( );
 
-		// Check everyone's PacketBuffer for anything that needs to be sent.
-		SERVER_SendOutPackets( );
+		// Queue this tic's packets, if sv_batchsocketio is on, so that they can be sent with a single system call.
+		NETWORK_BeginOutboundBatch( );
 
+		// Check everyone's PacketBuffer for anything that needs to be sent.
 		// [BB] Send out sheduled packets, respecting sv_maxpacketspertick.
-		for ( ulIdx = 0; ulIdx < MAXPLAYERS; ulIdx++ )
-		{
-			if ( g_aClients[ulIdx].State == CLS_FREE )
-				continue;
+		server_SendAllClientPackets( );
 
-			SERVER_GetClient ( ulIdx )->SavedPackets.Tick ( );
-		}
+		NETWORK_FlushOutboundBatch( );
 
 		// Potentially send an update to the master server.
 		SERVER_MASTER_Tick( );
@@ -742,6 +927,11 @@ void SERVER_Tick( void )
 */
 	g_lGameTime = lNowTime;
 
+	// The tic clock can start a tic before the millisecond it falls into is over,
+	// make sure that g_lGameTime already counts it so that it's not run again.
+	if ( bTicClock )
+		g_lGameTime = MAX<LONG>( g_lGameTime, server_GetTicStartTime( lNewTics ));
+
 	// [BB] Remove IP adresses from g_floodProtectionIPQueue that have been in there long enough.
 	g_floodProtectionIPQueue.adjustHead ( g_lGameTime / 1000 );
 
@@ -775,6 +965,74 @@ void SERVER_SendOutPackets( void )
 	}
 }
 
+//*****************************************************************************
+//
+// Sends everything that is waiting for the client, including the packets that
+// are scheduled in its SavedPackets. Only touches the state of this client, so
+// that it can run for several clients at once.
+static void server_SendClientPackets( unsigned int ulClient )
+{
+	g_bKickForMissedPackets[ulClient] = false;
+
+	if ( SERVER_IsValidClient( ulClient ))
+	{
+		if ( g_aClients[ulClient].PacketBuffer.CalcSize() > 0 )
+			SERVER_SendClientPacket( ulClient, true );
+
+		if ( g_aClients[ulClient].UnreliablePacketBuffer.CalcSize() > 0 )
+			SERVER_SendClientPacket( ulClient, false );
+	}
+
+	if ( g_aClients[ulClient].State != CLS_FREE )
+		g_bKickForMissedPackets[ulClient] = ( g_aClients[ulClient].SavedPackets.Tick( ) == false );
+}
+
+//*****************************************************************************
+//
+static void server_SendClientPacketsToQueue( unsigned int ulClient )
+{
+	NETWORK_SetOutboundQueue( &g_OutboundQueues[ulClient] );
+	server_SendClientPackets( ulClient );
+	NETWORK_SetOutboundQueue( NULL );
+}
+
+//*****************************************************************************
+//
+// With sv_sendthreads, the packets of the clients are built and Huffman encoded
+// on worker threads. The main thread then sends the finished packets.
+//
+// A worker only touches the state of its own client: PacketBuffer,
+// UnreliablePacketBuffer, SavedPackets and its NETWORK_OUTBOUNDQUEUE_s. Other
+// than that it only reads CVARs and NETWORK_AUTH_GetCachedServerAddress.
+// Anything called on this path must not use Printf, the GC, TArray or other
+// M_Malloc based containers, since M_Malloc updates GC::AllocBytes without
+// synchronization. Use std containers or new instead. Sending the packets,
+// the traffic statistics and kicking clients are left to the main thread.
+static void server_SendAllClientPackets( void )
+{
+	if ( g_SendWorkers.GetNumThreads( ) == 0 )
+	{
+		for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+			server_SendClientPackets( ulIdx );
+	}
+	else
+	{
+		// NETWORK_LaunchPacket needs this. Make sure the workers only have to read it.
+		NETWORK_AUTH_GetCachedServerAddress( );
+
+		g_SendWorkers.ParallelFor( MAXPLAYERS, server_SendClientPacketsToQueue );
+
+		for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+			NETWORK_SendOutboundQueue( g_OutboundQueues[ulIdx] );
+	}
+
+	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
+	{
+		if ( g_bKickForMissedPackets[ulIdx] )
+			SERVER_KickPlayer( ulIdx, "Too many missed packets." );
+	}
+}
+
 //*****************************************************************************
 //
 void SERVER_SendClientPacket( ULONG ulClient, bool bReliable )
@@ -1245,6 +1503,10 @@ bool SERVER_PerformAuthenticationChecksum( BYTESTREAM_s *pByteStream )
 
 	clientBehaviorString = NETWORK_ReadString( pByteStream );
 
+	// Relays don't have the map, they only pass the stream on to their viewers.
+	if ( g_aClients[g_lCurrentClient].bRelay )
+		return ( true );
+
 	// Checksums did not match! Therefore, the level authentication has failed.
 	if (( serverVertexString.Compare( clientVertexString ) != 0 ) ||
 		( serverLinedefString.Compare( clientLinedefString ) != 0 ) ||
@@ -1625,8 +1887,9 @@ void SERVER_DetermineConnectionType( BYTESTREAM_s *pByteStream )
 	ULONG	ulTime;
 	LONG	lCommand;
 
-	// If either this IP is in our flood protection queue, or the queue is full (DOS), ignore the request.
-	if ( g_floodProtectionIPQueue.isFull( ) || g_floodProtectionIPQueue.addressInQueue( NETWORK_GetFromAddress( )))
+	// If this IP is in our flood protection queue, ignore the request. When the queue is full (DOS),
+	// new IPs replace the ones that would expire first, so legitimate clients still get through.
+	if ( g_floodProtectionIPQueue.addressInQueue( NETWORK_GetFromAddress( )))
 		return;
 
 	lCommand = NETWORK_ReadByte( pByteStream );
@@ -1901,6 +2164,9 @@ void SERVER_SetupNewConnection( BYTESTREAM_s *pByteStream, bool bNewPlayer )
 	// [TP] Save whether or not the player wants to hide his account.
 	g_aClients[lClient].WantHideAccount = !!NETWORK_ReadByte( pByteStream );
 
+	// Relays are checked against sv_relaypassword further down.
+	g_aClients[lClient].bRelay = false;
+
 	// Read in the client's network game version.
 	clientNetworkGameVersion = NETWORK_ReadByte( pByteStream );
 
@@ -1946,8 +2212,23 @@ void SERVER_SetupNewConnection( BYTESTREAM_s *pByteStream, bool bNewPlayer )
 	if ( bNewPlayer )
 		g_aClients[lClient].ulLastCommandTic = g_aClients[lClient].ulLastGameTic = gametic;
 
+	// A spectator relay has to know the relay password, which also lets it past sv_forcepassword.
+	if ( connectFlags & CCF_RELAY )
+	{
+		strcpy( szServerPassword, sv_relaypassword );
+
+		if (( strlen( szServerPassword ) == 0 ) || ( strcmp( strupr( szServerPassword ), clientPassword.GetChars() ) != 0 ))
+		{
+			SERVER_ClientError( lClient, NETWORK_ERRORCODE_WRONGPASSWORD );
+			return;
+		}
+
+		// Relays only ever watch.
+		g_aClients[lClient].bRelay = true;
+		g_aClients[lClient].bWantStartAsSpectator = true;
+	}
 	// Check if we require a password to join this server.
-	if ( sv_forcepassword && ( strlen( sv_password ) > 0 ))
+	else if ( sv_forcepassword && ( strlen( sv_password ) > 0 ))
 	{
 		// Store password in temporary buffer (becuase we strupr it).
 		strcpy( szServerPassword, sv_password );
@@ -1970,7 +2251,10 @@ void SERVER_SetupNewConnection( BYTESTREAM_s *pByteStream, bool bNewPlayer )
 		return;
 	}
 
-	if ( sv_pure && strcmp ( NETWORK_ReadString( pByteStream ), g_lumpsAuthenticationChecksum.GetChars() ) )
+	// A relay doesn't load any lumps, it just passes our stream on.
+	if ( g_aClients[lClient].bRelay )
+		NETWORK_ReadString( pByteStream );
+	else if ( sv_pure && strcmp ( NETWORK_ReadString( pByteStream ), g_lumpsAuthenticationChecksum.GetChars() ) )
 	{
 		// Client fails the lump authentication.
 		SERVER_ClientError( lClient, NETWORK_ERRORCODE_PROTECTED_LUMP_AUTHENTICATIONFAILED );
@@ -2021,6 +2305,7 @@ void SERVER_SetupNewConnection( BYTESTREAM_s *pByteStream, bool bNewPlayer )
 	// [CK] Since the client is not up to date at all, the farthest the client
 	// should be able to go back is the gametic they connected with.
 	g_aClients[lClient].lLastServerGametic = gametic;
+	PLAYERSNAPSHOT_ClearClient( lClient );
 
 	SERVER_InitClientSRPData ( lClient );
 
@@ -2778,6 +3063,9 @@ void SERVER_WriteCommands( void )
 	// Ping clients and stuff.
 	SERVER_SendHeartBeat( );
 
+	// Serialize every player's movement update only once for all recipients.
+	SERVERCOMMANDS_BeginMovePlayerCache( );
+
 	for ( ULONG ulIdx = 0; ulIdx < MAXPLAYERS; ++ulIdx )
 	{
 		// [BB] Only clients need to be informed about player movement.
@@ -2793,7 +3081,12 @@ void SERVER_WriteCommands( void )
 
 		// See if any players need to be updated to clients.
 		// [BB] Only necessary if we are in a level.
-		if ( gamestate == GS_LEVEL )
+		if (( gamestate == GS_LEVEL ) && PLAYERSNAPSHOT_IsEnabled( ))
+		{
+			// Send the movement of all players as one delta compressed snapshot.
+			PLAYERSNAPSHOT_SendToClient( ulIdx );
+		}
+		else if ( gamestate == GS_LEVEL )
 		{
 			for ( ULONG ulPlayer = 0; ulPlayer < MAXPLAYERS; ulPlayer++ )
 			{
@@ -2831,6 +3124,8 @@ void SERVER_WriteCommands( void )
 		SERVERCOMMANDS_MoveLocalPlayer( ulIdx );
 	}
 
+	SERVERCOMMANDS_EndMovePlayerCache( );
+
 	// Once every four seconds, update each player's ping.
 	if (( gametic % ( 4 * TICRATE )) == 0 )
 	{
@@ -3473,6 +3768,13 @@ void SERVER_ReconnectNewLevel( const char *pszMapName )
 {
 	ULONG	ulIdx;
 
+	// Relays can't parse the stream, so the map change has to start a packet for them to see it.
+	for ( ulIdx = 0; ulIdx < MAXPLAYERS; ulIdx++ )
+	{
+		if ( SERVER_IsValidClient( ulIdx ) && g_aClients[ulIdx].bRelay )
+			SERVER_SendClientPacket( ulIdx, true );
+	}
+
 	// Tell clients to reconnect, and that the upcoming map will be pszMapName.
 	SERVERCOMMANDS_MapNew( pszMapName );
 
@@ -5232,6 +5534,7 @@ ClientMoveCommand::ClientMoveCommand ( BYTESTREAM_s *pByteStream )
 	// do reasonable sanity checks on the tic here. Instead this is done
 	// when processing the command.
 	moveCmd.ulServerGametic = NETWORK_ReadLong( pByteStream );
+	moveCmd.lSnapshotTic = NETWORK_ReadLong( pByteStream );
 
 	// Read in the information the client is sending us.
 	const ULONG ulBits = NETWORK_ReadByte( pByteStream );
@@ -5301,6 +5604,8 @@ bool ClientMoveCommand::process( const ULONG ulClient ) const
 	if ( ( moveCmd.ulServerGametic <= unsigned ( gametic ) ) && ( unsigned ( g_aClients[ulClient].lLastServerGametic ) < moveCmd.ulServerGametic ) )
 		g_aClients[ulClient].lLastServerGametic = moveCmd.ulServerGametic; // [CK] Use the gametic from what we saw
 
+	PLAYERSNAPSHOT_AcknowledgeTic( ulClient, moveCmd.lSnapshotTic );
+
 	// If the client is attacking, he always sends the name of the weapon he's using.
 	if ( pCmd->ucmd.buttons & BT_ATTACK )
 	{
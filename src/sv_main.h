@@ -188,6 +188,9 @@ struct CLIENT_MOVE_COMMAND_s
 	ULONG				ulGametic;
 	ULONG			ulServerGametic;
 
+	// The latest player snapshot the client received completely.
+	LONG			lSnapshotTic;
+
 	// [BB] We want to process the command from the lowest gametic first.
 	// This puts the lowest gametic on top of the queue. 
 	bool operator<(const CLIENT_MOVE_COMMAND_s& other) const {
@@ -261,6 +264,9 @@ struct CLIENT_s
 	// [TP] Client doesn't want his account to be revealed to the other players.
 	bool			WantHideAccount;
 
+	// Client is a spectator relay that passes our stream on to its own viewers.
+	bool			bRelay;
+
 	// [BB] Did the client not yet acknowledge receiving the last full update?
 	bool			bFullUpdateIncomplete;
 
@@ -42,6 +42,7 @@ INTBOOL CheckActorFlag(const AActor *owner, const char *flagname, bool printerro
 //
 //==========================================================================
 class FxExpression;
+class FxExpressionCode;
 
 struct FStateLabels;
 
@@ -124,6 +125,8 @@ struct FStateExpression
 	const PClass *owner;
 	bool constant;
 	bool cloned;
+	BYTE compiled;					// bit mask of the code[] entries that have been tried
+	FxExpressionCode *code[3];		// compiled for EvalExpressionI, F and Fix
 };
 
 class FStateExpressions
@@ -139,6 +142,7 @@ public:
 	void Copy(int dest, int src, int cnt);
 	int ResolveAll();
 	FxExpression *Get(int no);
+	FxExpressionCode *GetCode(int no, int type);
 	unsigned int Size() { return expressions.Size(); }
 };
 
@@ -143,6 +143,106 @@ struct ExpVal
 };
 
 
+//==========================================================================
+//
+// Expression bytecode
+//
+// Resolved expression trees are lowered into a flat, typed stack code
+// the first time an action function asks for a value. Every node emits
+// its value already converted the way its parent would have converted
+// the ExpVal (GetInt, GetFloat, GetBool...), so no boxing is needed.
+// Nodes without a native translation are called through EvalExpression.
+//
+//==========================================================================
+
+enum EEmitType
+{
+	EMIT_Int,
+	EMIT_Float,
+	EMIT_Fixed,		// as returned by EvalExpressionFix
+	EMIT_Bool,
+	EMIT_Pointer,
+
+	NUM_ROOT_EMIT_TYPES = EMIT_Bool
+};
+
+enum EExpOp
+{
+	XOP_RET,
+	XOP_PUSHI, XOP_PUSHF, XOP_PUSHP, XOP_SELF,
+	XOP_EVAL,					// calls Value.pointer's EvalExpression, Arg is the EEmitType
+	XOP_I2F, XOP_I2X, XOP_I2B, XOP_F2I, XOP_F2X, XOP_F2B, XOP_ZERO,
+	XOP_NEGI, XOP_NEGF, XOP_NOTI, XOP_NOTB, XOP_ABSI, XOP_ABSF,
+	XOP_ADDI, XOP_SUBI, XOP_MULI, XOP_DIVI, XOP_MODI,
+	XOP_ADDF, XOP_SUBF, XOP_MULF, XOP_DIVF, XOP_MODF,
+	XOP_LTI, XOP_GTI, XOP_GEI, XOP_LEI, XOP_EQI, XOP_NEI,
+	XOP_LTF, XOP_GTF, XOP_GEF, XOP_LEF, XOP_EQF, XOP_NEF,
+	XOP_SHL, XOP_SHR, XOP_USHR, XOP_AND, XOP_OR, XOP_XOR,
+	XOP_JMP, XOP_JZ, XOP_JNZ,	// Arg is the target instruction
+	XOP_RANDOM, XOP_RANDOM0, XOP_RANDOM2, XOP_FRANDOM,	// Value.pointer is the FRandom
+	XOP_ARANDOM, XOP_ARANDOM0, XOP_ARANDOM2, XOP_AFRANDOM,
+	XOP_RANGEF,					// scales a [0,1) random into [min,max]
+	XOP_LOADI, XOP_LOADB, XOP_LOADF, XOP_LOADX, XOP_LOADA, XOP_ADDRESS,	// Arg is the member offset
+	XOP_ARRAYI,					// Arg is the array size
+	XOP_SIN, XOP_COS, XOP_SQRT,
+};
+
+union FExpStackValue
+{
+	int Int;
+	double Float;
+	void *pointer;
+};
+
+struct FExpInstruction
+{
+	int Op;
+	int Arg;
+	FExpStackValue Value;
+};
+
+class FxExpression;
+
+class FxEmitter
+{
+public:
+	FxEmitter();
+
+	void Expression (FxExpression *x, EEmitType want);
+	void Constant (const ExpVal &val, EEmitType want);
+	void Fallback (FxExpression *x, EEmitType want);
+	void Convert (EEmitType from, EEmitType to);
+
+	void Emit (int op, int pushes = 0, int pops = 0, int arg = 0);
+	void EmitInt (int op, int value);
+	void EmitFloat (int op, double value);
+	void EmitPointer (int op, void *value, int pushes = 0, int pops = 0, int arg = 0);
+	int EmitJump (int op);
+	void BindJump (int jump);
+	void SetDepth (int depth) { Depth = depth; }
+	int GetDepth () const { return Depth; }
+
+	TArray<FExpInstruction> Code;
+	int MaxDepth;
+
+private:
+	int Depth;
+	unsigned int LabelPos;
+};
+
+class FxExpressionCode
+{
+public:
+	static FxExpressionCode *Compile (FxExpression *x, EEmitType type);
+	FExpStackValue Exec (AActor *self) const;
+
+private:
+	enum { MAX_STACK = 32 };
+
+	TArray<FExpInstruction> Code;
+};
+
+
 //==========================================================================
 //
 //
@@ -163,6 +263,7 @@ public:
 	FxExpression *ResolveAsBoolean(FCompileContext &ctx);
 	
 	virtual ExpVal EvalExpression (AActor *self);
+	virtual void Emit (FxEmitter &emit, EEmitType want);
 	virtual bool isConstant() const;
 	virtual void RequestAddress();
 
@@ -310,6 +411,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 
@@ -344,6 +446,7 @@ public:
 	~FxMinusSign();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -361,6 +464,7 @@ public:
 	~FxUnaryNotBitwise();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -378,6 +482,7 @@ public:
 	~FxUnaryNotBoolean();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -411,6 +516,7 @@ public:
 	FxAddSub(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -426,6 +532,7 @@ public:
 	FxMulDiv(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -441,6 +548,7 @@ public:
 	FxCompareRel(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -456,6 +564,7 @@ public:
 	FxCompareEq(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -471,6 +580,7 @@ public:
 	FxBinaryInt(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -491,6 +601,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -511,6 +622,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -530,6 +642,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -551,6 +664,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -564,6 +678,7 @@ class FxFRandom : public FxRandom
 public:
 	FxFRandom(FRandom *, FxExpression *mi, FxExpression *ma, const FScriptPosition &pos);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -584,6 +699,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 
@@ -605,6 +721,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -618,6 +735,7 @@ class FxAFRandom : public FxARandom
 public:
 	FxAFRandom(FxExpression *mi, FxExpression *ma, const FScriptPosition &pos);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -637,6 +755,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 
@@ -656,6 +775,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -676,6 +796,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -690,6 +811,7 @@ public:
 	FxSelf(const FScriptPosition&);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 //==========================================================================
@@ -710,6 +832,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	//void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxEmitter &emit, EEmitType want);
 };
 
 
@@ -857,6 +980,7 @@ public:
 
 
 FxExpression *ParseExpression (FScanner &sc, PClass *cls);
+ExpVal handleClientDivisionByZero ( void );
 
 
 #endif
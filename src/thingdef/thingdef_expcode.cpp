@@ -0,0 +1,553 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: thingdef_expcode.cpp
+//
+// Description: Flat bytecode for resolved DECORATE expressions
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+
+#include "actor.h"
+#include "tarray.h"
+#include "tables.h"
+#include "m_fixed.h"
+#include "i_system.h"
+#include "c_cvars.h"
+#include "thingdef.h"
+#include "thingdef_exp.h"
+#include "network.h"
+
+EXTERN_CVAR (Bool, sv_showactorrandom)
+
+//==========================================================================
+//
+// FxEmitter
+//
+//==========================================================================
+
+FxEmitter::FxEmitter()
+{
+	Depth = 0;
+	MaxDepth = 0;
+	LabelPos = ~0u;
+}
+
+//==========================================================================
+//
+// Emits x so that it leaves its value on the stack as want.
+// Constants are folded right here.
+//
+//==========================================================================
+
+void FxEmitter::Expression (FxExpression *x, EEmitType want)
+{
+	if (x->isConstant())
+	{
+		Constant (x->EvalExpression (NULL), want);
+	}
+	else
+	{
+		x->Emit (*this, want);
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxEmitter::Constant (const ExpVal &val, EEmitType want)
+{
+	switch (want)
+	{
+	case EMIT_Int:
+		EmitInt (XOP_PUSHI, val.GetInt());
+		break;
+
+	case EMIT_Float:
+		EmitFloat (XOP_PUSHF, val.GetFloat());
+		break;
+
+	case EMIT_Fixed:
+		EmitInt (XOP_PUSHI, val.Type == VAL_Int ? val.Int << FRACBITS :
+			val.Type == VAL_Float ? fixed_t(val.Float * FRACUNIT) : 0);
+		break;
+
+	case EMIT_Bool:
+		EmitInt (XOP_PUSHI, val.GetBool());
+		break;
+
+	case EMIT_Pointer:
+		EmitPointer (XOP_PUSHP, val.GetPointer<void>(), 1);
+		break;
+	}
+}
+
+//==========================================================================
+//
+// For nodes that have no translation: the interpreter calls the node's
+// EvalExpression and converts the result the way the tree walker would.
+//
+//==========================================================================
+
+void FxEmitter::Fallback (FxExpression *x, EEmitType want)
+{
+	EmitPointer (XOP_EVAL, x, 1, 0, want);
+}
+
+//==========================================================================
+//
+// Converts a value emitted as one type into another.
+//
+//==========================================================================
+
+void FxEmitter::Convert (EEmitType from, EEmitType to)
+{
+	if (from == to)
+	{
+		return;
+	}
+
+	// Fold into the constant that was just pushed, unless a jump lands
+	// behind it.
+	if (Code.Size() > 0 && LabelPos != Code.Size())
+	{
+		FExpInstruction &last = Code[Code.Size() - 1];
+
+		if (last.Op == XOP_PUSHI && from == EMIT_Int)
+		{
+			switch (to)
+			{
+			case EMIT_Float:	last.Op = XOP_PUSHF; last.Value.Float = double(last.Value.Int); return;
+			case EMIT_Fixed:	last.Value.Int <<= FRACBITS; return;
+			case EMIT_Bool:		last.Value.Int = !!last.Value.Int; return;
+			default:			break;
+			}
+		}
+		else if (last.Op == XOP_PUSHF && from == EMIT_Float)
+		{
+			double f = last.Value.Float;
+
+			switch (to)
+			{
+			case EMIT_Int:		last.Op = XOP_PUSHI; last.Value.Int = int(f); return;
+			case EMIT_Fixed:	last.Op = XOP_PUSHI; last.Value.Int = fixed_t(f * FRACUNIT); return;
+			case EMIT_Bool:		last.Op = XOP_PUSHI; last.Value.Int = f != 0.; return;
+			default:			break;
+			}
+		}
+	}
+
+	if (from == EMIT_Pointer || to == EMIT_Pointer)
+	{
+		// Pointers read as 0 and numbers as NULL.
+		Emit (XOP_ZERO);
+		return;
+	}
+
+	switch (from)
+	{
+	case EMIT_Int:
+	case EMIT_Bool:
+		Emit (to == EMIT_Float ? XOP_I2F : to == EMIT_Fixed ? XOP_I2X : XOP_I2B);
+		break;
+
+	case EMIT_Float:
+		Emit (to == EMIT_Int ? XOP_F2I : to == EMIT_Fixed ? XOP_F2X : XOP_F2B);
+		break;
+
+	default:
+		assert(false);
+		break;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxEmitter::Emit (int op, int pushes, int pops, int arg)
+{
+	FExpInstruction &ins = Code[Code.Reserve(1)];
+
+	ins.Op = op;
+	ins.Arg = arg;
+	ins.Value.pointer = NULL;
+
+	Depth += pushes - pops;
+	if (Depth > MaxDepth)
+	{
+		MaxDepth = Depth;
+	}
+}
+
+void FxEmitter::EmitInt (int op, int value)
+{
+	Emit (op, 1);
+	Code[Code.Size() - 1].Value.Int = value;
+}
+
+void FxEmitter::EmitFloat (int op, double value)
+{
+	Emit (op, 1);
+	Code[Code.Size() - 1].Value.Float = value;
+}
+
+void FxEmitter::EmitPointer (int op, void *value, int pushes, int pops, int arg)
+{
+	Emit (op, pushes, pops, arg);
+	Code[Code.Size() - 1].Value.pointer = value;
+}
+
+//==========================================================================
+//
+// Conditional jumps pop their operand. The target is set by BindJump.
+//
+//==========================================================================
+
+int FxEmitter::EmitJump (int op)
+{
+	Emit (op, 0, op == XOP_JMP ? 0 : 1);
+	return Code.Size() - 1;
+}
+
+void FxEmitter::BindJump (int jump)
+{
+	Code[jump].Arg = Code.Size();
+	LabelPos = Code.Size();
+}
+
+//==========================================================================
+//
+// FxExpressionCode :: Compile
+//
+// Returns NULL if the expression needs more stack than Exec provides.
+//
+//==========================================================================
+
+FxExpressionCode *FxExpressionCode::Compile (FxExpression *x, EEmitType type)
+{
+	FxEmitter emit;
+
+	emit.Expression (x, type);
+	emit.Emit (XOP_RET, 0, 1);
+
+	if (emit.MaxDepth > MAX_STACK)
+	{
+		return NULL;
+	}
+
+	FxExpressionCode *code = new FxExpressionCode;
+	code->Code = emit.Code;
+	code->Code.ShrinkToFit();
+	return code;
+}
+
+//==========================================================================
+//
+// FxExpressionCode :: Exec
+//
+//==========================================================================
+
+static void ShowActorRandom (AActor *self, const char *func)
+{
+	Printf("Checking random for \"%s\" in \"%s\" : %d\n", self->GetClass()->TypeName.GetChars( ), func, self->actorRandom());
+}
+
+FExpStackValue FxExpressionCode::Exec (AActor *self) const
+{
+	FExpStackValue stack[MAX_STACK];
+	FExpStackValue *sp = stack - 1;		// points at the top value
+	const FExpInstruction *pc = &Code[0];
+
+	for (;; ++pc)
+	{
+		switch (pc->Op)
+		{
+		default:
+		case XOP_RET:
+			return *sp;
+
+		case XOP_PUSHI:		(++sp)->Int = pc->Value.Int;		break;
+		case XOP_PUSHF:		(++sp)->Float = pc->Value.Float;	break;
+		case XOP_PUSHP:		(++sp)->pointer = pc->Value.pointer;	break;
+		case XOP_SELF:		(++sp)->pointer = self;				break;
+
+		case XOP_EVAL:
+		{
+			ExpVal val = static_cast<FxExpression *>(pc->Value.pointer)->EvalExpression (self);
+
+			++sp;
+			switch (pc->Arg)
+			{
+			case EMIT_Int:		sp->Int = val.GetInt(); break;
+			case EMIT_Float:	sp->Float = val.GetFloat(); break;
+			case EMIT_Bool:		sp->Int = val.GetBool(); break;
+			case EMIT_Pointer:	sp->pointer = val.GetPointer<void>(); break;
+			case EMIT_Fixed:
+				sp->Int = val.Type == VAL_Int ? val.Int << FRACBITS :
+					val.Type == VAL_Float ? fixed_t(val.Float * FRACUNIT) : 0;
+				break;
+			}
+			break;
+		}
+
+		case XOP_I2F:	sp->Float = double(sp->Int);			break;
+		case XOP_I2X:	sp->Int <<= FRACBITS;					break;
+		case XOP_I2B:	sp->Int = !!sp->Int;					break;
+		case XOP_F2I:	sp->Int = int(sp->Float);				break;
+		case XOP_F2X:	sp->Int = fixed_t(sp->Float * FRACUNIT);	break;
+		case XOP_F2B:	sp->Int = sp->Float != 0.;				break;
+		case XOP_ZERO:	memset (sp, 0, sizeof(*sp));			break;
+
+		case XOP_NEGI:	sp->Int = -sp->Int;						break;
+		case XOP_NEGF:	sp->Float = -sp->Float;					break;
+		case XOP_NOTI:	sp->Int = ~sp->Int;						break;
+		case XOP_NOTB:	sp->Int = !sp->Int;						break;
+		case XOP_ABSI:	sp->Int = abs(sp->Int);					break;
+		case XOP_ABSF:	sp->Float = fabs(sp->Float);			break;
+
+		case XOP_ADDI:	sp--; sp->Int = sp->Int + sp[1].Int;	break;
+		case XOP_SUBI:	sp--; sp->Int = sp->Int - sp[1].Int;	break;
+		case XOP_MULI:	sp--; sp->Int = sp->Int * sp[1].Int;	break;
+		case XOP_ADDF:	sp--; sp->Float = sp->Float + sp[1].Float;	break;
+		case XOP_SUBF:	sp--; sp->Float = sp->Float - sp[1].Float;	break;
+		case XOP_MULF:	sp--; sp->Float = sp->Float * sp[1].Float;	break;
+
+		case XOP_DIVI:
+		case XOP_MODI:
+			sp--;
+			if (sp[1].Int == 0)
+			{
+				// [BB] Due to Zandronum's jump handling, valid code can cause this on the clients.
+				if ( NETWORK_GetState( ) == NETSTATE_CLIENT )
+				{
+					memset (sp, 0, sizeof(*sp));
+					handleClientDivisionByZero();
+					break;
+				}
+				I_Error("Division by 0");
+			}
+			sp->Int = pc->Op == XOP_DIVI ? sp->Int / sp[1].Int : sp->Int % sp[1].Int;
+			break;
+
+		case XOP_DIVF:
+		case XOP_MODF:
+			sp--;
+			if (sp[1].Float == 0)
+			{
+				if ( NETWORK_GetState( ) == NETSTATE_CLIENT )
+				{
+					memset (sp, 0, sizeof(*sp));
+					handleClientDivisionByZero();
+					break;
+				}
+				I_Error("Division by 0");
+			}
+			sp->Float = pc->Op == XOP_DIVF ? sp->Float / sp[1].Float : fmod(sp->Float, sp[1].Float);
+			break;
+
+		case XOP_LTI:	sp--; sp->Int = sp->Int < sp[1].Int;	break;
+		case XOP_GTI:	sp--; sp->Int = sp->Int > sp[1].Int;	break;
+		case XOP_GEI:	sp--; sp->Int = sp->Int >= sp[1].Int;	break;
+		case XOP_LEI:	sp--; sp->Int = sp->Int <= sp[1].Int;	break;
+		case XOP_EQI:	sp--; sp->Int = sp->Int == sp[1].Int;	break;
+		case XOP_NEI:	sp--; sp->Int = sp->Int != sp[1].Int;	break;
+		case XOP_LTF:	sp--; sp->Int = sp->Float < sp[1].Float;	break;
+		case XOP_GTF:	sp--; sp->Int = sp->Float > sp[1].Float;	break;
+		case XOP_GEF:	sp--; sp->Int = sp->Float >= sp[1].Float;	break;
+		case XOP_LEF:	sp--; sp->Int = sp->Float <= sp[1].Float;	break;
+		case XOP_EQF:	sp--; sp->Int = sp->Float == sp[1].Float;	break;
+		case XOP_NEF:	sp--; sp->Int = sp->Float != sp[1].Float;	break;
+
+		case XOP_SHL:	sp--; sp->Int = sp->Int << sp[1].Int;	break;
+		case XOP_SHR:	sp--; sp->Int = sp->Int >> sp[1].Int;	break;
+		case XOP_USHR:	sp--; sp->Int = int((unsigned int)(sp->Int) >> sp[1].Int);	break;
+		case XOP_AND:	sp--; sp->Int = sp->Int & sp[1].Int;	break;
+		case XOP_OR:	sp--; sp->Int = sp->Int | sp[1].Int;	break;
+		case XOP_XOR:	sp--; sp->Int = sp->Int ^ sp[1].Int;	break;
+
+		case XOP_JMP:
+			pc = &Code[pc->Arg] - 1;
+			break;
+
+		case XOP_JZ:
+			if ((sp--)->Int == 0)
+				pc = &Code[pc->Arg] - 1;
+			break;
+
+		case XOP_JNZ:
+			if ((sp--)->Int != 0)
+				pc = &Code[pc->Arg] - 1;
+			break;
+
+		case XOP_RANDOM:
+		{
+			int minval = sp[-1].Int;
+			int maxval = sp[0].Int;
+
+			if (maxval < minval)
+			{
+				swapvalues (maxval, minval);
+			}
+			sp--;
+			sp->Int = (*static_cast<FRandom *>(pc->Value.pointer))(maxval - minval + 1) + minval;
+			break;
+		}
+
+		case XOP_RANDOM0:
+			(++sp)->Int = (*static_cast<FRandom *>(pc->Value.pointer))();
+			break;
+
+		case XOP_RANDOM2:
+			sp->Int = static_cast<FRandom *>(pc->Value.pointer)->Random2(sp->Int);
+			break;
+
+		case XOP_FRANDOM:
+			(++sp)->Float = (*static_cast<FRandom *>(pc->Value.pointer))(0x40000000) / double(0x40000000);
+			break;
+
+		case XOP_ARANDOM:
+		{
+			int minval = sp[-1].Int;
+			int maxval = sp[0].Int;
+
+			if (maxval < minval)
+			{
+				swapvalues (maxval, minval);
+			}
+			if ( sv_showactorrandom )
+				ShowActorRandom (self, "arandom");
+			sp--;
+			sp->Int = self->actorRandom(maxval - minval + 1) + minval;
+			break;
+		}
+
+		case XOP_ARANDOM0:
+			if ( sv_showactorrandom )
+				ShowActorRandom (self, "arandom");
+			(++sp)->Int = self->actorRandom();
+			break;
+
+		case XOP_ARANDOM2:
+			if ( sv_showactorrandom )
+				ShowActorRandom (self, "arandom2");
+			sp->Int = self->actorRandom.Random2(sp->Int);
+			break;
+
+		case XOP_AFRANDOM:
+			if ( sv_showactorrandom )
+				ShowActorRandom (self, "afrandom");
+			(++sp)->Float = self->actorRandom(0x40000000) / double(0x40000000);
+			break;
+
+		case XOP_RANGEF:
+		{
+			double minval = sp[-1].Float;
+			double maxval = sp[0].Float;
+
+			if (maxval < minval)
+			{
+				swapvalues (maxval, minval);
+			}
+			sp -= 2;
+			sp->Float = sp->Float * (maxval - minval) + minval;
+			break;
+		}
+
+		case XOP_LOADI:
+		case XOP_LOADB:
+		case XOP_LOADF:
+		case XOP_LOADX:
+		case XOP_LOADA:
+		case XOP_ADDRESS:
+		{
+			char *object = static_cast<char *>(sp->pointer);
+
+			if (object == NULL)
+			{
+				I_Error("Accessing member variable without valid object");
+			}
+			object += pc->Arg;
+			switch (pc->Op)
+			{
+			case XOP_LOADI:		sp->Int = *(int *)object; break;
+			case XOP_LOADB:		sp->Int = *(bool *)object; break;
+			case XOP_LOADF:		sp->Float = *(double *)object; break;
+			case XOP_LOADX:		sp->Float = (*(fixed_t *)object) / 65536.; break;
+			case XOP_LOADA:		sp->Float = (*(angle_t *)object) * 90./ANGLE_90; break;
+			default:			sp->pointer = object; break;
+			}
+			break;
+		}
+
+		case XOP_ARRAYI:
+		{
+			int indexval = (sp--)->Int;
+
+			if (indexval < 0 || indexval >= pc->Arg)
+			{
+				I_Error("Array index out of bounds");
+			}
+			sp->Int = static_cast<int *>(sp->pointer)[indexval];
+			break;
+		}
+
+		case XOP_SIN:
+		case XOP_COS:
+		{
+			angle_t angle = angle_t(sp->Float * ANGLE_90/90.);
+			sp->Float = FIXED2DBL (pc->Op == XOP_SIN ? finesine[angle>>ANGLETOFINESHIFT] : finecosine[angle>>ANGLETOFINESHIFT]);
+			break;
+		}
+
+		case XOP_SQRT:
+			sp->Float = sqrt(sp->Float);
+			break;
+		}
+	}
+}
@@ -107,6 +107,9 @@ int EvalExpressionI (DWORD xi, AActor *self)
 	FxExpression *x = StateParams.Get(xi);
 	if (x == NULL) return 0;
 
+	FxExpressionCode *code = StateParams.GetCode(xi, EMIT_Int);
+	if (code != NULL) return code->Exec (self).Int;
+
 	return x->EvalExpression (self).GetInt();
 }
 
@@ -131,6 +134,9 @@ double EvalExpressionF (DWORD xi, AActor *self)
 	FxExpression *x = StateParams.Get(xi);
 	if (x == NULL) return 0;
 
+	FxExpressionCode *code = StateParams.GetCode(xi, EMIT_Float);
+	if (code != NULL) return code->Exec (self).Float;
+
 	return x->EvalExpression (self).GetFloat();
 }
 
@@ -139,6 +145,9 @@ fixed_t EvalExpressionFix (DWORD xi, AActor *self)
 	FxExpression *x = StateParams.Get(xi);
 	if (x == NULL) return 0;
 
+	FxExpressionCode *code = StateParams.GetCode(xi, EMIT_Fixed);
+	if (code != NULL) return code->Exec (self).Int;
+
 	ExpVal val = x->EvalExpression (self);
 
 	switch (val.Type)
@@ -261,6 +270,17 @@ ExpVal FxExpression::EvalExpression (AActor *self)
 	return val;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxExpression::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Fallback (this, want);
+}
+
 
 //==========================================================================
 //
@@ -447,6 +467,18 @@ ExpVal FxIntCast::EvalExpression (AActor *self)
 	return baseval;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxIntCast::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (basex, EMIT_Int);
+	emit.Convert (EMIT_Int, want);
+}
+
 
 //==========================================================================
 //
@@ -576,6 +608,28 @@ ExpVal FxMinusSign::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxMinusSign::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (ValueType == VAL_Int)
+	{
+		emit.Expression (Operand, EMIT_Int);
+		emit.Emit (XOP_NEGI);
+		emit.Convert (EMIT_Int, want);
+	}
+	else
+	{
+		emit.Expression (Operand, EMIT_Float);
+		emit.Emit (XOP_NEGF);
+		emit.Convert (EMIT_Float, want);
+	}
+}
+
 
 //==========================================================================
 //
@@ -662,6 +716,19 @@ ExpVal FxUnaryNotBitwise::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxUnaryNotBitwise::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (Operand, EMIT_Int);
+	emit.Emit (XOP_NOTI);
+	emit.Convert (EMIT_Int, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxUnaryNotBoolean::FxUnaryNotBoolean(FxExpression *operand)
 : FxExpression(operand->ScriptPosition)
 {
@@ -740,6 +807,19 @@ ExpVal FxUnaryNotBoolean::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxUnaryNotBoolean::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (Operand, EMIT_Bool);
+	emit.Emit (XOP_NOTB);
+	emit.Convert (EMIT_Int, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxBinary::FxBinary(int o, FxExpression *l, FxExpression *r)
 : FxExpression(l->ScriptPosition)
 {
@@ -904,6 +984,29 @@ ExpVal FxAddSub::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxAddSub::Emit (FxEmitter &emit, EEmitType want)
+{
+	EEmitType type = ValueType == VAL_Float ? EMIT_Float : EMIT_Int;
+
+	emit.Expression (left, type);
+	emit.Expression (right, type);
+	if (type == EMIT_Float)
+	{
+		emit.Emit (Operator == '+' ? XOP_ADDF : XOP_SUBF, 0, 1);
+	}
+	else
+	{
+		emit.Emit (Operator == '+' ? XOP_ADDI : XOP_SUBI, 0, 1);
+	}
+	emit.Convert (type, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxMulDiv::FxMulDiv(int o, FxExpression *l, FxExpression *r)
 : FxBinary(o, l, r)
 {
@@ -978,7 +1081,7 @@ FxExpression *FxMulDiv::Resolve(FCompileContext& ctx)
 
 
 // [BB]
-static inline ExpVal handleClientDivisionByZero ( void )
+ExpVal handleClientDivisionByZero ( void )
 {
 	ExpVal ret;
 
@@ -1051,6 +1154,34 @@ ExpVal FxMulDiv::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxMulDiv::Emit (FxEmitter &emit, EEmitType want)
+{
+	EEmitType type = ValueType == VAL_Float ? EMIT_Float : EMIT_Int;
+
+	if (Operator != '*' && Operator != '/' && Operator != '%')
+	{
+		emit.Fallback (this, want);
+		return;
+	}
+	emit.Expression (left, type);
+	emit.Expression (right, type);
+	if (type == EMIT_Float)
+	{
+		emit.Emit (Operator == '*' ? XOP_MULF : Operator == '/' ? XOP_DIVF : XOP_MODF, 0, 1);
+	}
+	else
+	{
+		emit.Emit (Operator == '*' ? XOP_MULI : Operator == '/' ? XOP_DIVI : XOP_MODI, 0, 1);
+	}
+	emit.Convert (type, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxCompareRel::FxCompareRel(int o, FxExpression *l, FxExpression *r)
 : FxBinary(o, l, r)
 {
@@ -1137,6 +1268,33 @@ ExpVal FxCompareRel::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxCompareRel::Emit (FxEmitter &emit, EEmitType want)
+{
+	static const int ops[2][4] =
+	{
+		{ XOP_LTI, XOP_GTI, XOP_GEI, XOP_LEI },
+		{ XOP_LTF, XOP_GTF, XOP_GEF, XOP_LEF }
+	};
+	int isfloat = left->ValueType == VAL_Float || right->ValueType == VAL_Float;
+	int op = Operator == '<' ? 0 : Operator == '>' ? 1 : Operator == TK_Geq ? 2 : Operator == TK_Leq ? 3 : -1;
+
+	if (op < 0)
+	{
+		emit.Fallback (this, want);
+		return;
+	}
+	emit.Expression (left, isfloat ? EMIT_Float : EMIT_Int);
+	emit.Expression (right, isfloat ? EMIT_Float : EMIT_Int);
+	emit.Emit (ops[isfloat][op], 0, 1);
+	emit.Convert (EMIT_Int, want);
+}
+
 
 //==========================================================================
 //
@@ -1240,6 +1398,33 @@ ExpVal FxCompareEq::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxCompareEq::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (left->ValueType == VAL_Float || right->ValueType == VAL_Float)
+	{
+		emit.Expression (left, EMIT_Float);
+		emit.Expression (right, EMIT_Float);
+		emit.Emit (Operator == TK_Eq ? XOP_EQF : XOP_NEF, 0, 1);
+	}
+	else if (ValueType == VAL_Int)
+	{
+		emit.Expression (left, EMIT_Int);
+		emit.Expression (right, EMIT_Int);
+		emit.Emit (Operator == TK_Eq ? XOP_EQI : XOP_NEI, 0, 1);
+	}
+	else
+	{
+		emit.EmitInt (XOP_PUSHI, 0);
+	}
+	emit.Convert (EMIT_Int, want);
+}
+
 
 //==========================================================================
 //
@@ -1341,6 +1526,33 @@ ExpVal FxBinaryInt::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxBinaryInt::Emit (FxEmitter &emit, EEmitType want)
+{
+	int op =
+		Operator == TK_LShift? XOP_SHL : 
+		Operator == TK_RShift? XOP_SHR : 
+		Operator == TK_URShift? XOP_USHR : 
+		Operator == '&'? XOP_AND : 
+		Operator == '|'? XOP_OR : 
+		Operator == '^'? XOP_XOR : -1;
+
+	if (op < 0)
+	{
+		emit.Fallback (this, want);
+		return;
+	}
+	emit.Expression (left, EMIT_Int);
+	emit.Expression (right, EMIT_Int);
+	emit.Emit (op, 0, 1);
+	emit.Convert (EMIT_Int, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxBinaryLogical::FxBinaryLogical(int o, FxExpression *l, FxExpression *r)
 : FxExpression(l->ScriptPosition)
 {
@@ -1472,6 +1684,33 @@ ExpVal FxBinaryLogical::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxBinaryLogical::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (Operator != TK_AndAnd && Operator != TK_OrOr)
+	{
+		emit.Fallback (this, want);
+		return;
+	}
+
+	// The right side is only evaluated if the left one doesn't decide the result.
+	emit.Expression (left, EMIT_Bool);
+	int shortcut = emit.EmitJump (Operator == TK_AndAnd ? XOP_JZ : XOP_JNZ);
+	int depth = emit.GetDepth ();
+	emit.Expression (right, EMIT_Bool);
+	int done = emit.EmitJump (XOP_JMP);
+	emit.BindJump (shortcut);
+	emit.SetDepth (depth);
+	emit.EmitInt (XOP_PUSHI, Operator == TK_OrOr);
+	emit.BindJump (done);
+	emit.Convert (EMIT_Int, want);
+}
+
 
 //==========================================================================
 //
@@ -1550,6 +1789,25 @@ ExpVal FxConditional::EvalExpression (AActor *self)
 	return e->EvalExpression(self);
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxConditional::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (condition, EMIT_Bool);
+	int iffalse = emit.EmitJump (XOP_JZ);
+	int depth = emit.GetDepth ();
+	emit.Expression (truex, want);
+	int done = emit.EmitJump (XOP_JMP);
+	emit.BindJump (iffalse);
+	emit.SetDepth (depth);
+	emit.Expression (falsex, want);
+	emit.BindJump (done);
+}
+
 //==========================================================================
 //
 //
@@ -1640,6 +1898,32 @@ ExpVal FxAbs::EvalExpression (AActor *self)
 	return value;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxAbs::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (val->ValueType == VAL_Int)
+	{
+		emit.Expression (val, EMIT_Int);
+		emit.Emit (XOP_ABSI);
+		emit.Convert (EMIT_Int, want);
+	}
+	else if (val->ValueType == VAL_Float)
+	{
+		emit.Expression (val, EMIT_Float);
+		emit.Emit (XOP_ABSF);
+		emit.Convert (EMIT_Float, want);
+	}
+	else
+	{
+		emit.Fallback (this, want);
+	}
+}
+
 //==========================================================================
 //
 //
@@ -1719,6 +2003,27 @@ ExpVal FxRandom::EvalExpression (AActor *self)
 	return val;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxRandom::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (min != NULL && max != NULL)
+	{
+		emit.Expression (min, EMIT_Int);
+		emit.Expression (max, EMIT_Int);
+		emit.EmitPointer (XOP_RANDOM, rng, 0, 1);
+	}
+	else
+	{
+		emit.EmitPointer (XOP_RANDOM0, rng, 1);
+	}
+	emit.Convert (EMIT_Int, want);
+}
+
 //==========================================================================
 //
 //
@@ -1773,6 +2078,24 @@ ExpVal FxFRandom::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxFRandom::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.EmitPointer (XOP_FRANDOM, rng, 1);
+	if (min != NULL && max != NULL)
+	{
+		emit.Expression (min, EMIT_Float);
+		emit.Expression (max, EMIT_Float);
+		emit.Emit (XOP_RANGEF, 0, 2);
+	}
+	emit.Convert (EMIT_Float, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxRandom2::FxRandom2(FRandom *r, FxExpression *m, const FScriptPosition &pos)
 : FxExpression(pos)
 {
@@ -1822,6 +2145,19 @@ ExpVal FxRandom2::EvalExpression (AActor *self)
 	return maskval;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxRandom2::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (mask, EMIT_Int);
+	emit.EmitPointer (XOP_RANDOM2, rng);
+	emit.Convert (EMIT_Int, want);
+}
+
 //==========================================================================
 //
 //
@@ -1904,6 +2240,27 @@ ExpVal FxARandom::EvalExpression (AActor *self)
 	return val;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxARandom::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (min != NULL && max != NULL)
+	{
+		emit.Expression (min, EMIT_Int);
+		emit.Expression (max, EMIT_Int);
+		emit.Emit (XOP_ARANDOM, 0, 1);
+	}
+	else
+	{
+		emit.Emit (XOP_ARANDOM0, 1);
+	}
+	emit.Convert (EMIT_Int, want);
+}
+
 //==========================================================================
 //
 //
@@ -1960,6 +2317,24 @@ ExpVal FxAFRandom::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxAFRandom::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Emit (XOP_AFRANDOM, 1);
+	if (min != NULL && max != NULL)
+	{
+		emit.Expression (min, EMIT_Float);
+		emit.Expression (max, EMIT_Float);
+		emit.Emit (XOP_RANGEF, 0, 2);
+	}
+	emit.Convert (EMIT_Float, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxARandom2::FxARandom2(FxExpression *m, const FScriptPosition &pos)
 : FxExpression(pos)
 {
@@ -2016,6 +2391,19 @@ ExpVal FxARandom2::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxARandom2::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (mask, EMIT_Int);
+	emit.Emit (XOP_ARANDOM2);
+	emit.Convert (EMIT_Int, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxIdentifier::FxIdentifier(FName name, const FScriptPosition &pos)
 : FxExpression(pos)
 {
@@ -2162,6 +2550,18 @@ ExpVal FxSelf::EvalExpression (AActor *self)
 //
 //==========================================================================
 
+void FxSelf::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Emit (XOP_SELF, 1);
+	emit.Convert (EMIT_Pointer, want);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
 FxGlobalVariable::FxGlobalVariable(PSymbolVariable *mem, const FScriptPosition &pos)
 : FxExpression(pos)
 {
@@ -2236,6 +2636,51 @@ ExpVal FxGlobalVariable::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+// Loads a variable of the given type from the address on the stack.
+// Returns false for types that only GetVariableValue handles.
+//
+//==========================================================================
+
+static bool EmitLoad (FxEmitter &emit, FExpressionType &type, int offset, EEmitType want)
+{
+	switch (type.Type)
+	{
+	case VAL_Int:	emit.Emit (XOP_LOADI, 0, 0, offset); emit.Convert (EMIT_Int, want); return true;
+	case VAL_Bool:	emit.Emit (XOP_LOADB, 0, 0, offset); emit.Convert (EMIT_Int, want); return true;
+	case VAL_Float:	emit.Emit (XOP_LOADF, 0, 0, offset); emit.Convert (EMIT_Float, want); return true;
+	case VAL_Fixed:	emit.Emit (XOP_LOADX, 0, 0, offset); emit.Convert (EMIT_Float, want); return true;
+	case VAL_Angle:	emit.Emit (XOP_LOADA, 0, 0, offset); emit.Convert (EMIT_Float, want); return true;
+	default:		return false;
+	}
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxGlobalVariable::Emit (FxEmitter &emit, EEmitType want)
+{
+	if (AddressRequested)
+	{
+		emit.EmitPointer (XOP_PUSHP, (void*)var->offset, 1);
+		emit.Convert (EMIT_Pointer, want);
+	}
+	else if (var->ValueType == VAL_Int || var->ValueType == VAL_Bool || var->ValueType == VAL_Float ||
+		var->ValueType == VAL_Fixed || var->ValueType == VAL_Angle)
+	{
+		emit.EmitPointer (XOP_PUSHP, (void*)var->offset, 1);
+		EmitLoad (emit, var->ValueType, 0, want);
+	}
+	else
+	{
+		emit.Fallback (this, want);
+	}
+}
+
 
 //==========================================================================
 //
@@ -2354,6 +2799,34 @@ ExpVal FxClassMember::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxClassMember::Emit (FxEmitter &emit, EEmitType want)
+{
+	FExpressionType &type = membervar->ValueType;
+
+	if (classx->ValueType == VAL_Class || (!AddressRequested && type != VAL_Int && type != VAL_Bool &&
+		type != VAL_Float && type != VAL_Fixed && type != VAL_Angle))
+	{
+		emit.Fallback (this, want);
+	}
+	else if (AddressRequested)
+	{
+		emit.Expression (classx, EMIT_Pointer);
+		emit.Emit (XOP_ADDRESS, 0, 0, membervar->offset);
+		emit.Convert (EMIT_Pointer, want);
+	}
+	else
+	{
+		emit.Expression (classx, EMIT_Pointer);
+		EmitLoad (emit, type, membervar->offset, want);
+	}
+}
+
 
 
 //==========================================================================
@@ -2467,6 +2940,20 @@ ExpVal FxArrayElement::EvalExpression (AActor *self)
 	return ret;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxArrayElement::Emit (FxEmitter &emit, EEmitType want)
+{
+	emit.Expression (Array, EMIT_Pointer);
+	emit.Expression (index, EMIT_Int);
+	emit.Emit (XOP_ARRAYI, 0, 1, Array->ValueType.size);
+	emit.Convert (EMIT_Int, want);
+}
+
 
 //==========================================================================
 //
@@ -2971,6 +3458,13 @@ void FStateExpressions::Clear()
 		{
 			delete expressions[i].expr;
 		}
+		for (int j = 0; j < NUM_ROOT_EMIT_TYPES; j++)
+		{
+			if (expressions[i].code[j] != NULL)
+			{
+				delete expressions[i].code[j];
+			}
+		}
 	}
 	expressions.Clear();
 }
@@ -2989,6 +3483,8 @@ int FStateExpressions::Add(FxExpression *x, const PClass *o, bool c)
 	exp.owner = o;
 	exp.constant = c;
 	exp.cloned = false;
+	exp.compiled = 0;
+	memset(exp.code, 0, sizeof(exp.code));
 	return idx;
 }
 
@@ -3008,6 +3504,8 @@ int FStateExpressions::Reserve(int num, const PClass *cls)
 		exp[i].owner = cls;
 		exp[i].constant = false;
 		exp[i].cloned = false;
+		exp[i].compiled = 0;
+		memset(exp[i].code, 0, sizeof(exp[i].code));
 	}
 	return idx;
 }
@@ -3109,3 +3607,22 @@ FxExpression *FStateExpressions::Get(int num)
 	return NULL;
 }
 
+//==========================================================================
+//
+// Returns the expression's bytecode for the given root type, compiling
+// it on first use. NULL means the tree has to be walked instead.
+//
+//==========================================================================
+
+FxExpressionCode *FStateExpressions::GetCode(int num, int type)
+{
+	FStateExpression &exp = expressions[num];
+
+	if (!(exp.compiled & (1 << type)))
+	{
+		exp.compiled |= 1 << type;
+		exp.code[type] = FxExpressionCode::Compile(exp.expr, EEmitType(type));
+	}
+	return exp.code[type];
+}
+
@@ -149,6 +149,13 @@ public:
 		else ret.Float = FIXED2DBL (finecosine[angle>>ANGLETOFINESHIFT]);
 		return ret;
 	}
+
+	void Emit(FxEmitter &emit, EEmitType want)
+	{
+		emit.Expression((*ArgList)[0], EMIT_Float);
+		emit.Emit(Name == NAME_Sin ? XOP_SIN : XOP_COS);
+		emit.Convert(EMIT_Float, want);
+	}
 };
 
 GLOBALFUNCTION_ADDER(Cos);
@@ -183,6 +190,13 @@ public:
 		ret.Float = sqrt((*ArgList)[0]->EvalExpression(self).GetFloat());
 		return ret;
 	}
+
+	void Emit(FxEmitter &emit, EEmitType want)
+	{
+		emit.Expression((*ArgList)[0], EMIT_Float);
+		emit.Emit(XOP_SQRT);
+		emit.Convert(EMIT_Float, want);
+	}
 };
 
 GLOBALFUNCTION_ADDER(Sqrt);
@@ -102,6 +102,7 @@ void AUnlaggedActor::BeginPlay()
 		UNLAGGED_ResetActor( this );
 		isCurrentlyBeingUnlagged = false;
 		isMissile = !!(flags & MF_MISSILE);
+		wasRelinked = false;
 	}
 }
 
@@ -138,6 +139,32 @@ int reconciliationBlockers = 0;
 player_t* reconciledPlayer = NULL;
 int delayTics = 0;
 
+// Ring buffer with the recorded state of the last UNLAGGEDTICS tics. Each
+// recorded quantity lives in its own array with one row per tic, so a
+// reconciliation only has to read the row of the tic it rewinds to.
+static struct
+{
+	// UNLAGGEDTICS rows of numsectors plane distances.
+	TArray<fixed_t>		FloorD;
+	TArray<fixed_t>		CeilingD;
+	int					NumSectors;
+
+	fixed_t				PlayerX[UNLAGGEDTICS][MAXPLAYERS];
+	fixed_t				PlayerY[UNLAGGEDTICS][MAXPLAYERS];
+	fixed_t				PlayerZ[UNLAGGEDTICS][MAXPLAYERS];
+
+	// Sectors that have a floor or ceiling mover. Sectors without one are never reconciled.
+	TArray<int>			MoverSectors;
+	TArray<BYTE>		IsMoverSector;
+
+	// Planes and players the current reconciliation actually moved, so that
+	// UNLAGGED_Restore only has to undo those.
+	TArray<int>			ReconciledFloors;
+	TArray<int>			ReconciledCeilings;
+	TArray<BYTE>		IsSectorReconciled;
+	bool				IsPlayerReconciled[MAXPLAYERS];
+} unlaggedHistory;
+
 void UNLAGGED_Tick( void )
 {
 	// [BB] Only the server has to do anything here.
@@ -270,19 +297,35 @@ void UNLAGGED_ReconcileTick( AActor *actor, int Tic )
 	//find the index
 	const int unlaggedIndex = Tic % UNLAGGEDTICS;
 
-	//reconcile the sectors
-	for (int i = 0; i < numsectors; ++i)
+	//sight traces memoized against the present planes don't hold in the past
+	P_InvalidateSightCache();
+
+	//reconcile the sectors, only planes that were somewhere else back then need to be touched
+	if ( unlaggedHistory.NumSectors == numsectors )
 	{
-		if ( sectors[i].floordata && sectors[i].floordata->GetLastInstigator() != actor->player )
-		{
-			sectors[i].floorplane.restoreD = sectors[i].floorplane.d;
-			sectors[i].floorplane.d = sectors[i].floorplane.unlaggedD[unlaggedIndex];
-		}
+		const fixed_t *floorD = &unlaggedHistory.FloorD[unlaggedIndex * numsectors];
+		const fixed_t *ceilingD = &unlaggedHistory.CeilingD[unlaggedIndex * numsectors];
 
-		if ( sectors[i].ceilingdata && sectors[i].ceilingdata->GetLastInstigator() != actor->player )
+		for ( unsigned int i = 0; i < unlaggedHistory.MoverSectors.Size(); ++i )
 		{
-			sectors[i].ceilingplane.restoreD = sectors[i].ceilingplane.d;
-			sectors[i].ceilingplane.d = sectors[i].ceilingplane.unlaggedD[unlaggedIndex];
+			const int sectorIdx = unlaggedHistory.MoverSectors[i];
+			sector_t *sector = &sectors[sectorIdx];
+
+			if ( sector->floordata && ( floorD[sectorIdx] != sector->floorplane.d ) && sector->floordata->GetLastInstigator() != actor->player )
+			{
+				sector->floorplane.restoreD = sector->floorplane.d;
+				sector->floorplane.d = floorD[sectorIdx];
+				unlaggedHistory.ReconciledFloors.Push( sectorIdx );
+				unlaggedHistory.IsSectorReconciled[sectorIdx] = true;
+			}
+
+			if ( sector->ceilingdata && ( ceilingD[sectorIdx] != sector->ceilingplane.d ) && sector->ceilingdata->GetLastInstigator() != actor->player )
+			{
+				sector->ceilingplane.restoreD = sector->ceilingplane.d;
+				sector->ceilingplane.d = ceilingD[sectorIdx];
+				unlaggedHistory.ReconciledCeilings.Push( sectorIdx );
+				unlaggedHistory.IsSectorReconciled[sectorIdx] = true;
+			}
 		}
 	}
 
@@ -314,11 +357,17 @@ void UNLAGGED_ReconcileTick( AActor *actor, int Tic )
 			//to predict him
 			if (players + i != actor->player)
 			{
-				players[i].mo->SetOrigin(
-					players[i].unlaggedX[unlaggedIndex],
-					players[i].unlaggedY[unlaggedIndex],
-					players[i].unlaggedZ[unlaggedIndex]
-				);
+				const fixed_t x = unlaggedHistory.PlayerX[unlaggedIndex][i];
+				const fixed_t y = unlaggedHistory.PlayerY[unlaggedIndex][i];
+				const fixed_t z = unlaggedHistory.PlayerZ[unlaggedIndex][i];
+
+				// Relinking a player that didn't move is only necessary to update his floorz/ceilingz,
+				// which can only change if a sector he touches was reconciled.
+				if ( ( x != players[i].mo->x ) || ( y != players[i].mo->y ) || ( z != players[i].mo->z ) || UNLAGGED_IsActorInReconciledSector( players[i].mo ) )
+				{
+					players[i].mo->SetOrigin( x, y, z );
+					unlaggedHistory.IsPlayerReconciled[i] = true;
+				}
 			}
 			else
 				//However, the client sometimes mispredicts itself if it's on a moving sector.
@@ -344,7 +393,7 @@ void UNLAGGED_ReconcileTick( AActor *actor, int Tic )
 				//floor moved up - a client might have mispredicted himself too low due to gravity
 				//and the client thinking the floor is lower than it actually is
 				// [BB] But only do this if the sector actually moved. Note: This adjustment seems to break on some kind of non-moving 3D floors.
-				if ( (serverFloorZ > actor->floorz) && (( actor->Sector->floorplane.restoreD != actor->Sector->floorplane.d ) || ( actor->Sector->ceilingplane.restoreD != actor->Sector->ceilingplane.d )) )
+				if ( (serverFloorZ > actor->floorz) && UNLAGGED_IsSectorReconciled( actor->Sector ) )
 				{
 					//shooter was standing on the floor, let's pull him down to his floor if
 					//he wasn't falling
@@ -378,26 +427,37 @@ void UNLAGGED_ReconcileTick( AActor *actor, int Tic )
 			unlaggedActor->restoreFloorZ = unlaggedActor->floorz;
 			unlaggedActor->restoreCeilingZ = unlaggedActor->ceilingz;
 
-			unlaggedActor->UnlinkFromWorld();
+			// Only relink the actor if it was somewhere else or had different flags back then.
+			unlaggedActor->wasRelinked = ( unlaggedActor->x != unlaggedActor->unlaggedX[unlaggedIndex] )
+				|| ( unlaggedActor->y != unlaggedActor->unlaggedY[unlaggedIndex] )
+				|| ( unlaggedActor->z != unlaggedActor->unlaggedZ[unlaggedIndex] )
+				|| ( memcmp( unlaggedActor->restoreFlags, unlaggedActor->unlaggedFlags[unlaggedIndex], sizeof( unlaggedActor->restoreFlags ) ) != 0 );
 
-			unlaggedActor->mvFlags = unlaggedActor->unlaggedFlags[unlaggedIndex][0];
-			unlaggedActor->flags = unlaggedActor->unlaggedFlags[unlaggedIndex][1];
-			unlaggedActor->flags2 = unlaggedActor->unlaggedFlags[unlaggedIndex][2];
-			unlaggedActor->flags3 = unlaggedActor->unlaggedFlags[unlaggedIndex][3];
-			unlaggedActor->flags4 = unlaggedActor->unlaggedFlags[unlaggedIndex][4];
-			unlaggedActor->flags5 = unlaggedActor->unlaggedFlags[unlaggedIndex][5];
-			unlaggedActor->flags6 = unlaggedActor->unlaggedFlags[unlaggedIndex][6];
-			unlaggedActor->flags7 = unlaggedActor->unlaggedFlags[unlaggedIndex][7];
-			unlaggedActor->flags8 = unlaggedActor->unlaggedFlags[unlaggedIndex][8];
-			unlaggedActor->x = unlaggedActor->unlaggedX[unlaggedIndex];
-			unlaggedActor->y = unlaggedActor->unlaggedY[unlaggedIndex];
-			unlaggedActor->z = unlaggedActor->unlaggedZ[unlaggedIndex];
+			if ( unlaggedActor->wasRelinked )
+			{
+				unlaggedActor->UnlinkFromWorld();
 
-			unlaggedActor->LinkToWorld();
+				unlaggedActor->mvFlags = unlaggedActor->unlaggedFlags[unlaggedIndex][0];
+				unlaggedActor->flags = unlaggedActor->unlaggedFlags[unlaggedIndex][1];
+				unlaggedActor->flags2 = unlaggedActor->unlaggedFlags[unlaggedIndex][2];
+				unlaggedActor->flags3 = unlaggedActor->unlaggedFlags[unlaggedIndex][3];
+				unlaggedActor->flags4 = unlaggedActor->unlaggedFlags[unlaggedIndex][4];
+				unlaggedActor->flags5 = unlaggedActor->unlaggedFlags[unlaggedIndex][5];
+				unlaggedActor->flags6 = unlaggedActor->unlaggedFlags[unlaggedIndex][6];
+				unlaggedActor->flags7 = unlaggedActor->unlaggedFlags[unlaggedIndex][7];
+				unlaggedActor->flags8 = unlaggedActor->unlaggedFlags[unlaggedIndex][8];
+				unlaggedActor->x = unlaggedActor->unlaggedX[unlaggedIndex];
+				unlaggedActor->y = unlaggedActor->unlaggedY[unlaggedIndex];
+				unlaggedActor->z = unlaggedActor->unlaggedZ[unlaggedIndex];
 
-			unlaggedActor->floorz = unlaggedActor->Sector->floorplane.ZatPoint(unlaggedActor->restoreX, unlaggedActor->restoreY);
-			unlaggedActor->ceilingz = unlaggedActor->Sector->ceilingplane.ZatPoint(unlaggedActor->restoreX, unlaggedActor->restoreY);
+				unlaggedActor->LinkToWorld();
+			}
 
+			if ( unlaggedActor->wasRelinked || UNLAGGED_IsSectorReconciled( unlaggedActor->Sector ) )
+			{
+				unlaggedActor->floorz = unlaggedActor->Sector->floorplane.ZatPoint(unlaggedActor->restoreX, unlaggedActor->restoreY);
+				unlaggedActor->ceilingz = unlaggedActor->Sector->ceilingplane.ZatPoint(unlaggedActor->restoreX, unlaggedActor->restoreY);
+			}
 		}
 
 		unlaggedActor = unlaggedActor->nextUnlaggedActor;
@@ -421,13 +481,21 @@ void UNLAGGED_Restore( AActor *actor )
 		return;
 
 	//restore the sectors
-	for (int i = 0; i < numsectors; ++i)
+	P_InvalidateSightCache();
+	for ( unsigned int i = 0; i < unlaggedHistory.ReconciledFloors.Size(); ++i )
 	{
-		if ( sectors[i].floordata && sectors[i].floordata->GetLastInstigator() != actor->player )
-			sectors[i].floorplane.d = sectors[i].floorplane.restoreD;
-		if ( sectors[i].ceilingdata && sectors[i].ceilingdata->GetLastInstigator() != actor->player )
-			sectors[i].ceilingplane.d = sectors[i].ceilingplane.restoreD;
+		const int sectorIdx = unlaggedHistory.ReconciledFloors[i];
+		sectors[sectorIdx].floorplane.d = sectors[sectorIdx].floorplane.restoreD;
+		unlaggedHistory.IsSectorReconciled[sectorIdx] = false;
 	}
+	for ( unsigned int i = 0; i < unlaggedHistory.ReconciledCeilings.Size(); ++i )
+	{
+		const int sectorIdx = unlaggedHistory.ReconciledCeilings[i];
+		sectors[sectorIdx].ceilingplane.d = sectors[sectorIdx].ceilingplane.restoreD;
+		unlaggedHistory.IsSectorReconciled[sectorIdx] = false;
+	}
+	unlaggedHistory.ReconciledFloors.Clear();
+	unlaggedHistory.ReconciledCeilings.Clear();
 
 	//reconcile the PolyActions
 	TThinkerIterator<DPolyAction> polyActionIt;
@@ -441,6 +509,10 @@ void UNLAGGED_Restore( AActor *actor )
 	//restore the players
 	for (int i = 0; i < MAXPLAYERS; ++i)
 	{
+		if ( unlaggedHistory.IsPlayerReconciled[i] == false )
+			continue;
+
+		unlaggedHistory.IsPlayerReconciled[i] = false;
 		if (playeringame[i] && players[i].mo && !players[i].bSpectating && players + i != actor->player)
 		{
 			players[i].mo->SetOrigin( players[i].restoreX, players[i].restoreY, players[i].restoreZ );
@@ -471,22 +543,25 @@ void UNLAGGED_Restore( AActor *actor )
 			}
 			else
 			{
-				unlaggedActor->UnlinkFromWorld();
-
-				unlaggedActor->mvFlags = unlaggedActor->restoreFlags[0];
-				unlaggedActor->flags = unlaggedActor->restoreFlags[1];
-				unlaggedActor->flags2 = unlaggedActor->restoreFlags[2];
-				unlaggedActor->flags3 = unlaggedActor->restoreFlags[3];
-				unlaggedActor->flags4 = unlaggedActor->restoreFlags[4];
-				unlaggedActor->flags5 = unlaggedActor->restoreFlags[5];
-				unlaggedActor->flags6 = unlaggedActor->restoreFlags[6];
-				unlaggedActor->flags7 = unlaggedActor->restoreFlags[7];
-				unlaggedActor->flags8 = unlaggedActor->restoreFlags[8];
-				unlaggedActor->x = unlaggedActor->restoreX;
-				unlaggedActor->y = unlaggedActor->restoreY;
-				unlaggedActor->z = unlaggedActor->restoreZ;
-
-				unlaggedActor->LinkToWorld();
+				if ( unlaggedActor->wasRelinked )
+				{
+					unlaggedActor->UnlinkFromWorld();
+
+					unlaggedActor->mvFlags = unlaggedActor->restoreFlags[0];
+					unlaggedActor->flags = unlaggedActor->restoreFlags[1];
+					unlaggedActor->flags2 = unlaggedActor->restoreFlags[2];
+					unlaggedActor->flags3 = unlaggedActor->restoreFlags[3];
+					unlaggedActor->flags4 = unlaggedActor->restoreFlags[4];
+					unlaggedActor->flags5 = unlaggedActor->restoreFlags[5];
+					unlaggedActor->flags6 = unlaggedActor->restoreFlags[6];
+					unlaggedActor->flags7 = unlaggedActor->restoreFlags[7];
+					unlaggedActor->flags8 = unlaggedActor->restoreFlags[8];
+					unlaggedActor->x = unlaggedActor->restoreX;
+					unlaggedActor->y = unlaggedActor->restoreY;
+					unlaggedActor->z = unlaggedActor->restoreZ;
+
+					unlaggedActor->LinkToWorld();
+				}
 
 				unlaggedActor->floorz = unlaggedActor->restoreFloorZ;
 				unlaggedActor->ceilingz = unlaggedActor->restoreCeilingZ;
@@ -511,9 +586,10 @@ void UNLAGGED_RecordPlayer( player_t *player, int unlaggedIndex )
 		return;
 
 	//record the player
-	player->unlaggedX[unlaggedIndex] = player->mo->x;
-	player->unlaggedY[unlaggedIndex] = player->mo->y;
-	player->unlaggedZ[unlaggedIndex] = player->mo->z;
+	const ULONG ulPlayer = static_cast<ULONG>( player - players );
+	unlaggedHistory.PlayerX[unlaggedIndex][ulPlayer] = player->mo->x;
+	unlaggedHistory.PlayerY[unlaggedIndex][ulPlayer] = player->mo->y;
+	unlaggedHistory.PlayerZ[unlaggedIndex][ulPlayer] = player->mo->z;
 }
 
 
@@ -530,11 +606,7 @@ void UNLAGGED_ResetPlayer( player_t *player )
 		return;
 
 	for (int unlaggedIndex = 0; unlaggedIndex < UNLAGGEDTICS; ++unlaggedIndex)
-	{
-		player->unlaggedX[unlaggedIndex] = player->mo->x;
-		player->unlaggedY[unlaggedIndex] = player->mo->y;
-		player->unlaggedZ[unlaggedIndex] = player->mo->z;
-	}
+		UNLAGGED_RecordPlayer( player, unlaggedIndex );
 }
 
 // Record the positions of just one actor
@@ -602,12 +674,120 @@ void UNLAGGED_RecordSectors( int unlaggedIndex )
 	if (NETWORK_GetState() != NETSTATE_SERVER)
 		return;
 
+	// The level changed without UNLAGGED_ResetSectors being called, so the old history is useless.
+	if ( unlaggedHistory.NumSectors != numsectors )
+	{
+		UNLAGGED_ResetSectors( );
+		return;
+	}
+
 	//record the sectors
+	fixed_t *floorD = &unlaggedHistory.FloorD[unlaggedIndex * numsectors];
+	fixed_t *ceilingD = &unlaggedHistory.CeilingD[unlaggedIndex * numsectors];
+
+	for (int i = 0; i < numsectors; ++i)
+	{
+		floorD[i] = sectors[i].floorplane.d;
+		ceilingD[i] = sectors[i].ceilingplane.d;
+	}
+
+	// Rebuild the list of sectors that can be reconciled. Movers created
+	// later in this tic add themselves through UNLAGGED_AddMoverSector.
+	for ( unsigned int i = 0; i < unlaggedHistory.MoverSectors.Size(); ++i )
+		unlaggedHistory.IsMoverSector[unlaggedHistory.MoverSectors[i]] = false;
+	unlaggedHistory.MoverSectors.Clear();
+
+	for (int i = 0; i < numsectors; ++i)
+	{
+		if ( sectors[i].floordata || sectors[i].ceilingdata )
+			UNLAGGED_AddMoverSector( &sectors[i] );
+	}
+}
+
+// Reset the recorded positions of the sectors
+// Should be called when a level is loaded
+void UNLAGGED_ResetSectors( void )
+{
+	//Only do anything if it's on a server
+	if (NETWORK_GetState() != NETSTATE_SERVER)
+		return;
+
+	unlaggedHistory.NumSectors = numsectors;
+	unlaggedHistory.FloorD.Resize( UNLAGGEDTICS * numsectors );
+	unlaggedHistory.CeilingD.Resize( UNLAGGEDTICS * numsectors );
+	unlaggedHistory.MoverSectors.Clear();
+	unlaggedHistory.IsMoverSector.Resize( numsectors );
+	unlaggedHistory.IsSectorReconciled.Resize( numsectors );
+	unlaggedHistory.ReconciledFloors.Clear();
+	unlaggedHistory.ReconciledCeilings.Clear();
+
+	for (int i = 0; i < numsectors; ++i)
+	{
+		unlaggedHistory.IsMoverSector[i] = false;
+		unlaggedHistory.IsSectorReconciled[i] = false;
+	}
+
+	for (int unlaggedIndex = 0; unlaggedIndex < UNLAGGEDTICS; ++unlaggedIndex)
+	{
+		for (int i = 0; i < numsectors; ++i)
+		{
+			unlaggedHistory.FloorD[unlaggedIndex * numsectors + i] = sectors[i].floorplane.d;
+			unlaggedHistory.CeilingD[unlaggedIndex * numsectors + i] = sectors[i].ceilingplane.d;
+		}
+	}
+
 	for (int i = 0; i < numsectors; ++i)
 	{
-		sectors[i].floorplane.unlaggedD[unlaggedIndex] = sectors[i].floorplane.d;
-		sectors[i].ceilingplane.unlaggedD[unlaggedIndex] = sectors[i].ceilingplane.d;
+		if ( sectors[i].floordata || sectors[i].ceilingdata )
+			UNLAGGED_AddMoverSector( &sectors[i] );
+	}
+}
+
+// Mark a sector as one that has a floor or ceiling mover and thus may need to be reconciled
+void UNLAGGED_AddMoverSector( sector_t *sector )
+{
+	if ( ( sector == NULL ) || ( NETWORK_GetState() != NETSTATE_SERVER ) )
+		return;
+
+	const int sectorIdx = static_cast<int>( sector - sectors );
+
+	// The sector doesn't belong to the level the history was recorded for.
+	if ( ( sectorIdx < 0 ) || ( sectorIdx >= unlaggedHistory.NumSectors ) || ( unlaggedHistory.NumSectors != numsectors ) )
+		return;
+
+	if ( unlaggedHistory.IsMoverSector[sectorIdx] == false )
+	{
+		unlaggedHistory.IsMoverSector[sectorIdx] = true;
+		unlaggedHistory.MoverSectors.Push( sectorIdx );
+	}
+}
+
+// Check whether the current reconciliation moved the floor or ceiling of a sector
+bool UNLAGGED_IsSectorReconciled( const sector_t *sector )
+{
+	if ( ( sector == NULL ) || ( unlaggedHistory.NumSectors != numsectors ) )
+		return false;
+
+	return !!unlaggedHistory.IsSectorReconciled[sector - sectors];
+}
+
+// Check whether the current reconciliation moved a plane of any sector the actor touches,
+// P_FindFloorCeiling takes the neighbouring sectors into account as well
+bool UNLAGGED_IsActorInReconciledSector( const AActor *actor )
+{
+	if ( ( unlaggedHistory.ReconciledFloors.Size() == 0 ) && ( unlaggedHistory.ReconciledCeilings.Size() == 0 ) )
+		return false;
+
+	if ( UNLAGGED_IsSectorReconciled( actor->Sector ) )
+		return true;
+
+	for ( const msecnode_t *node = actor->touching_sectorlist; node != NULL; node = node->m_tnext )
+	{
+		if ( UNLAGGED_IsSectorReconciled( node->m_sector ) )
+			return true;
 	}
+
+	return false;
 }
 
 // Record the positions of the polyobjects
@@ -661,10 +841,11 @@ void UNLAGGED_GetHitOffset ( const AActor *attacker, const FTraceResults &trace,
 		const int unlaggedIndex = unlaggedGametic % UNLAGGEDTICS;
 
 		const player_t *hitPlayer = trace.Actor->player;
+		const ULONG ulHitPlayer = static_cast<ULONG>( hitPlayer - players );
 
-		hitOffset[0] = hitPlayer->restoreX - hitPlayer->unlaggedX[unlaggedIndex];
-		hitOffset[1] = hitPlayer->restoreY - hitPlayer->unlaggedY[unlaggedIndex];
-		hitOffset[2] = hitPlayer->restoreZ - hitPlayer->unlaggedZ[unlaggedIndex];
+		hitOffset[0] = hitPlayer->restoreX - unlaggedHistory.PlayerX[unlaggedIndex][ulHitPlayer];
+		hitOffset[1] = hitPlayer->restoreY - unlaggedHistory.PlayerY[unlaggedIndex][ulHitPlayer];
+		hitOffset[2] = hitPlayer->restoreZ - unlaggedHistory.PlayerZ[unlaggedIndex][ulHitPlayer];
 	}
 }
 
@@ -66,6 +66,10 @@ void	UNLAGGED_ResetPlayer( player_t *player );
 void	UNLAGGED_RecordActor( AUnlaggedActor* unlaggedActor, int unlaggedIndex );
 void	UNLAGGED_ResetActor( AUnlaggedActor* unlaggedActor );
 void	UNLAGGED_RecordSectors( int unlaggedIndex );
+void	UNLAGGED_ResetSectors( void );
+void	UNLAGGED_AddMoverSector( sector_t *sector );
+bool	UNLAGGED_IsSectorReconciled( const sector_t *sector );
+bool	UNLAGGED_IsActorInReconciledSector( const AActor *actor );
 void	UNLAGGED_RecordPolyobj( int unlaggedIndex );
 bool	UNLAGGED_DrawRailClientside ( AActor *attacker );
 void	UNLAGGED_GetHitOffset ( const AActor *attacker, const FTraceResults &trace, TVector3<fixed_t> &hitOffset );
@@ -46,7 +46,7 @@ const char *GetVersionStringRev();
 #define GAME_MAJOR_VERSION 1
 #define GAME_MINOR_VERSION 4
 #define GAMEVER_STRING "1.4.11"
-#define NETGAMEVER_STRING "1.4.10"
+#define NETGAMEVER_STRING "1.4.11"
 #define DOTVERSIONSTR GAMEVER_STRING ""
 #define VERSIONSTR DOTVERSIONSTR
 
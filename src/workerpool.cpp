@@ -0,0 +1,172 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: workerpool.cpp
+//
+// Description: A small pool of worker threads for data parallel jobs
+//
+//-----------------------------------------------------------------------------
+
+#include "workerpool.h"
+
+//*****************************************************************************
+//
+WorkerPool::WorkerPool ( ) :
+	_job ( NULL ),
+	_count ( 0 ),
+	_nextIndex ( 0 ),
+	_numBusy ( 0 ),
+	_generation ( 0 ),
+	_stop ( false )
+{
+}
+
+//*****************************************************************************
+//
+WorkerPool::~WorkerPool ( )
+{
+	StopThreads();
+}
+
+//*****************************************************************************
+//
+void WorkerPool::SetNumThreads ( unsigned int numThreads )
+{
+	if ( numThreads == _threads.size() )
+		return;
+
+	StopThreads();
+
+	for ( unsigned int i = 0; i < numThreads; ++i )
+		_threads.push_back( std::thread( &WorkerPool::WorkerMain, this, _generation ));
+}
+
+//*****************************************************************************
+//
+unsigned int WorkerPool::GetNumThreads ( ) const
+{
+	return static_cast<unsigned int>( _threads.size() );
+}
+
+//*****************************************************************************
+//
+void WorkerPool::StopThreads ( )
+{
+	{
+		std::lock_guard<std::mutex> lock ( _mutex );
+		_stop = true;
+	}
+	_wakeCondition.notify_all();
+
+	for ( unsigned int i = 0; i < _threads.size(); ++i )
+		_threads[i].join();
+
+	_threads.clear();
+	_stop = false;
+}
+
+//*****************************************************************************
+//
+void WorkerPool::ParallelFor ( unsigned int count, const Job &job )
+{
+	if ( count == 0 )
+		return;
+
+	// Not worth waking up anyone.
+	if (( _threads.size() == 0 ) || ( count == 1 ))
+	{
+		for ( unsigned int i = 0; i < count; ++i )
+			job( i );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock ( _mutex );
+		_job = &job;
+		_count = count;
+		_nextIndex = 0;
+		_numBusy = static_cast<unsigned int>( _threads.size() );
+		++_generation;
+	}
+	_wakeCondition.notify_all();
+
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock ( _mutex );
+	while ( _numBusy > 0 )
+		_doneCondition.wait( lock );
+	_job = NULL;
+}
+
+//*****************************************************************************
+//
+void WorkerPool::RunJobs ( )
+{
+	for ( unsigned int i = _nextIndex++; i < _count; i = _nextIndex++ )
+		( *_job )( i );
+}
+
+//*****************************************************************************
+//
+// The generation is passed by the creating thread, so that a worker that
+// starts late still takes part in a loop that was started in the meantime.
+void WorkerPool::WorkerMain ( unsigned int generation )
+{
+	std::unique_lock<std::mutex> lock ( _mutex );
+
+	while ( true )
+	{
+		while (( _stop == false ) && ( _generation == generation ))
+			_wakeCondition.wait( lock );
+
+		if ( _stop )
+			return;
+
+		generation = _generation;
+		lock.unlock();
+		RunJobs();
+		lock.lock();
+
+		if ( --_numBusy == 0 )
+			_doneCondition.notify_one();
+	}
+}
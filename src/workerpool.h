@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: workerpool.h
+//
+// Description: A small pool of worker threads for data parallel jobs
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+/**
+ * \brief Runs the iterations of a loop on several threads.
+ *
+ * The thread calling ParallelFor works on the loop as well and only returns
+ * once all iterations are done. ParallelFor must not be called by several
+ * threads at once or from within a job.
+ */
+class WorkerPool
+{
+public:
+	typedef std::function<void ( unsigned int )> Job;
+
+	WorkerPool ( );
+	~WorkerPool ( );
+
+	void			SetNumThreads ( unsigned int numThreads );
+	unsigned int	GetNumThreads ( ) const;
+	void			ParallelFor ( unsigned int count, const Job &job );
+
+private:
+	void			StopThreads ( );
+	void			WorkerMain ( unsigned int generation );
+	void			RunJobs ( );
+
+	std::vector<std::thread>	_threads;
+	std::mutex					_mutex;
+	std::condition_variable		_wakeCondition;
+	std::condition_variable		_doneCondition;
+
+	// The loop that is currently run.
+	const Job					*_job;
+	unsigned int				_count;
+	std::atomic<unsigned int>	_nextIndex;
+
+	// How many worker threads are still working on the current loop.
+	unsigned int				_numBusy;
+
+	// Increased for every loop, so that the workers notice there is a new one.
+	unsigned int				_generation;
+	bool						_stop;
+};
+
+#endif	// __WORKERPOOL_H__
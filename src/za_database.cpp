@@ -49,7 +49,17 @@
 #include "i_system.h"
 #include "g_game.h"
 #include "p_acs.h"
+#include "stats.h"
 #include <sqlite3.h>
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 //*****************************************************************************
 //	DEFINES
@@ -58,12 +68,122 @@
 
 #define TIMEQUERY "SELECT (julianday('now') - 2440587.5)*86400.0"
 
+// The integer value of an entry. The rank and sort queries must use exactly
+// this expression, otherwise SQLite can't use the index on it.
+#define INTEGERVALUE "CAST(Value AS INTEGER)"
+
+// How long the writer thread waits for more writes before it commits a batch.
+#define DATABASE_WRITE_DELAY	50
+
+//*****************************************************************************
+enum DATABASEWRITE_e
+{
+	DBW_SET,
+	DBW_DELETE,
+	DBW_INCREMENT,
+};
+
+//*****************************************************************************
+// A write that has been queued for the writer thread. Anything the writer
+// thread touches uses std::string, FString's reference counting isn't thread
+// safe.
+typedef struct
+{
+	DATABASEWRITE_e		Type;
+	std::string			Namespace;
+	std::string			EntryName;
+	std::string			Value;
+	int					iIncrement;
+
+} DATABASEWRITE_s;
+
+//*****************************************************************************
+enum DATABASEOVERLAY_e
+{
+	// The entry will have this value once all pending writes are done.
+	DBO_VALUE,
+
+	// The entry will be deleted once all pending writes are done.
+	DBO_DELETED,
+
+	// The entry has only been incremented, we don't know its final value
+	// without asking the database.
+	DBO_INCREMENTED,
+};
+
+//*****************************************************************************
+// What the database will contain for an entry once its pending writes are done.
+typedef struct
+{
+	DATABASEOVERLAY_e	State;
+	std::string			Value;
+
+	// How many queued writes still affect this entry.
+	ULONG				ulNumPending;
+
+} DATABASEOVERLAY_s;
+
+//*****************************************************************************
+// A prepared statement that is kept around and reused.
+typedef struct
+{
+	sqlite3_stmt		*pStmt;
+	bool				bInUse;
+
+} DATABASESTATEMENT_s;
+
+//*****************************************************************************
+//	PROTOTYPES
+
+static	void	database_StartWriter ( void );
+static	void	database_StopWriter ( void );
+static	void	database_ApplyWriteMode ( void );
+
 //*****************************************************************************
 //	VARIABLES
 
 // [BB] Handle to our database.
 sqlite3 *g_db = NULL;
 
+// Guards g_db and the statement cache. Recursive, because the DATABASE_*
+// functions call each other.
+static	std::recursive_mutex						g_DatabaseMutex;
+
+// Prepared statements, keyed by their SQL text.
+static	std::map<std::string, DATABASESTATEMENT_s *>	g_StatementCache;
+
+// Guards the write queue, the overlay and the writer statistics. Never lock
+// g_DatabaseMutex while holding this one.
+static	std::mutex									g_WriteQueueMutex;
+static	std::condition_variable						g_WriteQueueCondition;
+static	std::vector<DATABASEWRITE_s>				g_WriteQueue;
+static	std::map<std::string, DATABASEOVERLAY_s>	g_WriteOverlay;
+static	bool										g_bWriterShutdown = false;
+
+// Writes made inside a transaction started by ACS are held back until the
+// transaction is ended, so that the writer thread commits them together.
+// Without the writer, the depth tells whether the SQL transaction is open.
+static	std::vector<DATABASEWRITE_s>				g_TransactionWrites;
+static	int											g_iTransactionDepth = 0;
+
+// The writer thread. Only the game thread starts and stops it.
+static	std::thread									g_WriterThread;
+static	bool										g_bWriterRunning = false;
+
+// Messages from the writer thread are printed by the game thread.
+static	thread_local bool							g_bIsWriterThread = false;
+static	std::mutex									g_MessageMutex;
+static	std::string									g_DeferredMessages;
+static	std::atomic<bool>							g_bHaveDeferredMessages ( false );
+
+// Statistics.
+static	ULONG										g_ulNumWritesQueued = 0;
+static	ULONG										g_ulNumWritesCommitted = 0;
+static	ULONG										g_ulNumBatches = 0;
+static	ULONG										g_ulNumOverlayHits = 0;
+static	ULONG										g_ulNumFlushes = 0;
+static	ULONG										g_ulNumStatementsPrepared = 0;
+
 // [BB] Filename for the database.
 CUSTOM_CVAR( String, databasefile, ":memory:", CVAR_ARCHIVE|CVAR_NOSETBYACS )
 {
@@ -77,23 +197,128 @@ CUSTOM_CVAR( Int, database_maxpagecount, 32768, CVAR_ARCHIVE|CVAR_NOSETBYACS )
 		DATABASE_SetMaxPageCount ( self );
 }
 
+// Write entries from a background thread, so that the game doesn't have to
+// wait for the database.
+CUSTOM_CVAR( Bool, database_asyncwrites, false, CVAR_ARCHIVE|CVAR_NOSETBYACS )
+{
+	database_ApplyWriteMode ( );
+}
+
 //*****************************************************************************
-//	PROTOTYPES
+//	FUNCTIONS
+
+// Printf is only safe to use on the game thread, the writer thread has its
+// messages printed later.
+static void database_Printf ( const char *Format, ... )
+{
+	va_list argptr;
+	va_start ( argptr, Format );
+
+	if ( g_bIsWriterThread )
+	{
+		char message[1024];
+		vsnprintf ( message, sizeof( message ), Format, argptr );
+
+		std::lock_guard<std::mutex> lock ( g_MessageMutex );
+		g_DeferredMessages += message;
+		g_bHaveDeferredMessages = true;
+	}
+	else
+	{
+		FString message;
+		message.VFormat ( Format, argptr );
+		Printf ( "%s", message.GetChars() );
+	}
+
+	va_end ( argptr );
+}
+
+//*****************************************************************************
+//
+static void database_PrintDeferredMessages ( void )
+{
+	if ( g_bHaveDeferredMessages == false )
+		return;
+
+	std::string messages;
+	{
+		std::lock_guard<std::mutex> lock ( g_MessageMutex );
+		messages.swap ( g_DeferredMessages );
+		g_bHaveDeferredMessages = false;
+	}
+	Printf ( "%s", messages.c_str() );
+}
+
+//*****************************************************************************
+//
+// Returns a prepared statement for Command, preparing it if it isn't cached
+// yet. If the cached statement is already in use, a new one is prepared that
+// the caller has to finalize. The caller must hold g_DatabaseMutex.
+static sqlite3_stmt *database_AcquireStatement ( const char *Command, DATABASESTATEMENT_s *&pCached )
+{
+	pCached = NULL;
+	sqlite3_stmt *stmt = NULL;
+
+	std::map<std::string, DATABASESTATEMENT_s *>::iterator it = g_StatementCache.find ( Command );
+	const bool bCached = ( it != g_StatementCache.end( ));
+	if ( bCached && ( it->second->bInUse == false ))
+	{
+		pCached = it->second;
+		pCached->bInUse = true;
+		return pCached->pStmt;
+	}
+
+	int error = sqlite3_prepare_v2 ( g_db, Command, -1, &stmt, NULL );
+	if ( error != SQLITE_OK )
+	{
+		database_Printf ( "Could not prepare statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
+		return stmt;
+	}
+
+	g_ulNumStatementsPrepared++;
+	if ( bCached == false )
+	{
+		pCached = new DATABASESTATEMENT_s;
+		pCached->pStmt = stmt;
+		pCached->bInUse = true;
+		g_StatementCache[Command] = pCached;
+	}
+
+	return stmt;
+}
+
+//*****************************************************************************
+//
+static void database_ClearStatementCache ( void )
+{
+	for ( std::map<std::string, DATABASESTATEMENT_s *>::iterator it = g_StatementCache.begin( ); it != g_StatementCache.end( ); ++it )
+	{
+		sqlite3_finalize ( it->second->pStmt );
+		delete it->second;
+	}
+	g_StatementCache.clear( );
+}
 
+//*****************************************************************************
+//
 /**
  * \brief Handles the preparation, binding and execution of an SQLite command.
  *
+ * Statements are taken from a cache and reset instead of being finalized, so
+ * that the same SQL is only prepared once. The database is locked for as long
+ * as the command exists.
+ *
  * \author Benjamin Berkels
  */
 class DataBaseCommand
 {
+	std::lock_guard<std::recursive_mutex> _lock;
 	sqlite3_stmt *_stmt;
+	DATABASESTATEMENT_s *_cached;
 public:
-	DataBaseCommand ( const char *Command ) : _stmt ( NULL )
+	DataBaseCommand ( const char *Command ) : _lock ( g_DatabaseMutex ), _stmt ( NULL ), _cached ( NULL )
 	{
-		int error = sqlite3_prepare ( g_db, Command, -1, &_stmt, NULL );
-		if ( error != SQLITE_OK )
-			Printf ( "Could not prepare statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
+		_stmt = database_AcquireStatement ( Command, _cached );
 	}
 
 	~DataBaseCommand ( )
@@ -105,21 +330,31 @@ public:
 	{
 		int error = sqlite3_bind_text ( _stmt, Index, String, -1, SQLITE_STATIC );
 		if ( error != SQLITE_OK )
-			Printf ( "Could not bind text. Error: %s\n", sqlite3_errmsg ( g_db ) );
+			database_Printf ( "Could not bind text. Error: %s\n", sqlite3_errmsg ( g_db ) );
 	}
 
 	void bindInt ( const int Index, const int IntValue )
 	{
 		int error = sqlite3_bind_int ( _stmt, Index, IntValue );
 		if ( error != SQLITE_OK )
-			Printf ( "Could not bind integer. Error: %s\n", sqlite3_errmsg ( g_db ) );
+			database_Printf ( "Could not bind integer. Error: %s\n", sqlite3_errmsg ( g_db ) );
 	}
 
+	// Returns the statement to the cache, or finalizes it if it isn't cached.
 	void finalize ( )
 	{
 		if ( _stmt != NULL )
 		{
-			sqlite3_finalize ( _stmt );
+			if ( _cached != NULL )
+			{
+				sqlite3_reset ( _stmt );
+				sqlite3_clear_bindings ( _stmt );
+				_cached->bInUse = false;
+				_cached = NULL;
+			}
+			else
+				sqlite3_finalize ( _stmt );
+
 			_stmt = NULL;
 		}
 	}
@@ -129,7 +364,7 @@ public:
 		const int result = sqlite3_step ( _stmt );
 		if ( ( result != SQLITE_ROW ) && ( result != SQLITE_DONE ) )
 		{
-			Printf ( "Could not step statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
+			database_Printf ( "Could not step statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
 			finalize ( );
 		}
 
@@ -140,9 +375,9 @@ public:
 	{
 		const int result = sqlite3_step ( _stmt );
 		if ( result == SQLITE_ROW )
-			Printf ( "Executing statement did not finish, sqlite3_step() has another row ready.\n" );
+			database_Printf ( "Executing statement did not finish, sqlite3_step() has another row ready.\n" );
 		else if ( result != SQLITE_DONE )
-			Printf ( "Could not execute statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
+			database_Printf ( "Could not execute statement. Error: %s\n", sqlite3_errmsg ( g_db ) );
 
 		finalize();
 	}
@@ -171,24 +406,355 @@ public:
 };
 
 //*****************************************************************************
-//	FUNCTIONS
+//
+void database_ExecuteCommand ( const char *Command, int (*Callback)(void*,int,char**,char**) = NULL, void *Data = NULL )
+{
+	std::lock_guard<std::recursive_mutex> lock ( g_DatabaseMutex );
 
-void database_ClearHandle ( void )
+	int error = sqlite3_exec ( g_db, Command, Callback, Data, 0);
+	if ( error != SQLITE_OK )
+		database_Printf ( "Error: %s\n", sqlite3_errmsg ( g_db ) );
+}
+
+//*****************************************************************************
+//
+// These do the actual writing, each with a single statement.
+static void database_WriteSetEntry ( const char *Namespace, const char *EntryName, const char *EntryValue )
 {
-	if ( g_db != NULL )
+	DataBaseCommand cmd ( "INSERT OR REPLACE INTO " TABLENAME " VALUES(?1,?2,?3,(" TIMEQUERY "))" );
+	cmd.bindString ( 1, Namespace );
+	cmd.bindString ( 2, EntryName );
+	cmd.bindString ( 3, EntryValue );
+	cmd.exec ( );
+}
+
+//*****************************************************************************
+//
+static void database_WriteDeleteEntry ( const char *Namespace, const char *EntryName )
+{
+	DataBaseCommand cmd ( "DELETE FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2" );
+	cmd.bindString ( 1, Namespace );
+	cmd.bindString ( 2, EntryName );
+	cmd.exec ( );
+}
+
+//*****************************************************************************
+//
+static void database_WriteIncrementEntry ( const char *Namespace, const char *EntryName, int Increment )
+{
+	// A missing entry counts as zero, so this also creates the entry.
+	DataBaseCommand cmd ( "INSERT OR REPLACE INTO " TABLENAME " VALUES(?1,?2,COALESCE((SELECT CAST(Value AS INTEGER) FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2),0)+?3,(" TIMEQUERY "))" );
+	cmd.bindString ( 1, Namespace );
+	cmd.bindString ( 2, EntryName );
+	cmd.bindInt ( 3, Increment );
+	cmd.exec ( );
+}
+
+//*****************************************************************************
+//
+static std::string database_GetOverlayKey ( const std::string &Namespace, const std::string &EntryName )
+{
+	// The length prefix keeps different namespace / key name pairs apart.
+	char prefix[16];
+	mysnprintf ( prefix, sizeof( prefix ), "%u:", static_cast<unsigned int> ( Namespace.size( )));
+	return prefix + Namespace + EntryName;
+}
+
+//*****************************************************************************
+//
+// Updates the overlay to what the database will contain once Write is done.
+// The caller must hold g_WriteQueueMutex.
+static void database_AddToOverlay ( const DATABASEWRITE_s &Write )
+{
+	const std::string key = database_GetOverlayKey ( Write.Namespace, Write.EntryName );
+	std::map<std::string, DATABASEOVERLAY_s>::iterator it = g_WriteOverlay.find ( key );
+
+	if ( it == g_WriteOverlay.end( ))
 	{
-		sqlite3_close ( g_db );
-		g_db = NULL;
+		DATABASEOVERLAY_s entry;
+		entry.State = DBO_INCREMENTED;
+		entry.ulNumPending = 0;
+		it = g_WriteOverlay.insert ( std::make_pair ( key, entry )).first;
+	}
+
+	DATABASEOVERLAY_s *pEntry = &it->second;
+	pEntry->ulNumPending++;
+
+	switch ( Write.Type )
+	{
+	case DBW_SET:
+
+		pEntry->State = DBO_VALUE;
+		pEntry->Value = Write.Value;
+		break;
+
+	case DBW_DELETE:
+
+		pEntry->State = DBO_DELETED;
+		pEntry->Value = "";
+		break;
+
+	case DBW_INCREMENT:
+
+		// Same as COALESCE(CAST(Value AS INTEGER),0)+Increment.
+		if ( pEntry->State != DBO_INCREMENTED )
+		{
+			char value[32];
+			mysnprintf ( value, sizeof( value ), "%lld", strtoll ( pEntry->Value.c_str( ), NULL, 10 ) + Write.iIncrement );
+			pEntry->State = DBO_VALUE;
+			pEntry->Value = value;
+		}
+		break;
 	}
 }
 
 //*****************************************************************************
 //
-void database_ExecuteCommand ( const char *Command, int (*Callback)(void*,int,char**,char**) = NULL, void *Data = NULL )
+// The caller must hold g_DatabaseMutex.
+static void database_ExecuteWrites ( std::vector<DATABASEWRITE_s> &Writes )
 {
-	int error = sqlite3_exec ( g_db, Command, Callback, Data, 0);
-	if ( error != SQLITE_OK )
-		Printf ( "Error: %s\n", sqlite3_errmsg ( g_db ) );
+	if ( Writes.size( ) == 0 )
+		return;
+
+	const bool bTransaction = ( Writes.size( ) > 1 );
+	if ( bTransaction )
+		database_ExecuteCommand ( "BEGIN TRANSACTION" );
+
+	for ( unsigned int i = 0; i < Writes.size( ); i++ )
+	{
+		const DATABASEWRITE_s &write = Writes[i];
+
+		switch ( write.Type )
+		{
+		case DBW_SET:
+
+			database_WriteSetEntry ( write.Namespace.c_str( ), write.EntryName.c_str( ), write.Value.c_str( ));
+			break;
+
+		case DBW_DELETE:
+
+			database_WriteDeleteEntry ( write.Namespace.c_str( ), write.EntryName.c_str( ));
+			break;
+
+		case DBW_INCREMENT:
+
+			database_WriteIncrementEntry ( write.Namespace.c_str( ), write.EntryName.c_str( ), write.iIncrement );
+			break;
+		}
+	}
+
+	if ( bTransaction )
+		database_ExecuteCommand ( "END TRANSACTION" );
+
+	// The database is up to date with these writes now, so they no longer
+	// need to be answered from the overlay.
+	{
+		std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+
+		for ( unsigned int i = 0; i < Writes.size( ); i++ )
+		{
+			std::map<std::string, DATABASEOVERLAY_s>::iterator it = g_WriteOverlay.find ( database_GetOverlayKey ( Writes[i].Namespace, Writes[i].EntryName ));
+
+			if (( it != g_WriteOverlay.end( )) && ( --it->second.ulNumPending == 0 ))
+				g_WriteOverlay.erase ( it );
+		}
+
+		g_ulNumWritesCommitted += Writes.size( );
+		g_ulNumBatches++;
+	}
+
+	Writes.clear( );
+}
+
+//*****************************************************************************
+//
+static bool database_WriterShouldStop ( void )
+{
+	return g_bWriterShutdown;
+}
+
+//*****************************************************************************
+//
+static void database_WriterMain ( void )
+{
+	std::vector<DATABASEWRITE_s> writes;
+	g_bIsWriterThread = true;
+
+	while ( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock ( g_WriteQueueMutex );
+
+			while (( g_WriteQueue.size( ) == 0 ) && ( g_bWriterShutdown == false ))
+				g_WriteQueueCondition.wait ( lock );
+
+			if ( g_WriteQueue.size( ) == 0 )
+				return;
+
+			// Give the game some time to queue more writes, so that they
+			// end up in the same transaction.
+			g_WriteQueueCondition.wait_for ( lock, std::chrono::milliseconds ( DATABASE_WRITE_DELAY ), database_WriterShouldStop );
+		}
+
+		// Take the writes only after locking the database, so that a flush
+		// from the game thread can't overtake us.
+		std::lock_guard<std::recursive_mutex> dbLock ( g_DatabaseMutex );
+		{
+			std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+			writes.swap ( g_WriteQueue );
+		}
+		database_ExecuteWrites ( writes );
+	}
+}
+
+//*****************************************************************************
+//
+static void database_StartWriter ( void )
+{
+	if ( g_bWriterRunning || ( g_db == NULL ))
+		return;
+
+	g_bWriterShutdown = false;
+	g_WriterThread = std::thread ( database_WriterMain );
+	g_bWriterRunning = true;
+}
+
+//*****************************************************************************
+//
+static void database_StopWriter ( void )
+{
+	if ( g_bWriterRunning == false )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+		g_bWriterShutdown = true;
+
+		// An unfinished transaction has to be written now as well.
+		g_WriteQueue.insert ( g_WriteQueue.end( ), g_TransactionWrites.begin( ), g_TransactionWrites.end( ));
+		g_TransactionWrites.clear( );
+	}
+	g_WriteQueueCondition.notify_all( );
+
+	// The writer finishes all queued writes before it exits.
+	g_WriterThread.join( );
+	g_bWriterRunning = false;
+	g_bWriterShutdown = false;
+
+	database_PrintDeferredMessages( );
+}
+
+//*****************************************************************************
+//
+// Starts or stops the writer thread as database_asyncwrites says. An open
+// transaction belongs to the mode it was started in, so the switch waits
+// until it's ended.
+static void database_ApplyWriteMode ( void )
+{
+	if ( g_iTransactionDepth > 0 )
+		return;
+
+	if ( database_asyncwrites )
+		database_StartWriter ( );
+	else
+		database_StopWriter ( );
+}
+
+//*****************************************************************************
+//
+static void database_QueueWrite ( DATABASEWRITE_e Type, const char *Namespace, const char *EntryName, const char *EntryValue, int Increment )
+{
+	std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+	std::vector<DATABASEWRITE_s> &queue = ( g_iTransactionDepth > 0 ) ? g_TransactionWrites : g_WriteQueue;
+
+	queue.resize ( queue.size( ) + 1 );
+	DATABASEWRITE_s &write = queue.back( );
+	write.Type = Type;
+	write.Namespace = Namespace;
+	write.EntryName = EntryName;
+	write.Value = EntryValue;
+	write.iIncrement = Increment;
+
+	database_AddToOverlay ( write );
+	g_ulNumWritesQueued++;
+
+	if ( g_iTransactionDepth == 0 )
+		g_WriteQueueCondition.notify_one( );
+}
+
+//*****************************************************************************
+//
+// Writes everything that is queued right away. Has to be called before any
+// query that the overlay can't answer.
+static void database_FlushWrites ( void )
+{
+	if ( g_bWriterRunning == false )
+		return;
+
+	std::lock_guard<std::recursive_mutex> dbLock ( g_DatabaseMutex );
+	std::vector<DATABASEWRITE_s> writes;
+	{
+		std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+
+		// A query inside a transaction has to see the transaction's writes.
+		g_WriteQueue.insert ( g_WriteQueue.end( ), g_TransactionWrites.begin( ), g_TransactionWrites.end( ));
+		g_TransactionWrites.clear( );
+
+		if ( g_WriteQueue.size( ) == 0 )
+			return;
+
+		writes.swap ( g_WriteQueue );
+		g_ulNumFlushes++;
+	}
+	database_ExecuteWrites ( writes );
+}
+
+//*****************************************************************************
+//
+// Looks up an entry in the overlay. Returns true if the overlay knows what
+// the database will contain for the entry.
+static bool database_CheckOverlay ( const char *Namespace, const char *EntryName, bool &bExists, FString &Value )
+{
+	if ( g_bWriterRunning == false )
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+		std::map<std::string, DATABASEOVERLAY_s>::const_iterator it = g_WriteOverlay.find ( database_GetOverlayKey ( Namespace, EntryName ));
+
+		if ( it == g_WriteOverlay.end( ))
+			return false;
+
+		if ( it->second.State != DBO_INCREMENTED )
+		{
+			bExists = ( it->second.State == DBO_VALUE );
+			Value = it->second.Value.c_str( );
+			g_ulNumOverlayHits++;
+			return true;
+		}
+	}
+
+	// Only the database knows the value the increments are added to.
+	database_FlushWrites( );
+	return false;
+}
+
+//*****************************************************************************
+//
+void database_ClearHandle ( void )
+{
+	database_StopWriter ( );
+
+	// Closing the database ends any transaction.
+	g_iTransactionDepth = 0;
+
+	if ( g_db != NULL )
+	{
+		std::lock_guard<std::recursive_mutex> lock ( g_DatabaseMutex );
+		database_ClearStatementCache ( );
+		sqlite3_close ( g_db );
+		g_db = NULL;
+	}
 }
 
 //*****************************************************************************
@@ -238,12 +804,17 @@ void DATABASE_Init ( void )
 
 	// [BB] Now that the database is ready, we can set the max page count.
 	DATABASE_SetMaxPageCount ( database_maxpagecount );
+
+	if ( database_asyncwrites )
+		database_StartWriter ( );
 }
 
 //*****************************************************************************
 //
 bool DATABASE_IsAvailable ( const char *CallingFunction )
 {
+	database_PrintDeferredMessages ( );
+
 	const bool available = ( g_db != NULL );
 	if ( !available && CallingFunction )
 		Printf ( "%s error: No database.\n", CallingFunction );
@@ -269,7 +840,11 @@ void DATABASE_BeginTransaction ( void )
 	if ( DATABASE_IsAvailable ( "DATABASE_BeginTransaction" ) == false )
 		return;
 
-	database_ExecuteCommand ( "BEGIN TRANSACTION" );
+	// The writer thread commits in transactions anyway, it only needs to
+	// keep the writes of this transaction together. SQLite can't nest
+	// transactions, so only the outermost one is sent to it.
+	if (( g_iTransactionDepth++ == 0 ) && ( g_bWriterRunning == false ))
+		database_ExecuteCommand ( "BEGIN TRANSACTION" );
 }
 
 //*****************************************************************************
@@ -279,7 +854,21 @@ void DATABASE_EndTransaction ( void )
 	if ( DATABASE_IsAvailable ( "DATABASE_EndTransaction" ) == false )
 		return;
 
-	database_ExecuteCommand ( "END TRANSACTION" );
+	if (( g_iTransactionDepth == 0 ) || ( --g_iTransactionDepth > 0 ))
+		return;
+
+	if ( g_bWriterRunning )
+	{
+		std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+		g_WriteQueue.insert ( g_WriteQueue.end( ), g_TransactionWrites.begin( ), g_TransactionWrites.end( ));
+		g_TransactionWrites.clear( );
+		g_WriteQueueCondition.notify_one( );
+	}
+	else
+		database_ExecuteCommand ( "END TRANSACTION" );
+
+	// database_asyncwrites may have been changed during the transaction.
+	database_ApplyWriteMode ( );
 }
 
 //*****************************************************************************
@@ -290,6 +879,10 @@ void DATABASE_CreateTable ( )
 		return;
 
 	database_ExecuteCommand ( "CREATE TABLE if not exists " TABLENAME "(Namespace text, KeyName text, Value text, Timestamp text, PRIMARY KEY (Namespace, KeyName))" );
+
+	// Lets ranks and sorted entries be looked up without casting and sorting
+	// every entry of the namespace.
+	database_ExecuteCommand ( "CREATE INDEX if not exists " TABLENAME "IntegerValues ON " TABLENAME "(Namespace, " INTEGERVALUE ")" );
 }
 
 //*****************************************************************************
@@ -299,6 +892,8 @@ void DATABASE_ClearTable ( )
 	if ( DATABASE_IsAvailable ( "DATABASE_ClearTable" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	database_ExecuteCommand ( "DELETE FROM " TABLENAME );
 }
 
@@ -309,6 +904,8 @@ void DATABASE_DeleteTable ( )
 	if ( DATABASE_IsAvailable ( "DATABASE_DeleteTable" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	database_ExecuteCommand ( "DROP TABLE " TABLENAME );
 }
 
@@ -330,6 +927,8 @@ void DATABASE_DumpTable ( )
 	if ( DATABASE_IsAvailable ( "DATABASE_DumpTable" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	Printf ( "Dumping table \"%s\"\n", TABLENAME );
 	database_ExecuteCommand ( "SELECT * from " TABLENAME, database_DumpTableCallback );
 }
@@ -341,6 +940,8 @@ void DATABASE_EnableWAL ( )
 	if ( DATABASE_IsAvailable ( "DATABASE_EnableWAL" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	database_ExecuteCommand ( "PRAGMA journal_mode=WAL" );
 }
 
@@ -351,6 +952,8 @@ void DATABASE_DisableWAL ( )
 	if ( DATABASE_IsAvailable ( "DATABASE_DisableWAL" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	database_ExecuteCommand ( "PRAGMA journal_mode=DELETE" );
 }
 
@@ -361,6 +964,8 @@ void DATABASE_DumpNamespace ( const char *Namespace )
 	if ( DATABASE_IsAvailable ( "DATABASE_DumpNamespace" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	Printf ( "Dumping namespace \"%s\"\n", Namespace );
 	DataBaseCommand cmd ( "SELECT * from " TABLENAME " WHERE Namespace=?1" );
 	cmd.bindString ( 1, Namespace );
@@ -376,6 +981,8 @@ void DATABASE_AddEntry ( const char *Namespace, const char *EntryName, const cha
 	if ( DATABASE_IsAvailable ( "DATABASE_AddEntry" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	DataBaseCommand cmd ( "INSERT INTO " TABLENAME " VALUES(?1,?2,?3,(" TIMEQUERY "))" );
 	cmd.bindString ( 1, Namespace );
 	cmd.bindString ( 2, EntryName );
@@ -390,6 +997,8 @@ void DATABASE_SetEntry ( const char *Namespace, const char *EntryName, const cha
 	if ( DATABASE_IsAvailable ( "DATABASE_SetEntry" ) == false )
 		return;
 
+	database_FlushWrites ( );
+
 	DataBaseCommand cmd ( "UPDATE " TABLENAME " SET Value=?3,Timestamp=(" TIMEQUERY ") WHERE Namespace=?1 AND KeyName=?2" );
 	cmd.bindString ( 1, Namespace );
 	cmd.bindString ( 2, EntryName );
@@ -404,11 +1013,15 @@ FString DATABASE_GetEntry ( const char *Namespace, const char *EntryName )
 	if ( DATABASE_IsAvailable ( "DATABASE_GetEntry" ) == false )
 		return "";
 
+	bool exists;
+	FString value;
+	if ( database_CheckOverlay ( Namespace, EntryName, exists, value ))
+		return value;
+
 	DataBaseCommand cmd ( "SELECT * FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2" );
 	cmd.bindString ( 1, Namespace );
 	cmd.bindString ( 2, EntryName );
 	cmd.step( );
-	FString value;
 	value.AppendFormat ( "%s", cmd.getText(2) );
 	// [BB] We assume that the query will return exactly one row. So we finish stepping now.
 	cmd.exec( );
@@ -422,6 +1035,11 @@ bool DATABASE_EntryExists ( const char *Namespace, const char *EntryName )
 	if ( DATABASE_IsAvailable ( "DATABASE_GetEntry" ) == false )
 		return "";
 
+	bool exists;
+	FString value;
+	if ( database_CheckOverlay ( Namespace, EntryName, exists, value ))
+		return exists;
+
 	DataBaseCommand cmd ( "SELECT * FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2" );
 	cmd.bindString ( 1, Namespace );
 	cmd.bindString ( 2, EntryName );
@@ -436,10 +1054,8 @@ void DATABASE_DeleteEntry ( const char *Namespace, const char *EntryName )
 	if ( DATABASE_IsAvailable ( "DATABASE_DeleteEntry" ) == false )
 		return;
 
-	DataBaseCommand cmd ( "DELETE FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2" );
-	cmd.bindString ( 1, Namespace );
-	cmd.bindString ( 2, EntryName );
-	cmd.exec ( );
+	database_FlushWrites ( );
+	database_WriteDeleteEntry ( Namespace, EntryName );
 }
 
 //*****************************************************************************
@@ -449,17 +1065,16 @@ void DATABASE_SaveSetEntry ( const char *Namespace, const char *EntryName, const
 	if ( DATABASE_IsAvailable ( "DATABASE_SaveSetEntry" ) == false )
 		return;
 
-	if ( DATABASE_EntryExists ( Namespace, EntryName ) )
-	{
-		// [BB] Setting an entry to the empty string deletes the entry.
-		if ( EntryValue && ( strlen ( EntryValue ) > 0 ) )
-			DATABASE_SetEntry ( Namespace, EntryName, EntryValue );
-		else
-			DATABASE_DeleteEntry ( Namespace, EntryName );
-	}
+	// [BB] Setting an entry to the empty string deletes the entry.
 	// [BB] Don't store empty string entries.
-	else if ( EntryValue && ( strlen ( EntryValue ) > 0 ) )
-		DATABASE_AddEntry ( Namespace, EntryName, EntryValue );
+	const bool bDelete = ( ( EntryValue == NULL ) || ( strlen ( EntryValue ) == 0 ) );
+
+	if ( g_bWriterRunning )
+		database_QueueWrite ( bDelete ? DBW_DELETE : DBW_SET, Namespace, EntryName, bDelete ? "" : EntryValue, 0 );
+	else if ( bDelete )
+		database_WriteDeleteEntry ( Namespace, EntryName );
+	else
+		database_WriteSetEntry ( Namespace, EntryName, EntryValue );
 }
 
 //*****************************************************************************
@@ -478,10 +1093,17 @@ FString DATABASE_SaveGetEntry ( const char *Namespace, const char *EntryName )
 	if ( DATABASE_IsAvailable ( "DATABASE_SaveGetEntry" ) == false )
 		return "";
 
-	if ( DATABASE_EntryExists ( Namespace, EntryName ) )
-		return DATABASE_GetEntry ( Namespace, EntryName );
-	else
-		return "";
+	bool exists;
+	FString value;
+	if ( database_CheckOverlay ( Namespace, EntryName, exists, value ))
+		return value;
+
+	DataBaseCommand cmd ( "SELECT Value FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2" );
+	cmd.bindString ( 1, Namespace );
+	cmd.bindString ( 2, EntryName );
+	if ( cmd.step( ) )
+		value.AppendFormat ( "%s", cmd.getText(0) );
+	return value;
 }
 
 //*****************************************************************************
@@ -491,21 +1113,10 @@ void DATABASE_SaveIncrementEntryInt ( const char *Namespace, const char *EntryNa
 	if ( DATABASE_IsAvailable ( "DATABASE_SaveIncrementEntryInt" ) == false )
 		return;
 
-	FString newVal;
-	if ( DATABASE_EntryExists ( Namespace, EntryName ) )
-	{
-		// [BB] Get the old value and set the incremented value in a single query.
-		DataBaseCommand cmd ( "UPDATE " TABLENAME " SET Value=(SELECT CAST(Value AS INTEGER) FROM " TABLENAME " WHERE Namespace=?1 AND KeyName=?2)+?3,Timestamp=(" TIMEQUERY ") WHERE Namespace=?1 AND KeyName=?2" );
-		cmd.bindString ( 1, Namespace );
-		cmd.bindString ( 2, EntryName );
-		cmd.bindInt ( 3, Increment );
-		cmd.exec ( );
-	}
+	if ( g_bWriterRunning )
+		database_QueueWrite ( DBW_INCREMENT, Namespace, EntryName, "", Increment );
 	else
-	{
-		newVal.AppendFormat ( "%d", Increment );
-		DATABASE_AddEntry ( Namespace, EntryName, newVal.GetChars() );
-	}
+		database_WriteIncrementEntry ( Namespace, EntryName, Increment );
 }
 
 //*****************************************************************************
@@ -515,15 +1126,17 @@ int DATABASE_GetEntryRank ( const char *Namespace, const char *EntryName, const
 	if ( DATABASE_IsAvailable ( "DATABASE_GetEntryRank" ) == false )
 		return -1;
 
+	database_FlushWrites ( );
+
 	if ( DATABASE_EntryExists ( Namespace, EntryName ) )
 	{
 		// [BB] To get the rank of a certain entry, we get the value of the entry,
 		// count how many values are lower (or higher) than the value and return
 		// the count + 1.
 		FString commandString;
-		commandString.Format ( "SELECT COUNT(*) from " TABLENAME " WHERE Namespace=?1 AND CAST(Value AS INTEGER)" );
+		commandString.Format ( "SELECT COUNT(*) from " TABLENAME " WHERE Namespace=?1 AND " INTEGERVALUE );
 		commandString += Descending ? ">" : "<";
-		commandString += ( "(SELECT CAST(Value AS INTEGER) FROM " TABLENAME " WHERE Namespace=?2 AND KeyName=?3)" );
+		commandString += ( "(SELECT " INTEGERVALUE " FROM " TABLENAME " WHERE Namespace=?2 AND KeyName=?3)" );
 		DataBaseCommand cmd ( commandString.GetChars() );
 		cmd.bindString ( 1, Namespace );
 		cmd.bindString ( 2, Namespace );
@@ -548,8 +1161,10 @@ int DATABASE_GetSortedEntries ( const char *Namespace, const int N, const int Of
 		return 0;
 	}
 
+	database_FlushWrites ( );
+
 	FString commandString;
-	commandString.Format ( "SELECT * from " TABLENAME " WHERE Namespace=?1 ORDER BY CAST(Value AS INTEGER) " );
+	commandString.Format ( "SELECT * from " TABLENAME " WHERE Namespace=?1 ORDER BY " INTEGERVALUE " " );
 	commandString += Descending ? "DESC" : "ASC";
 	commandString += " LIMIT ?2 OFFSET ?3";
 	DataBaseCommand cmd ( commandString.GetChars() );
@@ -570,6 +1185,8 @@ int DATABASE_GetEntries ( const char *Namespace, TArray<std::pair<FString, FStri
 		return 0;
 	}
 
+	database_FlushWrites ( );
+
 	DataBaseCommand cmd ( "SELECT * from " TABLENAME " WHERE Namespace=?1" );
 	cmd.bindString ( 1, Namespace );
 	cmd.iterateAndGetReturnedEntries ( Entries );
@@ -601,3 +1218,22 @@ CCMD ( db_disable_wal )
 
 	DATABASE_DisableWAL();
 }
+
+//*****************************************************************************
+//	STATISTICS
+
+ADD_STAT( database )
+{
+	FString	Out;
+	std::lock_guard<std::mutex> lock ( g_WriteQueueMutex );
+
+	Out.Format( "%lu writes queued, %lu committed in %lu batches, %u waiting, %lu overlay hits, %lu flushes, %lu statements prepared",
+		g_ulNumWritesQueued,
+		g_ulNumWritesCommitted,
+		g_ulNumBatches,
+		static_cast<unsigned int> ( g_WriteQueue.size( ) + g_TransactionWrites.size( )),
+		g_ulNumOverlayHits,
+		g_ulNumFlushes,
+		g_ulNumStatementsPrepared );
+	return ( Out );
+}
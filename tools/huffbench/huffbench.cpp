@@ -0,0 +1,232 @@
+//-----------------------------------------------------------------------------
+//
+// Zandronum Source
+// Copyright (C) 2026 Zandronum Development Team
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+// 3. Neither the name of the Zandronum Development Team nor the names of its
+//    contributors may be used to endorse or promote products derived from this
+//    software without specific prior written permission.
+// 4. Redistributions in any form must be accompanied by information on how to
+//    obtain complete source code for the software and any accompanying
+//    software that uses the software. The source code must either be included
+//    in the distribution or be available for no more than the cost of
+//    distribution plus a nominal fee, and must be freely redistributable
+//    under reasonable conditions. For an executable file, complete source
+//    code means the source code for all modules it contains. It does not
+//    include source code for modules or files that typically accompany the
+//    major components of the operating system on which the executable file
+//    runs.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//
+//
+// Filename: huffbench.cpp
+//
+// Description: Replays captured packets through the table driven Huffman codec
+// and the reference bit-at-a-time one, checks that both produce the same output
+// and reports their throughput for decoding and encoding.
+//
+// Usage: huffbench [capture file] [passes]
+//
+// The capture file is written by starting a server or client with
+// "-capturepackets <file>". Without one, synthetic packets are used.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "huffman.h"
+
+using namespace skulltag;
+
+//*****************************************************************************
+//	DEFINES
+
+// Size of the decode buffers, matches g_ucHuffmanBuffer in network.cpp.
+#define	MAX_PACKET_SIZE		131072
+
+// Number of packets to generate if no capture file is given.
+#define	NUM_SYNTHETIC_PACKETS	20000
+
+//*****************************************************************************
+//	VARIABLES
+
+// The encoded packets and what they decode to.
+static	std::vector<std::vector<unsigned char> >	g_Packets;
+static	std::vector<std::vector<unsigned char> >	g_Payloads;
+static	size_t										g_ulTotalBytes = 0;
+static	size_t										g_ulTotalPayloadBytes = 0;
+
+//*****************************************************************************
+//	FUNCTIONS
+
+static bool huffbench_LoadCapture( const char *pszFileName )
+{
+	FILE *pFile = fopen( pszFileName, "rb" );
+	if ( pFile == NULL )
+	{
+		printf( "Can't open %s.\n", pszFileName );
+		return ( false );
+	}
+
+	unsigned char	ucLength[4];
+	while ( fread( ucLength, 1, sizeof( ucLength ), pFile ) == sizeof( ucLength ))
+	{
+		const size_t ulLength = ucLength[0] | ( ucLength[1] << 8 ) | ( ucLength[2] << 16 ) | ( ucLength[3] << 24 );
+		if ( ulLength > MAX_PACKET_SIZE )
+		{
+			printf( "%s is corrupt.\n", pszFileName );
+			break;
+		}
+
+		std::vector<unsigned char> packet( ulLength );
+		if ( fread( packet.data(), 1, ulLength, pFile ) != ulLength )
+			break;
+
+		// Unencoded packets never reach the decoder.
+		if (( ulLength == 0 ) || ( packet[0] == 0xff ))
+			continue;
+
+		g_ulTotalBytes += ulLength;
+		g_Packets.push_back( packet );
+	}
+
+	fclose( pFile );
+	return ( g_Packets.size( ) > 0 );
+}
+
+//*****************************************************************************
+//
+static void huffbench_GenerateSynthetic( void )
+{
+	unsigned char	ucBits[1024];
+	unsigned char	ucData[MAX_PACKET_SIZE];
+	unsigned char	ucEncoded[MAX_PACKET_SIZE];
+
+	srand( 0 );
+	for ( int i = 0; i < NUM_SYNTHETIC_PACKETS; i++ )
+	{
+		// Decoding random bits gives data with the byte distribution the tree was built for.
+		const int iBitsLength = 8 + rand( ) % ( sizeof( ucBits ) - 8 );
+		ucBits[0] = 0;
+		for ( int j = 1; j < iBitsLength; j++ )
+			ucBits[j] = static_cast<unsigned char>( rand( ));
+
+		const int iLength = HUFFMAN_GetCodec( )->decodeBitwise( ucBits, ucData, iBitsLength, sizeof( ucData ));
+		int iEncodedLength = sizeof( ucEncoded );
+		HUFFMAN_Encode( ucData, ucEncoded, iLength, &iEncodedLength );
+		if (( iEncodedLength == 0 ) || ( ucEncoded[0] == 0xff ))
+			continue;
+
+		g_ulTotalBytes += iEncodedLength;
+		g_Packets.push_back( std::vector<unsigned char>( ucEncoded, ucEncoded + iEncodedLength ));
+	}
+}
+
+//*****************************************************************************
+//
+template <typename CodecFunction>
+static double huffbench_Run( const char *pszName, int iPasses, const std::vector<std::vector<unsigned char> > &Input, size_t ulInputBytes, CodecFunction Function )
+{
+	static unsigned char	ucOutput[MAX_PACKET_SIZE];
+
+	const auto start = std::chrono::steady_clock::now( );
+	for ( int iPass = 0; iPass < iPasses; iPass++ )
+	{
+		for ( size_t i = 0; i < Input.size( ); i++ )
+			Function( Input[i].data( ), ucOutput, static_cast<int>( Input[i].size( )), static_cast<int>( sizeof( ucOutput )));
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now( ) - start;
+
+	const double dMegabytes = static_cast<double>( ulInputBytes ) * iPasses / ( 1024.0 * 1024.0 );
+	printf( "%-16s %8.3f s  %9.2f MB/s\n", pszName, elapsed.count( ), dMegabytes / elapsed.count( ));
+	return ( elapsed.count( ));
+}
+
+//*****************************************************************************
+//
+int main( int argc, char **argv )
+{
+	HUFFMAN_Construct( );
+	HuffmanCodec *pCodec = HUFFMAN_GetCodec( );
+
+	if ( argc > 1 )
+	{
+		if ( huffbench_LoadCapture( argv[1] ) == false )
+		{
+			printf( "No encoded packets in %s.\n", argv[1] );
+			return ( 1 );
+		}
+	}
+	else
+		huffbench_GenerateSynthetic( );
+
+	const int iPasses = ( argc > 2 ) ? atoi( argv[2] ) : 10;
+
+	// Both implementations must agree byte for byte on every packet.
+	static unsigned char	ucReference[MAX_PACKET_SIZE];
+	static unsigned char	ucOutput[MAX_PACKET_SIZE];
+	static unsigned char	ucEncoded[MAX_PACKET_SIZE];
+	for ( size_t i = 0; i < g_Packets.size( ); i++ )
+	{
+		const int iLength = static_cast<int>( g_Packets[i].size( ));
+		const int iReference = pCodec->decodeBitwise( g_Packets[i].data( ), ucReference, iLength, sizeof( ucReference ));
+		const int iOutput = pCodec->decode( g_Packets[i].data( ), ucOutput, iLength, sizeof( ucOutput ));
+		if (( iReference != iOutput ) || ( memcmp( ucReference, ucOutput, iOutput ) != 0 ))
+		{
+			printf( "Packet %u: decoders disagree.\n", static_cast<unsigned int>( i ));
+			return ( 1 );
+		}
+
+		g_ulTotalPayloadBytes += iOutput;
+		g_Payloads.push_back( std::vector<unsigned char>( ucOutput, ucOutput + iOutput ));
+
+		const int iReferenceEncoded = pCodec->encodeBitwise( ucOutput, ucReference, iOutput, sizeof( ucReference ));
+		const int iEncoded = pCodec->encode( ucOutput, ucEncoded, iOutput, sizeof( ucEncoded ));
+		if (( iReferenceEncoded != iEncoded ) || (( iEncoded > 0 ) && ( memcmp( ucReference, ucEncoded, iEncoded ) != 0 )))
+		{
+			printf( "Packet %u: encoders disagree.\n", static_cast<unsigned int>( i ));
+			return ( 1 );
+		}
+	}
+
+	printf( "%u packets, %u encoded bytes, %u decoded bytes, %d passes\n", static_cast<unsigned int>( g_Packets.size( )),
+		static_cast<unsigned int>( g_ulTotalBytes ), static_cast<unsigned int>( g_ulTotalPayloadBytes ), iPasses );
+
+	const double dDecodeBitwise = huffbench_Run( "decode bitwise", iPasses, g_Packets, g_ulTotalBytes, [pCodec]( const unsigned char *pIn, unsigned char *pOut, int iIn, int iOut )
+		{ return pCodec->decodeBitwise( pIn, pOut, iIn, iOut ); } );
+	const double dDecodeTable = huffbench_Run( "decode table", iPasses, g_Packets, g_ulTotalBytes, [pCodec]( const unsigned char *pIn, unsigned char *pOut, int iIn, int iOut )
+		{ return pCodec->decode( pIn, pOut, iIn, iOut ); } );
+	printf( "decode speedup   %8.2fx\n", dDecodeBitwise / dDecodeTable );
+
+	const double dEncodeBitwise = huffbench_Run( "encode bitwise", iPasses, g_Payloads, g_ulTotalPayloadBytes, [pCodec]( const unsigned char *pIn, unsigned char *pOut, int iIn, int iOut )
+		{ return pCodec->encodeBitwise( pIn, pOut, iIn, iOut ); } );
+	const double dEncodeTable = huffbench_Run( "encode table", iPasses, g_Payloads, g_ulTotalPayloadBytes, [pCodec]( const unsigned char *pIn, unsigned char *pOut, int iIn, int iOut )
+		{ return pCodec->encode( pIn, pOut, iIn, iOut ); } );
+	printf( "encode speedup   %8.2fx\n", dEncodeBitwise / dEncodeTable );
+
+	return ( 0 );
+}